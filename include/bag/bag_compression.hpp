@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "bag/bag_exception.hpp"
+
+/**
+ * Codec of the records of a chunk, stored in BagChunkHeader::compression.
+ */
+enum class BagCompression : std::uint32_t {
+  kNone = 0,
+
+  /**
+   * Byte oriented LZ77 in the style of LZ4 blocks, built for decompression speed over ratio.
+   */
+  kLZ = 1
+};
+
+/**
+ * Get the largest size lzCompress() can produce for an input.
+ * @param size The size of the input.
+ * @return The size the output must have room for.
+ */
+std::size_t lzCompressBound(std::size_t size);
+
+/**
+ * Compress bytes as a sequence of literal runs and back references within the last 64 KiB.
+ * @param input The bytes to compress.
+ * @param output Buffer of at least lzCompressBound(input.size()) bytes.
+ * @return The size of the compressed bytes at the start of the output.
+ */
+std::size_t lzCompress(std::span<std::uint8_t const> input, std::span<std::uint8_t> output);
+
+/**
+ * Decompress the output of lzCompress(). Every length and back reference is checked, so corrupt input only throws.
+ * @param input The compressed bytes.
+ * @param output Buffer of exactly the size of the bytes that were compressed.
+ * @throws BagException Throws exception if the input is corrupt or does not decompress to exactly the output's size.
+ */
+void lzDecompress(std::span<std::uint8_t const> input, std::span<std::uint8_t> output);
@@ -0,0 +1,19 @@
+#ifndef MROS_BAG_EXCEPTION_HPP
+#define MROS_BAG_EXCEPTION_HPP
+
+#include <stdexcept>
+#include <string>
+
+/**
+ * Runtime error to throw on failures to write or read a bag file.
+ */
+class BagException : public std::runtime_error {
+ public:
+  /**
+   * Constructor to produce runtime error that will throw an informative error message.
+   * @param error_message Error message detailing context of error.
+   */
+  explicit BagException(const std::string& error_message) : std::runtime_error("BagException: " + error_message) {}
+};
+
+#endif  // MROS_BAG_EXCEPTION_HPP
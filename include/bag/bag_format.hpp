@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+/**
+ * Layout of a bag file, all in host byte order:
+ *
+ *   BagFileHeader
+ *   chunk 0: BagChunkHeader | stored_size bytes of records | index_entry_count BagIndexEntry
+ *   chunk 1: ...
+ *   BagIndexHeader | topic_count topics | chunk_count chunks
+ *
+ * A record is a BagRecordHeader followed by the frame exactly as it was received from the Publisher, the
+ * TopicFrameHeader then the encoded message. Records carrying kTopicDefinitionID name the topic that later records of
+ * a topic ID belong to, so that a file cut short by a crash can still be read chunk by chunk. Each chunk's index holds
+ * the time, topic, and offset of every message record in the chunk, sorted by time. The file index at the end is only
+ * written when the bag is closed, and lists the topics and, for each chunk, its time range and the topics it holds.
+ *
+ * In the file index, a topic is a uint32 ID and uint32 name length followed by the name, and a chunk is a BagChunkInfo
+ * followed by topic_count BagChunkTopic.
+ */
+
+/**
+ * Magic at the start of a bag file.
+ */
+inline constexpr std::array<char, 8> kBagMagic = {'M', 'R', 'O', 'S', 'B', 'A', 'G', '\0'};
+
+/**
+ * Version of the layout written.
+ */
+inline constexpr std::uint32_t kBagFormatVersion = 1;
+
+/**
+ * Magic at the start of every chunk and of the file index.
+ */
+inline constexpr std::uint32_t kBagChunkMagic = 0x4B4E4843;  // "CHNK"
+inline constexpr std::uint32_t kBagIndexMagic = 0x58444E49;  // "INDX"
+
+/**
+ * Topic ID of the records defining a topic. Their payload is the uint32 ID being defined followed by the topic name.
+ */
+inline constexpr std::uint32_t kTopicDefinitionID = 0xFFFFFFFF;
+
+/**
+ * Header at the start of a bag file. index_offset is zero until the bag is closed.
+ */
+struct BagFileHeader {
+  std::array<char, 8> magic;
+  std::uint32_t format_version;
+  std::uint32_t flags;
+  std::uint64_t index_offset;
+  std::uint64_t chunk_count;
+};
+
+/**
+ * Header of a chunk. compression is the BagCompression of the records, stored_size the size of the records as stored,
+ * and data_size their size once decompressed, equal unless compression is used. The chunk's index is not compressed.
+ */
+struct BagChunkHeader {
+  std::uint32_t magic;
+  std::uint32_t compression;
+  std::uint64_t stored_size;
+  std::uint64_t data_size;
+  std::uint32_t record_count;
+  std::uint32_t index_entry_count;
+  std::int64_t start_time_ns;
+  std::int64_t end_time_ns;
+};
+
+/**
+ * Header of a record, followed by size bytes of frame.
+ */
+struct BagRecordHeader {
+  std::int64_t receive_time_ns;
+  std::uint32_t topic_id;
+  std::uint32_t size;
+};
+
+/**
+ * Entry of a chunk's index. offset is that of the record header within the chunk's decompressed records.
+ */
+struct BagIndexEntry {
+  std::int64_t receive_time_ns;
+  std::uint32_t topic_id;
+  std::uint32_t offset;
+};
+
+/**
+ * Header of the file index.
+ */
+struct BagIndexHeader {
+  std::uint32_t magic;
+  std::uint32_t topic_count;
+  std::uint64_t chunk_count;
+};
+
+/**
+ * A chunk in the file index.
+ */
+struct BagChunkInfo {
+  std::uint64_t offset;
+  std::int64_t start_time_ns;
+  std::int64_t end_time_ns;
+  std::uint32_t record_count;
+  std::uint32_t topic_count;
+};
+
+/**
+ * Number of message records of a topic in a chunk, in the file index.
+ */
+struct BagChunkTopic {
+  std::uint32_t topic_id;
+  std::uint32_t count;
+};
+
+static_assert(sizeof(BagFileHeader) == 32 && sizeof(BagChunkHeader) == 48 && sizeof(BagRecordHeader) == 16 &&
+              sizeof(BagIndexEntry) == 16 && sizeof(BagIndexHeader) == 16 && sizeof(BagChunkInfo) == 32 &&
+              sizeof(BagChunkTopic) == 8);
+
+/**
+ * View the bytes of one of the layout structs for writing.
+ */
+template <typename StructT>
+  requires std::is_trivially_copyable_v<StructT>
+std::span<std::uint8_t const> bagBytes(StructT const &value) {
+  return {reinterpret_cast<std::uint8_t const *>(&value), sizeof(StructT)};
+}
+
+/**
+ * Read one of the layout structs from bytes that may not be aligned.
+ * @return False if there are too few bytes, true otherwise.
+ */
+template <typename StructT>
+  requires std::is_trivially_copyable_v<StructT>
+bool readBagStruct(std::span<std::uint8_t const> bytes, StructT &value) {
+  if (bytes.size() < sizeof(StructT)) return false;
+  std::memcpy(&value, bytes.data(), sizeof(StructT));
+  return true;
+}
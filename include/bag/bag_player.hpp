@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bag/bag_reader.hpp"
+#include "messages/raw_message.hpp"
+#include "mros/node.hpp"
+
+/**
+ * Options of a BagPlayer.
+ */
+struct BagPlayerOptions {
+  /**
+   * Speed of playback relative to the recording. Zero or less to play as fast as possible.
+   */
+  double rate = 1;
+
+  /**
+   * Time to start playing from, relative to the earliest message of the bags.
+   */
+  std::chrono::nanoseconds start_offset{0};
+
+  /**
+   * Topics to play. Empty for all.
+   */
+  std::vector<std::string> topic_names;
+
+  /**
+   * Time to wait after creating the publishers so that subscribers can connect before the first message.
+   */
+  std::chrono::milliseconds publisher_delay{500};
+
+  /**
+   * Number of threads decompressing chunks ahead of playback. Zero to decompress on the playing thread.
+   */
+  std::size_t decompression_thread_count = 2;
+};
+
+/**
+ * Counters of a playback.
+ */
+struct BagPlayerStatistics {
+  std::uint64_t message_count = 0;
+  std::uint64_t frame_bytes = 0;
+  double elapsed_s = 0;
+};
+
+/**
+ * Replays bags through Publishers on a Node, merging several bags by time. Frames go from the bag's mapping to the
+ * sockets without being decoded or copied.
+ */
+class BagPlayer {
+ public:
+  /**
+   * Open the bags and create a Publisher for each topic to play.
+   * @param node The Node to create the publishers on.
+   * @param paths The bags to play.
+   * @param options The speed, start, and topics of playback.
+   * @throws BagException Throws exception if a bag cannot be read.
+   */
+  BagPlayer(std::shared_ptr<Node> const &node, std::vector<std::string> const &paths, BagPlayerOptions options = {});
+
+  /**
+   * Play the bags to the end.
+   * @param keep_playing Checked before each message and while waiting for one. Playback stops once it returns false.
+   * @return The counters of the playback.
+   */
+  BagPlayerStatistics play(std::function<bool()> const &keep_playing);
+
+  /**
+   * Get the time of the earliest message of the bags.
+   */
+  std::int64_t startTime() const;
+
+ private:
+  /**
+   * Wait until a deadline, waking up regularly to check whether playback should stop.
+   * @return False if playback should stop, true otherwise.
+   */
+  static bool waitUntil(std::chrono::steady_clock::time_point deadline, std::function<bool()> const &keep_playing);
+
+  std::vector<std::unique_ptr<BagReader>> readers_;
+  BagPlayerOptions options_;
+  std::unordered_map<std::string, std::shared_ptr<Publisher<RawMessage>>> publishers_;
+
+  /**
+   * Longest time waitUntil() sleeps before checking whether playback should stop.
+   */
+  static constexpr std::chrono::milliseconds kStopCheckPeriod_{100};
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "bag/bag_compression.hpp"
+#include "bag/bag_exception.hpp"
+#include "bag/bag_format.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+/**
+ * A chunk of a bag as listed in the file index.
+ */
+struct BagChunk {
+  std::uint64_t offset;
+  std::int64_t start_time_ns;
+  std::int64_t end_time_ns;
+  std::uint32_t message_count;
+  std::vector<BagChunkTopic> topics;
+};
+
+/**
+ * A message read from a bag. The frame points into the bag's mapping, or into the buffer of the stream that read it.
+ */
+struct BagMessage {
+  std::string const *topic_name;
+  std::int64_t receive_time_ns;
+
+  /**
+   * The frame as it was received: the TopicFrameHeader then the encoded message.
+   */
+  std::span<std::uint8_t const> frame;
+};
+
+/**
+ * Read only memory mapping of a bag file written by BagWriter. A bag without a file index, cut short by a crash, is
+ * read by scanning its chunks up to the first incomplete one.
+ */
+class BagReader {
+ public:
+  /**
+   * Map a bag file and read its index.
+   * @param path The path of the file.
+   * @throws BagException Throws exception if the file cannot be mapped or is not a bag.
+   */
+  explicit BagReader(std::string const &path);
+
+  /**
+   * Unmap the file.
+   */
+  ~BagReader();
+
+  BagReader(BagReader const &other) = delete;
+
+  void operator=(BagReader const &other) = delete;
+
+  /**
+   * Get the path of the file.
+   */
+  std::string const &path() const;
+
+  /**
+   * Get the names of the topics by topic ID.
+   */
+  std::vector<std::string> const &topics() const;
+
+  /**
+   * Get the chunks in file order.
+   */
+  std::vector<BagChunk> const &chunks() const;
+
+  /**
+   * Check whether the bag was closed properly, rather than recovered by scanning.
+   */
+  bool indexed() const;
+
+  /**
+   * Get the time of the earliest and latest message, or zero for an empty bag.
+   */
+  std::int64_t startTime() const;
+  std::int64_t endTime() const;
+
+  /**
+   * Get the header of a chunk.
+   */
+  BagChunkHeader chunkHeader(BagChunk const &chunk) const;
+
+  /**
+   * Get the records of a chunk.
+   * @param chunk The chunk.
+   * @param buffer Buffer to hold the records if they have to be decoded, such as when the chunk is compressed.
+   * @return The records, pointing into the mapping when they are stored as is, or into the buffer otherwise.
+   * @throws BagException Throws exception if the chunk cannot be decoded.
+   */
+  std::span<std::uint8_t const> chunkRecords(BagChunk const &chunk, std::vector<std::uint8_t> &buffer) const;
+
+  /**
+   * Get the index of a chunk, BagIndexEntry sorted by time.
+   */
+  std::span<std::uint8_t const> chunkIndex(BagChunk const &chunk) const;
+
+ private:
+  /**
+   * Read the file index written when the bag was closed.
+   */
+  void readFileIndex(std::uint64_t index_offset);
+
+  /**
+   * Rebuild the index of a bag without one from its chunks.
+   */
+  void recoverIndex();
+
+  /**
+   * Get the bytes of the file from an offset, throwing if there are fewer than size.
+   */
+  std::span<std::uint8_t const> bytesAt(std::uint64_t offset, std::uint64_t size) const;
+
+  std::string path_;
+
+  /**
+   * Mapping of the whole file.
+   */
+  std::uint8_t const *data_ = nullptr;
+  std::size_t size_ = 0;
+
+  std::vector<std::string> topics_;
+  std::vector<BagChunk> chunks_;
+  bool indexed_ = false;
+};
+
+/**
+ * Stream of the messages of one or more bags in time order. Chunks are only opened once the stream reaches their
+ * start time, and the open chunks are merged through a heap, so that bags are streamed without being read ahead and
+ * bags recorded at the same time are interleaved correctly. Compressed chunks can be decompressed ahead of the stream
+ * on a pool of threads, so that playback is not limited by the speed of one core.
+ */
+class BagMessageStream {
+ public:
+  /**
+   * Start a stream.
+   * @param readers The bags to merge. Must outlive the stream.
+   * @param start_time_ns Time of the first message streamed. Chunks ending earlier are skipped through the chunk index
+   * and the first message of the others is found by binary search of their index.
+   * @param topic_names The topics to stream. Empty for all.
+   * @param decompression_thread_count Number of threads decompressing the next chunks ahead of the stream. Zero to
+   * decompress each chunk on the calling thread when the stream reaches it.
+   */
+  explicit BagMessageStream(std::vector<BagReader const *> readers,
+                            std::int64_t start_time_ns = std::numeric_limits<std::int64_t>::min(),
+                            std::vector<std::string> const &topic_names = {},
+                            std::size_t decompression_thread_count = 0);
+
+  /**
+   * Get the next message in time order.
+   * @param message Set to the next message. Its frame stays valid until the next call.
+   * @return False once every message has been streamed, true otherwise.
+   */
+  bool next(BagMessage &message);
+
+ private:
+  /**
+   * Position within an open chunk.
+   */
+  struct ChunkCursor {
+    std::size_t reader_index;
+    std::vector<std::uint8_t> buffer;
+    std::span<std::uint8_t const> records;
+    std::span<std::uint8_t const> index;
+    std::uint32_t position;
+    BagIndexEntry entry;
+
+    /**
+     * Order in which the chunk was opened, to break ties between equal times.
+     */
+    std::uint64_t order;
+  };
+
+  /**
+   * Records of a chunk being decompressed ahead of the stream. decoded is set once records is ready.
+   */
+  struct DecodedChunk {
+    std::vector<std::uint8_t> buffer;
+    std::span<std::uint8_t const> records;
+    std::promise<void> decoded;
+  };
+
+  /**
+   * Comparison placing the cursor with the earliest entry on top of the heap.
+   */
+  struct LaterCursor {
+    bool operator()(std::unique_ptr<ChunkCursor> const &a, std::unique_ptr<ChunkCursor> const &b) const;
+  };
+
+  /**
+   * Open the next chunk in start time order and push it onto the heap if it holds a message to stream.
+   */
+  void openNextChunk();
+
+  /**
+   * Start decompressing the chunks after the next one to open, up to the prefetch limit.
+   */
+  void prefetchChunks();
+
+  /**
+   * Take a buffer to decompress a chunk into from those of closed chunks, so that their memory is reused.
+   */
+  std::vector<std::uint8_t> takeBuffer();
+
+  /**
+   * Keep the buffer of a closed chunk for a later chunk.
+   */
+  void recycleBuffer(std::vector<std::uint8_t> &&buffer);
+
+  /**
+   * Move a cursor to the next entry to stream from its position.
+   * @return False if the chunk has no more such entries, true otherwise.
+   */
+  bool seekEntry(ChunkCursor &cursor);
+
+  std::vector<BagReader const *> readers_;
+  std::int64_t start_time_ns_;
+
+  /**
+   * Topics to stream, by reader and topic ID. Empty for all.
+   */
+  std::vector<std::vector<bool>> streamed_topics_;
+
+  /**
+   * Chunks of every reader to stream, by reader index, sorted by start time.
+   */
+  std::vector<std::pair<std::size_t, BagChunk const *>> chunks_;
+  std::size_t next_chunk_ = 0;
+
+  /**
+   * Heap of the open chunks with messages left to stream, ordered by LaterCursor.
+   */
+  std::vector<std::unique_ptr<ChunkCursor>> cursors_;
+
+  /**
+   * Number of chunks opened.
+   */
+  std::uint64_t opened_chunk_count_ = 0;
+
+  /**
+   * Cursor of the message last returned, kept until the next call so that its frame stays valid.
+   */
+  std::unique_ptr<ChunkCursor> current_cursor_;
+
+  /**
+   * Buffers of closed chunks, kept for reuse.
+   */
+  std::vector<std::vector<std::uint8_t>> free_buffers_;
+
+  /**
+   * Chunks being decompressed ahead of the stream, in order from chunks_[next_chunk_], and how many to keep going.
+   */
+  std::deque<std::pair<std::shared_ptr<DecodedChunk>, std::future<void>>> decoded_chunks_;
+  std::size_t prefetch_chunk_count_ = 0;
+
+  /**
+   * Threads decompressing chunks ahead of the stream, null when there are none. Declared last so that it is joined
+   * before the chunks it decompresses into are destroyed.
+   */
+  std::unique_ptr<ThreadPool> decompression_pool_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bag/bag_writer.hpp"
+#include "messages/raw_message.hpp"
+#include "mros/node.hpp"
+
+/**
+ * Records topics into a bag. Subscribes to each topic with RawMessage so that frames are written exactly as they were
+ * received, without being decoded.
+ */
+class BagRecorder {
+ public:
+  /**
+   * Subscribe to the topics through a Node. Recording starts once the Node spins.
+   * @param node The Node to create the subscribers on.
+   * @param writer The bag to write the frames to.
+   * @param topic_names The topics to record.
+   * @param queue_size The number of frames each subscriber may queue before dropping the oldest.
+   */
+  BagRecorder(std::shared_ptr<Node> const &node, std::shared_ptr<BagWriter> writer,
+              std::vector<std::string> const &topic_names, std::uint32_t queue_size = kDefaultQueueSize_);
+
+  /**
+   * Get the number of frames that failed to be written because the bag failed.
+   */
+  std::uint64_t failedWriteCount() const;
+
+ private:
+  /**
+   * Write a frame to the bag, counting the failure if the bag has failed.
+   */
+  void record(std::string const &topic_name, RawMessage const &message);
+
+  std::shared_ptr<BagWriter> writer_;
+
+  /**
+   * Number of frames that failed to be written.
+   */
+  std::atomic<std::uint64_t> failed_write_count_ = 0;
+
+  /**
+   * Subscribers on the recorded topics. Declared last so that they are destroyed, joining their threads, first.
+   */
+  std::vector<std::shared_ptr<Subscriber<RawMessage>>> subscribers_;
+
+  /**
+   * Default queue size, large enough to absorb the bursts of fast topics while the bag waits on the disk.
+   */
+  static constexpr std::uint32_t kDefaultQueueSize_ = 10000;
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bag/bag_compression.hpp"
+#include "bag/bag_exception.hpp"
+#include "bag/bag_format.hpp"
+
+/**
+ * When a BagWriter forces what it has written out to disk.
+ */
+enum class BagSyncPolicy {
+  /**
+   * Never. The kernel writes the file back on its own schedule.
+   */
+  kNone,
+
+  /**
+   * Once, when the bag is closed.
+   */
+  kOnClose,
+
+  /**
+   * After every chunk, so that at most the chunks not yet written are lost on a crash.
+   */
+  kEveryChunk
+};
+
+/**
+ * Options of a BagWriter.
+ */
+struct BagWriterOptions {
+  /**
+   * Size in bytes of the records at which a chunk is sealed and handed to the writing thread.
+   */
+  std::size_t chunk_size = 4 << 20;
+
+  /**
+   * Age at which a chunk that is not yet full is sealed anyway, so that slow topics still reach the file.
+   */
+  std::chrono::milliseconds max_chunk_age{1000};
+
+  /**
+   * Number of sealed chunks that may wait for the writing thread before write() blocks.
+   */
+  std::size_t max_pending_chunks = 16;
+
+  BagSyncPolicy sync_policy = BagSyncPolicy::kOnClose;
+
+  /**
+   * Codec to compress each chunk's records with. A chunk that gets less than 1/16 smaller is stored as is.
+   */
+  BagCompression compression = BagCompression::kNone;
+};
+
+/**
+ * Counters of a BagWriter.
+ */
+struct BagWriterStatistics {
+  std::uint64_t message_count = 0;
+
+  /**
+   * Bytes of frames written, not counting the bag's own headers and indexes.
+   */
+  std::uint64_t frame_bytes = 0;
+  std::uint64_t chunk_count = 0;
+
+  /**
+   * Bytes of records in the chunks written, and the bytes they took in the file once compressed.
+   */
+  std::uint64_t record_bytes = 0;
+  std::uint64_t stored_record_bytes = 0;
+
+  /**
+   * Number of times write() had to wait for the writing thread to catch up.
+   */
+  std::uint64_t blocked_write_count = 0;
+};
+
+/**
+ * Writer of bag files recording raw topic frames. write() only appends the frame to the chunk being built in memory.
+ * Full chunks are handed to a writing thread that copies them sequentially into the file through a memory mapped
+ * window, so that the callers recording topics are never held up by the disk unless it falls behind by more than
+ * max_pending_chunks. Thread safe.
+ */
+class BagWriter {
+ public:
+  /**
+   * Create a bag file and start the writing thread.
+   * @param path The path of the file. An existing file is replaced.
+   * @param options The chunking and syncing options.
+   * @throws BagException Throws exception if the file cannot be created.
+   */
+  explicit BagWriter(std::string const &path, BagWriterOptions options = {});
+
+  /**
+   * Close the bag if it is still open.
+   */
+  ~BagWriter();
+
+  /**
+   * Append a frame to the bag.
+   * @param topic_name The topic the frame was received on.
+   * @param receive_time_ns The wall clock time the frame was received, in nanoseconds since the epoch.
+   * @param frame_parts The parts of the frame, written one after the other.
+   * @throws BagException Throws exception if the bag is closed or the writing thread has failed.
+   */
+  void write(std::string const &topic_name, std::int64_t receive_time_ns,
+             std::initializer_list<std::span<std::uint8_t const>> frame_parts);
+
+  /**
+   * Write the remaining chunks and the file index, sync according to the policy, and close the file.
+   * @throws BagException Throws exception if the writing thread has failed.
+   */
+  void close();
+
+  /**
+   * Get the writer's counters.
+   */
+  BagWriterStatistics statistics();
+
+ private:
+  /**
+   * A chunk being built or waiting to be written.
+   */
+  struct Chunk {
+    std::vector<std::uint8_t> records;
+    std::vector<BagIndexEntry> index;
+    std::map<std::uint32_t, std::uint32_t> topic_counts;
+    std::uint32_t record_count = 0;
+    std::int64_t start_time_ns = 0;
+    std::int64_t end_time_ns = 0;
+    std::chrono::steady_clock::time_point created_time;
+  };
+
+  /**
+   * Append a record to the current chunk. Must be called with chunk_lock_ held.
+   */
+  void appendRecord(std::int64_t receive_time_ns, std::uint32_t topic_id,
+                    std::initializer_list<std::span<std::uint8_t const>> parts);
+
+  /**
+   * Hand the current chunk to the writing thread and start a new one from the pool of written chunks. Must be called
+   * with chunk_lock_ held.
+   */
+  void sealChunk();
+
+  /**
+   * Write sealed chunks until the bag is closed and every chunk is written. Run by the writing thread.
+   */
+  void writeChunksUntilClosed();
+
+  /**
+   * Compress a chunk if asked to, write it at the end of the file, and note it for the file index.
+   * @return The size of the records as stored.
+   */
+  std::uint64_t writeChunk(Chunk const &chunk);
+
+  /**
+   * Copy bytes to the end of the file through the mapped window, moving the window as needed.
+   */
+  void writeBytes(std::span<std::uint8_t const> bytes);
+
+  /**
+   * Map the window holding a file offset, growing the file to cover it.
+   */
+  void mapWindow(std::uint64_t file_offset);
+
+  /**
+   * Unmap the current window, starting writeback of its pages, and syncing them first under kEveryChunk.
+   */
+  void unmapWindow();
+
+  /**
+   * Force the bytes written so far out to disk.
+   */
+  void sync();
+
+  /**
+   * Throw a BagException with the error of the last system call.
+   */
+  [[noreturn]] void throwErrno(std::string const &what);
+
+  std::string path_;
+  BagWriterOptions options_;
+  int file_descriptor_ = -1;
+
+  /**
+   * Current mapped window of the file, its offset in the file, and the size the file has been grown to.
+   */
+  std::uint8_t *window_ = nullptr;
+  std::uint64_t window_offset_ = 0;
+  std::uint64_t file_capacity_ = 0;
+
+  /**
+   * Offset of the end of the data written to the file. Only accessed by the writing thread until it is joined.
+   */
+  std::uint64_t write_offset_ = 0;
+
+  /**
+   * File index entries of the chunks written. Only accessed by the writing thread until it is joined.
+   */
+  std::vector<std::pair<BagChunkInfo, std::vector<BagChunkTopic>>> chunk_infos_;
+
+  /**
+   * Buffer the records of a chunk are compressed into, reused between chunks. Only accessed by the writing thread.
+   */
+  std::vector<std::uint8_t> compressed_records_;
+
+  /**
+   * Chunk being built, sealed chunks waiting to be written, and written chunks kept so their buffers are reused.
+   * Guarded by chunk_lock_.
+   */
+  Chunk current_chunk_;
+  std::deque<Chunk> pending_chunks_;
+  std::vector<Chunk> free_chunks_;
+
+  /**
+   * IDs of the topics by name, and names by ID. Guarded by chunk_lock_.
+   */
+  std::unordered_map<std::string, std::uint32_t> topic_ids_;
+  std::vector<std::string> topic_names_;
+
+  /**
+   * Counters, whether close() has been called, and the error of the writing thread if it failed. Guarded by
+   * chunk_lock_.
+   */
+  BagWriterStatistics statistics_;
+  bool closing_ = false;
+  std::string error_;
+
+  /**
+   * Lock taken to ensure thread safety of the chunks between the recording threads and the writing thread.
+   */
+  std::mutex chunk_lock_;
+
+  /**
+   * Signaled when a chunk is sealed or the bag is closing, and when a pending chunk has been written.
+   */
+  std::condition_variable chunk_sealed_condition_variable_;
+  std::condition_variable chunk_written_condition_variable_;
+
+  std::thread writing_thread_;
+
+  /**
+   * Size of the mapped window of the file. The file is grown a window at a time.
+   */
+  static constexpr std::size_t kWindowSize_ = 64 << 20;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bridge/bridge_exception.hpp"
+#include "bridge/bridge_link.hpp"
+#include "messages/raw_message.hpp"
+#include "mros/node.hpp"
+
+/**
+ * Options of a Bridge.
+ */
+struct BridgeOptions {
+  /**
+   * Topics to forward to the other side.
+   */
+  std::vector<std::string> topic_names;
+
+  /**
+   * Queue size of the subscribers on the forwarded topics.
+   */
+  std::uint32_t queue_size = 1000;
+
+  BridgeLinkOptions link;
+};
+
+/**
+ * One side of a bridge joining the Mediators of two hosts. Each side subscribes to the topics it forwards and sends
+ * their messages over a single BridgeLink, undecoded, and publishes the topics the other side forwards as they arrive.
+ * The two sides exchange the names of the topics they forward when the bridge starts, after which messages only carry a
+ * topic ID. A topic can only be forwarded in one direction, since a side would otherwise receive its own publications
+ * and send them back.
+ */
+class Bridge {
+ public:
+  /**
+   * Exchange topics with the other side, create the publishers and subscribers, and start the link. Subscribers only
+   * start delivering messages once the Node spins.
+   * @param node The Node on this side's Mediator.
+   * @param bridge_name The name of this side, told to the other side.
+   * @param socket The connection to the other side.
+   * @param options The topics to forward and the options of the link.
+   * @param closed_callback Called once when the link closes.
+   * @throws BridgeException Throws exception if a topic is forwarded by both sides.
+   * @throws SocketException Throws exception if the connection fails while exchanging topics.
+   */
+  Bridge(std::shared_ptr<Node> const &node, std::string const &bridge_name, std::shared_ptr<BsonSocket> socket,
+         BridgeOptions options, std::function<void()> closed_callback = {});
+
+  /**
+   * Close the link before the publishers it publishes on are destroyed.
+   */
+  ~Bridge();
+
+  Bridge(Bridge const &other) = delete;
+
+  void operator=(Bridge const &other) = delete;
+
+  /**
+   * Close the link. Must not be called from the closed callback.
+   */
+  void close();
+
+  /**
+   * Check whether the link to the other side is still open.
+   */
+  bool connected();
+
+  /**
+   * Get the counters of the link.
+   */
+  BridgeLinkStatistics statistics();
+
+  /**
+   * Get the name the other side gave, and the topics it forwards to this side.
+   */
+  BridgeHello const &remote() const;
+
+ private:
+  BridgeHello remote_;
+
+  /**
+   * Shared with the subscribers' callbacks, which an executor may still be running when the Bridge is destroyed. Once
+   * closed, the link drops what they send.
+   */
+  std::shared_ptr<BridgeLink> link_;
+
+  /**
+   * Publishers of the topics the other side forwards, by the other side's topic ID.
+   */
+  std::vector<std::shared_ptr<Publisher<RawMessage>>> publishers_;
+
+  /**
+   * Subscribers of the topics forwarded to the other side.
+   */
+  std::vector<std::shared_ptr<Subscriber<RawMessage>>> subscribers_;
+};
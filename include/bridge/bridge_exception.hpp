@@ -0,0 +1,20 @@
+#ifndef MROS_BRIDGE_EXCEPTION_HPP
+#define MROS_BRIDGE_EXCEPTION_HPP
+
+#include <stdexcept>
+#include <string>
+
+/**
+ * Runtime error to throw on failures to set up a bridge between two Mediators.
+ */
+class BridgeException : public std::runtime_error {
+ public:
+  /**
+   * Constructor to produce runtime error that will throw an informative error message.
+   * @param error_message Error message detailing context of error.
+   */
+  explicit BridgeException(const std::string& error_message)
+      : std::runtime_error("BridgeException: " + error_message) {}
+};
+
+#endif  // MROS_BRIDGE_EXCEPTION_HPP
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bridge/bridge_protocol.hpp"
+#include "bridge/token_bucket.hpp"
+#include "socket/bson_socket/bson_socket.hpp"
+
+/**
+ * Options of a BridgeLink.
+ */
+struct BridgeLinkOptions {
+  /**
+   * Size of the batches small messages are gathered into. A message larger than this is sent in a frame of its own.
+   */
+  std::size_t max_batch_bytes = 64 << 10;
+
+  /**
+   * Longest a message waits for others to fill its batch.
+   */
+  std::chrono::microseconds max_batch_delay{2000};
+
+  /**
+   * Rate to limit sending to, in bytes per second. Zero for no limit.
+   */
+  double max_rate_bytes_per_s = 0;
+
+  /**
+   * Bytes that may be sent at once after a pause under the rate limit.
+   */
+  std::size_t burst_bytes = 256 << 10;
+
+  /**
+   * Bytes of messages that may wait to be sent before the oldest are dropped, such as while the rate limit holds them
+   * back.
+   */
+  std::size_t max_pending_bytes = 16 << 20;
+};
+
+/**
+ * Counters of a BridgeLink.
+ */
+struct BridgeLinkStatistics {
+  std::uint64_t sent_message_count = 0;
+  std::uint64_t sent_batch_count = 0;
+
+  /**
+   * Bytes of frames sent, including the message headers.
+   */
+  std::uint64_t sent_bytes = 0;
+  std::uint64_t received_message_count = 0;
+  std::uint64_t received_batch_count = 0;
+
+  /**
+   * Number of messages dropped because too many bytes were waiting to be sent.
+   */
+  std::uint64_t dropped_message_count = 0;
+
+  /**
+   * Number of batches held back by the rate limit.
+   */
+  std::uint64_t throttled_batch_count = 0;
+};
+
+/**
+ * One connection carrying the messages of many topics in both directions between the two sides of a bridge. Messages
+ * to send are queued, and a sending thread gathers them into batches of up to max_batch_bytes, so that a burst of small
+ * messages costs one frame and one system call rather than one each. A batch goes out once it is full or its first
+ * message has waited max_batch_delay, and only as fast as the rate limit allows. A receiving thread splits the batches
+ * from the other side back into messages. Thread safe.
+ */
+class BridgeLink {
+ public:
+  /**
+   * Called with the topic ID and encoded message of each message received.
+   */
+  using MessageCallback = std::function<void(std::uint32_t, ByteSpan)>;
+
+  /**
+   * Take over a connected socket. Nothing is sent or received until start().
+   * @param socket The connection to the other side of the bridge.
+   * @param options The batching and rate limiting options.
+   */
+  explicit BridgeLink(std::shared_ptr<BsonSocket> socket, BridgeLinkOptions options = {});
+
+  /**
+   * Close the link.
+   */
+  ~BridgeLink();
+
+  BridgeLink(BridgeLink const &other) = delete;
+
+  void operator=(BridgeLink const &other) = delete;
+
+  /**
+   * Start the sending and receiving threads.
+   * @param message_callback Called on the receiving thread with each message received.
+   * @param closed_callback Called once when the link closes, from either end or on an error, on whichever thread
+   * noticed.
+   */
+  void start(MessageCallback message_callback, std::function<void()> closed_callback = {});
+
+  /**
+   * Queue a message to send.
+   * @param topic_id The topic ID of the message, as known to the other side.
+   * @param message The encoded message.
+   * @return False if the link is closed, true otherwise.
+   */
+  bool send(std::uint32_t topic_id, std::vector<std::uint8_t> &&message);
+
+  /**
+   * Stop the threads and close the socket. Messages still queued are dropped. Safe to call repeatedly, but not from
+   * the callbacks, which run on the threads it joins.
+   */
+  void close();
+
+  /**
+   * Check whether the link is still open.
+   */
+  bool connected();
+
+  /**
+   * Get the link's counters.
+   */
+  BridgeLinkStatistics statistics();
+
+ private:
+  /**
+   * A message waiting to be sent.
+   */
+  struct PendingMessage {
+    std::uint32_t topic_id;
+    std::vector<std::uint8_t> message;
+    std::chrono::steady_clock::time_point queued_time;
+  };
+
+  /**
+   * Batch and send queued messages until the link closes. Run by the sending thread.
+   */
+  void sendUntilClosed();
+
+  /**
+   * Receive batches and pass their messages to the callback until the link closes. Run by the receiving thread.
+   */
+  void receiveUntilClosed();
+
+  /**
+   * Mark the link closed, wake the sending thread, and shut the socket down to wake the receiving thread. Calls the
+   * closed callback the first time. Must be called without state_mutex_ held.
+   */
+  void markClosed();
+
+  std::shared_ptr<BsonSocket> socket_;
+  BridgeLinkOptions options_;
+  MessageCallback message_callback_;
+  std::function<void()> closed_callback_;
+
+  /**
+   * Messages waiting to be sent, their total size, whether the link is closed, and the counters. Guarded by
+   * state_mutex_.
+   */
+  std::deque<PendingMessage> pending_messages_;
+  std::size_t pending_bytes_ = 0;
+  bool closed_ = false;
+  BridgeLinkStatistics statistics_;
+
+  /**
+   * Lock taken to ensure thread safety of the queue and state between senders and the link's threads.
+   */
+  std::mutex state_mutex_;
+
+  /**
+   * Signaled when a message is queued or the link closes. Used with state_mutex_.
+   */
+  std::condition_variable state_condition_variable_;
+
+  std::thread sending_thread_;
+  std::thread receiving_thread_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * Frames sent over a bridge link, in order:
+ *
+ *   BridgeHello, as Bson, once in each direction
+ *   batches: BridgeMessageHeader | size bytes of message, repeated to the end of the frame
+ *
+ * The topic ID of a message is the index of its topic in the sender's BridgeHello, so that topic names are sent once
+ * rather than with every message. Messages are the encoded messages as published, without their TopicFrameHeader; the
+ * receiving side publishes them under a new one.
+ */
+
+/**
+ * First frame each side of a bridge sends: who it is and the topics it forwards.
+ */
+struct BridgeHello {
+  std::string bridge_name;
+  std::vector<std::string> topic_names;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(BridgeHello, bridge_name, topic_names)
+
+/**
+ * Header of a message in a batch, in host byte order.
+ */
+struct BridgeMessageHeader {
+  std::uint32_t topic_id;
+  std::uint32_t size;
+};
+
+static_assert(sizeof(BridgeMessageHeader) == 8);
+
+/**
+ * Append a message to a batch.
+ * @param batch The batch being built.
+ * @param topic_id The topic ID of the message.
+ * @param message The encoded message.
+ */
+inline void appendBridgeMessage(std::vector<std::uint8_t> &batch, std::uint32_t topic_id,
+                                std::span<std::uint8_t const> message) {
+  BridgeMessageHeader header{topic_id, static_cast<std::uint32_t>(message.size())};
+  auto const *header_bytes = reinterpret_cast<std::uint8_t const *>(&header);
+  batch.insert(batch.end(), header_bytes, header_bytes + sizeof(header));
+  batch.insert(batch.end(), message.begin(), message.end());
+}
+
+/**
+ * Call a function on each message of a batch.
+ * @param batch The batch received.
+ * @param function Called with the topic ID and message of each message, in order.
+ * @return False if the batch is malformed, after calling the function on the messages before the malformed one.
+ */
+template <typename FunctionT>
+bool forEachBridgeMessage(std::span<std::uint8_t const> batch, FunctionT &&function) {
+  while (!batch.empty()) {
+    BridgeMessageHeader header{};
+    if (batch.size() < sizeof(header)) return false;
+    std::memcpy(&header, batch.data(), sizeof(header));
+    batch = batch.subspan(sizeof(header));
+    if (batch.size() < header.size) return false;
+    function(header.topic_id, batch.first(header.size));
+    batch = batch.subspan(header.size);
+  }
+  return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Token bucket limiting the rate at which bytes are sent. The bucket fills at the rate up to the burst size, and
+ * sending takes tokens from it. Sends larger than what is in the bucket are allowed, leaving it in debt, and the caller
+ * waits until the debt is repaid, so a send of any size goes out at the limited rate rather than being refused.
+ */
+class TokenBucket {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Start with a full bucket.
+   * @param rate_bytes_per_s The rate to limit sending to, in bytes per second. Zero or less for no limit.
+   * @param burst_bytes The size of the bucket, which is how many bytes may be sent at once after a pause.
+   * @param start The time the bucket is full at.
+   */
+  TokenBucket(double rate_bytes_per_s, std::size_t burst_bytes, Clock::time_point start = Clock::now());
+
+  /**
+   * Take tokens for a send.
+   * @param size_bytes The size of the send.
+   * @param now The current time.
+   * @return How long to wait before sending, zero if the bucket held enough tokens.
+   */
+  Clock::duration take(std::size_t size_bytes, Clock::time_point now = Clock::now());
+
+  /**
+   * Check whether the bucket limits the rate at all.
+   */
+  bool limited() const;
+
+ private:
+  double rate_bytes_per_s_;
+  double burst_bytes_;
+
+  /**
+   * Tokens in the bucket as of last_fill_, negative while in debt.
+   */
+  double tokens_;
+  Clock::time_point last_fill_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include "socket/bson_socket/bson_socket.hpp"
+#include "timer/rate.hpp"
+
+/**
+ * Paces a publishing loop at a fixed rate on the absolute deadlines of a Rate, spinning out the end of each wait to
+ * publish closer to the deadline than a sleep alone wakes up. Missed deadlines are skipped and counted as by the Rate,
+ * so that the shortfall can be reported.
+ */
+class PublishPacer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Create a pacer whose first deadline is start.
+   * @param rate_hz The number of deadlines per second. Zero or less for no pacing.
+   * @param start The first deadline.
+   */
+  explicit PublishPacer(double rate_hz, Clock::time_point start = Clock::now());
+
+  /**
+   * Get the next deadline to publish at given the current time, and advance past it. Deadlines more than a period in
+   * the past are skipped and counted as missed.
+   * @param now The current time.
+   * @return The deadline, or now when not pacing.
+   */
+  Clock::time_point nextDeadline(Clock::time_point now);
+
+  /**
+   * Block until the next deadline. Sleeps until shortly before the deadline and spins for the rest, since a sleep alone
+   * wakes up tens of microseconds late and would cap the rate of a single publisher.
+   */
+  void waitForNextDeadline();
+
+  /**
+   * Get the number of deadlines skipped because the loop fell behind.
+   */
+  std::uint64_t missedDeadlines() const;
+
+ private:
+  /**
+   * Time before a deadline at which waitForNextDeadline() stops sleeping and starts spinning.
+   */
+  static constexpr std::chrono::microseconds kSpinThreshold_{100};
+
+  /**
+   * Schedule of deadlines. Empty when not pacing.
+   */
+  std::optional<Rate> rate_;
+};
+
+/**
+ * Make an encoded message for load testing with a single "data" string field, so that it decodes as a StringMessage.
+ * @param size_bytes The size of the encoded message. Sizes below that of an empty message give an empty message.
+ */
+Bson makeSyntheticPayload(std::size_t size_bytes);
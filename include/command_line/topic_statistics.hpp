@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Statistics over the most recent messages received on a topic, as reported by mrostopic.
+ */
+struct TopicStatisticsSummary {
+  /**
+   * Number of messages received since the statistics were created, including those no longer in the window.
+   */
+  std::uint64_t total_count = 0;
+
+  /**
+   * Number of messages in the window.
+   */
+  std::size_t window_count = 0;
+
+  /**
+   * Average rate over the window in messages per second. Zero with fewer than two messages.
+   */
+  double rate_hz = 0;
+
+  /**
+   * Shortest, longest, and standard deviation of the time between consecutive arrivals in the window, in seconds.
+   */
+  double min_interval_s = 0;
+  double max_interval_s = 0;
+  double interval_std_dev_s = 0;
+
+  /**
+   * Average bandwidth over the window in bytes per second. Zero with fewer than two messages.
+   */
+  double bandwidth_bytes_per_s = 0;
+
+  /**
+   * Mean, smallest, and largest message size in the window, in bytes.
+   */
+  double mean_size_bytes = 0;
+  std::size_t min_size_bytes = 0;
+  std::size_t max_size_bytes = 0;
+
+  /**
+   * Mean, smallest, largest, and standard deviation of the delay from publishing to arrival in the window, in seconds.
+   */
+  double mean_delay_s = 0;
+  double min_delay_s = 0;
+  double max_delay_s = 0;
+  double delay_std_dev_s = 0;
+};
+
+/**
+ * Fixed size window over the most recent messages on a topic. Recording a message only writes one slot of a ring
+ * buffer, so that recording keeps up with fast topics, and the statistics are computed over the window on demand.
+ * Thread safe.
+ */
+class TopicStatistics {
+ public:
+  /**
+   * Create statistics over a window of the most recent messages.
+   * @param window_size The number of messages in the window. At least two messages are always kept.
+   */
+  explicit TopicStatistics(std::size_t window_size);
+
+  /**
+   * Record a received message.
+   * @param arrival_time_ns The wall clock time the message arrived, in nanoseconds since the epoch.
+   * @param publish_time_ns The wall clock time the message was published, in nanoseconds since the epoch.
+   * @param size_bytes The size of the encoded message in bytes.
+   */
+  void record(std::int64_t arrival_time_ns, std::int64_t publish_time_ns, std::size_t size_bytes);
+
+  /**
+   * Compute the statistics over the messages in the window.
+   */
+  TopicStatisticsSummary summarize();
+
+ private:
+  /**
+   * One recorded message.
+   */
+  struct Sample {
+    std::int64_t arrival_time_ns;
+    std::int64_t delay_ns;
+    std::size_t size_bytes;
+  };
+
+  /**
+   * Ring buffer of the most recent samples. The oldest sample is at next_sample_ once the window is full.
+   */
+  std::vector<Sample> samples_;
+
+  /**
+   * Index of the slot the next sample is written to.
+   */
+  std::size_t next_sample_ = 0;
+
+  /**
+   * Number of samples recorded in total.
+   */
+  std::uint64_t total_count_ = 0;
+
+  /**
+   * Lock taken to ensure thread safety of accessing the samples.
+   */
+  std::mutex samples_lock_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class Flow;
+
+/**
+ * Runs coroutines on one thread. Coroutines suspended on a message, an RPC reply, or anything else hand their handle
+ * back to the scheduler when they can continue, so thousands of them wait at once without holding a thread each.
+ */
+class CoroutineScheduler : public std::enable_shared_from_this<CoroutineScheduler> {
+ public:
+  /**
+   * Start the scheduling thread.
+   */
+  CoroutineScheduler();
+
+  /**
+   * Shut down and join the scheduling thread. Must not be run by the scheduling thread itself.
+   */
+  ~CoroutineScheduler();
+
+  CoroutineScheduler(CoroutineScheduler const &other) = delete;
+
+  void operator=(CoroutineScheduler const &other) = delete;
+
+  /**
+   * Start running a flow on the scheduling thread. The flow runs until its first suspension on the scheduling thread,
+   * not the caller's, and frees itself when it returns.
+   */
+  void spawn(Flow flow);
+
+  /**
+   * Queue a suspended coroutine to be resumed on the scheduling thread. Callable from any thread. Coroutines scheduled
+   * after shutdown are destroyed rather than resumed, so that their frames are not leaked.
+   */
+  void schedule(std::coroutine_handle<> handle);
+
+  /**
+   * Resume the coroutines already queued, then stop the scheduling thread. Coroutines still suspended on something
+   * that never completes stay suspended. Safe to call repeatedly.
+   */
+  void shutdown();
+
+  /**
+   * Get the number of coroutines resumed so far.
+   */
+  std::uint64_t resumedCount();
+
+  /**
+   * Get the scheduler running the calling thread's coroutine, so that awaitables can hand the coroutine back to it.
+   * @return The scheduler, or null if the calling thread is not a scheduling thread.
+   */
+  static std::shared_ptr<CoroutineScheduler> current();
+
+ private:
+  /**
+   * Resume queued coroutines until shut down and the queue is empty. Run by the scheduling thread.
+   */
+  void resumeUntilShutdown();
+
+  /**
+   * Coroutines waiting to be resumed. Guarded by ready_mutex_.
+   */
+  std::deque<std::coroutine_handle<>> ready_;
+  std::mutex ready_mutex_;
+
+  /**
+   * Condition variable signaled when a coroutine is queued or the scheduler is shut down. Used with ready_mutex_.
+   */
+  std::condition_variable ready_condition_variable_;
+  bool shutdown_ = false;
+  std::uint64_t resumed_count_ = 0;
+
+  std::thread scheduling_thread_;
+
+  /**
+   * Scheduler whose thread is the calling thread, set by the scheduling thread for its lifetime.
+   */
+  static thread_local CoroutineScheduler *current_;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <utility>
+
+#include "logging/logging.hpp"
+
+/**
+ * Detached coroutine started on a CoroutineScheduler, such as one step of a pipeline waiting on several topics in turn:
+ *
+ *   Flow relay(std::shared_ptr<Subscriber<Pose>> poses, std::shared_ptr<Publisher<Pose>> publisher) {
+ *     while (true) publisher->publish(co_await poses->next());
+ *   }
+ *
+ *   node->spawn(relay(poses, publisher));
+ *
+ * A Flow does not start until spawned, and frees its frame when it returns. Exceptions escaping it are logged and
+ * end the flow.
+ */
+class Flow {
+ public:
+  struct promise_type {
+    Flow get_return_object() { return Flow(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    std::suspend_never final_suspend() noexcept { return {}; }
+
+    void return_void() {}
+
+    void unhandled_exception() {
+      try {
+        std::rethrow_exception(std::current_exception());
+      } catch (std::exception const &e) {
+        Logger::getLogger().warn(std::string("Flow ended by exception: ") + e.what());
+      } catch (...) {
+        Logger::getLogger().warn("Flow ended by unknown exception.");
+      }
+    }
+  };
+
+  Flow(Flow &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+  Flow(Flow const &other) = delete;
+
+  /**
+   * Destroy the flow if it was never spawned.
+   */
+  ~Flow() {
+    if (handle_) handle_.destroy();
+  }
+
+  /**
+   * Give up ownership of the suspended coroutine, to be resumed by whoever takes it.
+   */
+  std::coroutine_handle<> release() { return std::exchange(handle_, {}); }
+
+ private:
+  explicit Flow(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
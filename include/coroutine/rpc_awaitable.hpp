@@ -0,0 +1,70 @@
+#pragma once
+
+#include <coroutine>
+#include <future>
+#include <memory>
+#include <string>
+
+#include "coroutine/coroutine_scheduler.hpp"
+#include "socket/bson_rpc_socket/typed_rpc.hpp"
+
+/**
+ * Awaitable full duplex typed RPC request. The request is sent when the coroutine suspends, and the coroutine is handed
+ * back to the scheduler it was running on once the response arrives, so no thread blocks on the reply. Outside a
+ * scheduler, the coroutine resumes on the socket's receiving thread instead.
+ */
+template <typename ResultT>
+class RPCAwaitable {
+ public:
+  RPCAwaitable(BsonRPCSocket &socket, std::string callback_name, json argument, int timeout)
+      : socket_(socket), callback_name_(std::move(callback_name)), argument_(std::move(argument)), timeout_(timeout) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    // The response callback may resume the coroutine on another thread before sending returns, destroying this
+    // awaitable, so nothing of it is touched after sending.
+    socket_.sendRequestAndGetResponse(
+        callback_name_, argument_,
+        [this, handle, scheduler = CoroutineScheduler::current()](std::future<json> response) -> void {
+          response_ = std::move(response);
+          if (scheduler) {
+            scheduler->schedule(handle);
+          } else {
+            handle.resume();
+          }
+        },
+        timeout_);
+  }
+
+  /**
+   * @return The decoded result.
+   * @throws SocketException Throws the failures described by sendTypedRequestAndGetFuture().
+   */
+  ResultT await_resume() { return decodeRPCMessage<ResultT>(callback_name_, response_.get()); }
+
+ private:
+  BsonRPCSocket &socket_;
+  std::string callback_name_;
+  json argument_;
+  int timeout_;
+  std::future<json> response_;
+};
+
+/**
+ * Send a full duplex typed RPC request to be awaited by a coroutine, as in
+ *
+ *   GraphUpdate update = co_await awaitTypedRequest(socket, kGetGraphRPC, {false, 0});
+ *
+ * @param socket The socket to send the request on. Must outlive the awaiting.
+ * @param method The method declaration.
+ * @param argument The argument to pass to the peer socket's handler.
+ * @param timeout Time to wait for the response in milliseconds. Defaults to an indefinite timeout.
+ * @return Awaitable resuming with the decoded result.
+ */
+template <typename ArgumentT, typename ResultT>
+  requires(!std::is_void_v<ResultT>)
+RPCAwaitable<ResultT> awaitTypedRequest(BsonRPCSocket &socket, RPCMethod<ArgumentT, ResultT> const &method,
+                                        ArgumentT const &argument, int timeout = -1) {
+  return RPCAwaitable<ResultT>(socket, method.name, argument, timeout);
+}
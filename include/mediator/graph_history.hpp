@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "mediator/mediator_rpc.hpp"
+
+/**
+ * Version counter and bounded log of the most recent changes to the graph of Nodes and topics. Lets a watcher that
+ * already holds an older version catch up from the deltas it missed instead of fetching a full snapshot. Not thread
+ * safe.
+ */
+class GraphHistory {
+ public:
+  /**
+   * Create an empty history at version zero.
+   * @param capacity The number of most recent deltas to keep.
+   */
+  explicit GraphHistory(std::size_t capacity);
+
+  /**
+   * Record a change, assigning it the next version.
+   * @param delta The change. Its version is overwritten.
+   * @return The recorded change with its version.
+   */
+  GraphDelta const &record(GraphDelta delta);
+
+  /**
+   * Get the version of the latest change, or zero if nothing has changed.
+   */
+  std::uint64_t version() const;
+
+  /**
+   * Get the changes made after a version.
+   * @param since_version The version the caller already has.
+   * @param deltas Set to the changes after since_version in version order.
+   * @return False if some of those changes are no longer kept or since_version is newer than the history, true
+   * otherwise.
+   */
+  bool deltasSince(std::uint64_t since_version, std::vector<GraphDelta> &deltas) const;
+
+ private:
+  /**
+   * Most recent changes in version order.
+   */
+  std::deque<GraphDelta> deltas_;
+
+  /**
+   * Number of most recent changes kept.
+   */
+  std::size_t capacity_;
+
+  /**
+   * Version of the latest change.
+   */
+  std::uint64_t version_ = 0;
+};
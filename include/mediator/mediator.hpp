@@ -3,17 +3,23 @@
 #include <atomic>
 #include <chrono>
 #include <csignal>
+#include <deque>
 #include <exception>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "logging/logging.hpp"
+#include "mediator/graph_history.hpp"
+#include "mediator/mediator_rpc.hpp"
 #include "mros/mros.hpp"
 #include "mros/utils/utils.hpp"
 #include "socket/bson_rpc_socket/connection_bson_rpc_socket.hpp"
+#include "socket/bson_rpc_socket/rpc_dispatcher.hpp"
 #include "socket/server_socket.hpp"
+#include "thread_pool/thread_pool.hpp"
 
 using namespace std::chrono_literals;
 using Json = nlohmann::json;
@@ -24,6 +30,8 @@ using NodeURI = std::string;
 struct AddressPort {
   std::string host;
   int port;
+  TopicTransport transport = TopicTransport::kTcp;
+  std::string interface_address;
 };
 
 struct TopicData {
@@ -31,6 +39,14 @@ struct TopicData {
   std::unordered_set<NodeURI> subscribing_nodes;
 };
 
+/**
+ * Changes to the graph waiting to be pushed to a watching node, and whether a push task is sending them.
+ */
+struct GraphWatcherQueue {
+  std::deque<GraphDelta> deltas;
+  bool sending = false;
+};
+
 struct NodeData {
   std::string name;
   std::shared_ptr<ConnectionBsonRPCSocket> connection;
@@ -55,6 +71,17 @@ class Mediator : public std::enable_shared_from_this<Mediator> {
    */
   void handleRPCConnections();
 
+  /**
+   * Release the retired connections whose receiving threads have finished closing.
+   */
+  void releaseRetiredConnections();
+
+  /**
+   * Complete the connection handshake with a newly accepted node on a handshake thread. Removes the node's connection
+   * from node_table_ if the node does not complete the handshake within kHandshakeTimeout_.
+   */
+  void completeHandshake(const NodeURI &node_uri, const std::shared_ptr<ConnectionBsonRPCSocket> &connection_socket);
+
   /**
    * Check whether a termination signal has been sent to the process.
    */
@@ -75,10 +102,10 @@ class Mediator : public std::enable_shared_from_this<Mediator> {
   void addPublisher(const NodeURI &node_uri, const TopicName &topic_name, const AddressPort &address_port);
 
   /**
-   * Update tables to add subscriber. Requests that the calling node connect to all the existing publishers. Nodes
-   * request this callback when the user creates a subscriber.
+   * Update tables to add subscriber. Returns the existing publishers for the calling node to connect to. Nodes request
+   * this callback when the user creates a subscriber.
    */
-  Json addSubscriber(const NodeURI &node_uri, const TopicName &topic_name);
+  PublisherAddresses addSubscriber(const NodeURI &node_uri, const TopicName &topic_name);
 
   /**
    * Update tables to remove the node, including all of its publishers and subscribers. Close the rpc connection to that
@@ -89,6 +116,12 @@ class Mediator : public std::enable_shared_from_this<Mediator> {
    */
   void removeNode(const NodeURI &node_uri);
 
+  /**
+   * Update tables to remove the node as in removeNode(), without touching its connection.
+   * @return The node's connection, or nullptr if the node was already removed.
+   */
+  std::shared_ptr<ConnectionBsonRPCSocket> takeNode(const NodeURI &node_uri);
+
   /**
    * Update tables to remove the publisher for a specific Node and Topic. Called by the destructor of a publisher, which
    * tells its associated Node to request this callback.
@@ -101,43 +134,107 @@ class Mediator : public std::enable_shared_from_this<Mediator> {
    */
   void removeSubscriber(const NodeURI &node_uri, const TopicName &topic_name);
 
-  /** Json decode function wrappers **/
-
   /**
-   * Json parsing wrapper for addNode() to allow registration as a callback.
+   * Get a snapshot of the graph, or the changes since the version the calling node already has while graph_history_
+   * still holds them. If requested, every later change is pushed to the calling node until it disconnects. Called by
+   * tools such as mrosnode.
    */
-  void jsonAddNodeCallback(Json const &json);
+  GraphUpdate getGraph(const NodeURI &node_uri, const GraphRequest &request);
 
   /**
-   * Json parsing wrapper for addPublisher() to allow registration as a callback.
+   * Disconnect every node with a name other than the calling node by removing it as in removeNode(). Called by
+   * mroskill on a dispatched callback, so the nodes' connections are shut down and retired rather than closed, which
+   * would wait on each node's reply.
    */
-  void jsonAddPublisherCallback(Json const &json);
+  KillNodeResult killNode(const NodeURI &node_uri, const std::string &node_name);
 
   /**
-   * Json parsing wrapper for addSubscriber() to allow registration as a callback.
+   * Record a change to the graph in graph_history_ and queue it for the watching nodes, starting a push task for each
+   * watcher not already sending. Must be called with node_table_mutex_ held, right after the change is made to
+   * node_table_, so that snapshots and deltas agree on versions.
    */
-  Json jsonAddSubscriberCallback(Json const &json);
+  void recordGraphChange(GraphDeltaKind kind, const NodeURI &node_uri, const std::string &node_name,
+                         const TopicName &topic_name = "");
 
   /**
-   * Json parsing wrapper for removePublisher() to allow registration as a callback.
+   * Send the changes queued for a watching node until its queue is empty, without holding node_table_mutex_ while
+   * sending, so that a watcher slow to receive holds up nobody but itself. Run on graph_push_pool_, one task per
+   * watcher at a time so that the watcher receives the changes in version order.
    */
-  void jsonRemovePublisherCallback(Json const &json);
-
-  /**
-   * Json parsing wrapper for removeSubscriber() to allow registration as a callback.
-   */
-  void jsonRemoveSubscriberCallback(Json const &json);
+  void pushGraphChanges(const NodeURI &watcher_uri, const std::shared_ptr<GraphWatcherQueue> &watcher_queue);
 
   std::unordered_map<TopicName, TopicData> topic_table_;
   std::unordered_map<NodeURI, NodeData> node_table_;
+  /**
+   * Locks of the tables. When both are held, node_table_mutex_ is taken first.
+   */
   std::mutex topic_table_mutex_;
   std::mutex node_table_mutex_;
   std::vector<std::string> node_uris_;
 
+  /**
+   * Connections of removed nodes. removeNode() runs on the connection's own receiving thread through the closing
+   * callback, so the connection is kept here until its closing routine has finished. Guarded by node_table_mutex_.
+   */
+  std::vector<std::shared_ptr<ConnectionBsonRPCSocket>> retired_connections_;
+
+  /**
+   * Version and recent changes of the graph. Guarded by node_table_mutex_.
+   */
+  GraphHistory graph_history_{kGraphHistorySize_};
+
+  /**
+   * Nodes that asked to be pushed every change to the graph, and the changes waiting to be pushed to each. Guarded by
+   * node_table_mutex_.
+   */
+  std::unordered_map<NodeURI, std::shared_ptr<GraphWatcherQueue>> graph_watchers_;
+
   std::unique_ptr<ServerSocket> bson_rpc_server_;
   std::string address_;
   int port_;
 
+  /**
+   * Worker threads completing connection handshakes so that the accepting loop is never blocked by a slow node.
+   */
+  std::unique_ptr<ThreadPool> handshake_pool_;
+
+  /**
+   * Dispatcher running every node's RPC callbacks off the receiving threads. Each node's requests run in the order they
+   * were sent, and different nodes' requests run concurrently.
+   */
+  std::shared_ptr<RPCDispatcher> rpc_dispatcher_;
+
+  /**
+   * Worker threads pushing graph changes to the watching nodes.
+   */
+  std::unique_ptr<ThreadPool> graph_push_pool_;
+
+  /**
+   * Number of connection handshakes that may be in progress at once.
+   */
+  static constexpr std::size_t kHandshakeThreadCount_ = 16;
+
+  /**
+   * Number of watching nodes that may be pushed changes at once.
+   */
+  static constexpr std::size_t kGraphPushThreadCount_ = 4;
+
+  /**
+   * Time in milliseconds a node has to send its connection message before its connection is dropped.
+   */
+  static constexpr int kHandshakeTimeout_ = 5000;
+
+  /**
+   * Number of pending connections the kernel may hold before the accepting loop drains them.
+   */
+  static constexpr int kListenBacklog_ = SOMAXCONN;
+
+  /**
+   * Number of most recent graph changes kept for watchers catching up from an older version. A watcher with more
+   * changes than this waiting to be pushed is only pushed the newest, whose gap in versions makes it fetch a snapshot.
+   */
+  static constexpr std::size_t kGraphHistorySize_ = 4096;
+
   MROS &mros_;
   Logger &logger_;
 };
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "socket/bson_rpc_socket/typed_rpc.hpp"
+
+/**
+ * Connection message sent by a Node to the Mediator.
+ */
+struct ConnectNodeRequest {
+  std::string node_name;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ConnectNodeRequest, node_name)
+
+/**
+ * Transport a publisher sends its messages over.
+ */
+enum class TopicTransport { kTcp, kUdpMulticast };
+NLOHMANN_JSON_SERIALIZE_ENUM(TopicTransport, {{TopicTransport::kTcp, "tcp"}, {TopicTransport::kUdpMulticast, "udp"}})
+
+/**
+ * Argument of addPublisher: the topic and the address subscribers should connect to, or for a UDP multicast publisher
+ * the group and port they should join and the address of the interface it sends on.
+ */
+struct AddPublisherRequest {
+  std::string topic_name;
+  std::string address;
+  int port;
+  TopicTransport transport;
+  std::string interface_address;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(AddPublisherRequest, topic_name, address, port, transport, interface_address)
+
+/**
+ * Argument of the RPC methods that only name a topic.
+ */
+struct TopicRequest {
+  std::string topic_name;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TopicRequest, topic_name)
+
+/**
+ * Addresses of the publishers on a topic, in matching order. Interface addresses are empty for TCP publishers.
+ */
+struct PublisherAddresses {
+  std::string topic_name;
+  std::vector<std::string> publisher_addresses;
+  std::vector<int> publisher_ports;
+  std::vector<TopicTransport> publisher_transports;
+  std::vector<std::string> publisher_interface_addresses;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(PublisherAddresses, topic_name, publisher_addresses, publisher_ports,
+                                   publisher_transports, publisher_interface_addresses)
+
+/**
+ * Node to Mediator: register a publisher.
+ */
+inline constexpr RPCMethod<AddPublisherRequest> kAddPublisherRPC{"addPublisher"};
+
+/**
+ * Node to Mediator: register a subscriber and get the publishers already on its topic.
+ */
+inline constexpr RPCMethod<TopicRequest, PublisherAddresses> kAddSubscriberRPC{"addSubscriber"};
+
+/**
+ * Node to Mediator: unregister a publisher.
+ */
+inline constexpr RPCMethod<TopicRequest> kRemovePublisherRPC{"removePublisher"};
+
+/**
+ * Node to Mediator: unregister a subscriber.
+ */
+inline constexpr RPCMethod<TopicRequest> kRemoveSubscriberRPC{"removeSubscriber"};
+
+/**
+ * Mediator to Node: connect the Node's subscriber on a topic to new publishers.
+ */
+inline constexpr RPCMethod<PublisherAddresses> kConnectSubscriberToPublishersRPC{"connectSubscriberToPublishers"};
+
+/**
+ * Kinds of change to the graph of Nodes and topics.
+ */
+enum class GraphDeltaKind { kAddNode, kRemoveNode, kAddPublisher, kRemovePublisher, kAddSubscriber, kRemoveSubscriber };
+NLOHMANN_JSON_SERIALIZE_ENUM(GraphDeltaKind, {{GraphDeltaKind::kAddNode, "add node"},
+                                              {GraphDeltaKind::kRemoveNode, "remove node"},
+                                              {GraphDeltaKind::kAddPublisher, "add publisher"},
+                                              {GraphDeltaKind::kRemovePublisher, "remove publisher"},
+                                              {GraphDeltaKind::kAddSubscriber, "add subscriber"},
+                                              {GraphDeltaKind::kRemoveSubscriber, "remove subscriber"}})
+
+/**
+ * One change to the graph. Graph versions count the changes made since the Mediator started, so the delta with
+ * version n turns the graph at version n - 1 into the graph at version n.
+ */
+struct GraphDelta {
+  std::uint64_t version;
+  GraphDeltaKind kind;
+  std::string node_uri;
+  std::string node_name;
+
+  /**
+   * Topic of a publisher or subscriber change. Empty for Node changes.
+   */
+  std::string topic_name;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(GraphDelta, version, kind, node_uri, node_name, topic_name)
+
+/**
+ * A Node in a snapshot of the graph.
+ */
+struct GraphNodeInfo {
+  std::string node_uri;
+  std::string node_name;
+  std::vector<std::string> publications;
+  std::vector<std::string> subscriptions;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(GraphNodeInfo, node_uri, node_name, publications, subscriptions)
+
+/**
+ * Argument of getGraph.
+ */
+struct GraphRequest {
+  /**
+   * Whether the Mediator should push every later change to the caller through graphChanged.
+   */
+  bool watch;
+
+  /**
+   * Version of the graph the caller already has, or zero for none. The Mediator answers with only the deltas since
+   * this version while it still has them.
+   */
+  std::uint64_t since_version;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(GraphRequest, watch, since_version)
+
+/**
+ * Result of getGraph: either a full snapshot of the graph or the deltas since the requested version.
+ */
+struct GraphUpdate {
+  std::uint64_t version;
+
+  /**
+   * Whether nodes holds a full snapshot. Otherwise deltas holds the changes since the requested version.
+   */
+  bool full;
+  std::vector<GraphNodeInfo> nodes;
+  std::vector<GraphDelta> deltas;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(GraphUpdate, version, full, nodes, deltas)
+
+/**
+ * Argument of killNode.
+ */
+struct KillNodeRequest {
+  std::string node_name;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(KillNodeRequest, node_name)
+
+/**
+ * Result of killNode: the URIs of the Nodes that were disconnected.
+ */
+struct KillNodeResult {
+  std::vector<std::string> node_uris;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(KillNodeResult, node_uris)
+
+/**
+ * Client to Mediator: get the graph of Nodes and topics, optionally watching it for changes.
+ */
+inline constexpr RPCMethod<GraphRequest, GraphUpdate> kGetGraphRPC{"getGraph"};
+
+/**
+ * Mediator to watching client: a change to the graph, sent in version order.
+ */
+inline constexpr RPCMethod<GraphDelta> kGraphChangedRPC{"graphChanged"};
+
+/**
+ * Client to Mediator: disconnect every Node with a name.
+ */
+inline constexpr RPCMethod<KillNodeRequest, KillNodeResult> kKillNodeRPC{"killNode"};
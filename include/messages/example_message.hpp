@@ -12,7 +12,7 @@ struct StringMessage {
     data = thing;
   }
 
-  nlohmann::json convert_to_json() {
+  nlohmann::json convert_to_json() const {
     nlohmann::json json{{"data", data}};
     return json;
   }
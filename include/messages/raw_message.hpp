@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "mros/utils/topic_frame.hpp"
+
+/**
+ * Message holding the undecoded Bson of a message on any topic. Subscribing with RawMessage skips decoding, for tools
+ * that measure or record topics. Publishing a RawMessage sends its payload as is under a new header.
+ */
+struct RawMessage {
+  /**
+   * Header of the frame the message was received in. Ignored when publishing.
+   */
+  TopicFrameHeader header;
+
+  /**
+   * Encoded message.
+   */
+  std::vector<std::uint8_t> payload;
+
+  void set_from_frame(TopicFrameHeader const &frame_header, std::span<std::uint8_t const> frame_payload) {
+    header = frame_header;
+    payload.assign(frame_payload.begin(), frame_payload.end());
+  }
+
+  std::span<std::uint8_t const> frame_payload() const { return payload; }
+};
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mediator/mediator_rpc.hpp"
+#include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+
+/**
+ * Local copy of the graph of Nodes and topics, kept up to date from the Mediator's snapshots and deltas.
+ */
+class GraphView {
+ public:
+  /**
+   * A Node and the topics it publishes and subscribes to.
+   */
+  struct NodeEntry {
+    std::string node_name;
+    std::set<std::string> publications;
+    std::set<std::string> subscriptions;
+  };
+
+  /**
+   * Apply the result of getGraph.
+   * @param update A full snapshot, or the deltas since this view's version.
+   * @return False if the update holds deltas that do not follow on from this view's version, true otherwise.
+   */
+  bool apply(GraphUpdate const &update);
+
+  /**
+   * Apply one change. Changes at or before this view's version are ignored.
+   * @param delta The change.
+   * @return False if the change skips a version, leaving the view unchanged, true otherwise.
+   */
+  bool apply(GraphDelta const &delta);
+
+  /**
+   * Get the version of the graph this view holds.
+   */
+  std::uint64_t version() const;
+
+  /**
+   * Get the Nodes in the graph by URI.
+   */
+  std::map<std::string, NodeEntry> const &nodes() const;
+
+  /**
+   * Get the URIs of the Nodes with a name.
+   */
+  std::vector<std::string> findNodes(std::string const &node_name) const;
+
+ private:
+  /**
+   * Nodes in the graph by URI.
+   */
+  std::map<std::string, NodeEntry> nodes_;
+
+  /**
+   * Version of the graph held.
+   */
+  std::uint64_t version_ = 0;
+};
+
+/**
+ * Client of the Mediator's graph interface for tools such as mrosnode and mroskill. Connects to the Mediator as a Node
+ * of its own, fetches the graph, and optionally keeps a GraphView up to date from the changes the Mediator pushes.
+ */
+class GraphWatcher {
+ public:
+  /**
+   * Callback invoked on the receiving thread with each change applied to the view.
+   */
+  using ChangeCallback = std::function<void(GraphDelta const &)>;
+
+  /**
+   * Connect to the Mediator and fetch the graph.
+   * @param node_name The name to connect to the Mediator with.
+   * @param watch Whether to keep the view up to date after the first fetch.
+   * @param change_callback Callback invoked with each change applied to the view while watching.
+   * @param address The address of the Mediator.
+   * @param port The port of the Mediator.
+   * @throws SocketException Throws exception if the Mediator cannot be reached.
+   */
+  GraphWatcher(std::string const &node_name, bool watch, ChangeCallback change_callback = {},
+               std::string const &address = "127.0.0.1", int port = 13331);
+
+  /**
+   * Close the connection with the Mediator.
+   */
+  ~GraphWatcher();
+
+  /**
+   * Get a copy of the current view of the graph.
+   */
+  GraphView graph();
+
+  /**
+   * Fetch the changes the view has missed, or a full snapshot if the Mediator no longer has them. Only needed after
+   * synchronized() turns false, which means a change was lost.
+   */
+  void synchronize();
+
+  /**
+   * Check whether the view has applied every change pushed since the last fetch.
+   */
+  bool synchronized();
+
+  /**
+   * Check whether the connection with the Mediator is still open.
+   */
+  bool connected();
+
+  /**
+   * Ask the Mediator to disconnect every Node with a name.
+   * @return The URIs of the Nodes that were disconnected.
+   */
+  std::vector<std::string> killNode(std::string const &node_name);
+
+ private:
+  /**
+   * Apply a change pushed by the Mediator, holding it back until the fetch in progress has been applied.
+   */
+  void handleChange(GraphDelta const &delta);
+
+  /**
+   * Connection with the Mediator.
+   */
+  std::unique_ptr<ClientBsonRPCSocket> bson_rpc_client_;
+
+  /**
+   * Whether the Mediator pushes changes to this watcher.
+   */
+  bool watch_;
+
+  /**
+   * Callback invoked with each change applied to the view.
+   */
+  ChangeCallback change_callback_;
+
+  /**
+   * View of the graph. Guarded by graph_lock_.
+   */
+  GraphView graph_;
+
+  /**
+   * Whether every pushed change has been applied to graph_. False while fetching. Guarded by graph_lock_.
+   */
+  bool synchronized_ = false;
+
+  /**
+   * Changes pushed while fetching, applied once the fetch completes. Guarded by graph_lock_.
+   */
+  std::vector<GraphDelta> pending_deltas_;
+
+  /**
+   * Lock taken to ensure thread safety of accessing the view between the receiving thread and the user's thread.
+   */
+  std::mutex graph_lock_;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Kinds of test a FieldCondition makes of a field.
+ */
+enum class FieldConditionKind { kEquals, kRange };
+NLOHMANN_JSON_SERIALIZE_ENUM(FieldConditionKind, {{FieldConditionKind::kEquals, "equals"},
+                                                  {FieldConditionKind::kRange, "range"}})
+
+/**
+ * Test of one field of an encoded message.
+ */
+struct FieldCondition {
+  /**
+   * Name of the field, with the names of nested documents and the indices of arrays separated by dots, such as
+   * "pose.position.x" or "ranges.0".
+   */
+  std::string field;
+  FieldConditionKind kind = FieldConditionKind::kEquals;
+
+  /**
+   * Value the field must equal, for kEquals. A number, string, or boolean. Numbers compare by value whatever their
+   * encoded type.
+   */
+  nlohmann::json value;
+
+  /**
+   * Inclusive bounds the field must lie within, for kRange. The field must be a number.
+   */
+  double min = 0;
+  double max = 0;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(FieldCondition, field, kind, value, min, max)
+
+/**
+ * Declarative filter of the messages on a topic, passed by a Subscriber to each Publisher it connects to so that the
+ * Publisher only sends the messages the Subscriber wants. A message passes if it meets all of the conditions. The
+ * conditions are tested on the encoded Bson by walking it to the named fields, so a Publisher tests each message
+ * against many Subscribers' filters without decoding it. A message missing a field, or that is not well formed Bson,
+ * fails the conditions on that field.
+ */
+struct MessageFilter {
+  std::vector<FieldCondition> conditions;
+
+  /**
+   * Add a condition that a field equals a value.
+   * @return This filter, to chain further conditions.
+   */
+  MessageFilter &whereEquals(std::string field, nlohmann::json value);
+
+  /**
+   * Add a condition that a numeric field lies within inclusive bounds.
+   * @return This filter, to chain further conditions.
+   */
+  MessageFilter &whereInRange(std::string field, double min, double max);
+
+  /**
+   * Check whether the filter passes every message.
+   */
+  bool empty() const;
+
+  /**
+   * Test an encoded message against the conditions.
+   * @param bson The Bson of the message.
+   * @return True if the message meets every condition, false otherwise.
+   */
+  bool matches(std::span<std::uint8_t const> bson) const;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(MessageFilter, conditions)
+
+/**
+ * First message a Subscriber sends on each Publisher connection.
+ */
+struct SubscribeRequest {
+  MessageFilter filter;
+
+  /**
+   * Most messages per second the Publisher sends on the connection, zero for every message.
+   */
+  double max_rate_hz = 0;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SubscribeRequest, filter, max_rate_hz)
+
+/**
+ * A value found in an encoded Bson document.
+ */
+struct BsonElement {
+  /**
+   * Bson type byte of the value.
+   */
+  std::uint8_t type = 0;
+
+  /**
+   * Encoded bytes of the value.
+   */
+  std::span<std::uint8_t const> value;
+};
+
+/**
+ * Find a field in an encoded Bson document without decoding the document, skipping over the other fields.
+ * @param bson The Bson document.
+ * @param field The name of the field, with nested names separated by dots.
+ * @param element Set to the field's value if it is found.
+ * @return False if the field is missing or the document is malformed, true otherwise.
+ */
+bool findBsonField(std::span<std::uint8_t const> bson, std::string_view field, BsonElement &element);
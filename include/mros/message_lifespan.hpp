@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "socket/bson_socket/bson_socket.hpp"
+
+/**
+ * Clock a message's age is measured on for its lifespan.
+ */
+enum class LifespanClock : std::uint8_t {
+  /**
+   * Time since the Subscriber received the message. Drops the backlog a stalled callback left behind.
+   */
+  kReceiveTime,
+
+  /**
+   * Time since the Publisher published the message, by the wall clock time in its frame header. Also drops messages
+   * that were late to arrive, but relies on the clocks of the two hosts agreeing.
+   */
+  kPublishTime,
+};
+
+/**
+ * Age past which queued messages are stale and dropped before they are decoded or delivered.
+ */
+class MessageLifespan {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param lifespan The age past which messages are dropped. Zero or less to keep messages however old.
+   * @param clock The clock the age is measured on.
+   */
+  explicit MessageLifespan(Clock::duration lifespan = Clock::duration::zero(),
+                           LifespanClock clock = LifespanClock::kReceiveTime);
+
+  /**
+   * Check whether messages expire at all.
+   */
+  bool limited() const { return lifespan_ > Clock::duration::zero(); }
+
+  /**
+   * Check whether messages need their receive time recorded as they are queued.
+   */
+  bool needsReceiveTime() const { return limited() && clock_ == LifespanClock::kReceiveTime; }
+
+  /**
+   * Check whether a queued frame has expired. Frames too short to hold a header never expire by publish time, and are
+   * left for decoding to reject.
+   * @param frame The frame, starting with its TopicFrameHeader.
+   * @param receive_time The time the frame was received, used when measuring on the receive time.
+   * @param now The current time.
+   */
+  bool expired(ByteSpan frame, Clock::time_point receive_time, Clock::time_point now) const;
+
+ private:
+  Clock::duration lifespan_;
+  LifespanClock clock_;
+};
@@ -1,29 +1,60 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <concepts>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <span>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
+#include "coroutine/coroutine_scheduler.hpp"
+#include "coroutine/flow.hpp"
+#include "coroutine/rpc_awaitable.hpp"
 #include "logging/logging.hpp"
+#include "mediator/mediator_rpc.hpp"
 #include "mros/utils/utils.hpp"
 #include "mros/mros.hpp"
 #include "mros/node_base.hpp"
 #include "mros/publisher.hpp"
 #include "mros/subscriber.hpp"
+#include "mros/wait_set.hpp"
 #include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+#include "thread_pool/thread_pool.hpp"
+#include "timer/timer.hpp"
 
 using TopicName = std::string;
 
+/**
+ * Options of a Node.
+ */
+struct NodeOptions {
+  /**
+   * Number of threads running the callbacks of the Node's timers, and of its subscribers once it spins, including
+   * those reserved for high priority callbacks.
+   */
+  std::size_t callback_thread_count = 2;
+
+  /**
+   * Threads of the callback executor reserved for high priority callbacks, and their realtime priority and CPUs.
+   */
+  ThreadPoolOptions callback_executor;
+};
+
 class Node : public std::enable_shared_from_this<Node>, public NodeBase {
  public:
   /**
    * Set up the node's rpc connection to the mediator and then start the sentinel thread.
+   * @param node_name The name of the node.
+   * @param mediator_address The address of the Mediator in x.x.x.x format.
+   * @param mediator_port The port of the Mediator.
+   * @param options The size and scheduling of the callback executor.
    */
-  explicit Node(std::string const &node_name);
+  explicit Node(std::string const &node_name, std::string const &mediator_address = "127.0.0.1",
+                int mediator_port = 13331, NodeOptions options = {});
 
   /**
    * Set the is_shutdown flag to true and then join the sentinel thread.
@@ -31,41 +62,128 @@ class Node : public std::enable_shared_from_this<Node>, public NodeBase {
   ~Node();
 
   /**
-   * Spin all associated publishers
+   * Run the callbacks of all the Node's subscribers on the callback executor as messages arrive, by priority class,
+   * then block until the Node disconnects. Each subscriber's callback runs on one executor thread at a time.
    */
   void spin();
 
   /**
-   *
+   * Get the counters of the callback executor for each priority class, indexed by TaskPriority, such as the callbacks
+   * that missed their subscriber's deadline. All zero until the executor starts with the first timer or spin().
+   */
+  std::array<TaskPriorityStatistics, kTaskPriorityCount> callbackStatistics();
+
+  /**
+   * Run the callback of every Subscriber with its oldest queued message, skipping Subscribers with none. Does not
+   * block, so to wait for messages from several Subscribers, timers and events at once use a WaitSet instead.
    */
   void spinOnce();
 
   /**
-   *
+   * Create a subscriber on a topic and connect it to the topic's publishers, now and as they are added.
+   * @param topic_name The topic to subscribe to.
+   * @param queue_size The number of messages to queue before dropping the oldest.
+   * @param callback Called with each message once the Node spins.
+   * @param options The filter and maximum rate the publishers apply for the subscriber.
    */
   template <typename MessageT, typename CallbackT = void (*)(MessageT), typename SubscriberT = Subscriber<MessageT>>
-  requires JsonConvertible<MessageT>
-  std::shared_ptr<SubscriberT> createSubscriber(std::string topic_name, std::uint32_t queue_size, CallbackT &&callback);
+  requires TopicMessage<MessageT> && std::invocable<CallbackT &, MessageT>
+  std::shared_ptr<SubscriberT> createSubscriber(std::string topic_name, std::uint32_t queue_size, CallbackT &&callback,
+                                                SubscriberOptions options = {});
 
   /**
-   *
+   * Create a subscriber whose callback takes its messages in batches, with as many as are queued at once up to the
+   * maximum batch size of the options, to amortize the cost of delivery on high rate topics.
+   * @param topic_name The topic to subscribe to.
+   * @param queue_size The number of messages to queue before dropping the oldest.
+   * @param callback Called with each batch of messages once the Node spins, which are only valid during the call.
+   * @param options The filter and maximum rate the publishers apply for the subscriber, and the batch limits.
+   */
+  template <typename MessageT, typename CallbackT, typename SubscriberT = Subscriber<MessageT>>
+  requires TopicMessage<MessageT> && std::invocable<CallbackT &, std::span<MessageT const>>
+  std::shared_ptr<SubscriberT> createSubscriber(std::string topic_name, std::uint32_t queue_size, CallbackT &&callback,
+                                                SubscriberOptions options = {});
+
+  /**
+   * Create a subscriber without a callback, whose messages are awaited with next() in coroutines spawned on the Node.
+   * Spinning skips it, so that its messages are left for the coroutines.
+   * @param topic_name The topic to subscribe to.
+   * @param queue_size The number of messages to queue before dropping the oldest.
+   * @param options The filter and maximum rate the publishers apply for the subscriber.
+   */
+  template <typename MessageT, typename SubscriberT = Subscriber<MessageT>>
+  requires TopicMessage<MessageT>
+  std::shared_ptr<SubscriberT> createSubscriber(std::string topic_name, std::uint32_t queue_size,
+                                                SubscriberOptions options = {});
+
+  /**
+   * Create a publisher on a topic and register it with the Mediator, which connects the topic's subscribers to it.
+   * @param topic_name The topic to publish on.
+   * @param options The transport to publish over.
+   * @throws SocketException Throws exception if the publisher's sockets fail to set up.
    */
   template <typename MessageT, typename PublisherT = Publisher<MessageT>>
-  requires JsonConvertible<MessageT>
-  std::shared_ptr<PublisherT> createPublisher(std::string topic_name);
+  requires TopicMessage<MessageT>
+  std::shared_ptr<PublisherT> createPublisher(std::string topic_name, PublisherOptions const &options = {});
+
+  /**
+   * Create a timer running a callback once a period on the Node's callback executor, until the timer is cancelled or
+   * destroyed or the Node disconnects. All the Node's timers share one scheduling thread and the executor's threads,
+   * which start with the first timer.
+   * @param period The time between runs. The first run is a period from now.
+   * @param callback The function to run.
+   * @return The timer, whose statistics count the runs, the missed deadlines, and how late the runs started.
+   */
+  std::shared_ptr<Timer> createTimer(std::chrono::steady_clock::duration period, std::function<void()> callback);
+
+  /**
+   * Create a timer running a callback once on the Node's callback executor, sharing the scheduling thread of
+   * createTimer().
+   * @param delay The time from now to the run.
+   * @param callback The function to run.
+   * @return The timer, which runs unless cancelled or destroyed first, or the Node disconnects.
+   */
+  std::shared_ptr<Timer> createOneShotTimer(std::chrono::steady_clock::duration delay,
+                                            std::function<void()> callback) override;
+
+  /**
+   * Start a coroutine on the Node's coroutine scheduler, which resumes all the Node's coroutines on one thread as the
+   * messages and replies they await arrive. The scheduler starts with the first coroutine and stops when the Node
+   * disconnects.
+   * @param flow The coroutine, which starts on the scheduling thread.
+   */
+  void spawn(Flow flow);
+
+  /**
+   * Send a full duplex request to the Mediator to be awaited by a coroutine, as in
+   *
+   *   GraphUpdate update = co_await node->callMediator(kGetGraphRPC, {false, 0});
+   *
+   * @param method The Mediator method to call.
+   * @param argument The argument of the method.
+   * @return Awaitable resuming with the decoded result, or throwing SocketException if the Mediator does not respond
+   * in time.
+   */
+  template <typename ArgumentT, typename ResultT>
+  RPCAwaitable<ResultT> callMediator(RPCMethod<ArgumentT, ResultT> const &method, ArgumentT const &argument) {
+    return awaitTypedRequest(*bson_rpc_client_, method, argument, kMediatorTimeout_);
+  }
 
  private:
   /**
-   * Instruct a Subscriber to add a connection to a new Publisher on the topic, given the Publisher's address.
-   * Registered as a callback for the Mediator, and called by the Mediator when another Node adds a publisher on a Topic
-   * subscribed to by this Node.
+   * Create a subscriber with either kind of callback, register it with the Mediator and connect it to the publishers
+   * already on the topic.
    */
-  void connectSubscriberToPublishers(TopicName topic_name, std::vector<std::string> hosts, std::vector<int> ports);
+  template <typename MessageT, typename SubscriberT, typename CallbackFunctionT>
+  std::shared_ptr<SubscriberT> addSubscriber(std::string topic_name, std::uint32_t queue_size,
+                                             CallbackFunctionT callback, SubscriberOptions options);
 
   /**
-   * Json parsing wrapper for connectSubscriberToNewPublisher() to allow registration as callback.
+   * Instruct a Subscriber to add connections to Publishers on the topic, given the Publishers' addresses. Registered as
+   * a callback for the Mediator, and called by the Mediator when another Node adds a publisher on a Topic subscribed to
+   * by this Node.
    */
-  void jsonConnectSubscriberToPublishersCallback(json const &json);
+  void connectSubscriberToPublishers(PublisherAddresses const &publishers);
 
   /**
    * Remove a Subscriber instance on a given topic if one exists. Called on destruction of a Subscriber by a user or
@@ -87,6 +205,11 @@ class Node : public std::enable_shared_from_this<Node>, public NodeBase {
    */
   void disconnect();
 
+  /**
+   * Get the callback executor, starting it if this is the first use. Called with timer_scheduler_mutex_ held.
+   */
+  std::shared_ptr<ThreadPool> const &callbackExecutor();
+
   /**
    * RPC client to communicate with the Mediator.
    */
@@ -102,23 +225,52 @@ class Node : public std::enable_shared_from_this<Node>, public NodeBase {
    */
   std::unordered_map<TopicName, std::weak_ptr<SubscriberBase>> subscribers_;
 
+  /**
+   * Time in milliseconds to wait for the mediator to respond to a full duplex request.
+   */
+  static constexpr int kMediatorTimeout_ = 5000;
+
+  NodeOptions options_;
+
+  /**
+   * Executor running timer and subscriber callbacks, created with the first timer or spin(), and the scheduler handing
+   * timer callbacks to it, created with the first timer. Subscribers hold the executor weakly. The scheduler is
+   * declared last so that it is destroyed before the executor. Guarded by timer_scheduler_mutex_.
+   */
+  std::shared_ptr<ThreadPool> callback_executor_;
+  std::unique_ptr<TimerScheduler> timer_scheduler_;
+  std::mutex timer_scheduler_mutex_;
+
+  /**
+   * Scheduler resuming the Node's coroutines, created with the first one. Shared so that awaitables can keep it alive
+   * until they hand their coroutine back. Guarded by coroutine_scheduler_mutex_.
+   */
+  std::shared_ptr<CoroutineScheduler> coroutine_scheduler_;
+  std::mutex coroutine_scheduler_mutex_;
+
   std::mutex spin_lock_;
   std::condition_variable spin_condition_variable_;
   std::atomic<bool> connected_;
   std::string node_name_;
 
+  /**
+   * Pointer to this Node held by the ctrl+C routine weakly, so that a Node destroyed before ctrl+C is not disconnected
+   * again through a dangling pointer.
+   */
+  std::shared_ptr<Node *> deactivate_target_;
+
   MROS &mros_;
   Logger &logger_;
 };
 
 template <typename MessageT, typename PublisherT>
-requires JsonConvertible<MessageT>
-std::shared_ptr<PublisherT> Node::createPublisher(std::string topic_name) {
+requires TopicMessage<MessageT>
+std::shared_ptr<PublisherT> Node::createPublisher(std::string topic_name, PublisherOptions const &options) {
   // Copy the topic name to avoid using string invalidated by std::move().
   std::string temp_topic_name = topic_name;
 
   // Create a publisher and add it to the container of publishers.
-  auto raw_publisher = new PublisherT(shared_from_this(), std::move(topic_name));
+  auto raw_publisher = new PublisherT(shared_from_this(), std::move(topic_name), options);
   auto temp_publisher = std::shared_ptr<PublisherT>(raw_publisher);
   // TODO: Check and throw an error for multiple publishers on the same topic.
   publishers_[topic_name] = temp_publisher;
@@ -127,32 +279,63 @@ std::shared_ptr<PublisherT> Node::createPublisher(std::string topic_name) {
   std::pair<std::string, int> address_port = temp_publisher->getAddress();
 
   // Send a full duplex request to the mediator to connect the subscriber.
-  json message{{"topic_name", temp_topic_name}, {"address", address_port.first}, {"port", address_port.second}};
-  bson_rpc_client_->sendRequest("addPublisher", message);
+  std::string interface_address =
+      options.transport == TopicTransport::kUdpMulticast ? options.multicast_interface : std::string();
+  sendTypedRequest(*bson_rpc_client_, kAddPublisherRPC,
+                   {temp_topic_name, address_port.first, address_port.second, options.transport, interface_address});
 
   // Return the new publisher to the user.
   return temp_publisher;
 }
 
 template <typename MessageT, typename CallbackT, typename SubscriberT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT> && std::invocable<CallbackT &, MessageT>
 std::shared_ptr<SubscriberT> Node::createSubscriber(std::string topic_name, std::uint32_t queue_size,
-                                                    CallbackT &&callback) {
+                                                    CallbackT &&callback, SubscriberOptions options) {
+  std::function<void(MessageT)> callbackFunc(callback);
+  return addSubscriber<MessageT, SubscriberT>(std::move(topic_name), queue_size, std::move(callbackFunc),
+                                              std::move(options));
+}
+
+template <typename MessageT, typename CallbackT, typename SubscriberT>
+requires TopicMessage<MessageT> && std::invocable<CallbackT &, std::span<MessageT const>>
+std::shared_ptr<SubscriberT> Node::createSubscriber(std::string topic_name, std::uint32_t queue_size,
+                                                    CallbackT &&callback, SubscriberOptions options) {
+  std::function<void(std::span<MessageT const>)> callbackFunc(callback);
+  return addSubscriber<MessageT, SubscriberT>(std::move(topic_name), queue_size, std::move(callbackFunc),
+                                              std::move(options));
+}
+
+template <typename MessageT, typename SubscriberT, typename CallbackFunctionT>
+std::shared_ptr<SubscriberT> Node::addSubscriber(std::string topic_name, std::uint32_t queue_size,
+                                                 CallbackFunctionT callback, SubscriberOptions options) {
   // Copy the topic name to avoid using string invalidated by std::move().
   std::string temp_topic_name = topic_name;
 
   // Create a subscriber and add it to the container of subscribers.
-  std::function<void(MessageT)> callbackFunc(callback);
-  auto raw_subscriber =
-      new Subscriber<MessageT>(shared_from_this(), std::move(topic_name), queue_size, std::move(callbackFunc));
+  auto raw_subscriber = new Subscriber<MessageT>(shared_from_this(), std::move(topic_name), queue_size,
+                                                 std::move(callback), std::move(options));
   auto temp_subscriber = std::shared_ptr<SubscriberT>(raw_subscriber);
   // TODO: Check and throw an error for multiple subscribers on the same topic.
   subscribers_[temp_topic_name] = temp_subscriber;
 
-  // Send a full duplex request to the mediator to connect the subscriber to any publishers on the topic.
-  json message{{"topic_name", temp_topic_name}};
-  bson_rpc_client_->sendRequestAndGetResponse("addSubscriber", message, "connectSubscriberToPublishers");
+  // Send a full duplex request to the mediator and block until its response arrives, then connect the subscriber to
+  // the publishers already on the topic. Publishers added later are pushed by the mediator.
+  try {
+    connectSubscriberToPublishers(
+        sendTypedRequestAndGetFuture(*bson_rpc_client_, kAddSubscriberRPC, {temp_topic_name}, kMediatorTimeout_).get());
+  } catch (SocketException const &e) {
+    logger_.info(e.what());
+  }
 
   // Return the new subscriber to the user.
   return temp_subscriber;
 }
+
+template <typename MessageT, typename SubscriberT>
+requires TopicMessage<MessageT>
+std::shared_ptr<SubscriberT> Node::createSubscriber(std::string topic_name, std::uint32_t queue_size,
+                                                    SubscriberOptions options) {
+  return createSubscriber<MessageT, std::function<void(MessageT)>, SubscriberT>(
+      std::move(topic_name), queue_size, std::function<void(MessageT)>(), std::move(options));
+}
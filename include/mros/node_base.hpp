@@ -1,19 +1,24 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 
 #include "mros/utils/utils.hpp"
 
+class Timer;
+
 /**
  * Interface class for Node to provide dependency inversion with Publisher and Subscriber.
  */
 class NodeBase {
   template <typename MessageT>
-  requires JsonConvertible<MessageT>
+  requires TopicMessage<MessageT>
   friend class Publisher;
 
   template <typename MessageT>
-  requires JsonConvertible<MessageT>
+  requires TopicMessage<MessageT>
   friend class Subscriber;
  protected:
   NodeBase() = default;
@@ -23,4 +28,10 @@ class NodeBase {
   virtual void removeSubscriberByTopic(std::string topic_name) = 0;
 
   virtual void removePublisherByTopic(std::string topic_name) = 0;
+
+  /**
+   * Create a timer running a callback once, a delay from now, on the Node's callback executor.
+   */
+  virtual std::shared_ptr<Timer> createOneShotTimer(std::chrono::steady_clock::duration delay,
+                                                    std::function<void()> callback) = 0;
 };
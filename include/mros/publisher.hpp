@@ -2,17 +2,97 @@
 
 #include <arpa/inet.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <span>
+#include <vector>
 
 #include "logging/logging.hpp"
+#include "mediator/mediator_rpc.hpp"
+#include "mros/message_filter.hpp"
 #include "mros/node_base.hpp"
+#include "mros/rate_limiter.hpp"
 #include "socket/bson_socket/connection_bson_socket.hpp"
+#include "socket/bson_socket/write_coalescer.hpp"
+#include "socket/multicast_socket/multicast_sender_socket.hpp"
 #include "socket/server_socket.hpp"
 
 using namespace std::chrono_literals;
 
 class Node;
 
+/**
+ * Options of a Publisher.
+ */
+struct PublisherOptions {
+  /**
+   * Transport to send messages over. TCP sends every message to every subscriber over its own connection, reliably.
+   * UDP multicast sends every message once to a multicast group that subscribers join, so that publishing costs the
+   * same however many subscribers there are, but messages may be lost or arrive out of order.
+   */
+  TopicTransport transport = TopicTransport::kTcp;
+
+  /**
+   * Multicast group to send to, for the UDP multicast transport.
+   */
+  std::string multicast_group = "239.255.13.31";
+
+  /**
+   * Port to send to, for the UDP multicast transport. Zero to have the kernel choose a free one, so that publishers on
+   * the same group do not share a port.
+   */
+  int multicast_port = 0;
+
+  /**
+   * Address of the interface to send on, for the UDP multicast transport. The loopback address keeps messages on this
+   * host.
+   */
+  std::string multicast_interface = "127.0.0.1";
+
+  /**
+   * Largest datagram to send, for the UDP multicast transport. The default fits an Ethernet MTU. On loopback, larger
+   * datagrams split a message into fewer fragments.
+   */
+  std::size_t max_datagram_bytes = 1472;
+
+  /**
+   * Whether TCP subscriber connections send each write at once (TCP_NODELAY) rather than holding small writes under
+   * Nagle's algorithm until earlier data is acknowledged. Nagle's algorithm joins small messages published faster than
+   * the round trip into fewer segments, at the cost of up to a round trip of latency.
+   */
+  bool tcp_no_delay = false;
+
+  /**
+   * Longest time a message may be held to be written to a TCP subscriber together with the messages published after
+   * it, so that small messages at a high rate take fewer system calls. Zero, the default, writes every message as it is
+   * published, which latency critical topics should keep.
+   */
+  std::chrono::microseconds coalesce_delay{0};
+
+  /**
+   * Number of held bytes at which the messages held for a subscriber are written without waiting out the delay.
+   * Messages this large are never held.
+   */
+  std::size_t coalesce_bytes = 16 * 1024;
+};
+
+/**
+ * Counters of the writes a TCP Publisher made to its subscriber connections.
+ */
+struct PublisherSendStatistics {
+  /**
+   * Messages written to subscriber connections, counting each message once per connection.
+   */
+  std::uint64_t frame_count = 0;
+
+  /**
+   * Writes to subscriber connections. Each is one sendmsg() call unless the kernel takes the write in parts.
+   */
+  std::uint64_t write_count = 0;
+};
+
 /**
  * Publisher base class for providing interface to Node.
  */
@@ -32,7 +112,7 @@ class PublisherBase {
  * Publisher template class to return to user for use in messaging.
  */
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 class Publisher : public std::enable_shared_from_this<Publisher<MessageT>>, public PublisherBase {
  public:
   Publisher() = delete;
@@ -41,9 +121,62 @@ class Publisher : public std::enable_shared_from_this<Publisher<MessageT>>, publ
 
   void publish(MessageT message);
 
+  /**
+   * Publish a message that is already encoded, such as one replayed from a bag, without decoding it. The message is
+   * sent under a new frame header like any other.
+   * @param encoded_message The Bson of the message.
+   */
+  void publishEncoded(ByteSpan encoded_message);
+
+  /**
+   * Publish a burst of messages at once, such as one per object detected in a frame. Each message is encoded once, and
+   * every subscriber connection is written with one vectored send for the whole burst, while subscribers still receive
+   * the messages one by one, in order, with consecutive sequence numbers. Filters and maximum rates apply to each
+   * message as if published on its own.
+   * @param messages The messages to publish, in order.
+   */
+  void publishMany(std::span<MessageT const> messages);
+
+  /**
+   * Publish a burst of messages that are already encoded, as publishMany() does.
+   * @param encoded_messages The Bson of each message, in order.
+   */
+  void publishEncodedMany(std::span<ByteSpan const> encoded_messages);
+
+  /**
+   * Get the counters of the multicast sender. All zero for a TCP publisher.
+   */
+  MulticastSenderStatistics multicastStatistics();
+
+  /**
+   * Get the counters of the writes to subscriber connections, such as to find the writes per message with coalescing.
+   * All zero for a UDP multicast publisher.
+   */
+  PublisherSendStatistics sendStatistics();
+
+  /**
+   * Check whether any subscriber is connected, without locking, so that producers can skip building messages nobody
+   * would receive. Always true for a UDP multicast publisher, which cannot see who has joined its group.
+   */
+  bool hasSubscribers() const;
+
+  /**
+   * Get the number of connected subscribers, without locking. Zero for a UDP multicast publisher, which cannot see who
+   * has joined its group.
+   */
+  std::size_t getNumSubscribers() const;
+
+  /**
+   * Set a callback called each time a subscriber connects, such as to publish a latched message to it or to start
+   * building messages that were skipped while nobody was listening. Called on the Publisher's accepting thread, so it
+   * must not block for long. Never called for a UDP multicast publisher.
+   * @param callback Called with the number of connected subscribers, including the new one.
+   */
+  void onSubscriberConnect(std::function<void(std::size_t)> callback);
+
   friend class Node;
  private:
-  Publisher(std::weak_ptr<NodeBase> node, std::string topic_name);
+  Publisher(std::weak_ptr<NodeBase> node, std::string topic_name, PublisherOptions const &options);
 
   std::pair<std::string, int> getAddress() override;
 
@@ -51,38 +184,156 @@ class Publisher : public std::enable_shared_from_this<Publisher<MessageT>>, publ
 
   void acceptConnectionsUntilDisconnect();
 
+  /**
+   * Write the messages held for each connection once their delay runs out, until disconnected. Run by the flushing
+   * thread of a Publisher that coalesces writes.
+   */
+  void flushCoalescedUntilDisconnect();
+
+  /**
+   * Check whether any subscriber is due a message under its maximum rate, so that messages none of them are due are
+   * not encoded. Always true for a UDP multicast publisher, whose receivers decimate for themselves, and answered
+   * without the lock while any subscriber is not rate limited.
+   */
+  bool anySubscriberDue();
+
+  /**
+   * Update subscriber_count_ and limited_subscriber_count_ from subscriber_connections_. Called with
+   * subscriber_connections_mutex_ held.
+   */
+  void countSubscribers();
+
+  /**
+   * A connected Subscriber and the filter and maximum rate it asked for when connecting.
+   */
+  struct SubscriberConnection {
+    std::shared_ptr<ConnectionBsonSocket> socket;
+    MessageFilter filter;
+    RateLimiter rate_limiter;
+
+    /**
+     * Messages held to be written together. Null when the Publisher writes every message at once.
+     */
+    std::unique_ptr<WriteCoalescer> coalescer;
+  };
+
+  /**
+   * Write one message to a connection, or hold it to be written with later ones. Called with
+   * subscriber_connections_mutex_ held.
+   * @throws SocketException Throws exception if the connection fails.
+   */
+  void sendFrame(SubscriberConnection& connection, ByteSpan encoded_header, ByteSpan encoded_message);
+
+  /**
+   * Write header and message pairs to a connection with one vectored send, or hold them to be written with later ones.
+   * Called with subscriber_connections_mutex_ held.
+   * @throws SocketException Throws exception if the connection fails.
+   */
+  void sendFrames(SubscriberConnection& connection, std::span<ByteSpan const> frame_parts);
+
+  /**
+   * Write the messages held for a connection, if any. Called with subscriber_connections_mutex_ held.
+   * @throws SocketException Throws exception if the connection fails.
+   */
+  void flushCoalescer(SubscriberConnection& connection);
+
   std::weak_ptr<NodeBase> node_;
   std::string topic_name_;
 
   std::shared_ptr<ServerSocket> subscriber_acceptor_;
   std::thread accepting_thread_;
   std::atomic<bool> connected_;
+  PublisherOptions options_;
+
+  /**
+   * Thread writing held messages whose delay has run out, and the condition it waits on for messages to be held. Only
+   * started when the Publisher coalesces writes.
+   */
+  std::thread flushing_thread_;
+  std::condition_variable flush_condition_variable_;
 
-  std::vector<std::shared_ptr<ConnectionBsonSocket>> subscriber_connections_;
+  std::vector<SubscriberConnection> subscriber_connections_;
   std::mutex subscriber_connections_mutex_;
 
+  /**
+   * Size of subscriber_connections_, kept up to date under subscriber_connections_mutex_ so that it can be read without
+   * the lock.
+   */
+  std::atomic<std::size_t> subscriber_count_ = 0;
+
+  /**
+   * Number of subscriber_connections_ with a maximum rate, kept alongside subscriber_count_. While it is below
+   * subscriber_count_ some subscriber is due every message, so publishing need not check the rate limiters first.
+   */
+  std::atomic<std::size_t> limited_subscriber_count_ = 0;
+
+  /**
+   * Guarded by subscriber_connections_mutex_.
+   */
+  PublisherSendStatistics send_statistics_;
+
+  std::function<void(std::size_t)> subscriber_connect_callback_;
+  std::mutex subscriber_connect_callback_mutex_;
+
+  /**
+   * Sender to the multicast group of a UDP multicast publisher, which has no subscriber acceptor or connections. Null
+   * for a TCP publisher.
+   */
+  std::unique_ptr<MulticastSenderSocket> multicast_sender_;
+
+  /**
+   * Sequence number of the next message published. Guarded by subscriber_connections_mutex_.
+   */
+  std::uint64_t next_sequence_ = 0;
+
+  /**
+   * Time in milliseconds a connecting subscriber has to send its SubscribeRequest before it is dropped.
+   */
+  static constexpr int kSubscribeRequestTimeout_ = 1000;
+
   Logger &logger_;
 };
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
-Publisher<MessageT>::Publisher(std::weak_ptr<NodeBase> node, std::string topic_name)
-    : node_(std::move(node)), topic_name_(std::move(topic_name)), connected_(true), logger_(Logger::getLogger()) {
+requires TopicMessage<MessageT>
+Publisher<MessageT>::Publisher(std::weak_ptr<NodeBase> node, std::string topic_name, PublisherOptions const &options)
+    : node_(std::move(node)),
+      topic_name_(std::move(topic_name)),
+      connected_(true),
+      options_(options),
+      logger_(Logger::getLogger()) {
+  // A multicast publisher sends to its group whoever is listening, so it never accepts connections.
+  if (options.transport == TopicTransport::kUdpMulticast) {
+    multicast_sender_ =
+        std::make_unique<MulticastSenderSocket>(options.multicast_group, options.multicast_port,
+                                                options.multicast_interface, options.max_datagram_bytes);
+    return;
+  }
+
   // Initialize the server socket to port zero so that the kernel will choose a valid port.
   subscriber_acceptor_ = std::make_shared<ServerSocket>(AF_INET, "127.0.0.1", 0, 100);
 
   // Start and detach the accepting thread to handle incoming subscriber connections.
   accepting_thread_ = std::thread([this]() -> void { acceptConnectionsUntilDisconnect(); });
+  if (options_.coalesce_delay > std::chrono::microseconds::zero()) {
+    flushing_thread_ = std::thread([this]() -> void { flushCoalescedUntilDisconnect(); });
+  }
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 Publisher<MessageT>::~Publisher() {
   // Trigger the shutdown sequence for the accepting thread if it has not already been triggered.
   if (connected_) connected_ = false;
 
-  // Wait for the accepting thread to finish closing the server and connections.
-  accepting_thread_.join();
+  // Wait for the accepting thread to finish closing the server and connections, if there is one.
+  if (accepting_thread_.joinable()) accepting_thread_.join();
+
+  // Wake the flushing thread so that it sees the shutdown, and wait for it to finish.
+  subscriber_connections_mutex_.lock();
+  flush_condition_variable_.notify_all();
+  subscriber_connections_mutex_.unlock();
+  if (flushing_thread_.joinable()) flushing_thread_.join();
 
   // Tell the Node to remove this Publisher if the Node is available.
   if (auto const& node = node_.lock()) {
@@ -91,60 +342,356 @@ Publisher<MessageT>::~Publisher() {
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 void Publisher<MessageT>::disconnect() {
-  // Set connection flag to false so that the accepting thread shuts down.
+  // Set connection flag to false so that the accepting and flushing threads shut down.
   connected_ = false;
+  std::lock_guard<std::mutex> subscriber_connections_lock_guard(subscriber_connections_mutex_);
+  flush_condition_variable_.notify_all();
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 std::pair<std::string, int> Publisher<MessageT>::getAddress() {
+  if (multicast_sender_) return multicast_sender_->getGroupPort();
   return subscriber_acceptor_->getAddressPort();
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
+MulticastSenderStatistics Publisher<MessageT>::multicastStatistics() {
+  if (multicast_sender_) return multicast_sender_->statistics();
+  return {};
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+PublisherSendStatistics Publisher<MessageT>::sendStatistics() {
+  std::lock_guard<std::mutex> subscriber_connections_lock_guard(subscriber_connections_mutex_);
+  return send_statistics_;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
 void Publisher<MessageT>::publish(MessageT message) {
-  json json_message = message.convert_to_json();
+  // Return before taking any lock when nobody is listening, as on debug topics.
+  if (!hasSubscribers()) return;
+
+  // Skip encoding a message no subscriber is due, as when all of them ask for a lower rate. It still uses up its
+  // sequence number.
+  if (!anySubscriberDue()) {
+    std::lock_guard<std::mutex> subscriber_connections_lock_guard(subscriber_connections_mutex_);
+    ++next_sequence_;
+    return;
+  }
+
+  // Encode the message once for all subscribers. Raw messages are already encoded.
+  if constexpr (FrameConvertible<MessageT>) {
+    publishEncoded(message.frame_payload());
+  } else {
+    publishEncoded(json::to_bson(message.convert_to_json()));
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::publishEncoded(ByteSpan encoded_message) {
+  if (!hasSubscribers()) return;
 
   // Send the message to all subscriber connections. Hold the lock for the whole send cycle so that shutdown will not
   // cause messages to only be sent to some subscribers.
   subscriber_connections_mutex_.lock();
 
-  // Send on all connections, removing the ones that throw an error.
-  std::erase_if(subscriber_connections_, [json_message](std::shared_ptr<ConnectionBsonSocket> const& input) -> bool {
+  // Stamp the message with a header so that tools can measure the topic without decoding it.
+  TopicFrameHeader header{TopicFrameHeader::now(), next_sequence_++};
+  auto encoded_header = header.encode();
+
+  // Send once to the multicast group, however many subscribers have joined it.
+  if (multicast_sender_) {
+    subscriber_connections_mutex_.unlock();
+    multicast_sender_->sendFrame({encoded_header, encoded_message});
+    return;
+  }
+
+  // Send on all connections that are due a message under their maximum rate and whose filter passes it, removing the
+  // ones that throw an error. Filters are tested on the encoded message, so it is never decoded. Messages that fail the
+  // filter do not use up the rate.
+  auto now = RateLimiter::Clock::now();
+  auto send_failed = [this, &encoded_header, encoded_message, now](SubscriberConnection& input) -> bool {
+    if (!input.rate_limiter.due(now) || !input.filter.matches(encoded_message)) return false;
+    input.rate_limiter.take(now);
     try {
-      input->sendMessage(json_message);
+      sendFrame(input, encoded_header, encoded_message);
       return false;
     } catch (PeerClosedException const& e) {
       return true;
     } catch (...) {
       return true;
     }
-  });
+  };
+  std::erase_if(subscriber_connections_, send_failed);
+  countSubscribers();
   subscriber_connections_mutex_.unlock();
 }
 
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::publishMany(std::span<MessageT const> messages) {
+  if (messages.empty() || !hasSubscribers()) return;
+
+  // Skip encoding messages no subscriber is due, using up their sequence numbers as publish() does.
+  if (!anySubscriberDue()) {
+    std::lock_guard<std::mutex> subscriber_connections_lock_guard(subscriber_connections_mutex_);
+    next_sequence_ += messages.size();
+    return;
+  }
+
+  // Encode each message once for all subscribers. Raw messages are already encoded.
+  std::vector<Bson> encoded_storage;
+  std::vector<ByteSpan> encoded_messages;
+  encoded_messages.reserve(messages.size());
+  if constexpr (FrameConvertible<MessageT>) {
+    for (auto const& message : messages) encoded_messages.push_back(message.frame_payload());
+  } else {
+    encoded_storage.reserve(messages.size());
+    for (auto const& message : messages) {
+      // Messages whose conversion is not const are converted from a copy, as publish() takes its message by value.
+      if constexpr (requires { message.convert_to_json(); }) {
+        encoded_storage.push_back(json::to_bson(message.convert_to_json()));
+      } else {
+        encoded_storage.push_back(json::to_bson(MessageT(message).convert_to_json()));
+      }
+    }
+    encoded_messages.assign(encoded_storage.begin(), encoded_storage.end());
+  }
+  publishEncodedMany(encoded_messages);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::publishEncodedMany(std::span<ByteSpan const> encoded_messages) {
+  if (encoded_messages.empty() || !hasSubscribers()) return;
+
+  // Hold the lock for the whole send cycle, as publishEncoded() does, so that the burst is not interleaved with other
+  // messages.
+  std::lock_guard<std::mutex> subscriber_connections_lock_guard(subscriber_connections_mutex_);
+
+  // Stamp each message with its own header, all at the same time, and lay the frames out as header and message pairs.
+  std::int64_t timestamp = TopicFrameHeader::now();
+  std::vector<std::array<std::uint8_t, TopicFrameHeader::kSize>> encoded_headers;
+  encoded_headers.reserve(encoded_messages.size());
+  std::vector<ByteSpan> frame_parts;
+  frame_parts.reserve(2 * encoded_messages.size());
+  for (auto encoded_message : encoded_messages) {
+    encoded_headers.push_back(TopicFrameHeader{timestamp, next_sequence_++}.encode());
+    frame_parts.push_back(encoded_headers.back());
+    frame_parts.push_back(encoded_message);
+  }
+
+  // Datagrams are sent one by one to the multicast group.
+  if (multicast_sender_) {
+    for (std::size_t i = 0; i < frame_parts.size(); i += 2) {
+      multicast_sender_->sendFrame({frame_parts[i], frame_parts[i + 1]});
+    }
+    return;
+  }
+
+  // Send each connection the frames it is due and whose filter passes them in one vectored send, removing the
+  // connections that throw an error. Connections without a filter or maximum rate take the whole burst as laid out.
+  auto now = RateLimiter::Clock::now();
+  std::vector<ByteSpan> connection_frame_parts;
+  auto send_failed = [this, &frame_parts, &connection_frame_parts, now](SubscriberConnection& input) -> bool {
+    std::span<ByteSpan const> parts = frame_parts;
+    if (input.rate_limiter.limited() || !input.filter.empty()) {
+      connection_frame_parts.clear();
+      for (std::size_t i = 0; i < frame_parts.size(); i += 2) {
+        if (!input.rate_limiter.due(now) || !input.filter.matches(frame_parts[i + 1])) continue;
+        input.rate_limiter.take(now);
+        connection_frame_parts.push_back(frame_parts[i]);
+        connection_frame_parts.push_back(frame_parts[i + 1]);
+      }
+      if (connection_frame_parts.empty()) return false;
+      parts = connection_frame_parts;
+    }
+    try {
+      sendFrames(input, parts);
+      return false;
+    } catch (...) {
+      return true;
+    }
+  };
+  std::erase_if(subscriber_connections_, send_failed);
+  countSubscribers();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::sendFrame(SubscriberConnection& connection, ByteSpan encoded_header,
+                                    ByteSpan encoded_message) {
+  ++send_statistics_.frame_count;
+  if (!connection.coalescer) {
+    ++send_statistics_.write_count;
+    connection.socket->sendFrame({encoded_header, encoded_message});
+    return;
+  }
+
+  // Messages as large as the threshold gain nothing from being held, so they are written at once, after those held.
+  if (encoded_header.size() + encoded_message.size() >= options_.coalesce_bytes) {
+    flushCoalescer(connection);
+    ++send_statistics_.write_count;
+    connection.socket->sendFrame({encoded_header, encoded_message});
+    return;
+  }
+
+  // Hold the message, writing the held messages once they reach the threshold. The flushing thread is woken for the
+  // first message held, whose delay it then waits out.
+  bool was_empty = connection.coalescer->empty();
+  if (connection.coalescer->add({encoded_header, encoded_message}, WriteCoalescer::Clock::now())) {
+    flushCoalescer(connection);
+  } else if (was_empty) {
+    flush_condition_variable_.notify_one();
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::sendFrames(SubscriberConnection& connection, std::span<ByteSpan const> frame_parts) {
+  if (connection.coalescer) {
+    for (std::size_t i = 0; i < frame_parts.size(); i += 2) sendFrame(connection, frame_parts[i], frame_parts[i + 1]);
+    return;
+  }
+  send_statistics_.frame_count += frame_parts.size() / 2;
+  ++send_statistics_.write_count;
+  connection.socket->sendFrames(frame_parts, 2);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::flushCoalescer(SubscriberConnection& connection) {
+  if (connection.coalescer->empty()) return;
+  ++send_statistics_.write_count;
+  connection.coalescer->flush(*connection.socket);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::flushCoalescedUntilDisconnect() {
+  std::unique_lock<std::mutex> unique_subscriber_connections_lock(subscriber_connections_mutex_);
+  while (connected_) {
+    // Sleep until the earliest delay runs out, or until a message is held if none is.
+    auto deadline = WriteCoalescer::Clock::time_point::max();
+    for (auto const& connection : subscriber_connections_) {
+      if (connection.coalescer) deadline = std::min(deadline, connection.coalescer->deadline());
+    }
+    if (deadline == WriteCoalescer::Clock::time_point::max()) {
+      flush_condition_variable_.wait(unique_subscriber_connections_lock);
+    } else {
+      flush_condition_variable_.wait_until(unique_subscriber_connections_lock, deadline);
+    }
+
+    // Write the messages whose delay has run out, removing the connections that throw an error.
+    auto now = WriteCoalescer::Clock::now();
+    std::erase_if(subscriber_connections_, [this, now](SubscriberConnection& input) -> bool {
+      if (!input.coalescer || input.coalescer->deadline() > now) return false;
+      try {
+        flushCoalescer(input);
+        return false;
+      } catch (...) {
+        return true;
+      }
+    });
+    countSubscribers();
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Publisher<MessageT>::hasSubscribers() const {
+  return multicast_sender_ || subscriber_count_ > 0;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+std::size_t Publisher<MessageT>::getNumSubscribers() const {
+  return subscriber_count_;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::onSubscriberConnect(std::function<void(std::size_t)> callback) {
+  std::lock_guard<std::mutex> subscriber_connect_callback_lock_guard(subscriber_connect_callback_mutex_);
+  subscriber_connect_callback_ = std::move(callback);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Publisher<MessageT>::anySubscriberDue() {
+  if (multicast_sender_ || limited_subscriber_count_ < subscriber_count_) return true;
+  auto now = RateLimiter::Clock::now();
+  std::lock_guard<std::mutex> subscriber_connections_lock_guard(subscriber_connections_mutex_);
+  return std::any_of(subscriber_connections_.begin(), subscriber_connections_.end(),
+                     [now](SubscriberConnection const& input) -> bool { return input.rate_limiter.due(now); });
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Publisher<MessageT>::countSubscribers() {
+  subscriber_count_ = subscriber_connections_.size();
+  limited_subscriber_count_ =
+      std::count_if(subscriber_connections_.begin(), subscriber_connections_.end(),
+                    [](SubscriberConnection const& input) -> bool { return input.rate_limiter.limited(); });
+}
+
 template<typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 void Publisher<MessageT>::acceptConnectionsUntilDisconnect() {
   while (connected_) {
     auto subscriber_connection = subscriber_acceptor_->acceptConnection<ConnectionBsonSocket>();
 
-    // If a non-null connection was created, add it to the container of connections.
+    // If a non-null connection was created, take the Subscriber's filter and maximum rate from the request it sends
+    // first and add the connection to the container of connections. Subscribers that fail to send a request are
+    // dropped.
     if (subscriber_connection) {
-      subscriber_connections_mutex_.lock();
-      subscriber_connections_.push_back(subscriber_connection);
-      subscriber_connections_mutex_.unlock();
+      try {
+        // Bound the wait for the request so that a client that never sends one cannot block later subscribers or
+        // shutdown. Clients that time out are dropped like those that fail.
+        subscriber_connection->setReceiveTimeout(kSubscribeRequestTimeout_);
+        auto request = subscriber_connection->receiveMessage().template get<SubscribeRequest>();
+        subscriber_connection->setReceiveTimeout(0);
+        subscriber_connection->setNoDelay(options_.tcp_no_delay);
+        std::unique_ptr<WriteCoalescer> coalescer;
+        if (options_.coalesce_delay > std::chrono::microseconds::zero()) {
+          coalescer = std::make_unique<WriteCoalescer>(options_.coalesce_delay, options_.coalesce_bytes);
+        }
+        subscriber_connections_mutex_.lock();
+        subscriber_connections_.push_back({subscriber_connection, std::move(request.filter),
+                                           RateLimiter(request.max_rate_hz), std::move(coalescer)});
+        std::size_t subscriber_count = subscriber_connections_.size();
+        countSubscribers();
+        subscriber_connections_mutex_.unlock();
+
+        // Call back without holding the connections lock, so that the callback may publish.
+        std::lock_guard<std::mutex> subscriber_connect_callback_lock_guard(subscriber_connect_callback_mutex_);
+        if (subscriber_connect_callback_) subscriber_connect_callback_(subscriber_count);
+      } catch (SocketException const& e) {
+      } catch (json::exception const& e) {
+      }
     }
     std::this_thread::sleep_for(10ms);
   }
   // Close the server so that no more connections can be added.
   subscriber_acceptor_->close();
 
-  // Disconnect all the subscriber connections (handled by dtor of bson socket object).
+  // Write the messages still held, then disconnect all the subscriber connections (handled by dtor of bson socket
+  // object).
   subscriber_connections_mutex_.lock();
+  for (auto& connection : subscriber_connections_) {
+    try {
+      if (connection.coalescer) flushCoalescer(connection);
+    } catch (...) {
+    }
+  }
   subscriber_connections_.clear();
+  countSubscribers();
   subscriber_connections_mutex_.unlock();
 }
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+
+/**
+ * Decimator letting messages through at no more than a maximum rate. Messages are let through on a schedule of one per
+ * period, with a quarter period of slack so that messages published at exactly the maximum rate are not halved by
+ * jitter. A limiter that falls more than a period behind its schedule starts a new one rather than letting a burst
+ * through to catch up.
+ */
+class RateLimiter {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param max_rate_hz The rate to limit messages to, in messages per second. Zero or less for no limit.
+   */
+  explicit RateLimiter(double max_rate_hz = 0);
+
+  /**
+   * Check whether a message would be let through.
+   * @param now The current time.
+   */
+  bool due(Clock::time_point now) const;
+
+  /**
+   * Let a message through, moving the schedule on by a period.
+   * @param now The current time.
+   */
+  void take(Clock::time_point now);
+
+  /**
+   * Check whether the limiter limits the rate at all.
+   */
+  bool limited() const;
+
+ private:
+  Clock::duration period_;
+
+  /**
+   * Time the next message is scheduled for, before which it is only let through within the slack.
+   */
+  Clock::time_point next_time_;
+};
@@ -1,21 +1,90 @@
 #pragma once
 
+#include <coroutine>
+#include <deque>
+#include <span>
 #include <unordered_set>
 
+#include "coroutine/coroutine_scheduler.hpp"
 #include "logging/logging.hpp"
+#include "mediator/mediator_rpc.hpp"
+#include "mros/message_filter.hpp"
+#include "mros/message_lifespan.hpp"
 #include "mros/utils/utils.hpp"
 #include "mros/node_base.hpp"
+#include "mros/rate_limiter.hpp"
+#include "mros/wait_set.hpp"
 #include "socket/bson_socket/client_bson_socket.hpp"
+#include "socket/multicast_socket/multicast_receiver_socket.hpp"
+#include "thread_pool/thread_pool.hpp"
+#include "timer/timer.hpp"
 
 using PublisherURI = std::string;
 
 class Node;
 
+/**
+ * Options of a Subscriber.
+ */
+struct SubscriberOptions {
+  /**
+   * Filter passed to each Publisher on connecting, so that messages the Subscriber does not want are never sent to it.
+   * Messages from UDP multicast Publishers, which send to every receiver alike, are filtered on arrival instead, still
+   * before they are queued or decoded.
+   */
+  MessageFilter filter;
+
+  /**
+   * Most messages per second to receive, zero for every message. Passed to each Publisher on connecting, so that a
+   * Subscriber that needs a lower rate than the topic is published at is sent only that rate, and the Publisher skips
+   * encoding messages no Subscriber is due. Messages from UDP multicast Publishers are decimated on arrival instead.
+   */
+  double max_rate_hz = 0;
+
+  /**
+   * Priority class of the callback on the Node's callback executor once the Node spins, so that messages of control
+   * topics are not held up behind slow callbacks of bulk topics.
+   */
+  TaskPriority priority = TaskPriority::kNormal;
+
+  /**
+   * Time from queued messages being handed to the executor to the callback finishing with them, beyond which the
+   * executor counts a missed deadline. Zero for no deadline.
+   */
+  std::chrono::steady_clock::duration deadline{0};
+
+  /**
+   * Age past which queued messages are dropped when taken off the queue, without being decoded, so that a Subscriber
+   * whose callback stalled resumes with live messages rather than the backlog. Zero to keep messages however old.
+   */
+  std::chrono::steady_clock::duration lifespan{0};
+
+  /**
+   * Clock the lifespan is measured on.
+   */
+  LifespanClock lifespan_clock = LifespanClock::kReceiveTime;
+
+  /**
+   * Most messages handed to a batch callback at once, zero for every message queued. Only used by Subscribers created
+   * with a callback taking a span of messages.
+   */
+  std::size_t max_batch_size = 0;
+
+  /**
+   * Longest time a Subscriber waits, after a message arrives, for more to fill the batch before calling the batch
+   * callback. Zero to call it with whatever is queued. Trades latency for fewer, larger batches. On the Node's
+   * executor, batches that have not filled are handed over at the next run of a timer with this period, so that no
+   * executor thread is held waiting.
+   */
+  std::chrono::steady_clock::duration max_batch_wait{0};
+};
+
 /**
  * Subscriber base class for providing interface to Node.
  */
 class SubscriberBase {
   friend class Node;
+  friend class WaitSet;
 
  protected:
   SubscriberBase() = default;
@@ -24,18 +93,40 @@ class SubscriberBase {
 
   virtual void disconnect() = 0;
 
-  virtual void connectToPublisher(std::string const& host, int port) = 0;
+  virtual void connectToPublisher(std::string const& host, int port, TopicTransport transport,
+                                  std::string const& interface_address) = 0;
 
   virtual void spin() = 0;
 
   virtual void spinOnce() = 0;
+
+  /**
+   * Run the callback on an executor as messages arrive, instead of on a thread of the Subscriber's own.
+   */
+  virtual void spinOn(std::shared_ptr<ThreadPool> const& executor) = 0;
+
+  /**
+   * Check whether messages are queued for the callback.
+   */
+  virtual bool hasMessages() = 0;
+
+  /**
+   * Run the callback once for every message queued, without waiting for more.
+   * @return The number of messages the callback was run with.
+   */
+  virtual std::size_t spinSome() = 0;
+
+  /**
+   * Signals of the WaitSets the Subscriber is in, raised when a message is queued on an empty queue.
+   */
+  WaitSignals wait_signals_;
 };
 
 /**
  * Subscriber template class to return to user for use in messaging.
  */
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 class Subscriber : public std::enable_shared_from_this<Subscriber<MessageT>>, public SubscriberBase {
  public:
   Subscriber() = delete;
@@ -44,33 +135,253 @@ class Subscriber : public std::enable_shared_from_this<Subscriber<MessageT>>, pu
 
   void spin() override;
 
+  /**
+   * Run the callback with the oldest queued message, if there is one.
+   */
   void spinOnce() override;
 
+  /**
+   * Awaitable taking the next message off the queue, returned by next().
+   */
+  class NextMessage {
+   public:
+    bool await_ready() const noexcept { return false; }
+
+    /**
+     * Take the next message if one is queued, otherwise wait for one to be received.
+     * @return False to carry on without suspending, true if suspended.
+     */
+    bool await_suspend(std::coroutine_handle<> handle);
+
+    /**
+     * @return The message.
+     * @throws SocketException Throws exception if the Subscriber was disconnected before a message came, or the message
+     * is malformed.
+     */
+    MessageT await_resume();
+
+   private:
+    friend class Subscriber;
+
+    explicit NextMessage(Subscriber& subscriber) : subscriber_(subscriber) {}
+
+    Subscriber& subscriber_;
+    std::coroutine_handle<> handle_;
+    std::shared_ptr<CoroutineScheduler> scheduler_;
+    Bson frame_;
+    bool disconnected_ = false;
+  };
+
+  /**
+   * Wait in a coroutine for the next message, as in
+   *
+   *   Pose pose = co_await subscriber->next();
+   *
+   * The coroutine is resumed on the scheduler it was running on when a message is received, without holding a thread
+   * while it waits, or on the receiving thread if it was not running on one. Awaiting coroutines take messages in the
+   * order they started waiting, and compete for them with spin() and spinOnce(), so a Subscriber is usually either
+   * awaited or spun.
+   */
+  NextMessage next() { return NextMessage(*this); }
+
+  /**
+   * Get the number of messages dropped for outliving the lifespan of the options.
+   */
+  std::uint64_t expiredCount() const { return expired_count_; }
+
+  /**
+   * Get the counters of the multicast receivers, summed over the UDP multicast publishers on the topic.
+   */
+  MulticastReceiverStatistics multicastStatistics();
+
   friend class Node;
 
  private:
   Subscriber(std::weak_ptr<NodeBase> node, std::string topic_name, std::uint32_t queue_size,
-             std::function<void(MessageT)> callback);
+             std::function<void(MessageT)> callback, SubscriberOptions options);
 
-  void connectToPublisher(std::string const& host, int port) override;
+  /**
+   * Create a Subscriber handing its messages to the callback in batches, as many as are queued at once up to the
+   * maximum batch size of the options, so that the locking, waking and calling is paid once per batch.
+   */
+  Subscriber(std::weak_ptr<NodeBase> node, std::string topic_name, std::uint32_t queue_size,
+             std::function<void(std::span<MessageT const>)> batch_callback, SubscriberOptions options);
+
+  /**
+   * Connect to a Publisher, or for a UDP multicast Publisher join its group and start a thread receiving from it.
+   * @param host The address of the Publisher, or its multicast group.
+   * @param port The port of the Publisher, or of its multicast group.
+   * @param transport The transport the Publisher sends over.
+   * @param interface_address The interface a multicast Publisher sends on. The group is joined on it if it belongs to
+   * this host, and on the default interface otherwise.
+   */
+  void connectToPublisher(std::string const& host, int port, TopicTransport transport,
+                          std::string const& interface_address) override;
 
   void disconnect() override;
 
   void receiveMessagesUntilDisconnect();
 
+  /**
+   * Receive frames from a multicast group until the receiver is shut down. Run by one thread per group.
+   */
+  void receiveMulticastUntilDisconnect(std::shared_ptr<MulticastReceiverSocket> const& receiver);
+
+  /**
+   * Frame waiting in the message queue, and when it was received if the lifespan is measured on the receive time.
+   */
+  struct QueuedFrame {
+    Bson frame;
+    MessageLifespan::Clock::time_point receive_time;
+  };
+
+  /**
+   * Add a received frame to the message queue, dropping the oldest frames if the queue is full.
+   */
+  void enqueueFrame(Bson&& frame);
+
+  /**
+   * Take the oldest frame that has not expired off the message queue, dropping and counting the expired frames ahead
+   * of it. Called with message_queue_mutex_ held.
+   * @return False if the queue held no frame that has not expired.
+   */
+  bool dequeueFrame(Bson& frame);
+
+  /**
+   * Check whether a frame taken off the queue has expired, counting it if so.
+   */
+  bool expired(QueuedFrame const& queued_frame, MessageLifespan::Clock::time_point now);
+
+  /**
+   * Get the time to check frames' lifespans against, only read from the clock if the lifespan is limited.
+   */
+  MessageLifespan::Clock::time_point lifespanNow() const {
+    return lifespan_.limited() ? MessageLifespan::Clock::now() : MessageLifespan::Clock::time_point();
+  }
+
   void executeCallbacksUntilDisconnect();
 
+  /**
+   * Run the batch callback with everything queued each time messages arrive, until disconnected. Run by the spinning
+   * thread in place of executeCallbacksUntilDisconnect() for batch Subscribers.
+   */
+  void executeBatchesUntilDisconnect();
+
+  /**
+   * Check whether the Subscriber has either kind of callback.
+   */
+  bool hasCallback() const { return callback_ || batch_callback_; }
+
+  /**
+   * Get the number of queued messages a batch spinning thread stops waiting for more at.
+   */
+  std::size_t batchFillSize() const {
+    return options_.max_batch_size > 0 ? std::min<std::size_t>(options_.max_batch_size, queue_size_) : queue_size_;
+  }
+
+  /**
+   * Check whether the executor should be handed the queued messages now rather than by the batch timer, which is
+   * unless a batch Subscriber with a batch wait has not filled its batch. Called with message_queue_mutex_ held.
+   */
+  bool executorBatchReady() const {
+    return !batch_callback_ || options_.max_batch_wait <= std::chrono::steady_clock::duration::zero() ||
+           message_queue_.size() >= batchFillSize();
+  }
+
+  /**
+   * Run the callback with frames taken off the queue, skipping expired and malformed frames, in batches for batch
+   * Subscribers. Stops early if the Subscriber disconnects.
+   * @return The number of messages the callback was run with.
+   */
+  std::size_t deliverFrames(std::queue<QueuedFrame>& frames);
+
+  bool hasMessages() override;
+
+  std::size_t spinSome() override;
+
+  void spinOn(std::shared_ptr<ThreadPool> const& executor) override;
+
+  /**
+   * Submit a task running the callbacks to the executor, at the priority and deadline of the options. Called with
+   * message_queue_mutex_ held, when messages are queued and no task is pending.
+   */
+  void submitExecutorTask();
+
+  /**
+   * Submit a task if the queued messages are ready for the executor, or else arm the batch timer for the batch they
+   * started. Called with message_queue_mutex_ held, when messages are queued and no task is pending.
+   */
+  void submitOrArmBatchTimer();
+
+  /**
+   * Run the callback with the queued messages, then submit another task if more were queued meanwhile. Run by the
+   * executor.
+   */
+  void runExecutorTask();
+
+  /**
+   * Submit a task running the batch callback with the queued messages, whether or not they fill a batch. Run by the
+   * batch timer.
+   */
+  void flushBatch();
+
+  /**
+   * Resume every coroutine awaiting a message, failing their awaits. Called on disconnecting.
+   */
+  void wakeMessageWaiters();
+
+  /**
+   * Decode a frame received from a Publisher into a message. Frames are queued undecoded and only decoded here, when
+   * they are taken off the queue, so that frames dropped from a full queue are never decoded.
+   * @return False if the frame is malformed, true otherwise.
+   */
+  static bool decodeFrame(Bson const& frame, MessageT& message);
+
   std::weak_ptr<NodeBase> node_;
 
   std::string topic_name_;
   std::uint32_t queue_size_;
   std::function<void(MessageT)> callback_;
+  std::function<void(std::span<MessageT const>)> batch_callback_;
+  SubscriberOptions options_;
 
-  std::queue<MessageT> message_queue_;
+  std::queue<QueuedFrame> message_queue_;
   std::mutex message_queue_mutex_;
   std::condition_variable queue_empty_condition_variable_;
 
+  /**
+   * Coroutines awaiting next() while the queue is empty, in the order they started waiting. Received frames are handed
+   * straight to the first of them instead of being queued. Guarded by message_queue_mutex_.
+   */
+  std::deque<NextMessage*> message_waiters_;
+
+  /**
+   * Executor running the callbacks after spinOn(), and whether a task running them is queued or running, so that the
+   * callback is never run concurrently with itself. Guarded by message_queue_mutex_.
+   */
+  std::weak_ptr<ThreadPool> executor_;
+  bool executor_task_pending_ = false;
+
+  /**
+   * One-shot timer handing the executor a batch that has not filled within the maximum batch wait, armed when the
+   * batch's first message is queued and dropped when a task is submitted. Guarded by message_queue_mutex_.
+   */
+  std::shared_ptr<Timer> batch_timer_;
+
+  /**
+   * Messages a batch is decoded into, kept to reuse their storage from call to call. Taken out by deliverFrames() while
+   * in use, so that a concurrent or nested call decodes into a buffer of its own. Guarded by message_queue_mutex_.
+   */
+  std::vector<MessageT> batch_;
+
   std::unordered_map<PublisherURI, std::shared_ptr<ClientBsonMessageSocket>> publisher_connections_;
+
+  /**
+   * Receivers of the multicast groups of UDP multicast Publishers, and the threads receiving from them. Guarded by
+   * publisher_connections_mutex_.
+   */
+  std::unordered_map<PublisherURI, std::shared_ptr<MulticastReceiverSocket>> multicast_receivers_;
+  std::vector<std::thread> multicast_receiving_threads_;
   std::mutex publisher_connections_mutex_;
 
   std::thread receiving_thread_;
@@ -78,35 +389,57 @@ class Subscriber : public std::enable_shared_from_this<Subscriber<MessageT>>, pu
   std::atomic<bool> spinning_;
   std::atomic<bool> connected_;
 
+  MessageLifespan lifespan_;
+  std::atomic<std::uint64_t> expired_count_ = 0;
+
   Logger& logger_;
 };
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 Subscriber<MessageT>::Subscriber(std::weak_ptr<NodeBase> node, std::string topic_name, std::uint32_t queue_size,
-                                 std::function<void(MessageT)> callback)
+                                 std::function<void(MessageT)> callback, SubscriberOptions options)
     : node_(std::move(node)),
       topic_name_(std::move(topic_name)),
       queue_size_(queue_size),
       callback_(callback),
+      options_(std::move(options)),
       connected_(true),
+      lifespan_(options_.lifespan, options_.lifespan_clock),
       logger_(Logger::getLogger()) {}
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
+Subscriber<MessageT>::Subscriber(std::weak_ptr<NodeBase> node, std::string topic_name, std::uint32_t queue_size,
+                                 std::function<void(std::span<MessageT const>)> batch_callback,
+                                 SubscriberOptions options)
+    : Subscriber(std::move(node), std::move(topic_name), queue_size, std::function<void(MessageT)>(),
+                 std::move(options)) {
+  batch_callback_ = std::move(batch_callback);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
 Subscriber<MessageT>::~Subscriber() {
   // Set connected to false so that the receiving and spinning threads will finish.
   connected_ = false;
 
-  // Wait for the receiving and spinning threads to finish if they were ever started.
+  wakeMessageWaiters();
+
+  // Wait for the receiving and spinning threads to finish if they were ever started. Multicast receiving threads block
+  // until their receivers are shut down.
   if (receiving_thread_.joinable()) receiving_thread_.join();
+  publisher_connections_mutex_.lock();
+  for (auto const& uri_receiver_pair : multicast_receivers_) uri_receiver_pair.second->shutdown();
+  publisher_connections_mutex_.unlock();
+  for (auto& multicast_receiving_thread : multicast_receiving_threads_) multicast_receiving_thread.join();
   if (spinning_thread_.joinable()) {
     // The spinning thread may be waiting on the empty queue condition variable which will prevent it from joining.
     // To release from the wait we simply take the queue lock and add a dummy message, making the queue empty. Before
     // calling the callback in the spinning thread, we check if the Node is connected, so that this dummy message will
     // not be used to execute a user callback.
     message_queue_mutex_.lock();
-    message_queue_.push(MessageT{});
+    message_queue_.push({});
     queue_empty_condition_variable_.notify_one();
     message_queue_mutex_.unlock();
 
@@ -121,18 +454,65 @@ Subscriber<MessageT>::~Subscriber() {
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 void Subscriber<MessageT>::disconnect() {
   connected_ = false;
+  wakeMessageWaiters();
+
+  // Wake the multicast receiving threads, which would otherwise wait for a datagram that may never come.
+  std::lock_guard<std::mutex> publisher_connection_mutex(publisher_connections_mutex_);
+  for (auto const& uri_receiver_pair : multicast_receivers_) uri_receiver_pair.second->shutdown();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+MulticastReceiverStatistics Subscriber<MessageT>::multicastStatistics() {
+  MulticastReceiverStatistics total;
+  std::lock_guard<std::mutex> publisher_connection_mutex(publisher_connections_mutex_);
+  for (auto const& uri_receiver_pair : multicast_receivers_) {
+    MulticastReceiverStatistics statistics = uri_receiver_pair.second->statistics();
+    total.received_frame_count += statistics.received_frame_count;
+    total.received_datagram_count += statistics.received_datagram_count;
+    total.receive_call_count += statistics.receive_call_count;
+    total.dropped_frame_count += statistics.dropped_frame_count;
+    total.reordered_frame_count += statistics.reordered_frame_count;
+    total.malformed_datagram_count += statistics.malformed_datagram_count;
+  }
+  return total;
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
-void Subscriber<MessageT>::connectToPublisher(std::string const& host, int port) {
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::connectToPublisher(std::string const& host, int port, TopicTransport transport,
+                                             std::string const& interface_address) {
+  if (transport == TopicTransport::kUdpMulticast) {
+    std::lock_guard<std::mutex> publisher_connection_mutex(publisher_connections_mutex_);
+    if (!connected_ || multicast_receivers_.contains(toURI(host, port))) return;
+    std::shared_ptr<MulticastReceiverSocket> receiver;
+    try {
+      receiver = std::make_shared<MulticastReceiverSocket>(host, port, interface_address);
+    } catch (SocketException const& e) {
+      // Joining on an interface of another host fails, so fall back to the default interface.
+      try {
+        receiver = std::make_shared<MulticastReceiverSocket>(host, port, "0.0.0.0");
+      } catch (SocketException const& e) {
+        logger_.info(e.what());
+        return;
+      }
+    }
+    multicast_receivers_.insert({toURI(host, port), receiver});
+    multicast_receiving_threads_.emplace_back(
+        [this, receiver]() -> void { receiveMulticastUntilDisconnect(receiver); });
+    return;
+  }
+
   try {
     // Create a new client socket and connect it to the specified host and port.
     auto client = std::make_shared<ClientBsonMessageSocket>(AF_INET, host, port);
     client->connect();
+
+    // Tell the Publisher which messages to send before receiving any.
+    client->sendMessage(SubscribeRequest{options_.filter, options_.max_rate_hz});
     std::lock_guard<std::mutex> publisher_connection_mutex(publisher_connections_mutex_);
     publisher_connections_.insert({toURI(host, port), client});
 
@@ -146,34 +526,221 @@ void Subscriber<MessageT>::connectToPublisher(std::string const& host, int port)
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 void Subscriber<MessageT>::spin() {
+  // Subscribers without a callback leave their messages to coroutines awaiting next().
+  if (!hasCallback()) return;
+
   // Start the spinning thread and return control to the user.
-  spinning_thread_ = std::thread([this]() -> void { executeCallbacksUntilDisconnect(); });
+  if (batch_callback_) {
+    spinning_thread_ = std::thread([this]() -> void { executeBatchesUntilDisconnect(); });
+  } else {
+    spinning_thread_ = std::thread([this]() -> void { executeCallbacksUntilDisconnect(); });
+  }
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
 void Subscriber<MessageT>::spinOnce() {
+  if (!hasCallback()) return;
   MessageT message;
+  Bson frame;
   message_queue_mutex_.lock();
 
   // Get a message off the top of the queue if there is one, and use it to execute a callback.
-  if (!message_queue_.empty()) {
-    message = message_queue_.front();
-    message_queue_.pop();
+  if (!dequeueFrame(frame)) {
+    message_queue_mutex_.unlock();
+    return;
+  }
+  message_queue_mutex_.unlock();
+  if (!decodeFrame(frame, message)) return;
+  if (batch_callback_) {
+    batch_callback_(std::span<MessageT const>(&message, 1));
+  } else {
+    callback_(message);
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::spinOn(std::shared_ptr<ThreadPool> const& executor) {
+  if (!hasCallback()) return;
+  std::lock_guard<std::mutex> message_queue_lock_guard(message_queue_mutex_);
+  executor_ = executor;
+  if (!message_queue_.empty() && !executor_task_pending_) submitOrArmBatchTimer();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::submitExecutorTask() {
+  auto executor = executor_.lock();
+  if (!executor) return;
+  auto deadline = options_.deadline > std::chrono::steady_clock::duration::zero()
+                      ? ThreadPool::Clock::now() + options_.deadline
+                      : ThreadPool::Clock::time_point::max();
+  executor_task_pending_ = true;
+  batch_timer_.reset();
+  executor->submit(
+      [weak_subscriber = this->weak_from_this()]() -> void {
+        if (auto subscriber = weak_subscriber.lock()) subscriber->runExecutorTask();
+      },
+      options_.priority, deadline);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::runExecutorTask() {
+  // Take the messages queued so far and leave later ones to another task, so that higher priority tasks submitted
+  // meanwhile run first.
+  std::queue<QueuedFrame> frames;
+  message_queue_mutex_.lock();
+  std::swap(frames, message_queue_);
+  message_queue_mutex_.unlock();
+  deliverFrames(frames);
+  std::lock_guard<std::mutex> message_queue_lock_guard(message_queue_mutex_);
+  executor_task_pending_ = false;
+  if (!message_queue_.empty() && connected_) submitOrArmBatchTimer();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::submitOrArmBatchTimer() {
+  if (executorBatchReady()) {
+    submitExecutorTask();
+    return;
+  }
+  if (batch_timer_) return;
+
+  // Wait for the batch to fill on a timer rather than on an executor thread, unless the Node is gone.
+  auto node = node_.lock();
+  if (!node) {
+    submitExecutorTask();
+    return;
+  }
+  batch_timer_ =
+      node->createOneShotTimer(options_.max_batch_wait, [weak_subscriber = this->weak_from_this()]() -> void {
+        if (auto subscriber = weak_subscriber.lock()) subscriber->flushBatch();
+      });
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::flushBatch() {
+  std::lock_guard<std::mutex> message_queue_lock_guard(message_queue_mutex_);
+  batch_timer_.reset();
+  if (!message_queue_.empty() && !executor_task_pending_ && connected_) submitExecutorTask();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Subscriber<MessageT>::hasMessages() {
+  if (!hasCallback()) return false;
+  std::lock_guard<std::mutex> message_queue_lock_guard(message_queue_mutex_);
+  return !message_queue_.empty();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+std::size_t Subscriber<MessageT>::spinSome() {
+  if (!hasCallback()) return 0;
+
+  // Take the whole queue at once so that the receiving threads are not held up while the callbacks run.
+  std::queue<QueuedFrame> frames;
+  message_queue_mutex_.lock();
+  std::swap(frames, message_queue_);
+  message_queue_mutex_.unlock();
+  return deliverFrames(frames);
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+std::size_t Subscriber<MessageT>::deliverFrames(std::queue<QueuedFrame>& frames) {
+  // The clock is read again before each message, or each batch, since the callbacks before it may have taken long
+  // enough for it to expire.
+  std::size_t delivered_count = 0;
+  if (!batch_callback_) {
+    MessageT message;
+    for (; !frames.empty() && connected_; frames.pop()) {
+      if (expired(frames.front(), lifespanNow()) || !decodeFrame(frames.front().frame, message)) continue;
+      callback_(message);
+      ++delivered_count;
+    }
+    return delivered_count;
   }
+
+  // Decode each batch into the Subscriber's batch vector, reusing the messages' storage from batch to batch and call to
+  // call. It is only grown, never shrunk.
+  std::size_t max_batch_size = options_.max_batch_size > 0 ? options_.max_batch_size : frames.size();
+  message_queue_mutex_.lock();
+  std::vector<MessageT> batch = std::move(batch_);
   message_queue_mutex_.unlock();
-  callback_(message);
+  batch.resize(std::max(batch.size(), std::min(max_batch_size, frames.size())));
+  while (!frames.empty() && connected_) {
+    std::size_t batch_size = 0;
+    auto now = lifespanNow();
+    for (; !frames.empty() && batch_size < max_batch_size; frames.pop()) {
+      if (!expired(frames.front(), now) && decodeFrame(frames.front().frame, batch[batch_size])) ++batch_size;
+    }
+    if (batch_size == 0) continue;
+    batch_callback_(std::span<MessageT const>(batch.data(), batch_size));
+    delivered_count += batch_size;
+  }
+  std::lock_guard<std::mutex> message_queue_lock_guard(message_queue_mutex_);
+  batch_ = std::move(batch);
+  return delivered_count;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Subscriber<MessageT>::NextMessage::await_suspend(std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> message_queue_lock_guard(subscriber_.message_queue_mutex_);
+  if (!subscriber_.connected_) {
+    disconnected_ = true;
+    return false;
+  }
+  if (subscriber_.dequeueFrame(frame_)) return false;
+  handle_ = handle;
+  scheduler_ = CoroutineScheduler::current();
+  subscriber_.message_waiters_.push_back(this);
+  return true;
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
+MessageT Subscriber<MessageT>::NextMessage::await_resume() {
+  // The Subscriber may be gone by the time a coroutine woken by its destruction resumes, so it is not touched here.
+  if (disconnected_) throw SocketException("Subscriber disconnected while awaiting a message.");
+  MessageT message;
+  if (!decodeFrame(frame_, message)) throw SocketException("Subscriber received a malformed message.");
+  return message;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::wakeMessageWaiters() {
+  std::unique_lock<std::mutex> unique_message_queue_mutex(message_queue_mutex_);
+  std::deque<NextMessage*> message_waiters = std::move(message_waiters_);
+  message_waiters_.clear();
+  std::vector<std::pair<std::coroutine_handle<>, std::shared_ptr<CoroutineScheduler>>> resumptions;
+  for (NextMessage* message_waiter : message_waiters) {
+    message_waiter->disconnected_ = true;
+    resumptions.emplace_back(message_waiter->handle_, std::move(message_waiter->scheduler_));
+  }
+  unique_message_queue_mutex.unlock();
+  for (auto& [handle, scheduler] : resumptions) {
+    if (scheduler) {
+      scheduler->schedule(handle);
+    } else {
+      handle.resume();
+    }
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
 void Subscriber<MessageT>::receiveMessagesUntilDisconnect() {
   std::unordered_map<PublisherURI, std::shared_ptr<ClientBsonMessageSocket>> publisher_connections_duplicate;
   std::unordered_set<PublisherURI> disconnected_publisher_uris;
-  json json_message;
-  MessageT message;
   while (connected_) {
     // Copy out the publisher connections for this receive cycle to avoid holding a lock while calling receive().
     publisher_connections_mutex_.lock();
@@ -184,19 +751,7 @@ void Subscriber<MessageT>::receiveMessagesUntilDisconnect() {
     for (const auto& uri_connection_pair : publisher_connections_duplicate) {
       try {
         // Receive the message, which will throw PeerClosedException if the publisher has disconnected.
-        json_message = uri_connection_pair.second->receiveMessage();
-        message.set_from_json(json_message);
-
-        // Drop messages from the front of the queue if the queue size has been exceeded and add the new message.
-        message_queue_mutex_.lock();
-        while (message_queue_.size() > queue_size_ + 1) {
-          message_queue_.pop();
-        }
-        message_queue_.push(message);
-
-        // If the queue was empty before adding the message, signal the queue condition variable.
-        if (message_queue_.size() == 1) queue_empty_condition_variable_.notify_one();
-        message_queue_mutex_.unlock();
+        enqueueFrame(uri_connection_pair.second->receiveFrame());
 
         // Add publisher connections that throw errors to the list of connections to be removed.
       } catch (PeerClosedException const& e) {
@@ -220,9 +775,95 @@ void Subscriber<MessageT>::receiveMessagesUntilDisconnect() {
 }
 
 template <typename MessageT>
-requires JsonConvertible<MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::receiveMulticastUntilDisconnect(std::shared_ptr<MulticastReceiverSocket> const& receiver) {
+  // The group sends every message to every receiver, so filter and decimate here, before queueing. Messages that fail
+  // the filter do not use up the rate.
+  RateLimiter rate_limiter(options_.max_rate_hz);
+  while (connected_) {
+    try {
+      receiver->receiveFrames([this, &rate_limiter](Bson& frame) -> void {
+        auto now = RateLimiter::Clock::now();
+        if (!rate_limiter.due(now)) return;
+        if (!options_.filter.empty() && (frame.size() < TopicFrameHeader::kSize ||
+                                         !options_.filter.matches(ByteSpan(frame).subspan(TopicFrameHeader::kSize)))) {
+          return;
+        }
+        rate_limiter.take(now);
+        enqueueFrame(std::move(frame));
+      });
+    } catch (SocketException const& e) {
+      return;
+    }
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::enqueueFrame(Bson&& frame) {
+  std::unique_lock<std::mutex> unique_message_queue_mutex(message_queue_mutex_);
+
+  // Hand the frame straight to the first coroutine awaiting one. Its handle and scheduler are copied out before
+  // unlocking, since the awaitable is destroyed as soon as the coroutine resumes.
+  if (!message_waiters_.empty()) {
+    NextMessage* message_waiter = message_waiters_.front();
+    message_waiters_.pop_front();
+    message_waiter->frame_ = std::move(frame);
+    std::coroutine_handle<> handle = message_waiter->handle_;
+    std::shared_ptr<CoroutineScheduler> scheduler = std::move(message_waiter->scheduler_);
+    unique_message_queue_mutex.unlock();
+    if (scheduler) {
+      scheduler->schedule(handle);
+    } else {
+      handle.resume();
+    }
+    return;
+  }
+
+  // Drop messages from the front of the queue if the queue size has been exceeded and add the new message.
+  while (message_queue_.size() > queue_size_ + 1) {
+    message_queue_.pop();
+  }
+  message_queue_.push({std::move(frame), lifespan_.needsReceiveTime() ? MessageLifespan::Clock::now()
+                                                                      : MessageLifespan::Clock::time_point()});
+
+  // If the queue was empty before adding the message, signal the queue condition variable and the WaitSets. A batch
+  // spinning thread waiting for its batch to fill is also signaled once it has.
+  if (message_queue_.size() == 1) {
+    queue_empty_condition_variable_.notify_one();
+    wait_signals_.notify();
+  } else if (batch_callback_ && message_queue_.size() == batchFillSize()) {
+    queue_empty_condition_variable_.notify_one();
+  }
+  if (!executor_task_pending_ && !executor_.expired()) submitOrArmBatchTimer();
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Subscriber<MessageT>::dequeueFrame(Bson& frame) {
+  auto now = lifespanNow();
+  for (; !message_queue_.empty(); message_queue_.pop()) {
+    if (expired(message_queue_.front(), now)) continue;
+    frame = std::move(message_queue_.front().frame);
+    message_queue_.pop();
+    return true;
+  }
+  return false;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Subscriber<MessageT>::expired(QueuedFrame const& queued_frame, MessageLifespan::Clock::time_point now) {
+  if (!lifespan_.expired(queued_frame.frame, queued_frame.receive_time, now)) return false;
+  ++expired_count_;
+  return true;
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
 void Subscriber<MessageT>::executeCallbacksUntilDisconnect() {
   MessageT message;
+  Bson frame;
   while (connected_) {
     std::unique_lock<std::mutex> unique_message_queue_mutex(message_queue_mutex_);
 
@@ -232,12 +873,53 @@ void Subscriber<MessageT>::executeCallbacksUntilDisconnect() {
                                            [this]() -> bool { return !message_queue_.empty(); });
     }
 
-    // Get a message off the top of the queue and use it to execute a callback.
-    message = message_queue_.front();
-    message_queue_.pop();
+    // Get a message off the top of the queue and use it to execute a callback, unless every queued message expired.
+    bool dequeued = dequeueFrame(frame);
     unique_message_queue_mutex.unlock();
+    if (!dequeued) continue;
 
     // Check connection to ensure this message isn't the dummy message pushed in the shutdown routine.
-    if (connected_) callback_(message);
+    if (connected_ && decodeFrame(frame, message)) callback_(message);
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+void Subscriber<MessageT>::executeBatchesUntilDisconnect() {
+  std::queue<QueuedFrame> frames;
+  while (connected_) {
+    std::unique_lock<std::mutex> unique_message_queue_mutex(message_queue_mutex_);
+
+    // Wait for a message, then up to the maximum wait for the batch to fill.
+    queue_empty_condition_variable_.wait(unique_message_queue_mutex,
+                                         [this]() -> bool { return !message_queue_.empty(); });
+    if (options_.max_batch_wait > std::chrono::steady_clock::duration::zero()) {
+      queue_empty_condition_variable_.wait_for(unique_message_queue_mutex, options_.max_batch_wait, [this]() -> bool {
+        return message_queue_.size() >= batchFillSize() || !connected_;
+      });
+    }
+
+    // Take everything queued at once. The dummy message pushed in the shutdown routine fails decoding.
+    std::swap(frames, message_queue_);
+    unique_message_queue_mutex.unlock();
+    deliverFrames(frames);
+  }
+}
+
+template <typename MessageT>
+requires TopicMessage<MessageT>
+bool Subscriber<MessageT>::decodeFrame(Bson const& frame, MessageT& message) {
+  TopicFrameHeader header;
+  if (!header.decode(frame)) return false;
+  ByteSpan payload(frame.data() + TopicFrameHeader::kSize, frame.size() - TopicFrameHeader::kSize);
+  if constexpr (FrameConvertible<MessageT>) {
+    message.set_from_frame(header, payload);
+  } else {
+    try {
+      message.set_from_json(json::from_bson(payload.begin(), payload.end()));
+    } catch (json::exception const& e) {
+      return false;
+    }
   }
+  return true;
 }
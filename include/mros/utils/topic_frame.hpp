@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+/**
+ * Header a Publisher puts in front of every message it sends, ahead of the encoded message. Lets tools measure a topic
+ * without decoding its messages.
+ */
+struct TopicFrameHeader {
+  /**
+   * Wall clock time the message was published, in nanoseconds since the epoch.
+   */
+  std::int64_t publish_time_ns = 0;
+
+  /**
+   * Number of messages the Publisher sent before this one.
+   */
+  std::uint64_t sequence = 0;
+
+  /**
+   * Size of an encoded header in bytes.
+   */
+  static constexpr std::size_t kSize = sizeof(std::int64_t) + sizeof(std::uint64_t);
+
+  /**
+   * Get the current wall clock time in the form of publish_time_ns.
+   */
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /**
+   * Encode the header in host byte order.
+   */
+  std::array<std::uint8_t, kSize> encode() const {
+    std::array<std::uint8_t, kSize> bytes{};
+    std::memcpy(bytes.data(), &publish_time_ns, sizeof(publish_time_ns));
+    std::memcpy(bytes.data() + sizeof(publish_time_ns), &sequence, sizeof(sequence));
+    return bytes;
+  }
+
+  /**
+   * Decode the header at the front of a frame.
+   * @return False if the frame is too short to hold a header, true otherwise.
+   */
+  bool decode(std::span<std::uint8_t const> frame) {
+    if (frame.size() < kSize) return false;
+    std::memcpy(&publish_time_ns, frame.data(), sizeof(publish_time_ns));
+    std::memcpy(&sequence, frame.data() + sizeof(publish_time_ns), sizeof(sequence));
+    return true;
+  }
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <span>
 #include <string>
 
+#include "mros/utils/topic_frame.hpp"
 #include "nlohmann/json.hpp"
 
 std::string toURI(const std::string &host, int port);
@@ -11,3 +13,18 @@ concept JsonConvertible = requires (T t, nlohmann::json json){
   { t.convert_to_json()} -> std::same_as<nlohmann::json>;
   { t.set_from_json(json)} -> std::same_as<void>;
 };
+
+/**
+ * Message type that is sent and received as undecoded bytes, such as RawMessage.
+ */
+template <typename T>
+concept FrameConvertible = requires (T t, TopicFrameHeader const &header, std::span<std::uint8_t const> payload){
+  { t.frame_payload()} -> std::convertible_to<std::span<std::uint8_t const>>;
+  { t.set_from_frame(header, payload)} -> std::same_as<void>;
+};
+
+/**
+ * Message type that can be published and subscribed to on a topic.
+ */
+template <typename T>
+concept TopicMessage = JsonConvertible<T> || FrameConvertible<T>;
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class SubscriberBase;
+
+/**
+ * Signal a WaitSet blocks on, raised by the entities in it when they become ready.
+ */
+class WaitSignal {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Raise the signal, waking the waiting thread.
+   */
+  void notify();
+
+  /**
+   * Lower the signal. Called before checking the entities for readiness, so that an entity becoming ready after it was
+   * checked raises the signal again.
+   */
+  void reset();
+
+  /**
+   * Block until the signal is raised or a deadline passes.
+   * @return True if the signal was raised.
+   */
+  bool waitUntil(Clock::time_point deadline);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_variable_;
+  bool raised_ = false;
+};
+
+/**
+ * Signals of the WaitSets an entity has been added to. Signals of destroyed WaitSets are dropped on the next notify.
+ */
+class WaitSignals {
+ public:
+  void attach(std::shared_ptr<WaitSignal> const &wait_signal);
+
+  /**
+   * Raise the signal of every WaitSet the entity is in.
+   */
+  void notify();
+
+ private:
+  std::mutex mutex_;
+  std::vector<std::weak_ptr<WaitSignal>> wait_signals_;
+};
+
+/**
+ * Event raised by user code to wake a WaitSet, such as a request to stop or new work queued by another thread.
+ * Triggering is sticky: a trigger with no WaitSet waiting is reported by the next wait.
+ */
+class GuardCondition {
+ public:
+  /**
+   * Raise the condition, waking every WaitSet it is in.
+   */
+  void trigger();
+
+  friend class WaitSet;
+
+ private:
+  /**
+   * Take the trigger, lowering the condition.
+   * @return True if the condition was raised.
+   */
+  bool take();
+
+  std::mutex mutex_;
+  bool triggered_ = false;
+  WaitSignals wait_signals_;
+};
+
+/**
+ * Entities that were ready when a WaitSet woke, as indices in the order each kind was added.
+ */
+struct WaitResult {
+  std::vector<std::size_t> subscribers;
+  std::vector<std::size_t> timers;
+  std::vector<std::size_t> guard_conditions;
+
+  /**
+   * Check whether the wait timed out with nothing ready.
+   */
+  bool empty() const { return subscribers.empty() && timers.empty() && guard_conditions.empty(); }
+};
+
+/**
+ * Blocks one thread on several subscribers, timers and guard conditions at once, and runs the callbacks of those that
+ * are ready on that thread, as in
+ *
+ *   WaitSet wait_set;
+ *   wait_set.addSubscriber(poses);
+ *   wait_set.addSubscriber(scans);
+ *   wait_set.addTimer(100ms, publishStatus);
+ *   while (node_running) wait_set.spinSome(1s);
+ *
+ * Subscribers in a WaitSet should not also be spun, which would compete with it for their messages. A WaitSet is used
+ * by one thread at a time.
+ */
+class WaitSet {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  WaitSet();
+
+  WaitSet(WaitSet const &other) = delete;
+
+  void operator=(WaitSet const &other) = delete;
+
+  /**
+   * Add a subscriber, ready while it has messages queued. Subscribers without a callback are never ready, as their
+   * messages are left to coroutines.
+   */
+  void addSubscriber(std::shared_ptr<SubscriberBase> subscriber);
+
+  /**
+   * Add a timer run by the waiting thread, ready once a period. Deadlines missed by more than a period are skipped
+   * rather than run in a burst.
+   * @param period The time between runs. The first run is a period from now.
+   * @param callback The function to run.
+   */
+  void addTimer(Clock::duration period, std::function<void()> callback);
+
+  /**
+   * Add a guard condition, ready once triggered until the wait that reports it.
+   * @param guard_condition The condition.
+   * @param callback Run by spinSome() when the condition is ready. May be empty.
+   */
+  void addGuardCondition(std::shared_ptr<GuardCondition> guard_condition, std::function<void()> callback = {});
+
+  /**
+   * Block until at least one entity is ready or the timeout passes, without running any callbacks. Reporting a guard
+   * condition lowers it, while subscribers stay ready until their messages are taken and timers until they are run.
+   * @param timeout Longest time to block. Negative to block until something is ready.
+   * @return The ready entities, empty if the timeout passed.
+   */
+  WaitResult wait(Clock::duration timeout);
+
+  /**
+   * Block as wait() does, then run the callback of every ready entity, for subscribers once per queued message or once
+   * per batch of them.
+   * @param timeout Longest time to block. Negative to block until something is ready.
+   * @return The number of callbacks run, counting each message handed to a batch callback.
+   */
+  std::size_t spinSome(Clock::duration timeout);
+
+ private:
+  /**
+   * Timer run by the waiting thread.
+   */
+  struct WaitTimer {
+    Clock::duration period;
+    Clock::time_point next_deadline;
+    std::function<void()> callback;
+  };
+
+  /**
+   * Guard condition and the callback run when it is ready.
+   */
+  struct WaitGuardCondition {
+    std::shared_ptr<GuardCondition> guard_condition;
+    std::function<void()> callback;
+  };
+
+  /**
+   * Collect the entities ready now, taking the triggers of the guard conditions.
+   */
+  WaitResult collectReady(Clock::time_point now);
+
+  /**
+   * Get the earliest timer deadline, or the maximum time point if there are no timers.
+   */
+  Clock::time_point nextTimerDeadline() const;
+
+  std::shared_ptr<WaitSignal> wait_signal_;
+  std::vector<std::shared_ptr<SubscriberBase>> subscribers_;
+  std::vector<WaitTimer> timers_;
+  std::vector<WaitGuardCondition> guard_conditions_;
+};
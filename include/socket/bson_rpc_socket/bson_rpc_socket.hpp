@@ -1,13 +1,20 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
+#include "socket/bson_rpc_socket/rpc_dispatcher.hpp"
 #include "socket/bson_socket/bson_socket.hpp"
+#include "socket/utils/rpc_timeout_exception.hpp"
 
 using namespace nlohmann;
 /**
@@ -32,8 +39,25 @@ using RequestResponseCallbackJson = std::function<json(json const &)>;
 using ClosingCallback = std::function<void()>;
 
 /**
- * Abstract mixin class to provide half and full duplex string based RPC to peer sockets, along with no a zero message
- * lose closing routine.
+ * Identifier attached to a full duplex request so that its response can be matched to the caller.
+ */
+using RequestID = std::uint64_t;
+
+/**
+ * Index of a callback in a socket's method table. Each socket sends its method names to the peer socket while
+ * connecting, so that requests name their callback with this index rather than a string.
+ */
+using MethodID = std::uint16_t;
+
+/**
+ * Function taking the ready result of a full duplex request. Calling get() on the future returns the peer socket's
+ * response or rethrows the failure, such as an RPCTimeoutException.
+ */
+using ResponseCallbackJson = std::function<void(std::future<json>)>;
+
+/**
+ * Abstract mixin class to provide half and full duplex RPC to peer sockets, along with no a zero message lose closing
+ * routine. Messages are a fixed size binary Envelope followed by a Bson payload.
  */
 class BsonRPCSocket : virtual public BsonSocket {
  public:
@@ -58,6 +82,13 @@ class BsonRPCSocket : virtual public BsonSocket {
    */
   bool connected();
 
+  /**
+   * Check if the receiving thread has finished the closing routine. Once true the receiving thread no longer touches
+   * this socket, so it may be destroyed even if the closing callback was what released it.
+   * @return True if the closing routine has finished, false otherwise.
+   */
+  bool closed();
+
   /**
    * Performs a half duplex RPC to the peer socket, invoking a callback a certain name with a supplied argument.
    * @param callback_name The name of the peer socket's callback to invoke.
@@ -67,7 +98,8 @@ class BsonRPCSocket : virtual public BsonSocket {
 
   /**
    * Performs a full duplex RPC to the peer socket, invoking a callback in the peer socket which in turn invokes a
-   * callback in this socket, passing the return of the previous call as the argument.
+   * callback in this socket, passing the return of the previous call as the argument. The response is matched by
+   * request ID like sendRequestAndGetFuture(), then handed to the request callback named response_callback_name.
    * @param callback_name The name of the peer socket's callback to invoke.
    * @param callback_argument The json argument to pass to the peer socket's callback.
    * @param response_callback_name The callback of this socket to be invoked with the peer socket's return.
@@ -76,26 +108,58 @@ class BsonRPCSocket : virtual public BsonSocket {
                                  CallbackName const &response_callback_name);
 
   /**
-   * Adds a request callback to request_callbacks_ that can then be called by the peer socket.
-   * @param callback_name The name of the callback, used as the key in request_callbacks_.
-   * @param callback The callback function, used as the value in request_callbacks_.
+   * Performs a full duplex RPC to the peer socket and returns a future for the peer socket's response. Any number of
+   * requests may be outstanding at once, each is matched to its response by a request ID.
+   * @param callback_name The name of the peer socket's request response callback to invoke.
+   * @param callback_argument The json argument to pass to the peer socket's callback.
+   * @param timeout Time to wait for the response in milliseconds. Defaults to an indefinite timeout.
+   * @return Future holding the response. Holds an RPCTimeoutException if the timeout expires, a PeerClosedException if
+   * the socket closes first, and a SocketException if sending fails or the peer has no callback with the name.
+   */
+  std::future<json> sendRequestAndGetFuture(CallbackName const &callback_name, json const &callback_argument,
+                                            int timeout = -1);
+
+  /**
+   * Performs a full duplex RPC to the peer socket and invokes a callback of this socket with the response's future
+   * once it is ready. The callback is invoked on the receiving thread, or on the thread enforcing timeouts.
+   * @param callback_name The name of the peer socket's request response callback to invoke.
+   * @param callback_argument The json argument to pass to the peer socket's callback.
+   * @param response_callback The callback taking the ready future, which holds the same results as
+   * sendRequestAndGetFuture().
+   * @param timeout Time to wait for the response in milliseconds. Defaults to an indefinite timeout.
+   */
+  void sendRequestAndGetResponse(CallbackName const &callback_name, json const &callback_argument,
+                                 ResponseCallbackJson const &response_callback, int timeout = -1);
+
+  /**
+   * Adds a request callback to methods_ that can then be called by the peer socket.
+   * @param callback_name The name of the callback, used as the key in method_ids_.
+   * @param callback The callback function, stored in the method's entry of methods_.
    */
   void registerRequestCallback(const CallbackName &callback_name, const RequestCallbackJson &callback);
 
   /**
-   * Adds a request response callback to request_response_callbacks_ that can then be called by the peer socket.
-   * @param callback_name The name of the callback, used as the key in request_response_callbacks_.
-   * @param callback The callback function, used as the value in request_response_callbacks_.
+   * Adds a request response callback to methods_ that can then be called by the peer socket.
+   * @param callback_name The name of the callback, used as the key in method_ids_.
+   * @param callback The callback function, stored in the method's entry of methods_.
    */
   void registerRequestResponseCallback(const CallbackName &callback_name, const RequestResponseCallbackJson &callback);
 
   /**
-   * Adds a request callback to request_callbacks_ with key kClosingCallbackName_. This callback will be executed by the
-   * receiving thread once it receives a closing message.
+   * Sets the closing callback. This callback will be executed by the receiving thread once it receives a closing
+   * message.
    * @param callback Void routine taking no arguments to be executed immediately before closing the socket.
    */
   void registerClosingCallback(const ClosingCallback &callback);
 
+  /**
+   * Run request callbacks on a dispatcher's worker threads instead of the receiving thread. Without a dispatcher,
+   * callbacks run on the receiving thread one at a time. The closing callback always runs on the receiving thread once
+   * every dispatched callback has finished. Must be called before connecting.
+   * @param dispatcher The dispatcher, which may be shared with other sockets.
+   */
+  void setDispatcher(std::shared_ptr<RPCDispatcher> dispatcher);
+
  protected:
   /**
    * Remove sendMessage() from the public interface. Keep protected for use in this class and subclasses.
@@ -107,12 +171,41 @@ class BsonRPCSocket : virtual public BsonSocket {
    */
   using BsonSocket::receiveMessage;
 
+  /**
+   * Remove sendFrame() from the public interface. Keep protected for use in this class and subclasses.
+   */
+  using BsonSocket::sendFrame;
+
+  /**
+   * Remove receiveFrame() from the public interface. Keep protected for use in this class and subclasses.
+   */
+  using BsonSocket::receiveFrame;
+
+  /**
+   * Remove setReceiveTimeout() from the public interface, since the receive cycle must not time out. Keep protected for
+   * bounding the connection handshake.
+   */
+  using BsonSocket::setReceiveTimeout;
+
   /**
    * Run the receive cycle on the receiving thread and detach the receiving thread. Allows derived classes (clients and
    * connections) to being receiving at the appropriate time.
    */
   void startReceiveCycle();
 
+  /**
+   * Get the names of this socket's methods ordered by MethodID, to be sent to the peer socket while connecting.
+   * @return Json array of callback names.
+   */
+  json getMethodNames();
+
+  /**
+   * Set the peer socket's method names received while connecting. Requests to methods not in the list, such as those
+   * registered after connecting, are sent with their callback name instead.
+   * @param method_names Json array of callback names ordered by MethodID.
+   */
+  void setPeerMethodNames(json const &method_names);
+
   /**
    * Boolean that is true if the socket is connected, false otherwise.
    */
@@ -120,19 +213,166 @@ class BsonRPCSocket : virtual public BsonSocket {
 
  private:
   /**
-   * Receive and decode messages, check for closing messages, and handle callbacks and return callbacks.
+   * Fixed size header preceding the Bson payload of every message sent after connecting.
+   */
+  struct Envelope {
+    /**
+     * Index of the callback in the receiving socket's methods_. kUnresolvedMethodID_ if the name is sent instead.
+     */
+    MethodID method_id = kUnresolvedMethodID_;
+
+    /**
+     * Bitwise or of the k*Flag_ constants describing the message.
+     */
+    std::uint8_t flags = 0;
+
+    /**
+     * ID of a full duplex request or of the request a response answers. Zero for half duplex requests.
+     */
+    RequestID request_id = 0;
+  };
+
+  /**
+   * Callbacks registered under one name.
+   */
+  struct Method {
+    /**
+     * Name of the callback, used when reporting errors to the peer socket.
+     */
+    CallbackName name;
+
+    /**
+     * Callback invoked by half duplex requests, if one is registered. Shared so that it can be copied cheaply and
+     * invoked without holding request_callbacks_lock_.
+     */
+    std::shared_ptr<RequestCallbackJson const> request_callback;
+
+    /**
+     * Callback invoked by full duplex requests, if one is registered. Shared like request_callback.
+     */
+    std::shared_ptr<RequestResponseCallbackJson const> request_response_callback;
+  };
+
+  /**
+   * Receive and decode messages, check for closing messages, and handle callbacks and responses.
    */
   void receiveCycle();
 
   /**
    * Process a request by calling the appropriate callback.
    */
-  void processRequest(json const &callback_argument);
+  void processRequest(Envelope const &envelope, ByteSpan payload);
+
+  /**
+   * Process a request by calling the appropriate callback and sending a response carrying the request ID.
+   */
+  void processRequestResponse(Envelope const &envelope, ByteSpan payload);
+
+  /**
+   * Call a request response callback and send its response, or an error response if it throws or is missing.
+   */
+  void respondToRequest(RequestID request_id, Method const &method, json const &callback_argument);
+
+  /**
+   * Run a callback on the dispatcher if one is set, counting it as in flight until it finishes, or run it now.
+   */
+  void runCallback(CallbackName const &callback_name, Task task);
+
+  /**
+   * Process a response to a full duplex request by completing the matching pending request.
+   */
+  void processResponse(Envelope const &envelope, ByteSpan payload);
+
+  /**
+   * Decode the callback argument of a request and copy the method it invokes.
+   * @param envelope The request's envelope.
+   * @param payload The request's Bson payload.
+   * @param callback_argument Set to the decoded callback argument.
+   * @return Copy of the method. Its callbacks are null if none are registered, and its name describes the request.
+   */
+  Method resolveRequest(Envelope const &envelope, ByteSpan payload, json &callback_argument);
+
+  /**
+   * Invoke a request callback of this socket by name. Used to deliver responses to sendRequestAndGetResponse() calls
+   * naming a response callback.
+   */
+  void invokeRequestCallback(CallbackName const &callback_name, json const &callback_argument);
+
+  /**
+   * Send a request to the peer socket's callback, using its MethodID when the peer socket has sent one. Must be called
+   * with sending_lock_ held.
+   */
+  void sendRequestEnvelope(CallbackName const &callback_name, std::uint8_t flags, RequestID request_id,
+                           json const &callback_argument);
+
+  /**
+   * Encode an envelope and payload and send them as one frame. Non object payloads are wrapped in an object under
+   * "message" since a Bson document must be an object. Must be called with sending_lock_ held.
+   */
+  void sendEnvelope(Envelope envelope, json const &payload);
+
+  /**
+   * Decode the envelope at the front of a frame.
+   * @return False if the frame is too short to hold an envelope, true otherwise.
+   */
+  static bool decodeEnvelope(Bson const &frame, Envelope &envelope);
 
   /**
-   * Process a request by calling the appropriate callback and sending the return request message.
+   * Decode a payload, unwrapping it if it was wrapped by sendEnvelope().
    */
-  void processRequestResponse(json const &callback_argument);
+  static json decodePayload(Envelope const &envelope, ByteSpan payload);
+
+  /**
+   * State of a full duplex request that has been sent but whose response has not arrived.
+   */
+  struct PendingRequest {
+    /**
+     * Name of the peer socket's callback, used in the timeout message.
+     */
+    CallbackName callback_name;
+
+    /**
+     * Promise to be fulfilled with the response or the failure.
+     */
+    std::promise<json> promise;
+
+    /**
+     * Future of the promise, kept to pass to response_callback. Only valid when response_callback is set.
+     */
+    std::future<json> future;
+
+    /**
+     * Callback to be invoked once the promise is fulfilled, if one was supplied.
+     */
+    ResponseCallbackJson response_callback;
+
+    /**
+     * Time after which the request fails with an RPCTimeoutException. Max time point if there is no timeout.
+     */
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  /**
+   * Register a pending request and send it to the peer socket. Fails the request immediately if sending fails.
+   */
+  void sendPendingRequest(CallbackName const &callback_name, json const &callback_argument,
+                          PendingRequest pending_request);
+
+  /**
+   * Fulfill a pending request and invoke its response callback if it has one.
+   */
+  static void completePendingRequest(PendingRequest &pending_request, json const *response,
+                                     std::exception_ptr const &error);
+
+  /**
+   * Fail every pending request with the supplied error. Called when the socket closes.
+   */
+  void failPendingRequests(std::exception_ptr const &error);
+
+  /**
+   * Fail pending requests whose deadlines have passed until the socket closes. Run by deadline_thread_.
+   */
+  void expireRequestsUntilClosed();
 
   /**
    * Send a closing message to the peer socket.
@@ -140,14 +380,39 @@ class BsonRPCSocket : virtual public BsonSocket {
   void sendClosingMessage();
 
   /**
-   * Map for storing request callbacks.
+   * Table of registered callbacks, indexed by MethodID. Guarded by request_callbacks_lock_.
+   */
+  std::vector<Method> methods_;
+
+  /**
+   * Map from callback name to index in methods_. Guarded by request_callbacks_lock_.
    */
-  std::unordered_map<CallbackName, RequestCallbackJson> request_callbacks_;
+  std::unordered_map<CallbackName, MethodID> method_ids_;
 
   /**
-   * Map for storing request response callbacks.
+   * Map from callback name to index in the peer socket's method table. Guarded by peer_method_ids_lock_.
    */
-  std::unordered_map<CallbackName, RequestResponseCallbackJson> request_response_callbacks_;
+  std::unordered_map<CallbackName, MethodID> peer_method_ids_;
+
+  /**
+   * Dispatcher running request callbacks, or null to run them on the receiving thread.
+   */
+  std::shared_ptr<RPCDispatcher> dispatcher_;
+
+  /**
+   * Number of callbacks handed to dispatcher_ that have not finished. Guarded by in_flight_callbacks_lock_.
+   */
+  std::size_t in_flight_callbacks_ = 0;
+
+  /**
+   * Lock taken to ensure thread safety of accessing in_flight_callbacks_.
+   */
+  std::mutex in_flight_callbacks_lock_;
+
+  /**
+   * Condition variable signaled when in_flight_callbacks_ reaches zero. Used with in_flight_callbacks_lock_.
+   */
+  std::condition_variable in_flight_callbacks_condition_variable_;
 
   /**
    * Callback to be called if closing_callback_set_ is true when receiving thread receives a closing message.
@@ -160,14 +425,14 @@ class BsonRPCSocket : virtual public BsonSocket {
   bool closing_callback_set_ = false;
 
   /**
-   * Lock taken to ensure thread safety of accessing request_callbacks_.
+   * Lock taken to ensure thread safety of accessing methods_ and method_ids_.
    */
   std::mutex request_callbacks_lock_;
 
   /**
-   * Lock taken to ensure thread safety of accessing request_response_callbacks_.
+   * Lock taken to ensure thread safety of accessing peer_method_ids_.
    */
-  std::mutex request_response_callbacks_lock_;
+  std::mutex peer_method_ids_lock_;
 
   /**
    * Lock taken to ensure thread safety of accessing closing_callback_.
@@ -201,8 +466,78 @@ class BsonRPCSocket : virtual public BsonSocket {
   bool closing_message_received_ = false;
 
   /**
-   * Variable for delimiting the parameters for callbacks within messages. One of these characters is sent as the
-   * closing message.
+   * Requests sent by sendRequestAndGetFuture() or sendRequestAndGetResponse() waiting on a response, keyed by ID.
+   */
+  std::unordered_map<RequestID, PendingRequest> pending_requests_;
+
+  /**
+   * Lock taken to ensure thread safety of accessing pending_requests_ and deadline_thread_stopped_.
+   */
+  std::mutex pending_requests_lock_;
+
+  /**
+   * Condition variable signaled when a request with a deadline is added or the socket closes. Used with
+   * pending_requests_lock_.
+   */
+  std::condition_variable pending_requests_condition_variable_;
+
+  /**
+   * ID for the next full duplex request.
+   */
+  std::atomic<RequestID> next_request_id_ = 1;
+
+  /**
+   * Thread failing requests whose timeouts expire. Only started once a request with a timeout is sent.
+   */
+  std::thread deadline_thread_;
+
+  /**
+   * Boolean, true once the socket has closed and deadline_thread_ should exit. Guarded by pending_requests_lock_.
+   */
+  bool deadline_thread_stopped_ = false;
+
+  /**
+   * MethodID of a request sent by callback name, when the peer socket's MethodID for the name is unknown.
+   */
+  static constexpr const MethodID kUnresolvedMethodID_ = 0xFFFF;
+
+  /**
+   * Size of an encoded Envelope: method ID, flags, a reserved byte, and request ID, in host byte order.
+   */
+  static constexpr const std::size_t kEnvelopeSize_ = sizeof(MethodID) + 2 + sizeof(RequestID);
+
+  /**
+   * Flag of a half duplex request.
+   */
+  static constexpr const std::uint8_t kRequestFlag_ = 1 << 0;
+
+  /**
+   * Flag of a full duplex request, which is answered with a response carrying its request ID.
+   */
+  static constexpr const std::uint8_t kRequestResponseFlag_ = 1 << 1;
+
+  /**
+   * Flag of a response to a full duplex request.
+   */
+  static constexpr const std::uint8_t kResponseFlag_ = 1 << 2;
+
+  /**
+   * Flag of a response whose payload is an object holding an "error" string rather than a result.
+   */
+  static constexpr const std::uint8_t kErrorFlag_ = 1 << 3;
+
+  /**
+   * Flag of a closing message in the three way closing handshake.
+   */
+  static constexpr const std::uint8_t kCloseFlag_ = 1 << 4;
+
+  /**
+   * Flag of a request whose payload is an object holding the "callback name" and "message" rather than the argument.
+   */
+  static constexpr const std::uint8_t kNamedMethodFlag_ = 1 << 5;
+
+  /**
+   * Flag of a payload wrapped in an object under "message" because it is not an object itself.
    */
-  static constexpr const std::uint8_t kParameterDelimiter_ = '%';
+  static constexpr const std::uint8_t kWrappedPayloadFlag_ = 1 << 6;
 };
@@ -33,8 +33,11 @@ class ConnectionBsonRPCSocket : virtual public ConnectionSocket, virtual public
 
   /**
    * Send the connecting message to the client socket to unblock it's connect() call.
+   * @param timeout Time to wait for the client's connection message in milliseconds. Defaults to an indefinite timeout.
+   * @throws SocketException Throws exception if the timeout expires or the client fails during the handshake. The
+   * socket is closed before throwing.
    */
-  void startConnection();
+  void startConnection(int timeout = -1);
 
  private:
   /**
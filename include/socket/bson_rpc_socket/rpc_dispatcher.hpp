@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "thread_pool/thread_pool.hpp"
+
+/**
+ * How the callbacks dispatched for one callback name are ordered relative to each other.
+ */
+enum class DispatchPolicy {
+  /**
+   * Callbacks run concurrently with no ordering.
+   */
+  kParallel,
+
+  /**
+   * Callbacks for the same socket and callback name run one at a time in the order they were received.
+   */
+  kSerializedPerMethod,
+
+  /**
+   * Callbacks for the same socket run one at a time in the order they were received, whatever their callback name.
+   * Callbacks for different sockets run concurrently.
+   */
+  kSerializedPerSocket,
+};
+
+/**
+ * Runs RPC callbacks received by BsonRPCSocket instances on a pool of worker threads instead of their receiving
+ * threads, so that a slow callback does not hold up later messages. One dispatcher may be shared by many sockets.
+ */
+class RPCDispatcher {
+ public:
+  /**
+   * Start the worker threads.
+   * @param thread_count The number of worker threads.
+   * @param default_policy The policy for callback names without their own policy.
+   */
+  explicit RPCDispatcher(std::size_t thread_count, DispatchPolicy default_policy = DispatchPolicy::kParallel);
+
+  /**
+   * Finish all dispatched callbacks and join the worker threads.
+   */
+  ~RPCDispatcher();
+
+  /**
+   * Deleted copy constructor since the worker threads reference this instance.
+   */
+  RPCDispatcher(RPCDispatcher const &other) = delete;
+
+  /**
+   * Deleted assignment operator since the worker threads reference this instance.
+   */
+  void operator=(RPCDispatcher const &other) = delete;
+
+  /**
+   * Set the policy for one callback name, overriding the default policy. Should be called before dispatching.
+   * @param callback_name The name of the callback.
+   * @param policy The policy for the callback.
+   */
+  void setPolicy(std::string const &callback_name, DispatchPolicy policy);
+
+  /**
+   * Queue a callback to run on a worker thread according to the policy for its name.
+   * @param socket Identity of the socket that received the request, used as the serialization key.
+   * @param callback_name The name of the callback.
+   * @param task The task running the callback.
+   */
+  void dispatch(void const *socket, std::string const &callback_name, Task task);
+
+  /**
+   * Wait for the dispatched callbacks to finish and join the worker threads. Callbacks dispatched once shutdown has
+   * begun run on the calling thread, or behind the callbacks already queued for their key. Safe to call repeatedly.
+   */
+  void shutdown();
+
+ private:
+  /**
+   * Key of a queue of callbacks that must run one at a time: the socket and, for kSerializedPerMethod, the name.
+   */
+  using SerialKey = std::pair<void const *, std::string>;
+
+  /**
+   * Run the tasks of a serial queue in order, removing the queue once it is empty.
+   */
+  void runSerial(SerialKey const &key);
+
+  /**
+   * Worker threads running the callbacks.
+   */
+  ThreadPool thread_pool_;
+
+  /**
+   * Policy for callback names without their own policy.
+   */
+  DispatchPolicy default_policy_;
+
+  /**
+   * Policies set by setPolicy(), keyed by callback name. Guarded by serial_queues_lock_.
+   */
+  std::unordered_map<std::string, DispatchPolicy> policies_;
+
+  /**
+   * Tasks waiting on a serialized callback for the same key to finish. A key is present while one of its tasks is
+   * queued in or running on the pool, and its queue holds the tasks behind that one. Guarded by serial_queues_lock_.
+   */
+  std::map<SerialKey, std::queue<Task>> serial_queues_;
+
+  /**
+   * Boolean, true once shutdown() has begun, after which no task is submitted to the pool. Guarded by
+   * serial_queues_lock_.
+   */
+  bool shutdown_ = false;
+
+  /**
+   * Lock taken to ensure thread safety of accessing policies_, serial_queues_, and shutdown_.
+   */
+  std::mutex serial_queues_lock_;
+};
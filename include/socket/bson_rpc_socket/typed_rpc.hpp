@@ -0,0 +1,122 @@
+#pragma once
+
+#include <future>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "socket/bson_rpc_socket/bson_rpc_socket.hpp"
+#include "socket/utils/rpc_malformed_message_exception.hpp"
+
+/**
+ * Declaration of an RPC method with a typed argument and result, shared by the sockets on both ends. The types must
+ * convert to and from json, for example through NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE. A method with a void result is
+ * sent as a half duplex request, any other method as a full duplex request.
+ */
+template <typename ArgumentT, typename ResultT = void>
+struct RPCMethod {
+  /**
+   * Type of the argument passed to the method.
+   */
+  using Argument = ArgumentT;
+
+  /**
+   * Type of the result returned by the method.
+   */
+  using Result = ResultT;
+
+  /**
+   * Name the method's callback is registered under.
+   */
+  char const *name;
+};
+
+/**
+ * Decode a typed RPC message.
+ * @param callback_name The name of the callback the message belongs to, for the error message.
+ * @param message The message to decode.
+ * @return The decoded message.
+ * @throws RPCMalformedMessageException Throws exception if the message does not decode into MessageT.
+ */
+template <typename MessageT>
+MessageT decodeRPCMessage(std::string const &callback_name, json const &message) {
+  try {
+    return message.get<MessageT>();
+  } catch (json::exception const &error) {
+    throw RPCMalformedMessageException(callback_name, error.what());
+  }
+}
+
+/**
+ * Wrap a handler taking a typed argument as a RequestCallbackJson, for example for use as a connecting callback.
+ * @param callback_name The name of the callback, for the error message.
+ * @param handler Callable taking ArgumentT const &.
+ * @return Callback decoding its json argument and invoking the handler. Throws RPCMalformedMessageException if the
+ * argument does not decode, without invoking the handler.
+ */
+template <typename ArgumentT, typename HandlerT>
+RequestCallbackJson makeTypedRequestCallback(std::string callback_name, HandlerT handler) {
+  return [callback_name = std::move(callback_name), handler = std::move(handler)](json const &input) -> void {
+    handler(decodeRPCMessage<ArgumentT>(callback_name, input));
+  };
+}
+
+/**
+ * Register the handler of a half duplex typed RPC method.
+ * @param socket The socket to register the callback with.
+ * @param method The method declaration.
+ * @param handler Callable taking ArgumentT const &. Malformed requests are dropped without invoking it.
+ */
+template <typename ArgumentT, typename HandlerT>
+void registerTypedCallback(BsonRPCSocket &socket, RPCMethod<ArgumentT> const &method, HandlerT handler) {
+  socket.registerRequestCallback(method.name, makeTypedRequestCallback<ArgumentT>(method.name, std::move(handler)));
+}
+
+/**
+ * Register the handler of a full duplex typed RPC method.
+ * @param socket The socket to register the callback with.
+ * @param method The method declaration.
+ * @param handler Callable taking ArgumentT const & and returning ResultT. Malformed requests are answered with an
+ * error response without invoking it.
+ */
+template <typename ArgumentT, typename ResultT, typename HandlerT>
+  requires(!std::is_void_v<ResultT>)
+void registerTypedCallback(BsonRPCSocket &socket, RPCMethod<ArgumentT, ResultT> const &method, HandlerT handler) {
+  socket.registerRequestResponseCallback(
+      method.name, [callback_name = std::string(method.name), handler = std::move(handler)](json const &input) -> json {
+        ResultT result = handler(decodeRPCMessage<ArgumentT>(callback_name, input));
+        return result;
+      });
+}
+
+/**
+ * Send a half duplex typed RPC request.
+ * @param socket The socket to send the request on.
+ * @param method The method declaration.
+ * @param argument The argument to pass to the peer socket's handler.
+ */
+template <typename ArgumentT>
+void sendTypedRequest(BsonRPCSocket &socket, RPCMethod<ArgumentT> const &method, ArgumentT const &argument) {
+  socket.sendRequest(method.name, argument);
+}
+
+/**
+ * Send a full duplex typed RPC request and get a future for its decoded result.
+ * @param socket The socket to send the request on.
+ * @param method The method declaration.
+ * @param argument The argument to pass to the peer socket's handler.
+ * @param timeout Time to wait for the response in milliseconds. Defaults to an indefinite timeout.
+ * @return Deferred future holding the result. Holds the failures described by sendRequestAndGetFuture(), or an
+ * RPCMalformedMessageException if the response does not decode into ResultT.
+ */
+template <typename ArgumentT, typename ResultT>
+  requires(!std::is_void_v<ResultT>)
+std::future<ResultT> sendTypedRequestAndGetFuture(BsonRPCSocket &socket, RPCMethod<ArgumentT, ResultT> const &method,
+                                                  ArgumentT const &argument, int timeout = -1) {
+  return std::async(std::launch::deferred,
+                    [callback_name = std::string(method.name),
+                     response = socket.sendRequestAndGetFuture(method.name, argument, timeout)]() mutable -> ResultT {
+                      return decodeRPCMessage<ResultT>(callback_name, response.get());
+                    });
+}
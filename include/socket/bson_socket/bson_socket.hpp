@@ -1,9 +1,13 @@
 #pragma once
 
+#include <sys/uio.h>
+
 #include <atomic>
 #include <cstdint>
+#include <initializer_list>
 #include <nlohmann/json.hpp>
 #include <queue>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -14,6 +18,11 @@
 
 using Bson = std::vector<std::uint8_t>;
 using BsonString = std::basic_string<std::uint8_t>;
+
+/**
+ * View of a contiguous range of bytes making up all or part of a frame.
+ */
+using ByteSpan = std::span<std::uint8_t const>;
 using namespace nlohmann;
 
 class BsonSocket : virtual public Socket {
@@ -38,6 +47,37 @@ class BsonSocket : virtual public Socket {
    */
   void sendMessage(json const &message);
 
+  /**
+   * Send a frame made of several byte ranges as one size prefixed frame. All ranges are written with a single
+   * sendmsg() call when the kernel accepts them at once, so the peer sees one contiguous frame.
+   * @param frame_parts The byte ranges making up the frame, in order.
+   * @throws SocketException Throws exception if socket is closed.
+   * @throws SocketErrnoException Throws exception on failure of sendmsg().
+   * @throws PeerClosedException Throws exception if peer has closed.
+   */
+  void sendFrame(std::initializer_list<ByteSpan> frame_parts);
+
+  /**
+   * Send several size prefixed frames, each made of the same number of byte ranges, writing all of them with as few
+   * sendmsg() calls as the kernel allows. The peer receives them as separate frames.
+   * @param frame_parts The byte ranges making up the frames, in order, parts_per_frame of them per frame.
+   * @param parts_per_frame The number of byte ranges in each frame.
+   * @throws SocketException Throws exception if socket is closed.
+   * @throws SocketErrnoException Throws exception on failure of sendmsg().
+   * @throws PeerClosedException Throws exception if peer has closed.
+   */
+  void sendFrames(std::span<ByteSpan const> frame_parts, std::size_t parts_per_frame);
+
+  /**
+   * Receive the bytes of one size prefixed frame without decoding them.
+   * @return The frame received, excluding its size prefix.
+   * @throws SocketException Throws exception if socket is closed, or if the size prefix exceeds kMaxFrameSize_, after
+   * which the stream cannot be read further.
+   * @throws SocketErrnoException Throws exception on failure of recv().
+   * @throws PeerClosedException Throws exception if peer has closed.
+   */
+  Bson receiveFrame();
+
   /**
    * Receive a Bson message, storing any additionally received items.
    * @return The bson message received.
@@ -48,22 +88,94 @@ class BsonSocket : virtual public Socket {
    */
   json receiveMessage();
 
+  /**
+   * Set whether small writes are sent at once (TCP_NODELAY) or held by Nagle's algorithm until earlier data is
+   * acknowledged, so that the kernel may join them into fewer segments.
+   * @param no_delay True to send at once.
+   * @throws SocketErrnoException Throws exception on failure of setsockopt().
+   */
+  void setNoDelay(bool no_delay);
+
+  /**
+   * Set the SO_RCVTIMEO option of the socket so that receives fail instead of blocking past the timeout.
+   * @param timeout Receive timeout in milliseconds. Zero disables the timeout.
+   * @throws SocketErrnoException Throws exception on failure of setsockopt().
+   */
+  void setReceiveTimeout(int timeout);
+
+  /**
+   * Shut down both directions of the connection without closing the socket, so that a thread blocked receiving on it
+   * wakes up with PeerClosedException.
+   */
+  void shutdown();
+
   /**
    * Close the socket if it is not already closed.
    */
   virtual void close();
 
  protected:
+  /**
+   * Send every byte described by an I/O vector, calling sendmsg() until the kernel has accepted all of them. The
+   * vector is modified to track partial sends. Vectors longer than the system limit are sent in several calls.
+   * @throws SocketErrnoException Throws exception on failure of sendmsg().
+   */
+  void sendVector(iovec *vector, std::size_t vector_count);
+
   std::atomic_bool is_open_ = true;
 
  private:
+  /**
+   * Check that the socket is open and its peer has not closed, without waiting.
+   * @throws SocketException Throws exception if socket is closed.
+   * @throws PeerClosedException Throws exception if peer has closed.
+   */
+  void checkSendable();
+
+  /**
+   * Receive once into storage_bson_, appending up to kReceiveBufferSize_ bytes.
+   * @throws PeerClosedException Throws exception if peer has closed.
+   * @throws SocketErrnoException Throws exception on failure of recv().
+   */
+  void receiveIntoStorage();
+
+  /**
+   * Receive exactly size bytes directly into destination, bypassing storage_bson_.
+   * @throws PeerClosedException Throws exception if peer has closed.
+   * @throws SocketErrnoException Throws exception on failure of recv().
+   */
+  void receiveExactly(std::uint8_t *destination, std::size_t size);
+
   std::queue<BsonString> message_queue_;
 
   bool back_is_complete_message_ = false;
 
-  static int constexpr const kReceiveBufferSize_ = 4;
+  /**
+   * Most bytes taken from the kernel by one recv() into storage_bson_. Small frames arriving together are received at
+   * once, while the remainder of a frame larger than what is stored is received directly into the frame.
+   */
+  static std::size_t constexpr const kReceiveBufferSize_ = 64 * 1024;
+
+  /**
+   * Largest frame receiveFrame() accepts. Larger size prefixes are treated as a corrupt stream.
+   */
+  static std::size_t constexpr const kMaxFrameSize_ = std::size_t(1) << 30;
+
+  /**
+   * Maximum number of parts in a frame passed to sendFrame().
+   */
+  static std::size_t constexpr const kMaxFrameParts_ = 8;
 
   static std::uint8_t constexpr const kDelimitingCharacter_ = '$';
 
+  /**
+   * Bytes received but not yet returned by receiveFrame(), starting at storage_offset_.
+   */
   BsonString storage_bson_;
+
+  /**
+   * Offset of the first unconsumed byte of storage_bson_. Consumed bytes are only erased once all are consumed or more
+   * space is needed, so that returning a frame does not shift the rest of the storage.
+   */
+  std::size_t storage_offset_ = 0;
 };
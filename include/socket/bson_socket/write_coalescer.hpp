@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+#include "socket/bson_socket/bson_socket.hpp"
+
+/**
+ * Buffer gathering the frames bound for one connection so that small frames sent at a high rate go out in one write
+ * rather than one each. Frames are held until the buffer reaches a number of bytes or the oldest frame has waited a
+ * maximum delay, whichever comes first, so the added latency is bounded. The owner checks both and calls flush(); the
+ * buffer does no locking of its own.
+ */
+class WriteCoalescer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param max_delay Longest time a frame is held before it must be flushed.
+   * @param max_bytes Number of buffered bytes at which the buffer should be flushed at once.
+   */
+  WriteCoalescer(Clock::duration max_delay, std::size_t max_bytes);
+
+  /**
+   * Copy a frame into the buffer.
+   * @param frame_parts The byte ranges making up the frame, in order.
+   * @param now The current time, which starts the delay if the buffer was empty.
+   * @return True if the buffer has reached its byte threshold and should be flushed now.
+   */
+  bool add(std::initializer_list<ByteSpan> frame_parts, Clock::time_point now);
+
+  /**
+   * Check whether any frame is buffered.
+   */
+  bool empty() const { return frame_count_ == 0; }
+
+  /**
+   * Get the time by which the buffered frames must be flushed, or the maximum time point if none are.
+   */
+  Clock::time_point deadline() const { return deadline_; }
+
+  /**
+   * Send the buffered frames with one vectored write and empty the buffer. The buffer is emptied even if the send
+   * throws, as a connection that failed to send is dropped.
+   * @throws SocketException, SocketErrnoException or PeerClosedException as BsonSocket::sendFrames() does.
+   */
+  void flush(BsonSocket &socket);
+
+ private:
+  Clock::duration max_delay_;
+  std::size_t max_bytes_;
+
+  /**
+   * Buffered frames, of which the first frame_count_ are in use. Frames past those keep their storage for reuse.
+   */
+  std::vector<Bson> frames_;
+  std::size_t frame_count_ = 0;
+  std::size_t byte_count_ = 0;
+  Clock::time_point deadline_ = Clock::time_point::max();
+
+  /**
+   * Spans of the buffered frames handed to sendFrames(), kept to reuse its storage.
+   */
+  std::vector<ByteSpan> frame_spans_;
+};
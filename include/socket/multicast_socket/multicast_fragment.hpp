@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+/**
+ * Header at the front of every datagram sent by a MulticastSenderSocket. A frame larger than one datagram is split into
+ * fragments, each carrying the position of its bytes in the frame so that the receiver can reassemble fragments that
+ * arrive out of order.
+ */
+struct MulticastFragmentHeader {
+  /**
+   * Number of frames the sender sent before this one.
+   */
+  std::uint64_t sequence = 0;
+
+  /**
+   * Random number chosen by each sender, so that a receiver notices a sender restarting with the same group and port.
+   */
+  std::uint32_t stream_id = 0;
+
+  /**
+   * Size of the whole frame in bytes.
+   */
+  std::uint32_t frame_size = 0;
+
+  /**
+   * Offset of this fragment's bytes in the frame.
+   */
+  std::uint32_t fragment_offset = 0;
+
+  /**
+   * Index of this fragment in its frame, and the number of fragments the frame was split into.
+   */
+  std::uint16_t fragment_index = 0;
+  std::uint16_t fragment_count = 0;
+
+  /**
+   * Size of an encoded header in bytes.
+   */
+  static constexpr std::size_t kSize = sizeof(std::uint64_t) + 3 * sizeof(std::uint32_t) + 2 * sizeof(std::uint16_t);
+
+  /**
+   * Decode the header at the front of a datagram.
+   * @return False if the datagram is too short to hold a header, true otherwise.
+   */
+  bool decode(std::span<std::uint8_t const> datagram) {
+    if (datagram.size() < kSize) return false;
+    std::memcpy(this, datagram.data(), kSize);
+    return true;
+  }
+};
+static_assert(sizeof(MulticastFragmentHeader) == MulticastFragmentHeader::kSize);
+
+/**
+ * Largest payload of a UDP datagram over IPv4.
+ */
+inline constexpr std::size_t kMaxMulticastDatagramBytes = 65507;
+
+/**
+ * Largest frame sent to or reassembled from a multicast group. Any host can send datagrams to the group, so receivers
+ * refuse fragment headers claiming larger frames rather than allocating them.
+ */
+inline constexpr std::size_t kMaxMulticastFrameBytes = std::size_t(64) << 20;
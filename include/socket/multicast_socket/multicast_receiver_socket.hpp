@@ -0,0 +1,192 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "socket/bson_socket/bson_socket.hpp"
+#include "socket/multicast_socket/multicast_fragment.hpp"
+#include "socket/socket.hpp"
+
+/**
+ * Counters of a MulticastReceiverSocket.
+ */
+struct MulticastReceiverStatistics {
+  std::uint64_t received_frame_count = 0;
+  std::uint64_t received_datagram_count = 0;
+
+  /**
+   * Number of recvmmsg() calls made, each receiving a batch of datagrams.
+   */
+  std::uint64_t receive_call_count = 0;
+
+  /**
+   * Number of frames never received whole, found from gaps in the sequence numbers of the frames that were.
+   */
+  std::uint64_t dropped_frame_count = 0;
+
+  /**
+   * Number of frames completed after a later frame, which had first counted them as dropped.
+   */
+  std::uint64_t reordered_frame_count = 0;
+
+  /**
+   * Number of datagrams that were truncated, whose fragment header did not fit the frame, or that claimed a frame
+   * larger than kMaxMulticastFrameBytes.
+   */
+  std::uint64_t malformed_datagram_count = 0;
+};
+
+/**
+ * Receiver of the frames a MulticastSenderSocket sends to a multicast group. Datagrams are received in batches with
+ * recvmmsg() and reassembled into frames, and frames are passed on as soon as all of their fragments have arrived,
+ * whatever order they arrived in. A few frames of each sender may be in reassembly at once; when another starts, or
+ * the frames in reassembly would hold too many bytes, the oldest is given up on. Loss and reordering are counted from
+ * each sender's sequence numbers.
+ */
+class MulticastReceiverSocket : public Socket {
+ public:
+  /**
+   * Bind to the group's port and join the group on an interface.
+   * @param group_address The multicast group address in x.x.x.x format.
+   * @param port The port the sender sends to.
+   * @param interface_address The address of the interface to receive on in x.x.x.x format.
+   * @throws SocketException Throws exception on failure of socket(), setsockopt(), or bind().
+   */
+  MulticastReceiverSocket(std::string const &group_address, int port, std::string const &interface_address);
+
+  /**
+   * Close the socket.
+   */
+  ~MulticastReceiverSocket() override;
+
+  MulticastReceiverSocket(MulticastReceiverSocket const &other) = delete;
+
+  void operator=(MulticastReceiverSocket const &other) = delete;
+
+  /**
+   * Block until at least one datagram arrives, then receive all datagrams waiting, up to a batch, and pass each frame
+   * they complete to the callback. Only one thread may receive at a time.
+   * @param frame_callback Called with each completed frame, which it may move from.
+   * @throws SocketException Throws exception if the socket has been shut down or closed.
+   * @throws SocketErrnoException Throws exception on failure of recvmmsg().
+   */
+  void receiveFrames(std::function<void(Bson &)> const &frame_callback);
+
+  /**
+   * Wake a thread blocked in receiveFrames(), which then throws. Later receives throw too.
+   */
+  void shutdown();
+
+  /**
+   * Get the socket's counters.
+   */
+  MulticastReceiverStatistics statistics();
+
+ private:
+  /**
+   * A frame some of whose fragments have arrived.
+   */
+  struct PartialFrame {
+    std::uint64_t sequence;
+    Bson frame;
+    std::vector<bool> fragment_received;
+    std::size_t remaining_fragment_count;
+  };
+
+  /**
+   * Frames in reassembly and sequence state of one sender, told apart by its stream ID.
+   */
+  struct Stream {
+    std::uint32_t stream_id;
+
+    /**
+     * Frames in reassembly, oldest first.
+     */
+    std::deque<PartialFrame> partial_frames;
+
+    /**
+     * Sequence number expected of the next frame to complete, unknown until a frame of the stream completes.
+     */
+    std::uint64_t next_sequence = 0;
+    bool next_sequence_known = false;
+  };
+
+  /**
+   * Add one datagram to the frame it belongs to, passing the frame to the callback if this completes it.
+   */
+  void addDatagram(ByteSpan datagram, std::function<void(Bson &)> const &frame_callback);
+
+  /**
+   * Find the stream of a stream ID and make it the most recently heard from, starting it if it is new and dropping
+   * the least recently heard from stream if there are too many.
+   */
+  Stream &findStream(std::uint32_t stream_id);
+
+  /**
+   * Give up on the oldest frames in reassembly until a new frame of a number of bytes fits, first those of the stream
+   * the new frame belongs to, then those of the least recently heard from streams.
+   */
+  void makeRoom(Stream &stream, std::size_t frame_size);
+
+  /**
+   * Count a completed frame of a stream against the sequence numbers it has seen so far.
+   */
+  void countFrame(Stream &stream, std::uint64_t sequence);
+
+  /**
+   * Most datagrams received by one recvmmsg() call.
+   */
+  static constexpr std::size_t kReceiveBatchSize_ = 32;
+
+  /**
+   * Receive buffer size asked of the kernel.
+   */
+  static constexpr int kReceiveBufferBytes_ = 4 << 20;
+
+  /**
+   * Most frames of one stream in reassembly at once.
+   */
+  static constexpr std::size_t kMaxPartialFrames_ = 4;
+
+  /**
+   * Most bytes of frames in reassembly at once, over all streams.
+   */
+  static constexpr std::size_t kMaxPartialFrameBytes_ = 2 * kMaxMulticastFrameBytes;
+
+  /**
+   * Most streams kept at once, such as publishers sharing a multicast port.
+   */
+  static constexpr std::size_t kMaxStreams_ = 8;
+
+  /**
+   * Receive buffers, one of kMaxMulticastDatagramBytes per datagram in a batch, with their message headers.
+   */
+  std::unique_ptr<std::uint8_t[]> receive_buffer_;
+  std::array<iovec, kReceiveBatchSize_> receive_vectors_{};
+  std::array<mmsghdr, kReceiveBatchSize_> receive_headers_{};
+
+  /**
+   * Streams heard from, least recently heard from first, and the bytes of their frames in reassembly. Only used by the
+   * receiving thread.
+   */
+  std::vector<Stream> streams_;
+  std::size_t partial_frame_bytes_ = 0;
+
+  /**
+   * Guarded by statistics_mutex_.
+   */
+  MulticastReceiverStatistics statistics_;
+  std::mutex statistics_mutex_;
+
+  std::atomic_bool is_shut_down_ = false;
+};
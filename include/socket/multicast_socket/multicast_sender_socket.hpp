@@ -0,0 +1,103 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "socket/bson_socket/bson_socket.hpp"
+#include "socket/multicast_socket/multicast_fragment.hpp"
+#include "socket/socket.hpp"
+
+/**
+ * Counters of a MulticastSenderSocket.
+ */
+struct MulticastSenderStatistics {
+  std::uint64_t sent_frame_count = 0;
+  std::uint64_t sent_datagram_count = 0;
+
+  /**
+   * Number of sendmmsg() calls made, each sending a batch of datagrams.
+   */
+  std::uint64_t send_call_count = 0;
+
+  /**
+   * Number of datagrams the kernel refused, such as for lack of buffer space. The frames they belonged to are lost.
+   */
+  std::uint64_t failed_datagram_count = 0;
+};
+
+/**
+ * Best effort sender of frames to a UDP multicast group. Each frame is split into datagrams of at most
+ * max_datagram_bytes and the datagrams are sent in batches with sendmmsg(), so a frame costs the same to send however
+ * many receivers have joined the group. Datagrams may be lost or reordered; nothing is retransmitted. Thread safe.
+ */
+class MulticastSenderSocket : public Socket {
+ public:
+  /**
+   * Set up the socket to send to a multicast group from an interface.
+   * @param group_address The multicast group address in x.x.x.x format.
+   * @param port The port to send to. Zero to have the kernel choose a free port, which receivers then bind to.
+   * @param interface_address The address of the interface to send on in x.x.x.x format, such as 127.0.0.1 to keep
+   * traffic on this host.
+   * @param max_datagram_bytes Size of the largest datagram to send, including the fragment header. Should fit the MTU
+   * of the interface to avoid IP fragmentation.
+   * @throws SocketException Throws exception on failure of socket(), setsockopt(), or bind(), or on invalid arguments.
+   */
+  MulticastSenderSocket(std::string const &group_address, int port, std::string const &interface_address,
+                        std::size_t max_datagram_bytes);
+
+  /**
+   * Close the socket.
+   */
+  ~MulticastSenderSocket() override;
+
+  MulticastSenderSocket(MulticastSenderSocket const &other) = delete;
+
+  void operator=(MulticastSenderSocket const &other) = delete;
+
+  /**
+   * Send a frame made of several byte ranges to the group, fragmenting it as needed. Datagrams the kernel refuses are
+   * counted rather than thrown, since delivery is best effort.
+   * @param frame_parts The byte ranges making up the frame, in order.
+   * @throws SocketException Throws exception if the frame has too many parts, is larger than kMaxMulticastFrameBytes,
+   * or needs too many fragments.
+   */
+  void sendFrame(std::initializer_list<ByteSpan> frame_parts);
+
+  /**
+   * Get the group address and port datagrams are sent to.
+   */
+  std::pair<std::string, int> getGroupPort() const;
+
+  /**
+   * Get the socket's counters.
+   */
+  MulticastSenderStatistics statistics();
+
+ private:
+  /**
+   * Most datagrams passed to one sendmmsg() call.
+   */
+  static constexpr std::size_t kSendBatchSize_ = 64;
+
+  /**
+   * Maximum number of parts in a frame passed to sendFrame().
+   */
+  static constexpr std::size_t kMaxFrameParts_ = 8;
+
+  sockaddr_in group_address_{};
+  std::size_t max_fragment_bytes_;
+  std::uint32_t stream_id_;
+
+  /**
+   * Sequence number of the next frame, and the counters. Guarded by send_mutex_, which also keeps the datagrams of
+   * concurrently sent frames from interleaving.
+   */
+  std::uint64_t next_sequence_ = 0;
+  MulticastSenderStatistics statistics_;
+  std::mutex send_mutex_;
+};
@@ -0,0 +1,21 @@
+#ifndef MROS_RPC_MALFORMED_MESSAGE_EXCEPTION_HPP
+#define MROS_RPC_MALFORMED_MESSAGE_EXCEPTION_HPP
+
+#include <socket/utils/socket_exception.hpp>
+
+/**
+ * Runtime error thrown when the argument or result of a typed RPC does not decode into its declared type.
+ */
+class RPCMalformedMessageException : public SocketException {
+ public:
+  /**
+   * Constructor feeding the callback name and decoding error into the message of the grandparent std::runtime_exception
+   * class.
+   * @param callback_name The name of the callback whose message failed to decode.
+   * @param reason Description of the decoding failure.
+   */
+  RPCMalformedMessageException(const std::string& callback_name, const std::string& reason)
+      : SocketException("Malformed message for " + callback_name + ": " + reason) {}
+};
+
+#endif  // MROS_RPC_MALFORMED_MESSAGE_EXCEPTION_HPP
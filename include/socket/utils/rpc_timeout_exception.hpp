@@ -0,0 +1,19 @@
+#ifndef MROS_RPC_TIMEOUT_EXCEPTION_HPP
+#define MROS_RPC_TIMEOUT_EXCEPTION_HPP
+
+#include <socket/utils/socket_exception.hpp>
+
+/**
+ * Runtime error to set on the result of a full duplex RPC whose response did not arrive before its timeout.
+ */
+class RPCTimeoutException : public SocketException {
+ public:
+  /**
+   * Constructor feeding the callback name into the message of the grandparent std::runtime_exception class.
+   * @param callback_name The name of the peer socket's callback that did not respond in time.
+   */
+  explicit RPCTimeoutException(const std::string& callback_name)
+      : SocketException("Timed out waiting for response to " + callback_name + ".") {}
+};
+
+#endif  // MROS_RPC_TIMEOUT_EXCEPTION_HPP
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * Task to be executed by a worker thread. Takes no arguments and returns nothing.
+ */
+using Task = std::function<void()>;
+
+/**
+ * Priority class of a task. Queued tasks of a higher class always run before those of a lower one.
+ */
+enum class TaskPriority : std::uint8_t { kLow, kNormal, kHigh };
+
+inline constexpr std::size_t kTaskPriorityCount = 3;
+
+/**
+ * Options of a ThreadPool for keeping high priority tasks from waiting behind slow lower priority ones.
+ */
+struct ThreadPoolOptions {
+  /**
+   * Number of the worker threads reserved for high priority tasks, which never run lower priority tasks and so are free
+   * whenever a high priority task is queued. At least one worker thread is always left for the other tasks.
+   */
+  std::size_t high_priority_thread_count = 0;
+
+  /**
+   * SCHED_FIFO priority, from 1 to 99, to run the reserved threads with, or zero to leave them under the default
+   * scheduler. Needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance; without them the threads run under the default
+   * scheduler and a warning is logged.
+   */
+  int high_priority_realtime_priority = 0;
+
+  /**
+   * CPUs to pin the reserved threads to, or empty for any CPU.
+   */
+  std::vector<int> high_priority_cpus;
+};
+
+/**
+ * Counters of the tasks of one priority class.
+ */
+struct TaskPriorityStatistics {
+  std::uint64_t executed_count = 0;
+
+  /**
+   * Number of tasks that finished after their deadline.
+   */
+  std::uint64_t deadline_missed_count = 0;
+};
+
+/**
+ * Fixed size pool of worker threads executing submitted tasks by priority class, and within a class in the order they
+ * were submitted.
+ */
+class ThreadPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Start the worker threads.
+   * @param thread_count The number of worker threads to start. At least one thread is always started.
+   * @param options The threads to reserve for high priority tasks and how to schedule them.
+   */
+  explicit ThreadPool(std::size_t thread_count, ThreadPoolOptions const &options = {});
+
+  /**
+   * Finish all queued tasks and join the worker threads.
+   */
+  ~ThreadPool();
+
+  /**
+   * Deleted copy constructor since the worker threads reference this instance.
+   */
+  ThreadPool(ThreadPool const &other) = delete;
+
+  /**
+   * Deleted assignment operator since the worker threads reference this instance.
+   */
+  void operator=(ThreadPool const &other) = delete;
+
+  /**
+   * Queue a task to be executed by the first available worker thread. Tasks submitted after shutdown() are dropped.
+   * @param task The task to execute. Exceptions thrown by the task are caught and discarded.
+   * @param priority The priority class of the task.
+   * @param deadline Time the task should have finished by. Tasks finishing later are counted as missing it, but still
+   * run in order. Defaults to no deadline.
+   */
+  void submit(Task task, TaskPriority priority = TaskPriority::kNormal,
+              Clock::time_point deadline = Clock::time_point::max());
+
+  /**
+   * Get the counters of each priority class, indexed by TaskPriority.
+   */
+  std::array<TaskPriorityStatistics, kTaskPriorityCount> statistics();
+
+  /**
+   * Stop accepting tasks, wait for the queued tasks to finish, and join the worker threads. Safe to call repeatedly.
+   */
+  void shutdown();
+
+  /**
+   * Get the number of worker threads in the pool.
+   * @return The number of worker threads.
+   */
+  std::size_t size() const { return worker_threads_.size(); }
+
+ private:
+  /**
+   * Task waiting for a worker thread.
+   */
+  struct QueuedTask {
+    Task task;
+    Clock::time_point deadline;
+  };
+
+  /**
+   * Execute queued tasks until shutdown() is called and the queues are empty. Run by every worker thread.
+   * @param high_priority_only Whether the thread is reserved for high priority tasks.
+   */
+  void workUntilShutdown(bool high_priority_only);
+
+  /**
+   * Apply the realtime priority and CPU affinity of the options to the calling reserved thread, logging failures.
+   */
+  static void scheduleHighPriorityThread(ThreadPoolOptions const &options);
+
+  /**
+   * Worker threads executing the queued tasks.
+   */
+  std::vector<std::thread> worker_threads_;
+
+  /**
+   * Tasks waiting for a worker thread, one queue per priority class indexed by TaskPriority. Guarded by tasks_mutex_.
+   */
+  std::array<std::queue<QueuedTask>, kTaskPriorityCount> tasks_;
+
+  /**
+   * Counters of each priority class. Guarded by tasks_mutex_.
+   */
+  std::array<TaskPriorityStatistics, kTaskPriorityCount> statistics_;
+
+  /**
+   * Lock taken to ensure thread safety of accessing tasks_ and shutdown_.
+   */
+  std::mutex tasks_mutex_;
+
+  /**
+   * Condition variable signaled when a task is queued or the pool is shut down. Used with tasks_mutex_.
+   */
+  std::condition_variable tasks_condition_variable_;
+
+  /**
+   * Condition variable signaled when a high priority task is queued or the pool is shut down, waited on by the
+   * reserved threads. Used with tasks_mutex_.
+   */
+  std::condition_variable high_priority_condition_variable_;
+
+  /**
+   * Boolean, true once shutdown() has been called. Guarded by tasks_mutex_.
+   */
+  bool shutdown_ = false;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Keeps a user loop at a fixed rate, as in
+ *
+ *   Rate rate(10);
+ *   while (mros.active()) {
+ *     publisher->publish(message);
+ *     rate.sleep();
+ *   }
+ *
+ * Deadlines are absolute, the n-th always the start plus n periods, so the time spent in the loop and the error of each
+ * wake up never accumulate into drift the way a fixed sleep_for() does. A loop that falls more than a period behind
+ * skips the deadlines it missed instead of bursting to catch up, and counts them.
+ */
+class Rate {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Start the loop's schedule now, with the first deadline a period away.
+   * @param rate_hz The number of loops per second. Must be positive.
+   * @throws std::invalid_argument Throws exception if the rate is not positive.
+   */
+  explicit Rate(double rate_hz);
+
+  /**
+   * Start the loop's schedule with the first deadline given.
+   * @param rate_hz The number of loops per second. Must be positive.
+   * @param first_deadline The first deadline.
+   * @throws std::invalid_argument Throws exception if the rate is not positive.
+   */
+  Rate(double rate_hz, Clock::time_point first_deadline);
+
+  /**
+   * Start the loop's schedule now, with the first deadline a period away.
+   * @param period The time between loops. Must be positive.
+   * @throws std::invalid_argument Throws exception if the period is not positive.
+   */
+  explicit Rate(Clock::duration period);
+
+  /**
+   * Sleep until the next deadline.
+   * @return False if the loop had already missed the deadline, so did not sleep, true otherwise.
+   */
+  bool sleep();
+
+  /**
+   * Get the next deadline given the current time, and advance past it, for loops that wait for it in their own way.
+   * Deadlines more than a period in the past are skipped and counted as missed.
+   * @param now The current time.
+   */
+  Clock::time_point nextDeadline(Clock::time_point now);
+
+  /**
+   * Restart the schedule now, such as after a pause, so that the pause is not counted as missed deadlines.
+   */
+  void reset();
+
+  /**
+   * Get the number of deadlines skipped because the loop fell more than a period behind.
+   */
+  std::uint64_t missedDeadlines() const;
+
+  /**
+   * Get the time between deadlines.
+   */
+  Clock::duration period() const;
+
+ private:
+  /**
+   * Get the period of a rate.
+   * @throws std::invalid_argument Throws exception if the rate is not positive.
+   */
+  static Clock::duration periodOf(double rate_hz);
+
+  Rate(Clock::duration period, Clock::time_point first_deadline);
+
+  Clock::duration period_;
+  Clock::time_point next_deadline_;
+  std::uint64_t missed_deadlines_ = 0;
+};
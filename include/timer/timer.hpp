@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "thread_pool/thread_pool.hpp"
+#include "timer/timer_wheel.hpp"
+
+class TimerScheduler;
+
+/**
+ * Counters of a Timer.
+ */
+struct TimerStatistics {
+  /**
+   * Number of times the callback has been started.
+   */
+  std::uint64_t fired_count = 0;
+
+  /**
+   * Number of deadlines skipped, because the callback was still running from an earlier deadline or the scheduler fell
+   * more than a period behind.
+   */
+  std::uint64_t missed_count = 0;
+
+  /**
+   * Mean and largest time from a deadline to the callback starting, in seconds.
+   */
+  double mean_lateness_s = 0;
+  double max_lateness_s = 0;
+};
+
+/**
+ * Periodic callback run by a TimerScheduler. The n-th deadline is always the first deadline plus n periods, so the time
+ * spent in the callback and the lateness of each run never accumulate into drift. A callback is never run concurrently
+ * with itself: deadlines that come while it is still running, or that the scheduler falls more than a period behind,
+ * are skipped and counted as missed. A one-shot Timer instead runs its callback at its first deadline only. Destroying
+ * the Timer cancels it.
+ */
+class Timer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  ~Timer();
+
+  /**
+   * Stop running the callback. A run already started still finishes.
+   */
+  void cancel();
+
+  /**
+   * Get the counters of the timer.
+   */
+  TimerStatistics statistics();
+
+  /**
+   * Get the time between deadlines, or the time to the deadline of a one-shot timer.
+   */
+  Clock::duration period() const;
+
+  friend class TimerScheduler;
+
+ private:
+  Timer(Clock::duration period, std::function<void()> callback, Clock::time_point first_deadline, bool one_shot);
+
+  /**
+   * Record the start of a run of the callback.
+   * @param lateness The time from the deadline to the start of the run.
+   */
+  void recordRun(Clock::duration lateness);
+
+  Clock::duration period_;
+  std::function<void()> callback_;
+  bool one_shot_;
+
+  /**
+   * Next deadline to run at. Only used by the scheduler's thread.
+   */
+  Clock::time_point next_deadline_;
+
+  /**
+   * True while a run of the callback is queued or running.
+   */
+  std::atomic<bool> running_ = false;
+  std::atomic<bool> cancelled_ = false;
+
+  TimerStatistics statistics_;
+  double total_lateness_s_ = 0;
+  std::mutex statistics_mutex_;
+};
+
+/**
+ * Runs many Timers from one thread holding their deadlines in a TimerWheel. Callbacks are handed to an executor rather
+ * than run on the scheduling thread, so that a slow callback does not make the other timers late.
+ */
+class TimerScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Start the scheduling thread.
+   * @param executor The executor to run callbacks on. Must outlive the scheduler.
+   * @param resolution The resolution of the timer wheel. Callbacks start up to this much late on top of the time to
+   * wake the scheduling thread and an executor thread.
+   */
+  explicit TimerScheduler(ThreadPool &executor, Clock::duration resolution = std::chrono::milliseconds(1));
+
+  /**
+   * Stop the scheduling thread.
+   */
+  ~TimerScheduler();
+
+  TimerScheduler(TimerScheduler const &other) = delete;
+
+  void operator=(TimerScheduler const &other) = delete;
+
+  /**
+   * Create a timer whose first deadline is a period from now.
+   * @param period The time between deadlines. Must be positive.
+   * @param callback The function to run at each deadline.
+   * @return The timer, which runs until cancelled or destroyed.
+   */
+  std::shared_ptr<Timer> createTimer(Clock::duration period, std::function<void()> callback);
+
+  /**
+   * Create a timer running a callback once, a delay from now.
+   * @param delay The time to the run. Must be positive.
+   * @param callback The function to run.
+   * @return The timer, which runs unless cancelled or destroyed first.
+   */
+  std::shared_ptr<Timer> createOneShotTimer(Clock::duration delay, std::function<void()> callback);
+
+  /**
+   * Stop the scheduling thread so that no more callbacks are handed to the executor. Safe to call repeatedly.
+   */
+  void shutdown();
+
+ private:
+  /**
+   * Expire deadlines and hand their callbacks to the executor until shut down. Run by the scheduling thread.
+   */
+  void scheduleUntilShutdown();
+
+  /**
+   * Add a timer to the wheel and wake the scheduling thread.
+   */
+  std::shared_ptr<Timer> addTimer(Clock::duration period, std::function<void()> callback, bool one_shot);
+
+  /**
+   * Run a timer whose deadline has expired and find its next deadline.
+   */
+  void fire(std::shared_ptr<Timer> const &timer, Clock::time_point now);
+
+  ThreadPool &executor_;
+
+  /**
+   * Deadlines of the timers, by timer identifier. Guarded by timers_mutex_.
+   */
+  TimerWheel timer_wheel_;
+
+  /**
+   * Timers by identifier, weak so that destroying a timer cancels it. Guarded by timers_mutex_.
+   */
+  std::unordered_map<std::uint64_t, std::weak_ptr<Timer>> timers_;
+  std::uint64_t next_timer_id_ = 0;
+  std::mutex timers_mutex_;
+
+  /**
+   * Condition variable signaled when a timer is created or the scheduler is shut down. Used with timers_mutex_.
+   */
+  std::condition_variable timers_condition_variable_;
+  bool shutdown_ = false;
+
+  std::thread scheduling_thread_;
+};
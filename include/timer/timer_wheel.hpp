@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Hierarchical timer wheel holding the deadlines of many timers at once. Scheduling and expiring a deadline take
+ * constant time however many deadlines are held, where a sorted queue would take logarithmic time.
+ *
+ * Time is counted in ticks of a fixed resolution from the wheel's start. The lowest level has a slot for each of the
+ * next kSlotCounts_[0] ticks, and each level above has slots as wide as the whole level below it. Deadlines are placed
+ * on the lowest level that spans them and cascade down a level each time the level below wraps, until they expire from
+ * the lowest level. Deadlines are rounded up to whole ticks, so they never expire early.
+ */
+class TimerWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Start an empty wheel.
+   * @param resolution The length of a tick. Deadlines expire up to one tick late.
+   * @param start The time of tick zero.
+   */
+  explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1),
+                      Clock::time_point start = Clock::now());
+
+  /**
+   * Add a deadline. Deadlines that have already passed expire on the next call to advance().
+   * @param id The identifier advance() returns when the deadline expires. Need not be unique.
+   * @param deadline The time to expire at.
+   */
+  void schedule(std::uint64_t id, Clock::time_point deadline);
+
+  /**
+   * Move the wheel on to a time, expiring the deadlines that have passed.
+   * @param now The current time.
+   * @param expired_ids Appended with the identifiers of the expired deadlines.
+   */
+  void advance(Clock::time_point now, std::vector<std::uint64_t> &expired_ids);
+
+  /**
+   * Get the time by which advance() must next be called, which is the next deadline on the lowest level or the next
+   * cascade of a level above holding deadlines, whichever is sooner. Never later than the next deadline.
+   * @return The time, or Clock::time_point::max() if the wheel is empty.
+   */
+  Clock::time_point nextWakeUp() const;
+
+  /**
+   * Get the number of deadlines held.
+   */
+  std::size_t size() const;
+
+ private:
+  /**
+   * A deadline held in a slot.
+   */
+  struct Entry {
+    std::uint64_t id;
+    std::uint64_t deadline_tick;
+  };
+
+  /**
+   * Place a deadline in the slot of the lowest level that spans it from the current tick.
+   */
+  void place(Entry const &entry);
+
+  /**
+   * Number of slots on each level. The levels span 256 ticks, then 16384, then about a million, then about 67 million,
+   * which at a millisecond resolution is over 18 hours. Later deadlines wait on the top level and are placed again as
+   * it turns.
+   */
+  static constexpr std::array<std::uint64_t, 4> kSlotCounts_ = {256, 64, 64, 64};
+
+  /**
+   * Width of a slot on each level, in ticks.
+   */
+  std::array<std::uint64_t, 4> slot_ticks_;
+
+  /**
+   * Slots of each level, indexed by level then slot.
+   */
+  std::array<std::vector<std::vector<Entry>>, 4> levels_;
+
+  /**
+   * Number of deadlines on each level, so that advance() can jump over ticks on which nothing expires or cascades.
+   */
+  std::array<std::size_t, 4> level_sizes_{};
+
+  Clock::duration resolution_;
+  Clock::time_point start_;
+
+  /**
+   * Identifiers of deadlines scheduled at or before the current tick, which expire on the next call to advance().
+   */
+  std::vector<std::uint64_t> overdue_ids_;
+
+  /**
+   * Last tick advanced to. Deadlines at or before it have expired.
+   */
+  std::uint64_t current_tick_ = 0;
+
+  /**
+   * Number of deadlines held, in slots or overdue.
+   */
+  std::size_t size_ = 0;
+};
@@ -0,0 +1,203 @@
+#include "bag/bag_compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+/**
+ * The compressed bytes are a series of sequences, each a token byte, literal bytes copied as is, then a back reference
+ * copying earlier output. The token holds the literal length in its high nibble and the match length less kMinMatch in
+ * its low nibble, with 15 meaning the length continues in following bytes, summed until one is less than 255. The back
+ * reference is a little endian uint16 distance back into the output. The last sequence only has literals, which is
+ * how the decompressor knows the input ended.
+ */
+static constexpr std::size_t kMinMatch = 4;
+static constexpr std::size_t kMaxOffset = 65535;
+static constexpr unsigned kHashBits = 14;
+
+/**
+ * Number of failed match attempts after which the compressor starts skipping ahead faster, so that incompressible
+ * data, such as already compressed images, costs little time.
+ */
+static constexpr unsigned kSkipTrigger = 6;
+
+static std::uint32_t load32(std::uint8_t const *bytes) {
+  std::uint32_t value = 0;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static std::uint64_t load64(std::uint8_t const *bytes) {
+  std::uint64_t value = 0;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+/**
+ * Copy at least size bytes in steps of kWildCopySize, which may write up to kWildCopySize - 1 bytes past the end.
+ * Constant size copies compile to single loads and stores, which is much faster than memcpy for short lengths.
+ * Correct for overlapping ranges as long as the source is at least kWildCopySize bytes behind the destination.
+ */
+static constexpr std::size_t kWildCopySize = 16;
+
+static void wildCopy(std::uint8_t *destination, std::uint8_t const *source, std::size_t size) {
+  std::uint8_t *end = destination + size;
+  do {
+    std::memcpy(destination, source, kWildCopySize);
+    destination += kWildCopySize;
+    source += kWildCopySize;
+  } while (destination < end);
+}
+
+static std::uint32_t hashPosition(std::uint8_t const *bytes) {
+  return (load32(bytes) * 2654435761U) >> (32 - kHashBits);
+}
+
+/**
+ * Write the part of a length that does not fit in its token nibble.
+ */
+static std::uint8_t *writeLength(std::uint8_t *output, std::size_t length) {
+  length -= 15;
+  while (length >= 255) {
+    *output++ = 255;
+    length -= 255;
+  }
+  *output++ = static_cast<std::uint8_t>(length);
+  return output;
+}
+
+/**
+ * Write a sequence of literals, followed by a back reference unless match_length is zero.
+ */
+static std::uint8_t *writeSequence(std::uint8_t *output, std::uint8_t const *literals, std::size_t literal_length,
+                                   std::size_t offset, std::size_t match_length) {
+  std::uint8_t *token = output++;
+  *token = static_cast<std::uint8_t>(std::min<std::size_t>(literal_length, 15) << 4);
+  if (literal_length >= 15) output = writeLength(output, literal_length);
+  std::memcpy(output, literals, literal_length);
+  output += literal_length;
+  if (match_length == 0) return output;
+
+  *output++ = static_cast<std::uint8_t>(offset);
+  *output++ = static_cast<std::uint8_t>(offset >> 8);
+  std::size_t length_code = match_length - kMinMatch;
+  *token |= static_cast<std::uint8_t>(std::min<std::size_t>(length_code, 15));
+  if (length_code >= 15) output = writeLength(output, length_code);
+  return output;
+}
+
+std::size_t lzCompressBound(std::size_t size) { return size + size / 255 + 16; }
+
+std::size_t lzCompress(std::span<std::uint8_t const> input, std::span<std::uint8_t> output) {
+  std::uint8_t const *begin = input.data();
+  std::size_t size = input.size();
+  std::uint8_t *out = output.data();
+
+  // Most recent position of each hash of kMinMatch bytes. Stale or colliding positions are caught by comparing bytes.
+  std::array<std::uint32_t, 1 << kHashBits> table{};
+  std::size_t anchor = 0;
+  std::size_t position = 0;
+  unsigned misses = 0;
+  while (size >= kMinMatch && position <= size - kMinMatch) {
+    std::uint32_t &entry = table[hashPosition(begin + position)];
+    std::size_t candidate = entry;
+    entry = static_cast<std::uint32_t>(position);
+    if (candidate >= position || position - candidate > kMaxOffset ||
+        load32(begin + candidate) != load32(begin + position)) {
+      position += 1 + (misses++ >> kSkipTrigger);
+      continue;
+    }
+
+    // Extend the match eight bytes at a time, then byte by byte near the end.
+    std::size_t length = kMinMatch;
+    while (position + length + sizeof(std::uint64_t) <= size) {
+      std::uint64_t difference = load64(begin + candidate + length) ^ load64(begin + position + length);
+      if (difference != 0) {
+        length += std::countr_zero(difference) / 8;
+        break;
+      }
+      length += sizeof(std::uint64_t);
+    }
+    if (position + length + sizeof(std::uint64_t) > size) {
+      while (position + length < size && begin[candidate + length] == begin[position + length]) ++length;
+    }
+
+    out = writeSequence(out, begin + anchor, position - anchor, position - candidate, length);
+    position += length;
+    anchor = position;
+    misses = 0;
+
+    // Remember a position inside the match too, which finds the next match sooner in repetitive data.
+    if (position - 2 <= size - kMinMatch) {
+      table[hashPosition(begin + position - 2)] = static_cast<std::uint32_t>(position - 2);
+    }
+  }
+  out = writeSequence(out, begin + anchor, size - anchor, 0, 0);
+  return static_cast<std::size_t>(out - output.data());
+}
+
+/**
+ * Read the part of a length that does not fit in its token nibble.
+ */
+static std::size_t readLength(std::uint8_t const *&input, std::uint8_t const *input_end) {
+  std::size_t length = 0;
+  std::uint8_t byte = 255;
+  while (byte == 255) {
+    if (input == input_end) throw BagException("Compressed chunk ends inside a length");
+    byte = *input++;
+    length += byte;
+  }
+  return length;
+}
+
+void lzDecompress(std::span<std::uint8_t const> input, std::span<std::uint8_t> output) {
+  std::uint8_t const *in = input.data();
+  std::uint8_t const *in_end = in + input.size();
+  std::uint8_t *out = output.data();
+  std::uint8_t *out_end = out + output.size();
+  while (true) {
+    if (in == in_end) throw BagException("Compressed chunk ends inside a sequence");
+    std::uint8_t token = *in++;
+
+    std::size_t literal_length = token >> 4;
+    if (literal_length == 15) literal_length += readLength(in, in_end);
+    if (literal_length > static_cast<std::size_t>(in_end - in) ||
+        literal_length > static_cast<std::size_t>(out_end - out)) {
+      throw BagException("Compressed chunk has literals past its end");
+    }
+    if (literal_length + kWildCopySize <= static_cast<std::size_t>(std::min(in_end - in, out_end - out))) {
+      wildCopy(out, in, literal_length);
+    } else {
+      std::memcpy(out, in, literal_length);
+    }
+    in += literal_length;
+    out += literal_length;
+    if (in == in_end) break;
+
+    if (in_end - in < 2) throw BagException("Compressed chunk ends inside a back reference");
+    std::size_t offset = in[0] | (static_cast<std::size_t>(in[1]) << 8);
+    in += 2;
+    if (offset == 0 || offset > static_cast<std::size_t>(out - output.data())) {
+      throw BagException("Compressed chunk refers back past its start");
+    }
+    std::size_t match_length = (token & 15) + kMinMatch;
+    if ((token & 15) == 15) match_length += readLength(in, in_end);
+    if (match_length > static_cast<std::size_t>(out_end - out)) {
+      throw BagException("Compressed chunk decompresses past its size");
+    }
+
+    // A match overlapping its own output repeats the bytes before it, so it is copied forward byte by byte unless it
+    // is far enough back for whole steps.
+    std::uint8_t const *match = out - offset;
+    if (offset >= kWildCopySize && match_length + kWildCopySize <= static_cast<std::size_t>(out_end - out)) {
+      wildCopy(out, match, match_length);
+    } else if (offset >= match_length) {
+      std::memcpy(out, match, match_length);
+    } else {
+      for (std::size_t i = 0; i < match_length; ++i) out[i] = match[i];
+    }
+    out += match_length;
+  }
+  if (out != out_end) throw BagException("Compressed chunk decompresses short of its size");
+}
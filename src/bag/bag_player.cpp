@@ -0,0 +1,69 @@
+#include "bag/bag_player.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+
+BagPlayer::BagPlayer(std::shared_ptr<Node> const &node, std::vector<std::string> const &paths,
+                     BagPlayerOptions options)
+    : options_(std::move(options)) {
+  for (auto const &path : paths) readers_.push_back(std::make_unique<BagReader>(path));
+
+  // Publish every topic to play that any of the bags holds.
+  std::unordered_set<std::string> topic_names(options_.topic_names.begin(), options_.topic_names.end());
+  for (auto const &reader : readers_) {
+    for (auto const &topic_name : reader->topics()) {
+      if (!topic_names.empty() && !topic_names.contains(topic_name)) continue;
+      if (!publishers_.contains(topic_name)) publishers_[topic_name] = node->createPublisher<RawMessage>(topic_name);
+    }
+  }
+}
+
+BagPlayerStatistics BagPlayer::play(std::function<bool()> const &keep_playing) {
+  BagPlayerStatistics statistics;
+  if (!waitUntil(std::chrono::steady_clock::now() + options_.publisher_delay, keep_playing)) return statistics;
+
+  std::vector<BagReader const *> readers;
+  for (auto const &reader : readers_) readers.push_back(reader.get());
+  BagMessageStream stream(readers, startTime() + options_.start_offset.count(), options_.topic_names,
+                          options_.decompression_thread_count);
+
+  // Schedule each message against the first one so that the wait for each message does not add up into drift.
+  auto play_start = std::chrono::steady_clock::now();
+  std::optional<std::int64_t> first_time_ns;
+  BagMessage message{};
+  while (keep_playing() && stream.next(message)) {
+    if (!first_time_ns) first_time_ns = message.receive_time_ns;
+    if (options_.rate > 0) {
+      auto bag_elapsed = std::chrono::nanoseconds(message.receive_time_ns - *first_time_ns);
+      auto deadline = play_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double, std::nano>(bag_elapsed.count() / options_.rate));
+      if (!waitUntil(deadline, keep_playing)) break;
+    }
+
+    // Replay the encoded message under a new header from this publisher.
+    if (message.frame.size() < TopicFrameHeader::kSize) continue;
+    publishers_.at(*message.topic_name)->publishEncoded(message.frame.subspan(TopicFrameHeader::kSize));
+    ++statistics.message_count;
+    statistics.frame_bytes += message.frame.size();
+  }
+  statistics.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - play_start).count();
+  return statistics;
+}
+
+std::int64_t BagPlayer::startTime() const {
+  std::int64_t start_time_ns = std::numeric_limits<std::int64_t>::max();
+  for (auto const &reader : readers_) {
+    if (!reader->chunks().empty()) start_time_ns = std::min(start_time_ns, reader->startTime());
+  }
+  return start_time_ns == std::numeric_limits<std::int64_t>::max() ? 0 : start_time_ns;
+}
+
+bool BagPlayer::waitUntil(std::chrono::steady_clock::time_point deadline, std::function<bool()> const &keep_playing) {
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (!keep_playing()) return false;
+    std::this_thread::sleep_until(std::min(deadline, std::chrono::steady_clock::now() + kStopCheckPeriod_));
+  }
+  return true;
+}
@@ -0,0 +1,351 @@
+#include "bag/bag_reader.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <unordered_set>
+
+BagReader::BagReader(std::string const &path) : path_(path) {
+  int file_descriptor = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file_descriptor < 0) throw BagException("open() failed on " + path_ + ": " + std::strerror(errno));
+  struct stat file_status {};
+  if (::fstat(file_descriptor, &file_status) < 0 || file_status.st_size < static_cast<off_t>(sizeof(BagFileHeader))) {
+    ::close(file_descriptor);
+    throw BagException(path_ + " is not a bag");
+  }
+  size_ = static_cast<std::size_t>(file_status.st_size);
+  void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, file_descriptor, 0);
+  ::close(file_descriptor);
+  if (data == MAP_FAILED) throw BagException("mmap() failed on " + path_ + ": " + std::strerror(errno));
+  data_ = static_cast<std::uint8_t const *>(data);
+
+  // Playback reads the file front to back, so let the kernel read ahead aggressively.
+  ::madvise(data, size_, MADV_SEQUENTIAL);
+
+  try {
+    BagFileHeader header{};
+    readBagStruct(bytesAt(0, sizeof(header)), header);
+    if (header.magic != kBagMagic) throw BagException(path_ + " is not a bag");
+    if (header.format_version != kBagFormatVersion) {
+      throw BagException(path_ + " has unsupported format version " + std::to_string(header.format_version));
+    }
+    if (header.index_offset != 0) {
+      readFileIndex(header.index_offset);
+    } else {
+      recoverIndex();
+    }
+  } catch (BagException const &e) {
+    ::munmap(const_cast<std::uint8_t *>(data_), size_);
+    throw;
+  }
+}
+
+BagReader::~BagReader() { ::munmap(const_cast<std::uint8_t *>(data_), size_); }
+
+std::string const &BagReader::path() const { return path_; }
+
+std::vector<std::string> const &BagReader::topics() const { return topics_; }
+
+std::vector<BagChunk> const &BagReader::chunks() const { return chunks_; }
+
+bool BagReader::indexed() const { return indexed_; }
+
+std::int64_t BagReader::startTime() const {
+  if (chunks_.empty()) return 0;
+  return std::min_element(chunks_.begin(), chunks_.end(), [](BagChunk const &a, BagChunk const &b) -> bool {
+           return a.start_time_ns < b.start_time_ns;
+         })->start_time_ns;
+}
+
+std::int64_t BagReader::endTime() const {
+  if (chunks_.empty()) return 0;
+  return std::max_element(chunks_.begin(), chunks_.end(), [](BagChunk const &a, BagChunk const &b) -> bool {
+           return a.end_time_ns < b.end_time_ns;
+         })->end_time_ns;
+}
+
+BagChunkHeader BagReader::chunkHeader(BagChunk const &chunk) const {
+  BagChunkHeader chunk_header{};
+  readBagStruct(bytesAt(chunk.offset, sizeof(chunk_header)), chunk_header);
+  if (chunk_header.magic != kBagChunkMagic) {
+    throw BagException("No chunk at offset " + std::to_string(chunk.offset) + " of " + path_);
+  }
+  return chunk_header;
+}
+
+std::span<std::uint8_t const> BagReader::chunkRecords(BagChunk const &chunk, std::vector<std::uint8_t> &buffer) const {
+  BagChunkHeader chunk_header = chunkHeader(chunk);
+  auto stored_records = bytesAt(chunk.offset + sizeof(BagChunkHeader), chunk_header.stored_size);
+  switch (static_cast<BagCompression>(chunk_header.compression)) {
+    case BagCompression::kNone:
+      return stored_records;
+    case BagCompression::kLZ:
+      // A sequence of the codec expands to at most about 255 times its size, which bounds a corrupt data_size.
+      if (chunk_header.data_size / 256 > chunk_header.stored_size) {
+        throw BagException("Bad decompressed size of the chunk at offset " + std::to_string(chunk.offset) + " of " +
+                           path_);
+      }
+      buffer.resize(chunk_header.data_size);
+      lzDecompress(stored_records, buffer);
+      return buffer;
+  }
+  throw BagException("Unsupported compression " + std::to_string(chunk_header.compression) + " in " + path_);
+}
+
+std::span<std::uint8_t const> BagReader::chunkIndex(BagChunk const &chunk) const {
+  BagChunkHeader chunk_header = chunkHeader(chunk);
+  return bytesAt(chunk.offset + sizeof(BagChunkHeader) + chunk_header.stored_size,
+                 chunk_header.index_entry_count * sizeof(BagIndexEntry));
+}
+
+void BagReader::readFileIndex(std::uint64_t index_offset) {
+  BagIndexHeader index_header{};
+  readBagStruct(bytesAt(index_offset, sizeof(index_header)), index_header);
+  if (index_header.magic != kBagIndexMagic) throw BagException("No file index in " + path_);
+
+  std::uint64_t offset = index_offset + sizeof(index_header);
+  topics_.resize(index_header.topic_count);
+  for (std::uint32_t topic = 0; topic < index_header.topic_count; ++topic) {
+    std::uint32_t topic_id = 0;
+    std::uint32_t name_size = 0;
+    readBagStruct(bytesAt(offset, sizeof(topic_id)), topic_id);
+    readBagStruct(bytesAt(offset + sizeof(topic_id), sizeof(name_size)), name_size);
+    auto name = bytesAt(offset + sizeof(topic_id) + sizeof(name_size), name_size);
+    if (topic_id >= topics_.size()) throw BagException("Bad topic ID in the file index of " + path_);
+    topics_[topic_id].assign(name.begin(), name.end());
+    offset += sizeof(topic_id) + sizeof(name_size) + name_size;
+  }
+
+  chunks_.reserve(index_header.chunk_count);
+  for (std::uint64_t chunk = 0; chunk < index_header.chunk_count; ++chunk) {
+    BagChunkInfo chunk_info{};
+    readBagStruct(bytesAt(offset, sizeof(chunk_info)), chunk_info);
+    auto chunk_topics = bytesAt(offset + sizeof(chunk_info), chunk_info.topic_count * sizeof(BagChunkTopic));
+    BagChunk &bag_chunk = chunks_.emplace_back(BagChunk{chunk_info.offset, chunk_info.start_time_ns,
+                                                        chunk_info.end_time_ns, chunk_info.record_count, {}});
+    bag_chunk.topics.resize(chunk_info.topic_count);
+    std::memcpy(bag_chunk.topics.data(), chunk_topics.data(), chunk_topics.size());
+    offset += sizeof(chunk_info) + chunk_topics.size();
+  }
+  indexed_ = true;
+}
+
+void BagReader::recoverIndex() {
+  std::uint64_t offset = sizeof(BagFileHeader);
+  std::vector<std::uint8_t> buffer;
+  while (offset + sizeof(BagChunkHeader) <= size_) {
+    BagChunkHeader chunk_header{};
+    readBagStruct(bytesAt(offset, sizeof(chunk_header)), chunk_header);
+    std::uint64_t chunk_size =
+        sizeof(chunk_header) + chunk_header.stored_size + chunk_header.index_entry_count * sizeof(BagIndexEntry);
+    if (chunk_header.magic != kBagChunkMagic || offset + chunk_size > size_) break;
+    BagChunk chunk{offset, chunk_header.start_time_ns, chunk_header.end_time_ns, chunk_header.index_entry_count, {}};
+
+    // Count the topics of the chunk from its index, and learn the names of new topics from its records.
+    std::map<std::uint32_t, std::uint32_t> topic_counts;
+    auto index = chunkIndex(chunk);
+    for (std::size_t entry_offset = 0; entry_offset < index.size(); entry_offset += sizeof(BagIndexEntry)) {
+      BagIndexEntry entry{};
+      readBagStruct(index.subspan(entry_offset), entry);
+      ++topic_counts[entry.topic_id];
+    }
+    for (auto const &[topic_id, count] : topic_counts) chunk.topics.push_back({topic_id, count});
+    auto records = chunkRecords(chunk, buffer);
+    for (std::size_t record_offset = 0; record_offset + sizeof(BagRecordHeader) <= records.size();) {
+      BagRecordHeader record_header{};
+      readBagStruct(records.subspan(record_offset), record_header);
+      auto frame = records.subspan(record_offset + sizeof(BagRecordHeader),
+                                   std::min<std::size_t>(record_header.size,
+                                                         records.size() - record_offset - sizeof(BagRecordHeader)));
+      std::uint32_t topic_id = 0;
+      if (record_header.topic_id == kTopicDefinitionID && readBagStruct(frame, topic_id)) {
+        if (topic_id >= topics_.size()) topics_.resize(topic_id + 1);
+        topics_[topic_id].assign(frame.begin() + sizeof(topic_id), frame.end());
+      }
+      record_offset += sizeof(BagRecordHeader) + record_header.size;
+    }
+    chunks_.push_back(std::move(chunk));
+    offset += chunk_size;
+  }
+}
+
+std::span<std::uint8_t const> BagReader::bytesAt(std::uint64_t offset, std::uint64_t size) const {
+  if (offset > size_ || size > size_ - offset) {
+    throw BagException(path_ + " is truncated at offset " + std::to_string(offset));
+  }
+  return {data_ + offset, size};
+}
+
+BagMessageStream::BagMessageStream(std::vector<BagReader const *> readers, std::int64_t start_time_ns,
+                                   std::vector<std::string> const &topic_names, std::size_t decompression_thread_count)
+    : readers_(std::move(readers)), start_time_ns_(start_time_ns), streamed_topics_(readers_.size()) {
+  if (decompression_thread_count > 0) {
+    // Two chunks in flight per thread keeps every thread busy while the stream takes one.
+    prefetch_chunk_count_ = 2 * decompression_thread_count;
+    decompression_pool_ = std::make_unique<ThreadPool>(decompression_thread_count);
+  }
+  std::unordered_set<std::string> topic_name_set(topic_names.begin(), topic_names.end());
+  for (std::size_t reader_index = 0; reader_index < readers_.size(); ++reader_index) {
+    BagReader const &reader = *readers_[reader_index];
+    if (!topic_name_set.empty()) {
+      for (auto const &topic_name : reader.topics()) {
+        streamed_topics_[reader_index].push_back(topic_name_set.contains(topic_name));
+      }
+    }
+
+    // Skip the chunks that end before the start time or hold none of the topics.
+    for (auto const &chunk : reader.chunks()) {
+      if (chunk.end_time_ns < start_time_ns_) continue;
+      if (!topic_name_set.empty() &&
+          std::none_of(chunk.topics.begin(), chunk.topics.end(), [&](BagChunkTopic const &chunk_topic) -> bool {
+            return chunk_topic.topic_id < streamed_topics_[reader_index].size() &&
+                   streamed_topics_[reader_index][chunk_topic.topic_id];
+          })) {
+        continue;
+      }
+      chunks_.emplace_back(reader_index, &chunk);
+    }
+  }
+  std::stable_sort(chunks_.begin(), chunks_.end(), [](auto const &a, auto const &b) -> bool {
+    return a.second->start_time_ns < b.second->start_time_ns;
+  });
+}
+
+bool BagMessageStream::next(BagMessage &message) {
+  // Advance past the message last returned.
+  if (current_cursor_) {
+    ++current_cursor_->position;
+    if (seekEntry(*current_cursor_)) {
+      cursors_.push_back(std::move(current_cursor_));
+      std::push_heap(cursors_.begin(), cursors_.end(), LaterCursor());
+    } else {
+      recycleBuffer(std::move(current_cursor_->buffer));
+    }
+    current_cursor_.reset();
+  }
+
+  // Open every chunk starting no later than the earliest message of the open chunks, since it may hold an earlier one.
+  while (next_chunk_ < chunks_.size() &&
+         (cursors_.empty() || chunks_[next_chunk_].second->start_time_ns <= cursors_.front()->entry.receive_time_ns)) {
+    openNextChunk();
+  }
+  if (cursors_.empty()) return false;
+
+  std::pop_heap(cursors_.begin(), cursors_.end(), LaterCursor());
+  current_cursor_ = std::move(cursors_.back());
+  cursors_.pop_back();
+
+  // Check the index entry against the records before taking a span at its offset.
+  ChunkCursor const &cursor = *current_cursor_;
+  BagRecordHeader record_header{};
+  if (cursor.entry.offset > cursor.records.size() ||
+      cursor.records.size() - cursor.entry.offset < sizeof(BagRecordHeader)) {
+    throw BagException("Index points past the records of a chunk in " + readers_[cursor.reader_index]->path());
+  }
+  auto record = cursor.records.subspan(cursor.entry.offset);
+  if (!readBagStruct(record, record_header) || record.size() - sizeof(BagRecordHeader) < record_header.size) {
+    throw BagException("Index points past the records of a chunk in " + readers_[cursor.reader_index]->path());
+  }
+  message.topic_name = &readers_[cursor.reader_index]->topics().at(cursor.entry.topic_id);
+  message.receive_time_ns = cursor.entry.receive_time_ns;
+  message.frame = record.subspan(sizeof(BagRecordHeader), record_header.size);
+  return true;
+}
+
+bool BagMessageStream::LaterCursor::operator()(std::unique_ptr<ChunkCursor> const &a,
+                                               std::unique_ptr<ChunkCursor> const &b) const {
+  if (a->entry.receive_time_ns != b->entry.receive_time_ns) {
+    return a->entry.receive_time_ns > b->entry.receive_time_ns;
+  }
+  return a->order > b->order;
+}
+
+void BagMessageStream::openNextChunk() {
+  auto [reader_index, chunk] = chunks_[next_chunk_];
+  auto cursor = std::make_unique<ChunkCursor>();
+  cursor->reader_index = reader_index;
+  if (decompression_pool_) {
+    prefetchChunks();
+    auto [decoded_chunk, decoded] = std::move(decoded_chunks_.front());
+    decoded_chunks_.pop_front();
+    ++next_chunk_;
+    prefetchChunks();
+    decoded.get();
+    cursor->buffer = std::move(decoded_chunk->buffer);
+    cursor->records = decoded_chunk->records;
+  } else {
+    ++next_chunk_;
+    cursor->buffer = takeBuffer();
+    cursor->records = readers_[reader_index]->chunkRecords(*chunk, cursor->buffer);
+  }
+  cursor->index = readers_[reader_index]->chunkIndex(*chunk);
+  cursor->order = opened_chunk_count_++;
+
+  // Binary search the index for the first entry at or after the start time.
+  std::uint32_t low = 0;
+  auto high = static_cast<std::uint32_t>(cursor->index.size() / sizeof(BagIndexEntry));
+  while (low < high) {
+    std::uint32_t middle = low + (high - low) / 2;
+    BagIndexEntry entry{};
+    readBagStruct(cursor->index.subspan(middle * sizeof(BagIndexEntry)), entry);
+    if (entry.receive_time_ns < start_time_ns_) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  cursor->position = low;
+  if (!seekEntry(*cursor)) {
+    recycleBuffer(std::move(cursor->buffer));
+    return;
+  }
+  cursors_.push_back(std::move(cursor));
+  std::push_heap(cursors_.begin(), cursors_.end(), LaterCursor());
+}
+
+bool BagMessageStream::seekEntry(ChunkCursor &cursor) {
+  auto const &streamed_topics = streamed_topics_[cursor.reader_index];
+  for (; cursor.position < cursor.index.size() / sizeof(BagIndexEntry); ++cursor.position) {
+    readBagStruct(cursor.index.subspan(cursor.position * sizeof(BagIndexEntry)), cursor.entry);
+    if (streamed_topics.empty()) return true;
+    if (cursor.entry.topic_id < streamed_topics.size() && streamed_topics[cursor.entry.topic_id]) return true;
+  }
+  return false;
+}
+
+void BagMessageStream::prefetchChunks() {
+  while (decoded_chunks_.size() < prefetch_chunk_count_ && next_chunk_ + decoded_chunks_.size() < chunks_.size()) {
+    auto [reader_index, chunk] = chunks_[next_chunk_ + decoded_chunks_.size()];
+    auto decoded_chunk = std::make_shared<DecodedChunk>();
+    decoded_chunk->buffer = takeBuffer();
+    decoded_chunks_.emplace_back(decoded_chunk, decoded_chunk->decoded.get_future());
+    decompression_pool_->submit([decoded_chunk, reader = readers_[reader_index], chunk]() -> void {
+      try {
+        decoded_chunk->records = reader->chunkRecords(*chunk, decoded_chunk->buffer);
+        decoded_chunk->decoded.set_value();
+      } catch (...) {
+        decoded_chunk->decoded.set_exception(std::current_exception());
+      }
+    });
+  }
+}
+
+std::vector<std::uint8_t> BagMessageStream::takeBuffer() {
+  if (free_buffers_.empty()) return {};
+  std::vector<std::uint8_t> buffer = std::move(free_buffers_.back());
+  free_buffers_.pop_back();
+  return buffer;
+}
+
+void BagMessageStream::recycleBuffer(std::vector<std::uint8_t> &&buffer) {
+  // Keep no more buffers than can be in use at once. Chunks that were not compressed never fill theirs.
+  if (buffer.capacity() > 0 && free_buffers_.size() < prefetch_chunk_count_ + 1) {
+    free_buffers_.push_back(std::move(buffer));
+  }
+}
@@ -0,0 +1,22 @@
+#include "bag/bag_recorder.hpp"
+
+BagRecorder::BagRecorder(std::shared_ptr<Node> const &node, std::shared_ptr<BagWriter> writer,
+                         std::vector<std::string> const &topic_names, std::uint32_t queue_size)
+    : writer_(std::move(writer)) {
+  for (auto const &topic_name : topic_names) {
+    subscribers_.push_back(node->createSubscriber<RawMessage>(
+        topic_name, queue_size,
+        [this, topic_name](RawMessage const &message) -> void { record(topic_name, message); }));
+  }
+}
+
+std::uint64_t BagRecorder::failedWriteCount() const { return failed_write_count_; }
+
+void BagRecorder::record(std::string const &topic_name, RawMessage const &message) {
+  auto encoded_header = message.header.encode();
+  try {
+    writer_->write(topic_name, TopicFrameHeader::now(), {encoded_header, message.payload});
+  } catch (BagException const &e) {
+    ++failed_write_count_;
+  }
+}
@@ -0,0 +1,296 @@
+#include "bag/bag_writer.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+BagWriter::BagWriter(std::string const &path, BagWriterOptions options) : path_(path), options_(options) {
+  file_descriptor_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (file_descriptor_ < 0) throwErrno("open()");
+
+  // The header is rewritten with the index offset when the bag is closed.
+  BagFileHeader header{kBagMagic, kBagFormatVersion, 0, 0, 0};
+  try {
+    writeBytes(bagBytes(header));
+  } catch (BagException const &e) {
+    ::close(file_descriptor_);
+    throw;
+  }
+
+  writing_thread_ = std::thread([this]() -> void { writeChunksUntilClosed(); });
+}
+
+BagWriter::~BagWriter() {
+  try {
+    close();
+  } catch (BagException const &e) {
+  }
+}
+
+void BagWriter::write(std::string const &topic_name, std::int64_t receive_time_ns,
+                      std::initializer_list<std::span<std::uint8_t const>> frame_parts) {
+  std::unique_lock<std::mutex> unique_chunk_lock(chunk_lock_);
+  if (closing_) throw BagException("write() on closed bag " + path_);
+  if (!error_.empty()) throw BagException(error_);
+
+  // Define the topic in the file the first time it is recorded.
+  auto topic_iter = topic_ids_.find(topic_name);
+  if (topic_iter == topic_ids_.end()) {
+    auto topic_id = static_cast<std::uint32_t>(topic_names_.size());
+    topic_iter = topic_ids_.emplace(topic_name, topic_id).first;
+    topic_names_.push_back(topic_name);
+    std::span<std::uint8_t const> name(reinterpret_cast<std::uint8_t const *>(topic_name.data()), topic_name.size());
+    appendRecord(receive_time_ns, kTopicDefinitionID, {bagBytes(topic_id), name});
+  }
+  std::uint32_t topic_id = topic_iter->second;
+
+  // Index the message by the offset of its record header within the chunk.
+  auto offset = static_cast<std::uint32_t>(current_chunk_.records.size());
+  current_chunk_.index.push_back({receive_time_ns, topic_id, offset});
+  appendRecord(receive_time_ns, topic_id, frame_parts);
+  ++current_chunk_.topic_counts[topic_id];
+  if (current_chunk_.index.size() == 1) {
+    current_chunk_.start_time_ns = receive_time_ns;
+    current_chunk_.end_time_ns = receive_time_ns;
+  }
+  current_chunk_.start_time_ns = std::min(current_chunk_.start_time_ns, receive_time_ns);
+  current_chunk_.end_time_ns = std::max(current_chunk_.end_time_ns, receive_time_ns);
+  ++statistics_.message_count;
+  statistics_.frame_bytes += current_chunk_.records.size() - offset - sizeof(BagRecordHeader);
+
+  if (current_chunk_.records.size() < options_.chunk_size) return;
+  sealChunk();
+
+  // Wait for the writing thread if it has fallen too far behind, so that memory use stays bounded.
+  if (pending_chunks_.size() > options_.max_pending_chunks) {
+    ++statistics_.blocked_write_count;
+    chunk_written_condition_variable_.wait(unique_chunk_lock, [this]() -> bool {
+      return pending_chunks_.size() <= options_.max_pending_chunks || !error_.empty();
+    });
+  }
+}
+
+void BagWriter::close() {
+  std::unique_lock<std::mutex> unique_chunk_lock(chunk_lock_);
+  if (closing_) return;
+  closing_ = true;
+  if (current_chunk_.record_count > 0) sealChunk();
+  chunk_sealed_condition_variable_.notify_one();
+  unique_chunk_lock.unlock();
+  writing_thread_.join();
+
+  // Write the file index after the last chunk and point the header at it.
+  unique_chunk_lock.lock();
+  std::string error = error_;
+  try {
+    if (error.empty()) {
+      std::uint64_t index_offset = write_offset_;
+      BagIndexHeader index_header{kBagIndexMagic, static_cast<std::uint32_t>(topic_names_.size()),
+                                  chunk_infos_.size()};
+      writeBytes(bagBytes(index_header));
+      for (std::uint32_t topic_id = 0; topic_id < topic_names_.size(); ++topic_id) {
+        auto name_size = static_cast<std::uint32_t>(topic_names_[topic_id].size());
+        writeBytes(bagBytes(topic_id));
+        writeBytes(bagBytes(name_size));
+        writeBytes({reinterpret_cast<std::uint8_t const *>(topic_names_[topic_id].data()), name_size});
+      }
+      for (auto const &[chunk_info, chunk_topics] : chunk_infos_) {
+        writeBytes(bagBytes(chunk_info));
+        writeBytes({reinterpret_cast<std::uint8_t const *>(chunk_topics.data()),
+                    chunk_topics.size() * sizeof(BagChunkTopic)});
+      }
+      unmapWindow();
+
+      BagFileHeader header{kBagMagic, kBagFormatVersion, 0, index_offset, chunk_infos_.size()};
+      if (::pwrite(file_descriptor_, &header, sizeof(header), 0) != sizeof(header)) throwErrno("pwrite()");
+      if (::ftruncate(file_descriptor_, static_cast<off_t>(write_offset_)) < 0) throwErrno("ftruncate()");
+      if (options_.sync_policy != BagSyncPolicy::kNone && ::fsync(file_descriptor_) < 0) throwErrno("fsync()");
+    }
+  } catch (BagException const &e) {
+    error = e.what();
+  }
+  if (window_) ::munmap(window_, kWindowSize_);
+  window_ = nullptr;
+  ::close(file_descriptor_);
+  file_descriptor_ = -1;
+  if (!error.empty()) throw BagException(error);
+}
+
+BagWriterStatistics BagWriter::statistics() {
+  std::lock_guard<std::mutex> chunk_lock_guard(chunk_lock_);
+  return statistics_;
+}
+
+void BagWriter::appendRecord(std::int64_t receive_time_ns, std::uint32_t topic_id,
+                             std::initializer_list<std::span<std::uint8_t const>> parts) {
+  // Wake the writing thread on the first record so that it starts timing the chunk's age.
+  if (current_chunk_.record_count++ == 0) {
+    current_chunk_.created_time = std::chrono::steady_clock::now();
+    chunk_sealed_condition_variable_.notify_one();
+  }
+  std::size_t size = 0;
+  for (auto const &part : parts) size += part.size();
+  BagRecordHeader record_header{receive_time_ns, topic_id, static_cast<std::uint32_t>(size)};
+  auto header_bytes = bagBytes(record_header);
+  current_chunk_.records.insert(current_chunk_.records.end(), header_bytes.begin(), header_bytes.end());
+  for (auto const &part : parts) current_chunk_.records.insert(current_chunk_.records.end(), part.begin(), part.end());
+}
+
+void BagWriter::sealChunk() {
+  pending_chunks_.push_back(std::move(current_chunk_));
+  if (free_chunks_.empty()) {
+    current_chunk_ = Chunk{};
+    current_chunk_.records.reserve(options_.chunk_size + options_.chunk_size / 8);
+  } else {
+    current_chunk_ = std::move(free_chunks_.back());
+    free_chunks_.pop_back();
+  }
+  chunk_sealed_condition_variable_.notify_one();
+}
+
+void BagWriter::writeChunksUntilClosed() {
+  std::unique_lock<std::mutex> unique_chunk_lock(chunk_lock_);
+  while (true) {
+    // Wait for a sealed chunk, sealing the current chunk instead once it is too old.
+    auto ready = [this]() -> bool { return !pending_chunks_.empty() || closing_; };
+    if (current_chunk_.record_count == 0) {
+      chunk_sealed_condition_variable_.wait(
+          unique_chunk_lock, [this, &ready]() -> bool { return ready() || current_chunk_.record_count > 0; });
+    } else {
+      auto seal_time = current_chunk_.created_time + options_.max_chunk_age;
+      if (!chunk_sealed_condition_variable_.wait_until(unique_chunk_lock, seal_time, ready)) sealChunk();
+    }
+    if (pending_chunks_.empty()) {
+      if (closing_) return;
+      continue;
+    }
+
+    // Write the chunk without holding the lock so that recording continues meanwhile. Once the writing thread has
+    // failed, chunks are only discarded so that write() never waits on it.
+    Chunk chunk = std::move(pending_chunks_.front());
+    pending_chunks_.pop_front();
+    bool failed = !error_.empty();
+    unique_chunk_lock.unlock();
+    std::string error;
+    std::uint64_t stored_size = 0;
+    if (!failed) {
+      try {
+        stored_size = writeChunk(chunk);
+      } catch (BagException const &e) {
+        error = e.what();
+      }
+    }
+    unique_chunk_lock.lock();
+    if (!error.empty()) error_ = error;
+    if (!failed && error.empty()) {
+      ++statistics_.chunk_count;
+      statistics_.record_bytes += chunk.records.size();
+      statistics_.stored_record_bytes += stored_size;
+    }
+
+    // Keep the chunk's buffers for a later chunk.
+    chunk.records.clear();
+    chunk.index.clear();
+    chunk.topic_counts.clear();
+    chunk.record_count = 0;
+    free_chunks_.push_back(std::move(chunk));
+    chunk_written_condition_variable_.notify_all();
+  }
+}
+
+std::uint64_t BagWriter::writeChunk(Chunk const &chunk) {
+  // Sort the index by time here rather than on the recording path. Records arrive almost in order.
+  std::vector<BagIndexEntry> index = chunk.index;
+  std::stable_sort(index.begin(), index.end(), [](BagIndexEntry const &a, BagIndexEntry const &b) -> bool {
+    return a.receive_time_ns < b.receive_time_ns;
+  });
+
+  // Compress on this thread so the recording path is unaffected. A chunk that barely gets smaller, such as one of
+  // already compressed images, is stored as is so that reading it costs nothing.
+  std::span<std::uint8_t const> stored_records = chunk.records;
+  auto compression = BagCompression::kNone;
+  if (options_.compression == BagCompression::kLZ && !chunk.records.empty()) {
+    compressed_records_.resize(lzCompressBound(chunk.records.size()));
+    std::size_t compressed_size = lzCompress(chunk.records, compressed_records_);
+    if (compressed_size < chunk.records.size() - chunk.records.size() / 16) {
+      stored_records = std::span<std::uint8_t const>(compressed_records_).first(compressed_size);
+      compression = BagCompression::kLZ;
+    }
+  }
+
+  BagChunkInfo chunk_info{write_offset_, chunk.start_time_ns, chunk.end_time_ns,
+                          static_cast<std::uint32_t>(index.size()),
+                          static_cast<std::uint32_t>(chunk.topic_counts.size())};
+  BagChunkHeader chunk_header{kBagChunkMagic,
+                              static_cast<std::uint32_t>(compression),
+                              stored_records.size(),
+                              chunk.records.size(),
+                              chunk.record_count,
+                              static_cast<std::uint32_t>(index.size()),
+                              chunk.start_time_ns,
+                              chunk.end_time_ns};
+  writeBytes(bagBytes(chunk_header));
+  writeBytes(stored_records);
+  writeBytes({reinterpret_cast<std::uint8_t const *>(index.data()), index.size() * sizeof(BagIndexEntry)});
+
+  std::vector<BagChunkTopic> chunk_topics;
+  for (auto const &[topic_id, count] : chunk.topic_counts) chunk_topics.push_back({topic_id, count});
+  chunk_infos_.emplace_back(chunk_info, std::move(chunk_topics));
+  if (options_.sync_policy == BagSyncPolicy::kEveryChunk) sync();
+  return stored_records.size();
+}
+
+void BagWriter::writeBytes(std::span<std::uint8_t const> bytes) {
+  while (!bytes.empty()) {
+    if (!window_ || write_offset_ >= window_offset_ + kWindowSize_) mapWindow(write_offset_);
+    std::size_t window_position = write_offset_ - window_offset_;
+    std::size_t size = std::min(bytes.size(), kWindowSize_ - window_position);
+    std::memcpy(window_ + window_position, bytes.data(), size);
+    write_offset_ += size;
+    bytes = bytes.subspan(size);
+  }
+}
+
+void BagWriter::mapWindow(std::uint64_t file_offset) {
+  unmapWindow();
+  std::uint64_t window_offset = file_offset - file_offset % kWindowSize_;
+
+  // Allocate the blocks up front so that a full disk fails here instead of raising SIGBUS on a write to the window.
+  if (window_offset + kWindowSize_ > file_capacity_) {
+    int error = ::posix_fallocate(file_descriptor_, static_cast<off_t>(file_capacity_),
+                                  static_cast<off_t>(window_offset + kWindowSize_ - file_capacity_));
+    if (error != 0) {
+      errno = error;
+      throwErrno("posix_fallocate()");
+    }
+    file_capacity_ = window_offset + kWindowSize_;
+  }
+  void *window = ::mmap(nullptr, kWindowSize_, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor_,
+                        static_cast<off_t>(window_offset));
+  if (window == MAP_FAILED) throwErrno("mmap()");
+  window_ = static_cast<std::uint8_t *>(window);
+  window_offset_ = window_offset;
+}
+
+void BagWriter::unmapWindow() {
+  if (!window_) return;
+  if (options_.sync_policy == BagSyncPolicy::kEveryChunk) ::msync(window_, kWindowSize_, MS_SYNC);
+  ::munmap(window_, kWindowSize_);
+  window_ = nullptr;
+
+  // Start writing the window back now, sequentially, rather than leaving it to pile up as dirty pages.
+  ::sync_file_range(file_descriptor_, static_cast<off_t>(window_offset_), kWindowSize_, SYNC_FILE_RANGE_WRITE);
+}
+
+void BagWriter::sync() {
+  if (window_ && ::msync(window_, kWindowSize_, MS_SYNC) < 0) throwErrno("msync()");
+  if (::fdatasync(file_descriptor_) < 0) throwErrno("fdatasync()");
+}
+
+void BagWriter::throwErrno(std::string const &what) {
+  throw BagException(what + " failed on " + path_ + ": " + std::strerror(errno));
+}
@@ -0,0 +1,44 @@
+#include "bridge/bridge.hpp"
+
+#include <algorithm>
+
+Bridge::Bridge(std::shared_ptr<Node> const &node, std::string const &bridge_name, std::shared_ptr<BsonSocket> socket,
+               BridgeOptions options, std::function<void()> closed_callback) {
+  // Both sides send first, so neither waits on the other.
+  Bson hello = json::to_bson(json(BridgeHello{bridge_name, options.topic_names}));
+  socket->sendFrame({hello});
+  remote_ = json::from_bson(socket->receiveFrame()).get<BridgeHello>();
+  for (auto const &topic_name : remote_.topic_names) {
+    if (std::find(options.topic_names.begin(), options.topic_names.end(), topic_name) != options.topic_names.end()) {
+      socket->close();
+      throw BridgeException("Topic " + topic_name + " is forwarded in both directions by " + bridge_name + " and " +
+                            remote_.bridge_name);
+    }
+  }
+
+  for (auto const &topic_name : remote_.topic_names) {
+    publishers_.push_back(node->createPublisher<RawMessage>(topic_name));
+  }
+  link_ = std::make_shared<BridgeLink>(std::move(socket), options.link);
+  link_->start(
+      [this](std::uint32_t topic_id, ByteSpan message) -> void {
+        if (topic_id < publishers_.size()) publishers_[topic_id]->publishEncoded(message);
+      },
+      std::move(closed_callback));
+
+  for (std::uint32_t topic_id = 0; topic_id < options.topic_names.size(); ++topic_id) {
+    subscribers_.push_back(node->createSubscriber<RawMessage>(
+        options.topic_names[topic_id], options.queue_size,
+        [link = link_, topic_id](RawMessage message) -> void { link->send(topic_id, std::move(message.payload)); }));
+  }
+}
+
+Bridge::~Bridge() { close(); }
+
+void Bridge::close() { link_->close(); }
+
+bool Bridge::connected() { return link_->connected(); }
+
+BridgeLinkStatistics Bridge::statistics() { return link_->statistics(); }
+
+BridgeHello const &Bridge::remote() const { return remote_; }
@@ -0,0 +1,155 @@
+#include "bridge/bridge_link.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+BridgeLink::BridgeLink(std::shared_ptr<BsonSocket> socket, BridgeLinkOptions options)
+    : socket_(std::move(socket)), options_(options) {}
+
+BridgeLink::~BridgeLink() { close(); }
+
+void BridgeLink::start(MessageCallback message_callback, std::function<void()> closed_callback) {
+  message_callback_ = std::move(message_callback);
+  closed_callback_ = std::move(closed_callback);
+  sending_thread_ = std::thread([this]() -> void { sendUntilClosed(); });
+  receiving_thread_ = std::thread([this]() -> void { receiveUntilClosed(); });
+}
+
+bool BridgeLink::send(std::uint32_t topic_id, std::vector<std::uint8_t> &&message) {
+  std::lock_guard<std::mutex> state_lock_guard(state_mutex_);
+  if (closed_) return false;
+  pending_bytes_ += sizeof(BridgeMessageHeader) + message.size();
+  pending_messages_.push_back({topic_id, std::move(message), Clock::now()});
+
+  // Drop the oldest messages rather than the newest, which matter more to a mirror of live topics.
+  while (pending_bytes_ > options_.max_pending_bytes && pending_messages_.size() > 1) {
+    pending_bytes_ -= sizeof(BridgeMessageHeader) + pending_messages_.front().message.size();
+    pending_messages_.pop_front();
+    ++statistics_.dropped_message_count;
+  }
+
+  // The sending thread only waits for the first message of a batch and for the batch to fill, so only wake it then
+  // rather than on every message.
+  if (pending_messages_.size() == 1 || pending_bytes_ >= options_.max_batch_bytes) {
+    state_condition_variable_.notify_one();
+  }
+  return true;
+}
+
+void BridgeLink::close() {
+  markClosed();
+  if (sending_thread_.joinable()) sending_thread_.join();
+  if (receiving_thread_.joinable()) receiving_thread_.join();
+  socket_->close();
+}
+
+bool BridgeLink::connected() {
+  std::lock_guard<std::mutex> state_lock_guard(state_mutex_);
+  return !closed_;
+}
+
+BridgeLinkStatistics BridgeLink::statistics() {
+  std::lock_guard<std::mutex> state_lock_guard(state_mutex_);
+  return statistics_;
+}
+
+void BridgeLink::sendUntilClosed() {
+  TokenBucket token_bucket(options_.max_rate_bytes_per_s, options_.burst_bytes);
+  std::vector<std::uint8_t> batch;
+  batch.reserve(options_.max_batch_bytes);
+  std::unique_lock<std::mutex> unique_state_lock(state_mutex_);
+  while (true) {
+    // Wait for a message, then for its batch to fill or for it to have waited long enough.
+    state_condition_variable_.wait(unique_state_lock,
+                                   [this]() -> bool { return closed_ || !pending_messages_.empty(); });
+    if (closed_) return;
+    state_condition_variable_.wait_until(
+        unique_state_lock, pending_messages_.front().queued_time + options_.max_batch_delay,
+        [this]() -> bool { return closed_ || pending_bytes_ >= options_.max_batch_bytes; });
+    if (closed_) return;
+
+    // Take messages up to a full batch. A message too large for a batch is sent alone, straight from its buffer.
+    batch.clear();
+    std::uint64_t message_count = 0;
+    PendingMessage large_message{};
+    BridgeMessageHeader large_message_header{};
+    bool send_alone =
+        sizeof(BridgeMessageHeader) + pending_messages_.front().message.size() > options_.max_batch_bytes;
+    if (send_alone) {
+      large_message = std::move(pending_messages_.front());
+      large_message_header = {large_message.topic_id, static_cast<std::uint32_t>(large_message.message.size())};
+      pending_messages_.pop_front();
+      pending_bytes_ -= sizeof(BridgeMessageHeader) + large_message.message.size();
+      message_count = 1;
+    } else {
+      while (!pending_messages_.empty() && batch.size() + sizeof(BridgeMessageHeader) +
+                                                   pending_messages_.front().message.size() <=
+                                               options_.max_batch_bytes) {
+        PendingMessage const &pending_message = pending_messages_.front();
+        appendBridgeMessage(batch, pending_message.topic_id, pending_message.message);
+        pending_bytes_ -= sizeof(BridgeMessageHeader) + pending_message.message.size();
+        pending_messages_.pop_front();
+        ++message_count;
+      }
+    }
+    std::size_t frame_size = send_alone ? sizeof(BridgeMessageHeader) + large_message.message.size() : batch.size();
+
+    // Hold the batch back while the rate limit is exceeded. Messages queued meanwhile make the next batch fuller.
+    auto delay = token_bucket.take(frame_size);
+    if (delay > Clock::duration::zero()) {
+      ++statistics_.throttled_batch_count;
+      if (state_condition_variable_.wait_for(unique_state_lock, delay, [this]() -> bool { return closed_; })) return;
+    }
+
+    unique_state_lock.unlock();
+    try {
+      if (send_alone) {
+        auto const *header_bytes = reinterpret_cast<std::uint8_t const *>(&large_message_header);
+        socket_->sendFrame({{header_bytes, sizeof(BridgeMessageHeader)}, large_message.message});
+      } else {
+        socket_->sendFrame({batch});
+      }
+    } catch (SocketException const &e) {
+      markClosed();
+      return;
+    }
+    unique_state_lock.lock();
+    statistics_.sent_message_count += message_count;
+    ++statistics_.sent_batch_count;
+    statistics_.sent_bytes += frame_size;
+  }
+}
+
+void BridgeLink::receiveUntilClosed() {
+  while (true) {
+    Bson frame;
+    try {
+      frame = socket_->receiveFrame();
+    } catch (SocketException const &e) {
+      break;
+    }
+    std::uint64_t message_count = 0;
+    bool well_formed = forEachBridgeMessage(frame, [this, &message_count](std::uint32_t topic_id,
+                                                                           ByteSpan message) -> void {
+      ++message_count;
+      message_callback_(topic_id, message);
+    });
+    std::lock_guard<std::mutex> state_lock_guard(state_mutex_);
+    statistics_.received_message_count += message_count;
+    ++statistics_.received_batch_count;
+    if (!well_formed) break;
+  }
+  markClosed();
+}
+
+void BridgeLink::markClosed() {
+  std::unique_lock<std::mutex> unique_state_lock(state_mutex_);
+  bool was_closed = closed_;
+  closed_ = true;
+  pending_messages_.clear();
+  pending_bytes_ = 0;
+  state_condition_variable_.notify_all();
+  unique_state_lock.unlock();
+  if (was_closed) return;
+  socket_->shutdown();
+  if (closed_callback_) closed_callback_();
+}
@@ -0,0 +1,23 @@
+#include "bridge/token_bucket.hpp"
+
+#include <algorithm>
+
+TokenBucket::TokenBucket(double rate_bytes_per_s, std::size_t burst_bytes, Clock::time_point start)
+    : rate_bytes_per_s_(rate_bytes_per_s),
+      burst_bytes_(static_cast<double>(burst_bytes)),
+      tokens_(static_cast<double>(burst_bytes)),
+      last_fill_(start) {}
+
+TokenBucket::Clock::duration TokenBucket::take(std::size_t size_bytes, Clock::time_point now) {
+  if (!limited()) return Clock::duration::zero();
+  if (now > last_fill_) {
+    double elapsed_s = std::chrono::duration<double>(now - last_fill_).count();
+    tokens_ = std::min(burst_bytes_, tokens_ + elapsed_s * rate_bytes_per_s_);
+    last_fill_ = now;
+  }
+  tokens_ -= static_cast<double>(size_bytes);
+  if (tokens_ >= 0) return Clock::duration::zero();
+  return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-tokens_ / rate_bytes_per_s_));
+}
+
+bool TokenBucket::limited() const { return rate_bytes_per_s_ > 0; }
@@ -0,0 +1,234 @@
+#include <unistd.h>
+
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bag/bag_player.hpp"
+#include "bag/bag_recorder.hpp"
+
+/**
+ * Print the usage of mrosbag.
+ */
+static void printUsage() {
+  std::cerr << "Usage: mrosbag record [-o <file>] [--chunk-size <bytes>] [--sync none|close|chunk] [--compress lz|none]"
+            << " <topic> ..." << std::endl
+            << "       mrosbag play [--rate <multiplier>] [--fast] [--start <s>] [--topics <topic> ...] [--threads <n>]"
+            << " <bag> ..." << std::endl
+            << "       mrosbag info <bag>" << std::endl
+            << "  record  record the frames of topics into a bag until ctrl+C" << std::endl
+            << "    --sync     when to force the bag out to disk: never, on close (default), or after every chunk"
+            << std::endl
+            << "    --compress compress each chunk, or not (default)" << std::endl
+            << "  play    replay bags, merged by time, at the recorded timing scaled by --rate" << std::endl
+            << "    --fast     play as fast as possible" << std::endl
+            << "    --start    seconds into the bags to start from" << std::endl
+            << "    --topics   topics to play, up to the next option" << std::endl
+            << "    --threads  threads decompressing chunks ahead of playback (default 2)" << std::endl
+            << "  info    summarize a bag" << std::endl;
+}
+
+/**
+ * Make the default name of a bag from the current local time.
+ */
+static std::string defaultBagPath() {
+  std::time_t now = std::time(nullptr);
+  std::tm local_time{};
+  localtime_r(&now, &local_time);
+  std::ostringstream path;
+  path << "mros_" << std::put_time(&local_time, "%Y-%m-%d-%H-%M-%S") << ".bag";
+  return path.str();
+}
+
+/**
+ * Record topics into a bag until ctrl+C, then print what was recorded.
+ */
+static int record(int argc, char **argv) {
+  std::string path = defaultBagPath();
+  BagWriterOptions options;
+  std::vector<std::string> topic_names;
+  for (int i = 2; i < argc; ++i) {
+    std::string argument = argv[i];
+    bool has_value = i + 1 < argc;
+    if (argument == "-o" && has_value) {
+      path = argv[++i];
+    } else if (argument == "--chunk-size" && has_value) {
+      options.chunk_size = std::stoul(argv[++i]);
+    } else if (argument == "--sync" && has_value) {
+      std::string sync_policy = argv[++i];
+      if (sync_policy == "none") {
+        options.sync_policy = BagSyncPolicy::kNone;
+      } else if (sync_policy == "close") {
+        options.sync_policy = BagSyncPolicy::kOnClose;
+      } else if (sync_policy == "chunk") {
+        options.sync_policy = BagSyncPolicy::kEveryChunk;
+      } else {
+        printUsage();
+        return 1;
+      }
+    } else if (argument == "--compress" && has_value) {
+      std::string compression = argv[++i];
+      if (compression == "lz") {
+        options.compression = BagCompression::kLZ;
+      } else if (compression == "none") {
+        options.compression = BagCompression::kNone;
+      } else {
+        printUsage();
+        return 1;
+      }
+    } else if (argument.starts_with("-")) {
+      printUsage();
+      return 1;
+    } else {
+      topic_names.push_back(argument);
+    }
+  }
+  if (topic_names.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  MROS::init(argc, argv);
+  std::shared_ptr<BagWriter> writer;
+  try {
+    writer = std::make_shared<BagWriter>(path, options);
+  } catch (BagException const &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  auto node = std::make_shared<Node>("mrosbag_" + std::to_string(getpid()));
+  {
+    BagRecorder recorder(node, writer, topic_names);
+    std::cout << "Recording to " << path << std::endl;
+    node->spin();
+    if (recorder.failedWriteCount() > 0) std::cerr << recorder.failedWriteCount() << " frames not written" << std::endl;
+  }
+
+  int status = 0;
+  try {
+    writer->close();
+  } catch (BagException const &e) {
+    std::cerr << e.what() << std::endl;
+    status = 1;
+  }
+  BagWriterStatistics statistics = writer->statistics();
+  std::cout << "Recorded " << statistics.message_count << " messages, " << statistics.frame_bytes << " bytes in "
+            << statistics.chunk_count << " chunks to " << path << std::endl;
+  if (options.compression != BagCompression::kNone && statistics.stored_record_bytes > 0) {
+    std::cout << "Compressed " << statistics.record_bytes << " bytes of records to " << statistics.stored_record_bytes
+              << ", ratio " << std::fixed << std::setprecision(2)
+              << static_cast<double>(statistics.record_bytes) / static_cast<double>(statistics.stored_record_bytes)
+              << std::endl;
+  }
+  if (statistics.blocked_write_count > 0) {
+    std::cout << "Waited on the disk " << statistics.blocked_write_count << " times" << std::endl;
+  }
+  return status;
+}
+
+/**
+ * Replay bags until they end or ctrl+C, then print what was played.
+ */
+static int play(int argc, char **argv) {
+  BagPlayerOptions options;
+  std::vector<std::string> paths;
+  bool reading_topics = false;
+  for (int i = 2; i < argc; ++i) {
+    std::string argument = argv[i];
+    bool has_value = i + 1 < argc;
+    if (argument.starts_with("-")) reading_topics = false;
+    if (argument == "--rate" && has_value) {
+      options.rate = std::stod(argv[++i]);
+    } else if (argument == "--fast") {
+      options.rate = 0;
+    } else if (argument == "--start" && has_value) {
+      options.start_offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::duration<double>(std::stod(argv[++i])));
+    } else if (argument == "--topics") {
+      reading_topics = true;
+    } else if (argument == "--threads" && has_value) {
+      options.decompression_thread_count = std::stoul(argv[++i]);
+    } else if (argument.starts_with("-")) {
+      printUsage();
+      return 1;
+    } else if (reading_topics) {
+      options.topic_names.push_back(argument);
+    } else {
+      paths.push_back(argument);
+    }
+  }
+  if (paths.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  MROS::init(argc, argv);
+  MROS &mros = MROS::getMROS();
+  auto node = std::make_shared<Node>("mrosbag_" + std::to_string(getpid()));
+  try {
+    BagPlayer player(node, paths, options);
+    BagPlayerStatistics statistics = player.play([&mros]() -> bool { return mros.active(); });
+    std::cout << "Played " << statistics.message_count << " messages, " << statistics.frame_bytes << " bytes in "
+              << std::fixed << std::setprecision(3) << statistics.elapsed_s << " s" << std::endl;
+  } catch (BagException const &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Print the time range, chunks, and topics of a bag.
+ */
+static int info(std::string const &path) {
+  try {
+    BagReader reader(path);
+    std::vector<std::uint64_t> message_counts(reader.topics().size());
+    std::uint64_t message_count = 0;
+    std::uint64_t record_bytes = 0;
+    std::uint64_t stored_record_bytes = 0;
+    for (auto const &chunk : reader.chunks()) {
+      BagChunkHeader chunk_header = reader.chunkHeader(chunk);
+      record_bytes += chunk_header.data_size;
+      stored_record_bytes += chunk_header.stored_size;
+      for (auto const &chunk_topic : chunk.topics) {
+        if (chunk_topic.topic_id < message_counts.size()) message_counts[chunk_topic.topic_id] += chunk_topic.count;
+      }
+      message_count += chunk.message_count;
+    }
+    std::cout << "path:     " << path << (reader.indexed() ? "" : " (not closed, recovered by scanning)") << std::endl
+              << "duration: " << std::fixed << std::setprecision(3)
+              << static_cast<double>(reader.endTime() - reader.startTime()) / 1e9 << " s" << std::endl
+              << "messages: " << message_count << std::endl
+              << "chunks:   " << reader.chunks().size() << std::endl
+              << "records:  " << record_bytes << " bytes, " << stored_record_bytes << " stored" << std::endl
+              << "topics:" << std::endl;
+    for (std::size_t topic_id = 0; topic_id < reader.topics().size(); ++topic_id) {
+      std::cout << "  " << reader.topics()[topic_id] << "\t" << message_counts[topic_id] << " messages" << std::endl;
+    }
+  } catch (BagException const &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Record topics into bag files, and replay or summarize them.
+ */
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+  std::string mode = argv[1];
+  if (mode == "record") return record(argc, argv);
+  if (mode == "play") return play(argc, argv);
+  if (mode == "info" && argc == 3) return info(argv[2]);
+  printUsage();
+  return 1;
+}
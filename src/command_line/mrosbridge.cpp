@@ -0,0 +1,137 @@
+#include <unistd.h>
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bridge/bridge.hpp"
+#include "socket/bson_socket/client_bson_socket.hpp"
+#include "socket/server_socket.hpp"
+
+/**
+ * Print the usage of mrosbridge.
+ */
+static void printUsage() {
+  std::cerr << "Usage: mrosbridge listen <port> [options]" << std::endl
+            << "       mrosbridge connect <address> <port> [options]" << std::endl
+            << "  Join this host's Mediator to another's through a mrosbridge on the other host." << std::endl
+            << "  listen   wait for the other side to connect on a port" << std::endl
+            << "  connect  connect to the other side listening at an address and port" << std::endl
+            << "Options:" << std::endl
+            << "  --core-address <address> address of the Mediator of this side (default 127.0.0.1)" << std::endl
+            << "  --core-port <port>       port of the Mediator of this side (default 13331)" << std::endl
+            << "  --forward <topic> ...    topics to forward to the other side, up to the next option" << std::endl
+            << "  --batch <bytes>          size of the batches small messages are sent in (default 65536)" << std::endl
+            << "  --batch-delay <us>       longest a message waits for its batch to fill (default 2000)" << std::endl
+            << "  --rate <bytes/s>         limit on the rate sent to the other side (default none)" << std::endl;
+}
+
+/**
+ * Bridge this host's Mediator to another's until ctrl+C or the other side leaves, then print what was bridged.
+ */
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+  std::string mode = argv[1];
+  std::string peer_address;
+  int peer_port = 0;
+  int first_option = 0;
+  if (mode == "listen") {
+    peer_port = std::stoi(argv[2]);
+    first_option = 3;
+  } else if (mode == "connect" && argc >= 4) {
+    peer_address = argv[2];
+    peer_port = std::stoi(argv[3]);
+    first_option = 4;
+  } else {
+    printUsage();
+    return 1;
+  }
+
+  std::string core_address = "127.0.0.1";
+  int core_port = 13331;
+  BridgeOptions options;
+  bool reading_topics = false;
+  for (int i = first_option; i < argc; ++i) {
+    std::string argument = argv[i];
+    bool has_value = i + 1 < argc;
+    if (argument.starts_with("-")) reading_topics = false;
+    if (argument == "--core-address" && has_value) {
+      core_address = argv[++i];
+    } else if (argument == "--core-port" && has_value) {
+      core_port = std::stoi(argv[++i]);
+    } else if (argument == "--forward") {
+      reading_topics = true;
+    } else if (argument == "--batch" && has_value) {
+      options.link.max_batch_bytes = std::stoul(argv[++i]);
+    } else if (argument == "--batch-delay" && has_value) {
+      options.link.max_batch_delay = std::chrono::microseconds(std::stol(argv[++i]));
+    } else if (argument == "--rate" && has_value) {
+      options.link.max_rate_bytes_per_s = std::stod(argv[++i]);
+    } else if (reading_topics) {
+      options.topic_names.push_back(argument);
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  MROS::init(argc, argv);
+  MROS &mros = MROS::getMROS();
+  std::string bridge_name = "mrosbridge_" + std::to_string(getpid());
+
+  // Connect to the other side, or wait for it to connect.
+  std::shared_ptr<BsonSocket> socket;
+  try {
+    if (mode == "listen") {
+      ServerSocket server_socket(AF_INET, "0.0.0.0", peer_port, 1);
+      std::cout << "Waiting for the other side on port " << peer_port << std::endl;
+      std::shared_ptr<ConnectionBsonSocket> connection_socket;
+      while (mros.active() && !(connection_socket = server_socket.acceptConnection<ConnectionBsonSocket>())) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      if (!connection_socket) return 0;
+      socket = connection_socket;
+    } else {
+      auto client_socket = std::make_shared<ClientBsonMessageSocket>(AF_INET, peer_address, peer_port);
+      client_socket->connect();
+      socket = client_socket;
+    }
+  } catch (SocketException const &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  // Stop as ctrl+C would once the other side leaves, so that spin() returns.
+  auto node = std::make_shared<Node>(bridge_name, core_address, core_port);
+  std::unique_ptr<Bridge> bridge;
+  try {
+    bridge = std::make_unique<Bridge>(node, bridge_name, socket, options, [&mros]() -> void {
+      if (mros.active()) std::raise(SIGINT);
+    });
+  } catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout << "Bridged to " << bridge->remote().bridge_name << ": forwarding " << options.topic_names.size()
+            << " topics, receiving " << bridge->remote().topic_names.size() << std::endl;
+  node->spin();
+  bridge->close();
+
+  BridgeLinkStatistics statistics = bridge->statistics();
+  std::cout << "Sent " << statistics.sent_message_count << " messages in " << statistics.sent_batch_count
+            << " batches, " << statistics.sent_bytes << " bytes" << std::endl
+            << "Received " << statistics.received_message_count << " messages in " << statistics.received_batch_count
+            << " batches" << std::endl;
+  if (statistics.dropped_message_count > 0) {
+    std::cout << "Dropped " << statistics.dropped_message_count << " messages waiting to be sent" << std::endl;
+  }
+  if (statistics.throttled_batch_count > 0) {
+    std::cout << "Held back " << statistics.throttled_batch_count << " batches for the rate limit" << std::endl;
+  }
+  return 0;
+}
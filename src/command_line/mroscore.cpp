@@ -1,7 +1,31 @@
+#include <iostream>
+#include <string>
+
 #include "mediator/mediator.hpp"
 
+/**
+ * Run the Mediator, on 127.0.0.1:13331 unless told otherwise, until ctrl+C.
+ *
+ * Usage: mroscore [--address <x.x.x.x>] [--port <port>]
+ *
+ * Nodes only reach the default address and port unless they are created with another one, so a second Mediator on the
+ * same host, such as one side of a bridge under test, needs its own port.
+ */
 int main(int argc, char** argv) {
+  std::string address = "127.0.0.1";
+  int port = 13331;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (argument == "--address" && i + 1 < argc) {
+      address = argv[++i];
+    } else if (argument == "--port" && i + 1 < argc) {
+      port = std::stoi(argv[++i]);
+    } else {
+      std::cerr << "Usage: mroscore [--address <x.x.x.x>] [--port <port>]" << std::endl;
+      return 1;
+    }
+  }
   MROS::init(argc, argv);
-  Mediator mediator("127.0.0.1", 13331);
+  Mediator mediator(address, port);
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,33 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+
+#include "mros/graph_watcher.hpp"
+
+/**
+ * Disconnect nodes by name. A killed node's connection with the Mediator is closed, which makes it disconnect its
+ * publishers and subscribers and return from spin().
+ */
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: mroskill <node name> [<node name> ...]" << std::endl;
+    return 1;
+  }
+  try {
+    GraphWatcher watcher("mroskill_" + std::to_string(getpid()), false);
+    bool killed_all = true;
+    for (int i = 1; i < argc; ++i) {
+      auto node_uris = watcher.killNode(argv[i]);
+      if (node_uris.empty()) {
+        std::cerr << "Unknown node " << argv[i] << std::endl;
+        killed_all = false;
+      }
+      for (auto const &node_uri : node_uris) std::cout << "killed " << argv[i] << " at " << node_uri << std::endl;
+    }
+    return killed_all ? 0 : 1;
+  } catch (std::exception const &e) {
+    std::cerr << "Unable to reach the Mediator: " << e.what() << std::endl;
+    return 1;
+  }
+}
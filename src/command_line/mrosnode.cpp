@@ -0,0 +1,134 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "mros/graph_watcher.hpp"
+#include "mros/mros.hpp"
+
+/**
+ * Print the usage of mrosnode.
+ */
+static void printUsage() {
+  std::cerr << "Usage: mrosnode list|info|watch [<node name>]" << std::endl
+            << "  list               names and URIs of the nodes" << std::endl
+            << "  info <node name>   topics the node publishes and subscribes to, and the nodes on the other end"
+            << std::endl
+            << "  watch              changes to the graph as they happen, until ctrl+C" << std::endl;
+}
+
+/**
+ * Describe a change to the graph in one line.
+ */
+static std::string describeChange(GraphDelta const &delta) {
+  std::string description = "[" + std::to_string(delta.version) + "] ";
+  switch (delta.kind) {
+    case GraphDeltaKind::kAddNode:
+      description += "added node ";
+      break;
+    case GraphDeltaKind::kRemoveNode:
+      description += "removed node ";
+      break;
+    case GraphDeltaKind::kAddPublisher:
+      description += "added publisher on " + delta.topic_name + " to node ";
+      break;
+    case GraphDeltaKind::kRemovePublisher:
+      description += "removed publisher on " + delta.topic_name + " from node ";
+      break;
+    case GraphDeltaKind::kAddSubscriber:
+      description += "added subscriber on " + delta.topic_name + " to node ";
+      break;
+    case GraphDeltaKind::kRemoveSubscriber:
+      description += "removed subscriber on " + delta.topic_name + " from node ";
+      break;
+  }
+  return description + delta.node_name + " at " + delta.node_uri;
+}
+
+/**
+ * Print the names and URIs of the nodes other than mrosnode itself.
+ */
+static void listNodes(GraphView const &graph, std::string const &own_name) {
+  for (auto const &[node_uri, node_entry] : graph.nodes()) {
+    if (node_entry.node_name == own_name) continue;
+    std::cout << node_entry.node_name << "\t" << node_uri << std::endl;
+  }
+}
+
+/**
+ * Print a topic with the other nodes on it.
+ * @param publishers Whether to list the topic's publishers, rather than its subscribers.
+ */
+static void printTopic(GraphView const &graph, std::string const &topic_name, std::string const &skipped_uri,
+                       bool publishers) {
+  std::cout << " * " << topic_name << std::endl;
+  for (auto const &[node_uri, node_entry] : graph.nodes()) {
+    if (node_uri == skipped_uri) continue;
+    auto const &topics = publishers ? node_entry.publications : node_entry.subscriptions;
+    if (topics.contains(topic_name)) std::cout << "    " << node_entry.node_name << " at " << node_uri << std::endl;
+  }
+}
+
+/**
+ * Print the topics of every node with a name.
+ * @return False if there is no such node, true otherwise.
+ */
+static bool printNodeInfo(GraphView const &graph, std::string const &node_name) {
+  auto node_uris = graph.findNodes(node_name);
+  for (auto const &node_uri : node_uris) {
+    auto const &node_entry = graph.nodes().at(node_uri);
+    std::cout << "Node [" << node_name << "]" << std::endl << "URI: " << node_uri << std::endl << std::endl;
+    std::cout << "Publications, with the subscribing nodes:" << std::endl;
+    for (auto const &topic_name : node_entry.publications) printTopic(graph, topic_name, node_uri, false);
+    std::cout << std::endl << "Subscriptions, with the publishing nodes:" << std::endl;
+    for (auto const &topic_name : node_entry.subscriptions) printTopic(graph, topic_name, node_uri, true);
+    std::cout << std::endl;
+  }
+  return !node_uris.empty();
+}
+
+/**
+ * Query the graph of nodes and topics from the Mediator.
+ */
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printUsage();
+    return 1;
+  }
+  std::string mode = argv[1];
+  if (!(mode == "list" && argc == 2) && !(mode == "info" && argc == 3) && !(mode == "watch" && argc == 2)) {
+    printUsage();
+    return 1;
+  }
+  std::string own_name = "mrosnode_" + std::to_string(getpid());
+
+  MROS::init(argc, argv);
+  MROS &mros = MROS::getMROS();
+  try {
+    if (mode == "list") {
+      listNodes(GraphWatcher(own_name, false).graph(), own_name);
+    } else if (mode == "info") {
+      if (!printNodeInfo(GraphWatcher(own_name, false).graph(), argv[2])) {
+        std::cerr << "Unknown node " << argv[2] << std::endl;
+        return 1;
+      }
+    } else {
+      // Print each change as the Mediator pushes it. The first fetch is printed as a listing.
+      GraphWatcher watcher(own_name, true,
+                           [](GraphDelta const &delta) -> void { std::cout << describeChange(delta) << std::endl; });
+      GraphView graph = watcher.graph();
+      std::cout << "graph at version " << graph.version() << ":" << std::endl;
+      listNodes(graph, own_name);
+      while (mros.active() && watcher.connected()) {
+        if (!watcher.synchronized()) watcher.synchronize();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+    }
+  } catch (std::exception const &e) {
+    std::cerr << "Unable to reach the Mediator: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
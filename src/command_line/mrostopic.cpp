@@ -0,0 +1,312 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "command_line/publish_pacer.hpp"
+#include "command_line/topic_statistics.hpp"
+#include "messages/raw_message.hpp"
+#include "mros/node.hpp"
+
+/**
+ * Number of messages the subscriber may queue before dropping the oldest. Large so that bursts are still measured.
+ */
+static constexpr std::uint32_t kQueueSize = 10000;
+
+/**
+ * Print the usage of mrostopic.
+ */
+static void printUsage() {
+  std::cerr << "Usage: mrostopic hz|bw|delay <topic> [--window <message count>] [--equals <field>=<value>]"
+            << " [--range <field>=<min>:<max>] [--max-rate <Hz>] [--core-port <port>]" << std::endl
+            << "       mrostopic pub <topic> [--rate <Hz>] [--size <bytes>] [--publishers <count>] [--duration <s>]"
+            << " [--transport tcp|udp] [--datagram <bytes>] [--core-port <port>]" << std::endl
+            << "  hz     rate of the topic and the time between messages" << std::endl
+            << "  bw     bandwidth of the topic and the size of its messages" << std::endl
+            << "  delay  time from publishing to arrival, using the publisher's wall clock" << std::endl
+            << "  pub    publish synthetic messages at a fixed total rate, or as fast as possible with a rate of 0"
+            << std::endl
+            << "  --equals     only measure messages whose field equals the value, filtered by the publishers"
+            << std::endl
+            << "  --range      only measure messages whose numeric field is within the bounds" << std::endl
+            << "  --max-rate   most messages per second to receive, decimated by the publishers" << std::endl
+            << "  --transport  publish over TCP, or best effort over UDP multicast on loopback (default tcp)"
+            << std::endl
+            << "  --datagram   largest UDP datagram, for --transport udp (default 1472)" << std::endl
+            << "  --core-port  port of the Mediator on 127.0.0.1 (default 13331)" << std::endl;
+}
+
+/**
+ * Format a number of bytes with a binary unit.
+ */
+static std::string formatBytes(double bytes) {
+  char const *units[] = {"B", "KiB", "MiB", "GiB"};
+  int unit = 0;
+  while (bytes >= 1024 && unit < 3) {
+    bytes /= 1024;
+    ++unit;
+  }
+  std::ostringstream formatted;
+  formatted << std::fixed << std::setprecision(unit == 0 ? 0 : 2) << bytes << " " << units[unit];
+  return formatted.str();
+}
+
+/**
+ * Print one report of a mode's statistics.
+ */
+static void printSummary(std::string const &mode, TopicStatisticsSummary const &summary) {
+  std::cout << std::fixed << std::setprecision(6);
+  if (mode == "hz") {
+    std::cout << "average rate: " << std::setprecision(3) << summary.rate_hz << " Hz" << std::setprecision(6)
+              << std::endl
+              << "\tmin: " << summary.min_interval_s << "s max: " << summary.max_interval_s
+              << "s std dev: " << summary.interval_std_dev_s << "s window: " << summary.window_count << std::endl;
+  } else if (mode == "bw") {
+    std::cout << "average: " << formatBytes(summary.bandwidth_bytes_per_s) << "/s" << std::endl
+              << "\tmean: " << formatBytes(summary.mean_size_bytes) << " min: " << formatBytes(summary.min_size_bytes)
+              << " max: " << formatBytes(summary.max_size_bytes) << " window: " << summary.window_count << std::endl;
+  } else {
+    std::cout << "average delay: " << summary.mean_delay_s << "s" << std::endl
+              << "\tmin: " << summary.min_delay_s << "s max: " << summary.max_delay_s
+              << "s std dev: " << summary.delay_std_dev_s << "s window: " << summary.window_count << std::endl;
+  }
+}
+
+/**
+ * Measure a topic through a subscriber that records each message's undecoded frame, printing the statistics every
+ * second until ctrl+C.
+ */
+static int measureTopic(std::string const &mode, std::string const &topic_name, std::size_t window_size,
+                        SubscriberOptions const &subscriber_options, int core_port) {
+  MROS &mros = MROS::getMROS();
+  auto node = std::make_shared<Node>("mrostopic_" + std::to_string(getpid()), "127.0.0.1", core_port);
+
+  // Record each message as it is taken off the queue. RawMessage skips decoding, so recording only stores a sample.
+  TopicStatistics statistics(window_size);
+  auto subscriber = node->createSubscriber<RawMessage>(
+      topic_name, kQueueSize, [&statistics](RawMessage const &message) -> void {
+        statistics.record(TopicFrameHeader::now(), message.header.publish_time_ns, message.payload.size());
+      },
+      subscriber_options);
+  std::thread spinning_thread([&node]() -> void { node->spin(); });
+
+  std::uint64_t reported_count = 0;
+  while (mros.active()) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (!mros.active()) break;
+    TopicStatisticsSummary summary = statistics.summarize();
+    if (summary.total_count == reported_count) {
+      std::cout << "no new messages" << std::endl;
+      continue;
+    }
+    reported_count = summary.total_count;
+    printSummary(mode, summary);
+
+    // Messages from multicast publishers may be lost, which only the receiving side can count.
+    MulticastReceiverStatistics multicast_statistics = subscriber->multicastStatistics();
+    if (multicast_statistics.received_frame_count > 0) {
+      std::cout << "\tmulticast dropped: " << multicast_statistics.dropped_frame_count
+                << " reordered: " << multicast_statistics.reordered_frame_count
+                << " datagrams per receive: "
+                << static_cast<double>(multicast_statistics.received_datagram_count) /
+                       static_cast<double>(multicast_statistics.receive_call_count)
+                << std::endl;
+    }
+  }
+  spinning_thread.join();
+  return 0;
+}
+
+/**
+ * Options of mrostopic pub.
+ */
+struct LoadOptions {
+  /**
+   * Total rate over all publishers in messages per second. Zero to publish as fast as possible.
+   */
+  double rate_hz = 10;
+
+  /**
+   * Size of each encoded message in bytes.
+   */
+  std::size_t size_bytes = 64;
+
+  /**
+   * Number of publishers, each on its own Node and thread.
+   */
+  std::size_t publisher_count = 1;
+
+  /**
+   * Seconds to publish for. Zero to publish until ctrl+C.
+   */
+  double duration_s = 0;
+
+  /**
+   * Transport and datagram size of the publishers.
+   */
+  PublisherOptions publisher_options;
+};
+
+/**
+ * Publish synthetic messages from parallel publishers at a fixed total rate, printing the achieved rate, the missed
+ * deadlines, and the time spent in publish() every second until ctrl+C or the end of the duration.
+ */
+static int publishLoad(std::string const &topic_name, LoadOptions const &options, std::size_t window_size,
+                       int core_port) {
+  MROS &mros = MROS::getMROS();
+  RawMessage message;
+  message.payload = makeSyntheticPayload(options.size_bytes);
+
+  // Give each publisher its own Node so that they are separate connections as seen by subscribers and the Mediator.
+  std::vector<std::shared_ptr<Node>> nodes;
+  std::vector<std::shared_ptr<Publisher<RawMessage>>> publishers;
+  for (std::size_t i = 0; i < options.publisher_count; ++i) {
+    nodes.push_back(std::make_shared<Node>("mrostopic_" + std::to_string(getpid()) + "_" + std::to_string(i),
+                                           "127.0.0.1", core_port));
+    publishers.push_back(nodes.back()->createPublisher<RawMessage>(topic_name, options.publisher_options));
+    publishers.back()->onSubscriberConnect([i](std::size_t subscriber_count) -> void {
+      std::cout << "publisher " << i << ": subscriber connected, " << subscriber_count << " connected" << std::endl;
+    });
+  }
+
+  // Split the rate over the publishers and offset their deadlines so that the topic sees evenly spaced messages.
+  double publisher_rate_hz = options.rate_hz / static_cast<double>(options.publisher_count);
+  auto start = PublishPacer::Clock::now();
+  auto end = start + std::chrono::duration_cast<PublishPacer::Clock::duration>(
+                         std::chrono::duration<double>(options.duration_s));
+  std::atomic<bool> publishing = true;
+  std::atomic<std::uint64_t> missed_deadlines = 0;
+  TopicStatistics statistics(window_size);
+  std::vector<std::thread> publishing_threads;
+  for (std::size_t i = 0; i < options.publisher_count; ++i) {
+    auto offset = options.rate_hz > 0 ? std::chrono::duration_cast<PublishPacer::Clock::duration>(
+                                            std::chrono::duration<double>(static_cast<double>(i) / options.rate_hz))
+                                      : PublishPacer::Clock::duration::zero();
+    publishing_threads.emplace_back([&, i, offset]() -> void {
+      PublishPacer pacer(publisher_rate_hz, start + offset);
+      std::uint64_t reported_missed_deadlines = 0;
+      while (publishing) {
+        pacer.waitForNextDeadline();
+        auto publish_start = PublishPacer::Clock::now();
+        publishers[i]->publish(message);
+        auto publish_end = PublishPacer::Clock::now();
+        statistics.record(publish_end.time_since_epoch().count(), publish_start.time_since_epoch().count(),
+                          message.payload.size());
+        missed_deadlines += pacer.missedDeadlines() - reported_missed_deadlines;
+        reported_missed_deadlines = pacer.missedDeadlines();
+      }
+    });
+  }
+
+  // Report every second from the message counts so that the achieved rate does not depend on the window.
+  std::uint64_t reported_count = 0;
+  auto reported_time = start;
+  while (mros.active() && (options.duration_s <= 0 || PublishPacer::Clock::now() < end)) {
+    auto report_time = reported_time + std::chrono::seconds(1);
+    if (options.duration_s > 0) report_time = std::min(report_time, end);
+    std::this_thread::sleep_until(report_time);
+    TopicStatisticsSummary summary = statistics.summarize();
+    double elapsed_s = std::chrono::duration<double>(PublishPacer::Clock::now() - reported_time).count();
+    reported_time = PublishPacer::Clock::now();
+    std::size_t subscriber_count = 0;
+    for (auto const &publisher : publishers) subscriber_count += publisher->getNumSubscribers();
+    std::cout << std::fixed << std::setprecision(3) << "published: " << summary.total_count - reported_count
+              << " rate: " << static_cast<double>(summary.total_count - reported_count) / elapsed_s << " Hz"
+              << " bandwidth: " << formatBytes(static_cast<double>(summary.total_count - reported_count) *
+                                               static_cast<double>(message.payload.size()) / elapsed_s)
+              << "/s missed deadlines: " << missed_deadlines << " subscribers: " << subscriber_count << std::endl
+              << std::setprecision(6) << "\tpublish latency mean: " << summary.mean_delay_s
+              << "s min: " << summary.min_delay_s << "s max: " << summary.max_delay_s
+              << "s std dev: " << summary.delay_std_dev_s << "s window: " << summary.window_count << std::endl;
+    reported_count = summary.total_count;
+  }
+  publishing = false;
+  for (auto &publishing_thread : publishing_threads) publishing_thread.join();
+
+  double total_s = std::chrono::duration<double>(PublishPacer::Clock::now() - start).count();
+  std::uint64_t total_count = statistics.summarize().total_count;
+  std::cout << std::setprecision(3) << "total published: " << total_count
+            << " average rate: " << static_cast<double>(total_count) / total_s << " Hz missed deadlines: "
+            << missed_deadlines << std::endl;
+  return 0;
+}
+
+/**
+ * Parse the value of --equals as a number, boolean, or null if it is one, and as a string otherwise.
+ */
+static json parseFilterValue(std::string const &value) {
+  json parsed = json::parse(value, nullptr, false);
+  if (parsed.is_number() || parsed.is_boolean() || parsed.is_null()) return parsed;
+  return value;
+}
+
+/**
+ * Measure a topic with hz, bw, or delay, or publish load on it with pub.
+ */
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printUsage();
+    return 1;
+  }
+  std::string mode = argv[1];
+  std::string topic_name = argv[2];
+  std::size_t window_size = 10000;
+  int core_port = 13331;
+  LoadOptions load_options;
+  SubscriberOptions subscriber_options;
+  bool publishing = mode == "pub";
+  for (int i = 3; i < argc; ++i) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+      printUsage();
+      return 1;
+    }
+    std::string value = argv[++i];
+    if (option == "--window") {
+      window_size = std::stoul(value);
+    } else if (option == "--core-port") {
+      core_port = std::stoi(value);
+    } else if (!publishing && option == "--equals" && value.find('=') != std::string::npos) {
+      std::size_t equals = value.find('=');
+      subscriber_options.filter.whereEquals(value.substr(0, equals), parseFilterValue(value.substr(equals + 1)));
+    } else if (!publishing && option == "--range" && value.find('=') != std::string::npos &&
+               value.find(':', value.find('=')) != std::string::npos) {
+      std::size_t equals = value.find('=');
+      std::size_t colon = value.find(':', equals);
+      subscriber_options.filter.whereInRange(value.substr(0, equals),
+                                             std::stod(value.substr(equals + 1, colon - equals - 1)),
+                                             std::stod(value.substr(colon + 1)));
+    } else if (!publishing && option == "--max-rate") {
+      subscriber_options.max_rate_hz = std::stod(value);
+    } else if (publishing && option == "--rate") {
+      load_options.rate_hz = std::stod(value);
+    } else if (publishing && option == "--size") {
+      load_options.size_bytes = std::stoul(value);
+    } else if (publishing && option == "--publishers") {
+      load_options.publisher_count = std::max<std::size_t>(std::stoul(value), 1);
+    } else if (publishing && option == "--duration") {
+      load_options.duration_s = std::stod(value);
+    } else if (publishing && option == "--transport" && (value == "tcp" || value == "udp")) {
+      load_options.publisher_options.transport = value == "udp" ? TopicTransport::kUdpMulticast : TopicTransport::kTcp;
+    } else if (publishing && option == "--datagram") {
+      load_options.publisher_options.max_datagram_bytes = std::stoul(value);
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (mode != "hz" && mode != "bw" && mode != "delay" && !publishing) {
+    printUsage();
+    return 1;
+  }
+
+  MROS::init(argc, argv);
+  if (publishing) return publishLoad(topic_name, load_options, window_size, core_port);
+  return measureTopic(mode, topic_name, window_size, subscriber_options, core_port);
+}
@@ -0,0 +1,28 @@
+#include "command_line/publish_pacer.hpp"
+
+#include <cmath>
+#include <string>
+#include <thread>
+
+PublishPacer::PublishPacer(double rate_hz, Clock::time_point start) {
+  if (rate_hz > 0) rate_.emplace(rate_hz, start);
+}
+
+PublishPacer::Clock::time_point PublishPacer::nextDeadline(Clock::time_point now) {
+  return rate_ ? rate_->nextDeadline(now) : now;
+}
+
+void PublishPacer::waitForNextDeadline() {
+  Clock::time_point deadline = nextDeadline(Clock::now());
+  if (deadline - Clock::now() > kSpinThreshold_) std::this_thread::sleep_until(deadline - kSpinThreshold_);
+  // Yield while spinning so that other publishing threads sharing the core still make their deadlines.
+  while (Clock::now() < deadline) std::this_thread::yield();
+}
+
+std::uint64_t PublishPacer::missedDeadlines() const { return rate_ ? rate_->missedDeadlines() : 0; }
+
+Bson makeSyntheticPayload(std::size_t size_bytes) {
+  std::size_t empty_size = json::to_bson(json{{"data", ""}}).size();
+  std::size_t data_size = size_bytes > empty_size ? size_bytes - empty_size : 0;
+  return json::to_bson(json{{"data", std::string(data_size, 'x')}});
+}
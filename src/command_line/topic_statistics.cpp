@@ -0,0 +1,85 @@
+#include "command_line/topic_statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * Convert nanoseconds to seconds.
+ */
+static double toSeconds(double nanoseconds) { return nanoseconds / 1e9; }
+
+TopicStatistics::TopicStatistics(std::size_t window_size) : samples_(std::max<std::size_t>(window_size, 2)) {}
+
+void TopicStatistics::record(std::int64_t arrival_time_ns, std::int64_t publish_time_ns, std::size_t size_bytes) {
+  std::lock_guard<std::mutex> samples_lock_guard(samples_lock_);
+  samples_[next_sample_] = {arrival_time_ns, arrival_time_ns - publish_time_ns, size_bytes};
+  next_sample_ = (next_sample_ + 1) % samples_.size();
+  ++total_count_;
+}
+
+TopicStatisticsSummary TopicStatistics::summarize() {
+  // Copy the window out in arrival order so that recording is not blocked while computing.
+  std::unique_lock<std::mutex> unique_samples_lock(samples_lock_);
+  TopicStatisticsSummary summary;
+  summary.total_count = total_count_;
+  std::size_t window_count = std::min<std::uint64_t>(total_count_, samples_.size());
+  std::vector<Sample> window;
+  window.reserve(window_count);
+  std::size_t first_sample = window_count < samples_.size() ? 0 : next_sample_;
+  for (std::size_t i = 0; i < window_count; ++i) window.push_back(samples_[(first_sample + i) % samples_.size()]);
+  unique_samples_lock.unlock();
+
+  summary.window_count = window_count;
+  if (window.empty()) return summary;
+
+  // Sizes and delays cover every message in the window.
+  double size_sum = 0;
+  double delay_sum = 0;
+  summary.min_size_bytes = std::numeric_limits<std::size_t>::max();
+  std::int64_t min_delay_ns = std::numeric_limits<std::int64_t>::max();
+  std::int64_t max_delay_ns = std::numeric_limits<std::int64_t>::min();
+  for (auto const &sample : window) {
+    size_sum += static_cast<double>(sample.size_bytes);
+    delay_sum += static_cast<double>(sample.delay_ns);
+    summary.min_size_bytes = std::min(summary.min_size_bytes, sample.size_bytes);
+    summary.max_size_bytes = std::max(summary.max_size_bytes, sample.size_bytes);
+    min_delay_ns = std::min(min_delay_ns, sample.delay_ns);
+    max_delay_ns = std::max(max_delay_ns, sample.delay_ns);
+  }
+  double mean_delay_ns = delay_sum / static_cast<double>(window.size());
+  double delay_square_sum = 0;
+  for (auto const &sample : window) {
+    double deviation = static_cast<double>(sample.delay_ns) - mean_delay_ns;
+    delay_square_sum += deviation * deviation;
+  }
+  summary.mean_size_bytes = size_sum / static_cast<double>(window.size());
+  summary.mean_delay_s = toSeconds(mean_delay_ns);
+  summary.min_delay_s = toSeconds(static_cast<double>(min_delay_ns));
+  summary.max_delay_s = toSeconds(static_cast<double>(max_delay_ns));
+  summary.delay_std_dev_s = toSeconds(std::sqrt(delay_square_sum / static_cast<double>(window.size())));
+
+  // Rate and bandwidth cover the intervals between arrivals, so the first message only marks the start.
+  if (window.size() < 2) return summary;
+  double span_ns = static_cast<double>(window.back().arrival_time_ns - window.front().arrival_time_ns);
+  double interval_count = static_cast<double>(window.size() - 1);
+  std::int64_t min_interval_ns = std::numeric_limits<std::int64_t>::max();
+  std::int64_t max_interval_ns = std::numeric_limits<std::int64_t>::min();
+  double interval_square_sum = 0;
+  double mean_interval_ns = span_ns / interval_count;
+  for (std::size_t i = 1; i < window.size(); ++i) {
+    std::int64_t interval_ns = window[i].arrival_time_ns - window[i - 1].arrival_time_ns;
+    min_interval_ns = std::min(min_interval_ns, interval_ns);
+    max_interval_ns = std::max(max_interval_ns, interval_ns);
+    double deviation = static_cast<double>(interval_ns) - mean_interval_ns;
+    interval_square_sum += deviation * deviation;
+  }
+  summary.min_interval_s = toSeconds(static_cast<double>(min_interval_ns));
+  summary.max_interval_s = toSeconds(static_cast<double>(max_interval_ns));
+  summary.interval_std_dev_s = toSeconds(std::sqrt(interval_square_sum / interval_count));
+  if (span_ns > 0) {
+    summary.rate_hz = interval_count / toSeconds(span_ns);
+    summary.bandwidth_bytes_per_s = (size_sum - static_cast<double>(window.front().size_bytes)) / toSeconds(span_ns);
+  }
+  return summary;
+}
@@ -0,0 +1,62 @@
+#include "coroutine/coroutine_scheduler.hpp"
+
+#include "coroutine/flow.hpp"
+
+thread_local CoroutineScheduler *CoroutineScheduler::current_ = nullptr;
+
+CoroutineScheduler::CoroutineScheduler() {
+  scheduling_thread_ = std::thread([this]() -> void { resumeUntilShutdown(); });
+}
+
+CoroutineScheduler::~CoroutineScheduler() { shutdown(); }
+
+void CoroutineScheduler::spawn(Flow flow) { schedule(flow.release()); }
+
+void CoroutineScheduler::schedule(std::coroutine_handle<> handle) {
+  if (!handle) return;
+  std::unique_lock<std::mutex> unique_ready_lock(ready_mutex_);
+  if (shutdown_) {
+    unique_ready_lock.unlock();
+    handle.destroy();
+    return;
+  }
+  ready_.push_back(handle);
+  ready_condition_variable_.notify_one();
+}
+
+void CoroutineScheduler::shutdown() {
+  std::unique_lock<std::mutex> unique_ready_lock(ready_mutex_);
+  shutdown_ = true;
+  ready_condition_variable_.notify_all();
+  unique_ready_lock.unlock();
+  if (scheduling_thread_.joinable() && scheduling_thread_.get_id() != std::this_thread::get_id()) {
+    scheduling_thread_.join();
+  }
+}
+
+std::uint64_t CoroutineScheduler::resumedCount() {
+  std::lock_guard<std::mutex> ready_lock_guard(ready_mutex_);
+  return resumed_count_;
+}
+
+std::shared_ptr<CoroutineScheduler> CoroutineScheduler::current() {
+  return current_ ? current_->shared_from_this() : nullptr;
+}
+
+void CoroutineScheduler::resumeUntilShutdown() {
+  current_ = this;
+  std::unique_lock<std::mutex> unique_ready_lock(ready_mutex_);
+  while (true) {
+    ready_condition_variable_.wait(unique_ready_lock, [this]() -> bool { return shutdown_ || !ready_.empty(); });
+
+    // Only exit once the queue has been drained so that no coroutine that was ready is lost.
+    if (ready_.empty()) break;
+    std::coroutine_handle<> handle = ready_.front();
+    ready_.pop_front();
+    ++resumed_count_;
+    unique_ready_lock.unlock();
+    handle.resume();
+    unique_ready_lock.lock();
+  }
+  current_ = nullptr;
+}
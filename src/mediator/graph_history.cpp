@@ -0,0 +1,24 @@
+#include "mediator/graph_history.hpp"
+
+GraphHistory::GraphHistory(std::size_t capacity) : capacity_(capacity) {}
+
+GraphDelta const &GraphHistory::record(GraphDelta delta) {
+  delta.version = ++version_;
+  if (!deltas_.empty() && deltas_.size() >= capacity_) deltas_.pop_front();
+  deltas_.push_back(std::move(delta));
+  return deltas_.back();
+}
+
+std::uint64_t GraphHistory::version() const { return version_; }
+
+bool GraphHistory::deltasSince(std::uint64_t since_version, std::vector<GraphDelta> &deltas) const {
+  deltas.clear();
+  if (since_version > version_) return false;
+  if (since_version == version_) return true;
+
+  // The oldest kept change must directly follow since_version.
+  std::uint64_t oldest_version = deltas_.empty() ? version_ + 1 : deltas_.front().version;
+  if (oldest_version > since_version + 1) return false;
+  deltas.assign(deltas_.begin() + static_cast<std::ptrdiff_t>(since_version + 1 - oldest_version), deltas_.end());
+  return true;
+}
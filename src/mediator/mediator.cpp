@@ -1,12 +1,17 @@
 #include "mediator/mediator.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 Mediator::Mediator(std::string address, int port)
     : address_(std::move(address)), port_(port), mros_(MROS::getMROS()), logger_(Logger::getLogger()) {
   // Initialize the server and begin accepting connections.
   try {
-    bson_rpc_server_ = std::make_unique<ServerSocket>(AF_INET, address_, port_, 100);
+    handshake_pool_ = std::make_unique<ThreadPool>(kHandshakeThreadCount_);
+    graph_push_pool_ = std::make_unique<ThreadPool>(kGraphPushThreadCount_);
+    rpc_dispatcher_ = std::make_shared<RPCDispatcher>(std::max(1u, std::thread::hardware_concurrency()),
+                                                      DispatchPolicy::kSerializedPerSocket);
+    bson_rpc_server_ = std::make_unique<ServerSocket>(AF_INET, address_, port_, kListenBacklog_);
     handleRPCConnections();
   } catch (std::exception const &e){
     logger_.info(e.what());
@@ -22,11 +27,9 @@ void Mediator::handleRPCConnections() {
   LogContext context("Mediator::handleRPCConnections");
   // Check that the mediator has not been killed.
   while (mros_.active()) {
-    // Attempt to accept a new connection, which is non-blocking.
-    auto connection_socket = bson_rpc_server_->acceptConnection<ConnectionBsonRPCSocket>();
-
-    // If a connection was accepted, set up the connection.
-    if (connection_socket) {
+    // Accept every pending connection, which is non-blocking, so that a burst of nodes does not wait on the sleep
+    // below.
+    while (auto connection_socket = bson_rpc_server_->acceptConnection<ConnectionBsonRPCSocket>()) {
       // Get the address and port of the connecting client and resolve it to the node's URI.
       auto client_address_port = bson_rpc_server_->getLastClientAddressPort();
       std::string node_uri = toURI(client_address_port.first, client_address_port.second);
@@ -37,49 +40,68 @@ void Mediator::handleRPCConnections() {
       node_table_[node_uri].connection = connection_socket;
       node_table_mutex_.unlock();
 
-      // Register addNode() as the connecting callback and cache the socket pointer so that addNode() can access it.
-      connection_socket->registerConnectingCallback([this, node_uri](Json const &input) -> void {
-        json input_with_uri = input;
-        input_with_uri["node_uri"] = node_uri;
-        return jsonAddNodeCallback(input_with_uri);
-      });
-
-      // Register an addPublisher callback that automatically inserts this node's URI.
-      connection_socket->registerRequestCallback("addPublisher", [this, node_uri](json const &input) -> void {
-        json input_with_uri = input;
-        input_with_uri["node_uri"] = node_uri;
-        jsonAddPublisherCallback(input_with_uri);
-      });
-
-      // Register an addSubscriber callback that automatically inserts this node's URI.
-      connection_socket->registerRequestResponseCallback("addSubscriber", [this, node_uri](json const &input) -> json {
-        json input_with_uri = input;
-        input_with_uri["node_uri"] = node_uri;
-        return jsonAddSubscriberCallback(input_with_uri);
-      });
-
-      // Register a removePublisher callback that automatically inserts this node's URI.
-      connection_socket->registerRequestCallback("removePublisher", [this, node_uri](json const &input) -> void {
-        json input_with_uri = input;
-        input_with_uri["node_uri"] = node_uri;
-        jsonRemovePublisherCallback(input_with_uri);
-      });
-
-      // Register a removeSubscriber callback that automatically inserts this node's URI.
-      connection_socket->registerRequestCallback("removeSubscriber", [this, node_uri](json const &input) -> void {
-        json input_with_uri = input;
-        input_with_uri["node_uri"] = node_uri;
-        jsonRemoveSubscriberCallback(input_with_uri);
-      });
+      // Run the node's callbacks on the shared dispatcher.
+      connection_socket->setDispatcher(rpc_dispatcher_);
+
+      // Register addNode() as the connecting callback. Each callback captures this node's URI.
+      connection_socket->registerConnectingCallback(makeTypedRequestCallback<ConnectNodeRequest>(
+          "connection", [this, node_uri](ConnectNodeRequest const &request) -> void {
+            addNode(node_uri, request.node_name);
+          }));
+      registerTypedCallback(*connection_socket, kAddPublisherRPC,
+                            [this, node_uri](AddPublisherRequest const &request) -> void {
+                              addPublisher(
+                                  node_uri, request.topic_name,
+                                  {request.address, request.port, request.transport, request.interface_address});
+                            });
+      registerTypedCallback(*connection_socket, kAddSubscriberRPC,
+                            [this, node_uri](TopicRequest const &request) -> PublisherAddresses {
+                              return addSubscriber(node_uri, request.topic_name);
+                            });
+      registerTypedCallback(*connection_socket, kRemovePublisherRPC,
+                            [this, node_uri](TopicRequest const &request) -> void {
+                              removePublisher(node_uri, request.topic_name);
+                            });
+      registerTypedCallback(*connection_socket, kRemoveSubscriberRPC,
+                            [this, node_uri](TopicRequest const &request) -> void {
+                              removeSubscriber(node_uri, request.topic_name);
+                            });
+      registerTypedCallback(*connection_socket, kGetGraphRPC,
+                            [this, node_uri](GraphRequest const &request) -> GraphUpdate {
+                              return getGraph(node_uri, request);
+                            });
+      registerTypedCallback(*connection_socket, kKillNodeRPC,
+                            [this, node_uri](KillNodeRequest const &request) -> KillNodeResult {
+                              return killNode(node_uri, request.node_name);
+                            });
 
       // Register a removeNode closing callback that automatically inserts this node's URI.
       connection_socket->registerClosingCallback([this, node_uri]() -> void { removeNode(node_uri); });
 
-      // Call addNode() internally to set up the node data and node specific callbacks, then start the connection.
-      connection_socket->startConnection();
+      // Hand the handshake, which calls addNode() through the connecting callback, to the handshake threads so that
+      // the next connection can be accepted immediately.
+      handshake_pool_->submit(
+          [this, node_uri, connection_socket]() -> void { completeHandshake(node_uri, connection_socket); });
     }
+    releaseRetiredConnections();
     std::this_thread::sleep_for(10ms);
   }
+  // Finish or time out the handshakes in progress and finish the dispatched callbacks before tearing down the tables
+  // they write to.
+  handshake_pool_->shutdown();
+  rpc_dispatcher_->shutdown();
+
+  // Wake pushes blocked on watchers that stopped receiving, then finish the pushes.
+  std::vector<std::shared_ptr<ConnectionBsonRPCSocket>> watcher_connections;
+  node_table_mutex_.lock();
+  for (auto const &watcher : graph_watchers_) {
+    auto node_iter = node_table_.find(watcher.first);
+    if (node_iter != node_table_.end()) watcher_connections.push_back(node_iter->second.connection);
+  }
+  node_table_mutex_.unlock();
+  for (auto const &connection : watcher_connections) connection->shutdown();
+  graph_push_pool_->shutdown();
+
   // Close all connections and clear all data.
   bson_rpc_server_->close();
   topic_table_mutex_.lock();
@@ -89,13 +111,39 @@ void Mediator::handleRPCConnections() {
   node_table_mutex_.lock();
   node_table_.clear();
   node_table_mutex_.unlock();
+  releaseRetiredConnections();
   logger_.info("Mediator closed");
 }
 
+void Mediator::releaseRetiredConnections() {
+  std::lock_guard<std::mutex> node_table_guard(node_table_mutex_);
+  std::erase_if(retired_connections_, [](std::shared_ptr<ConnectionBsonRPCSocket> const &connection) -> bool {
+    return connection->closed();
+  });
+}
+
+void Mediator::completeHandshake(const NodeURI &node_uri,
+                                 const std::shared_ptr<ConnectionBsonRPCSocket> &connection_socket) {
+  LogContext context("Mediator::completeHandshake");
+  try {
+    connection_socket->startConnection(kHandshakeTimeout_);
+  } catch (SocketException const &e) {
+    // Drop the connection unless the URI has already been reused by a newer connection.
+    node_table_mutex_.lock();
+    auto node_iter = node_table_.find(node_uri);
+    if (node_iter != node_table_.end() && node_iter->second.connection == connection_socket) {
+      node_table_.erase(node_iter);
+    }
+    node_table_mutex_.unlock();
+    logger_.info("Dropped connection from " + node_uri + ": " + e.what());
+  }
+}
+
 void Mediator::addNode(const NodeURI &node_uri, const std::string &node_name) {
   // Update the node table with the node's name. The connection should already be registered for this uri.
   std::lock_guard<std::mutex> node_table_guard(node_table_mutex_);
   node_table_[node_uri].name = node_name;
+  recordGraphChange(GraphDeltaKind::kAddNode, node_uri, node_name);
   std::string info = "Added Node " + node_name + " at " + node_uri;
   logger_.info(info);
 }
@@ -103,6 +151,15 @@ void Mediator::addNode(const NodeURI &node_uri, const std::string &node_name) {
 void Mediator::addPublisher(const NodeURI &node_uri, const TopicName &topic_name, const AddressPort &address_port) {
   LogContext context("Mediator::addPublisher");
 
+  // Ignore requests dispatched after the node was removed. The node table lock is held until the topic table is
+  // updated, so a removal either comes first and is seen here, or comes after and cleans up this topic too.
+  node_table_mutex_.lock();
+  auto node_iter = node_table_.find(node_uri);
+  if (node_iter == node_table_.end()) {
+    node_table_mutex_.unlock();
+    return;
+  }
+
   // Update topic table with the new publishing node and get a list of the subscribing nodes.
   topic_table_mutex_.lock();
   topic_table_[topic_name].publishing_nodes.insert(node_uri);
@@ -110,77 +167,109 @@ void Mediator::addPublisher(const NodeURI &node_uri, const TopicName &topic_name
                                              topic_table_[topic_name].subscribing_nodes.end());
   topic_table_mutex_.unlock();
 
-  // Update node table and notify subscribing nodes of new publisher.
-  node_table_mutex_.lock();
-
   // Update the node that created the new publisher with the new publisher.
-  node_table_[node_uri].publisher_addresses_by_topic[topic_name] = address_port;
+  node_iter->second.publisher_addresses_by_topic[topic_name] = address_port;
+  recordGraphChange(GraphDeltaKind::kAddPublisher, node_uri, node_iter->second.name, topic_name);
 
   // Request that all subscribing nodes connect their subscribers to the new publisher.
+  PublisherAddresses new_publisher{topic_name,
+                                   {address_port.host},
+                                   {address_port.port},
+                                   {address_port.transport},
+                                   {address_port.interface_address}};
   for (auto const &subscribing_node_uri : subscribing_node_uris) {
-    // Pack address and port into vectors to adhere to expected json message structure.
-    std::vector<std::string> publisher_addresses {address_port.host};
-    std::vector<int> publisher_ports {address_port.port};
-    node_table_[subscribing_node_uri].connection->sendRequest("connectSubscriberToPublishers",
-                                                              {{"topic_name", topic_name},
-                                                               {"publisher_addresses", publisher_addresses},
-                                                               {"publisher_ports", publisher_ports}});
+    // Skip subscribing nodes that have been removed since the topic table was read.
+    auto subscribing_node_iter = node_table_.find(subscribing_node_uri);
+    if (subscribing_node_iter == node_table_.end()) continue;
+    sendTypedRequest(*subscribing_node_iter->second.connection, kConnectSubscriberToPublishersRPC, new_publisher);
   }
   node_table_mutex_.unlock();
   logger_.info("Added Publisher");
 }
 
-Json Mediator::addSubscriber(const NodeURI &node_uri, const TopicName &topic_name) {
+PublisherAddresses Mediator::addSubscriber(const NodeURI &node_uri, const TopicName &topic_name) {
   LogContext context("Mediator::addSubscriber");
 
+  // Ignore requests dispatched after the node was removed, holding the node table lock until the topic table is
+  // updated as addPublisher() does.
+  PublisherAddresses publishers{topic_name, {}, {}, {}, {}};
+  node_table_mutex_.lock();
+  auto node_iter = node_table_.find(node_uri);
+  if (node_iter == node_table_.end()) {
+    node_table_mutex_.unlock();
+    return publishers;
+  }
+
   // Update topic table and get list of publishing nodes.
   topic_table_mutex_.lock();
   topic_table_[topic_name].subscribing_nodes.insert(node_uri);
   std::vector<NodeURI> publishing_node_uris(topic_table_[topic_name].publishing_nodes.begin(),
-                                                topic_table_[topic_name].publishing_nodes.end());
+                                            topic_table_[topic_name].publishing_nodes.end());
   topic_table_mutex_.unlock();
 
   // Update node table and get a list of publisher addresses for all publishing nodes.
-  node_table_mutex_.lock();
-  node_table_[node_uri].subscribed_topics.insert(topic_name);
-  std::vector<std::string> addresses;
-  std::vector<int> ports;
+  node_iter->second.subscribed_topics.insert(topic_name);
+  recordGraphChange(GraphDeltaKind::kAddSubscriber, node_uri, node_iter->second.name, topic_name);
   for (const auto& publishing_node_uri : publishing_node_uris) {
-    AddressPort address_port = node_table_[publishing_node_uri].publisher_addresses_by_topic[topic_name];
-    addresses.push_back(address_port.host);
-    ports.push_back(address_port.port);
+    // Skip publishing nodes that have been removed since the topic table was read.
+    auto publishing_node_iter = node_table_.find(publishing_node_uri);
+    if (publishing_node_iter == node_table_.end()) continue;
+    auto address_port_iter = publishing_node_iter->second.publisher_addresses_by_topic.find(topic_name);
+    if (address_port_iter == publishing_node_iter->second.publisher_addresses_by_topic.end()) continue;
+    publishers.publisher_addresses.push_back(address_port_iter->second.host);
+    publishers.publisher_ports.push_back(address_port_iter->second.port);
+    publishers.publisher_transports.push_back(address_port_iter->second.transport);
+    publishers.publisher_interface_addresses.push_back(address_port_iter->second.interface_address);
   }
   node_table_mutex_.unlock();
 
-  // Encode request for this node to subscribe to the existing publishers.
+  // Respond with the existing publishers for this node to subscribe to.
   logger_.info("Added Subscriber");
-  return json{{"topic_name", topic_name}, {"publisher_addresses", addresses}, {"publisher_ports", ports}};
+  return publishers;
 }
 
 void Mediator::removeNode(const NodeURI &node_uri) {
   LogContext context("Mediator::removeNode");
+  std::shared_ptr<ConnectionBsonRPCSocket> connection = takeNode(node_uri);
+  if (!connection) return;
+
+  // Close the node's connection. The connection is retired rather than destroyed since this is usually running on its
+  // receiving thread.
+  connection->close();
+  node_table_mutex_.lock();
+  retired_connections_.push_back(std::move(connection));
+  node_table_mutex_.unlock();
+}
+
+std::shared_ptr<ConnectionBsonRPCSocket> Mediator::takeNode(const NodeURI &node_uri) {
+  // Take the node's data out of node_table_ so that its topics can be cleaned up without holding the table lock.
+  node_table_mutex_.lock();
+  auto node_iter = node_table_.find(node_uri);
+  if (node_iter == node_table_.end()) {
+    node_table_mutex_.unlock();
+    return nullptr;
+  }
+  NodeData node_data = std::move(node_iter->second);
+  node_table_.erase(node_iter);
+  graph_watchers_.erase(node_uri);
+  if (!node_data.name.empty()) recordGraphChange(GraphDeltaKind::kRemoveNode, node_uri, node_data.name);
+  node_table_mutex_.unlock();
 
   // For each topic that the node publishes to, get the TopicName and remove this node as a publishing node in
   // topic_table_.
   topic_table_mutex_.lock();
-  for (const auto &topic_pub_data_it : node_table_[node_uri].publisher_addresses_by_topic) {
+  for (const auto &topic_pub_data_it : node_data.publisher_addresses_by_topic) {
     topic_table_[topic_pub_data_it.first].publishing_nodes.erase(node_uri);
   }
 
   // For each topic that the node subscribes to, get the TopicName and remove this node as a subscribing node in
   // topic_table_.
-  for (const auto &topic : node_table_[node_uri].subscribed_topics) {
+  for (const auto &topic : node_data.subscribed_topics) {
     topic_table_[topic].subscribing_nodes.erase(node_uri);
   }
   topic_table_mutex_.unlock();
-
-  // Close the node's connection and remove the node data from node_table_.
-  node_table_mutex_.lock();
-  std::string info = "Removed Node " + node_table_[node_uri].name + " at " + node_uri;
-  node_table_[node_uri].connection->close();
-  node_table_.erase(node_uri);
-  node_table_mutex_.unlock();
-  logger_.info(info);
+  logger_.info("Removed Node " + node_data.name + " at " + node_uri);
+  return std::move(node_data.connection);
 }
 
 void Mediator::removePublisher(const NodeURI &node_uri, const TopicName &topic_name) {
@@ -193,7 +282,10 @@ void Mediator::removePublisher(const NodeURI &node_uri, const TopicName &topic_n
 
   // Update the node_table_ to reflect that this node no longer publishes on this topic.
   node_table_mutex_.lock();
-  node_table_[node_uri].publisher_addresses_by_topic.erase(topic_name);
+  auto node_iter = node_table_.find(node_uri);
+  if (node_iter != node_table_.end() && node_iter->second.publisher_addresses_by_topic.erase(topic_name) > 0) {
+    recordGraphChange(GraphDeltaKind::kRemovePublisher, node_uri, node_iter->second.name, topic_name);
+  }
   node_table_mutex_.unlock();
   logger_.info("Removed Publisher");
 }
@@ -208,40 +300,105 @@ void Mediator::removeSubscriber(const NodeURI &node_uri, const TopicName &topic_
 
   // Update the node_table_ to reflect that this node no longer subscribes to this topic.
   node_table_mutex_.lock();
-  node_table_[node_uri].subscribed_topics.erase(topic_name);
+  auto node_iter = node_table_.find(node_uri);
+  if (node_iter != node_table_.end() && node_iter->second.subscribed_topics.erase(topic_name) > 0) {
+    recordGraphChange(GraphDeltaKind::kRemoveSubscriber, node_uri, node_iter->second.name, topic_name);
+  }
   node_table_mutex_.unlock();
   logger_.info("Removed Subscriber");
 }
 
-void Mediator::jsonAddNodeCallback(Json const &json) {
-  NodeURI node_uri = json["node_uri"];
-  std::string node_name = json["node_name"];
-  addNode(node_uri, node_name);
+GraphUpdate Mediator::getGraph(const NodeURI &node_uri, const GraphRequest &request) {
+  std::lock_guard<std::mutex> node_table_guard(node_table_mutex_);
+  if (request.watch) graph_watchers_.try_emplace(node_uri, std::make_shared<GraphWatcherQueue>());
+
+  // Send only the missed changes when the caller already has a version that the history still covers.
+  GraphUpdate update{graph_history_.version(), false, {}, {}};
+  if (request.since_version > 0 && graph_history_.deltasSince(request.since_version, update.deltas)) return update;
+
+  // Otherwise send a snapshot of every node that has completed its handshake.
+  update.full = true;
+  update.nodes.reserve(node_table_.size());
+  for (auto const &[uri, node_data] : node_table_) {
+    if (node_data.name.empty()) continue;
+    GraphNodeInfo node_info{uri, node_data.name, {}, {}};
+    for (auto const &publication : node_data.publisher_addresses_by_topic) {
+      node_info.publications.push_back(publication.first);
+    }
+    node_info.subscriptions.assign(node_data.subscribed_topics.begin(), node_data.subscribed_topics.end());
+    update.nodes.push_back(std::move(node_info));
+  }
+  return update;
 }
 
-void Mediator::jsonAddPublisherCallback(Json const &json) {
-  NodeURI node_uri = json["node_uri"];
-  TopicName topic_name = json["topic_name"];
-  AddressPort address_port;
-  address_port.host = json["address"];
-  address_port.port = json["port"];
-  addPublisher(node_uri, topic_name, address_port);
-}
+KillNodeResult Mediator::killNode(const NodeURI &node_uri, const std::string &node_name) {
+  LogContext context("Mediator::killNode");
 
-Json Mediator::jsonAddSubscriberCallback(Json const &json) {
-  NodeURI node_uri = json["node_uri"];
-  TopicName topic_name = json["topic_name"];
-  return addSubscriber(node_uri, topic_name);
+  // Find the nodes first since takeNode() takes the table lock itself.
+  KillNodeResult result;
+  node_table_mutex_.lock();
+  for (auto const &[uri, node_data] : node_table_) {
+    if (node_data.name == node_name && uri != node_uri) result.node_uris.push_back(uri);
+  }
+  node_table_mutex_.unlock();
+
+  // Shutting down a node's connection makes the node disconnect its publishers and subscribers. Closing it would block
+  // this dispatched callback until the node replies, so the connection's receiving thread finishes closing it instead,
+  // and the connection is retired until it has.
+  for (auto const &uri : result.node_uris) {
+    std::shared_ptr<ConnectionBsonRPCSocket> connection = takeNode(uri);
+    if (!connection) continue;
+    connection->shutdown();
+    std::lock_guard<std::mutex> node_table_guard(node_table_mutex_);
+    retired_connections_.push_back(std::move(connection));
+  }
+  logger_.info("Killed " + std::to_string(result.node_uris.size()) + " Node(s) named " + node_name);
+  return result;
 }
 
-void Mediator::jsonRemovePublisherCallback(Json const &json) {
-  NodeURI node_uri = json["node_uri"];
-  TopicName topic_name = json["topic_name"];
-  return removePublisher(node_uri, topic_name);
+void Mediator::recordGraphChange(GraphDeltaKind kind, const NodeURI &node_uri, const std::string &node_name,
+                                 const TopicName &topic_name) {
+  GraphDelta const &delta = graph_history_.record({0, kind, node_uri, node_name, topic_name});
+
+  // Queue the change in version order for each watcher, and start pushing to the watchers that are not being pushed.
+  for (auto const &[watcher_uri, watcher_queue] : graph_watchers_) {
+    watcher_queue->deltas.push_back(delta);
+
+    // A watcher that has fallen further behind than the history is only sent the newest change. The versions it skips
+    // make it fetch a snapshot, as it does for any lost change.
+    if (watcher_queue->deltas.size() > kGraphHistorySize_) {
+      watcher_queue->deltas.erase(watcher_queue->deltas.begin(), watcher_queue->deltas.end() - 1);
+    }
+    if (!watcher_queue->sending) {
+      watcher_queue->sending = true;
+      graph_push_pool_->submit(
+          [this, watcher_uri, watcher_queue]() -> void { pushGraphChanges(watcher_uri, watcher_queue); });
+    }
+  }
 }
 
-void Mediator::jsonRemoveSubscriberCallback(Json const &json) {
-  NodeURI node_uri = json["node_uri"];
-  TopicName topic_name = json["topic_name"];
-  return removeSubscriber(node_uri, topic_name);
+void Mediator::pushGraphChanges(const NodeURI &watcher_uri, const std::shared_ptr<GraphWatcherQueue> &watcher_queue) {
+  std::unique_lock<std::mutex> unique_node_table_lock(node_table_mutex_);
+  while (true) {
+    // Stop once the watcher is gone, or has been replaced by a new watcher on the same URI with its own task.
+    auto watcher_iter = graph_watchers_.find(watcher_uri);
+    if (watcher_iter == graph_watchers_.end() || watcher_iter->second != watcher_queue) return;
+    auto node_iter = node_table_.find(watcher_uri);
+    if (node_iter == node_table_.end() || watcher_queue->deltas.empty()) {
+      watcher_queue->sending = false;
+      return;
+    }
+
+    // Take the queued changes and send them without the lock.
+    std::deque<GraphDelta> deltas;
+    std::swap(deltas, watcher_queue->deltas);
+    auto connection = node_iter->second.connection;
+    unique_node_table_lock.unlock();
+    try {
+      for (auto const &delta : deltas) sendTypedRequest(*connection, kGraphChangedRPC, delta);
+    } catch (SocketException const &e) {
+      // The watcher is removed by its closing callback.
+    }
+    unique_node_table_lock.lock();
+  }
 }
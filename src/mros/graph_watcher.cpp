@@ -0,0 +1,153 @@
+#include "mros/graph_watcher.hpp"
+
+bool GraphView::apply(GraphUpdate const &update) {
+  if (!update.full) {
+    for (auto const &delta : update.deltas) {
+      if (!apply(delta)) return false;
+    }
+    return update.version <= version_;
+  }
+
+  // Replace the whole view with the snapshot.
+  nodes_.clear();
+  for (auto const &node_info : update.nodes) {
+    nodes_[node_info.node_uri] = {node_info.node_name, {node_info.publications.begin(), node_info.publications.end()},
+                                  {node_info.subscriptions.begin(), node_info.subscriptions.end()}};
+  }
+  version_ = update.version;
+  return true;
+}
+
+bool GraphView::apply(GraphDelta const &delta) {
+  if (delta.version <= version_) return true;
+  if (delta.version != version_ + 1) return false;
+
+  switch (delta.kind) {
+    case GraphDeltaKind::kAddNode:
+      nodes_[delta.node_uri].node_name = delta.node_name;
+      break;
+    case GraphDeltaKind::kRemoveNode:
+      nodes_.erase(delta.node_uri);
+      break;
+    case GraphDeltaKind::kAddPublisher:
+      nodes_[delta.node_uri].node_name = delta.node_name;
+      nodes_[delta.node_uri].publications.insert(delta.topic_name);
+      break;
+    case GraphDeltaKind::kRemovePublisher:
+      if (auto node_iter = nodes_.find(delta.node_uri); node_iter != nodes_.end()) {
+        node_iter->second.publications.erase(delta.topic_name);
+      }
+      break;
+    case GraphDeltaKind::kAddSubscriber:
+      nodes_[delta.node_uri].node_name = delta.node_name;
+      nodes_[delta.node_uri].subscriptions.insert(delta.topic_name);
+      break;
+    case GraphDeltaKind::kRemoveSubscriber:
+      if (auto node_iter = nodes_.find(delta.node_uri); node_iter != nodes_.end()) {
+        node_iter->second.subscriptions.erase(delta.topic_name);
+      }
+      break;
+  }
+  version_ = delta.version;
+  return true;
+}
+
+std::uint64_t GraphView::version() const { return version_; }
+
+std::map<std::string, GraphView::NodeEntry> const &GraphView::nodes() const { return nodes_; }
+
+std::vector<std::string> GraphView::findNodes(std::string const &node_name) const {
+  std::vector<std::string> node_uris;
+  for (auto const &[node_uri, node_entry] : nodes_) {
+    if (node_entry.node_name == node_name) node_uris.push_back(node_uri);
+  }
+  return node_uris;
+}
+
+GraphWatcher::GraphWatcher(std::string const &node_name, bool watch, ChangeCallback change_callback,
+                           std::string const &address, int port)
+    : bson_rpc_client_(std::make_unique<ClientBsonRPCSocket>(AF_INET, address, port)),
+      watch_(watch),
+      change_callback_(std::move(change_callback)) {
+  if (watch_) {
+    registerTypedCallback(*bson_rpc_client_, kGraphChangedRPC,
+                          [this](GraphDelta const &delta) -> void { handleChange(delta); });
+  }
+  json connecting_message = ConnectNodeRequest{node_name};
+  bson_rpc_client_->connectToServer(connecting_message);
+  synchronize();
+}
+
+GraphWatcher::~GraphWatcher() {
+  if (bson_rpc_client_->connected()) bson_rpc_client_->close();
+}
+
+GraphView GraphWatcher::graph() {
+  std::lock_guard<std::mutex> graph_lock_guard(graph_lock_);
+  return graph_;
+}
+
+void GraphWatcher::synchronize() {
+  // Hold pushed changes back while fetching, since they may arrive before the fetch's response.
+  std::unique_lock<std::mutex> unique_graph_lock(graph_lock_);
+  synchronized_ = false;
+  std::uint64_t since_version = graph_.version();
+  unique_graph_lock.unlock();
+
+  GraphUpdate update = sendTypedRequestAndGetFuture(*bson_rpc_client_, kGetGraphRPC, {watch_, since_version}).get();
+  unique_graph_lock.lock();
+  if (!graph_.apply(update)) {
+    // The deltas did not follow on from the view, so fall back to a full snapshot.
+    unique_graph_lock.unlock();
+    update = sendTypedRequestAndGetFuture(*bson_rpc_client_, kGetGraphRPC, {watch_, 0}).get();
+    unique_graph_lock.lock();
+    graph_.apply(update);
+  }
+
+  // Apply the changes pushed during the fetch, skipping those the fetch already covered.
+  std::vector<GraphDelta> applied_deltas;
+  synchronized_ = true;
+  for (auto const &delta : pending_deltas_) {
+    std::uint64_t previous_version = graph_.version();
+    if (!graph_.apply(delta)) {
+      synchronized_ = false;
+      break;
+    }
+    if (graph_.version() > previous_version) applied_deltas.push_back(delta);
+  }
+  pending_deltas_.clear();
+  unique_graph_lock.unlock();
+
+  if (change_callback_) {
+    for (auto const &delta : applied_deltas) change_callback_(delta);
+  }
+}
+
+bool GraphWatcher::synchronized() {
+  std::lock_guard<std::mutex> graph_lock_guard(graph_lock_);
+  return synchronized_;
+}
+
+bool GraphWatcher::connected() { return bson_rpc_client_->connected(); }
+
+std::vector<std::string> GraphWatcher::killNode(std::string const &node_name) {
+  return sendTypedRequestAndGetFuture(*bson_rpc_client_, kKillNodeRPC, {node_name}).get().node_uris;
+}
+
+void GraphWatcher::handleChange(GraphDelta const &delta) {
+  std::unique_lock<std::mutex> unique_graph_lock(graph_lock_);
+  if (!synchronized_) {
+    pending_deltas_.push_back(delta);
+    return;
+  }
+  std::uint64_t previous_version = graph_.version();
+  if (!graph_.apply(delta)) {
+    // A change was lost. Keep this one for the next synchronize().
+    synchronized_ = false;
+    pending_deltas_.push_back(delta);
+    return;
+  }
+  bool applied = graph_.version() > previous_version;
+  unique_graph_lock.unlock();
+  if (applied && change_callback_) change_callback_(delta);
+}
@@ -0,0 +1,242 @@
+#include "mros/message_filter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <variant>
+
+/**
+ * Bson type bytes of the values a filter reads or must skip over.
+ */
+static constexpr std::uint8_t kDouble = 0x01;
+static constexpr std::uint8_t kString = 0x02;
+static constexpr std::uint8_t kDocument = 0x03;
+static constexpr std::uint8_t kArray = 0x04;
+static constexpr std::uint8_t kBinary = 0x05;
+static constexpr std::uint8_t kUndefined = 0x06;
+static constexpr std::uint8_t kObjectId = 0x07;
+static constexpr std::uint8_t kBoolean = 0x08;
+static constexpr std::uint8_t kDateTime = 0x09;
+static constexpr std::uint8_t kNull = 0x0A;
+static constexpr std::uint8_t kRegex = 0x0B;
+static constexpr std::uint8_t kJavaScript = 0x0D;
+static constexpr std::uint8_t kInt32 = 0x10;
+static constexpr std::uint8_t kUInt64 = 0x11;  // Timestamp in the Bson specification, used by some encoders for uint64.
+static constexpr std::uint8_t kInt64 = 0x12;
+static constexpr std::uint8_t kDecimal128 = 0x13;
+static constexpr std::uint8_t kMaxKey = 0x7F;
+static constexpr std::uint8_t kMinKey = 0xFF;
+
+/**
+ * A numeric Bson value, kept exact for integers.
+ */
+using BsonNumber = std::variant<std::int64_t, std::uint64_t, double>;
+
+/**
+ * Read a value from the front of a byte range in host byte order, which on the little endian hosts mros runs on is the
+ * byte order of Bson.
+ */
+template <typename T>
+static T readLittleEndian(std::span<std::uint8_t const> bytes) {
+  T value;
+  std::memcpy(&value, bytes.data(), sizeof(T));
+  return value;
+}
+
+/**
+ * Get the size of a value of a type at the front of a byte range.
+ * @return False if the type is unknown or the value runs past the range, true otherwise.
+ */
+static bool valueSize(std::uint8_t type, std::span<std::uint8_t const> bytes, std::size_t &size) {
+  switch (type) {
+    case kDouble:
+    case kDateTime:
+    case kUInt64:
+    case kInt64:
+      size = 8;
+      break;
+    case kInt32:
+      size = 4;
+      break;
+    case kBoolean:
+      size = 1;
+      break;
+    case kObjectId:
+      size = 12;
+      break;
+    case kDecimal128:
+      size = 16;
+      break;
+    case kUndefined:
+    case kNull:
+    case kMinKey:
+    case kMaxKey:
+      size = 0;
+      break;
+    case kString:
+    case kJavaScript:
+    case kBinary: {
+      if (bytes.size() < 4) return false;
+      auto length = readLittleEndian<std::int32_t>(bytes);
+      if (length < 0) return false;
+      size = 4 + static_cast<std::size_t>(length) + (type == kBinary ? 1 : 0);
+      break;
+    }
+    case kDocument:
+    case kArray: {
+      if (bytes.size() < 4) return false;
+      auto length = readLittleEndian<std::int32_t>(bytes);
+      if (length < 5) return false;
+      size = static_cast<std::size_t>(length);
+      break;
+    }
+    case kRegex: {
+      // Pattern and options, each a null terminated string.
+      auto pattern_end = std::find(bytes.begin(), bytes.end(), 0);
+      if (pattern_end == bytes.end()) return false;
+      auto options_end = std::find(pattern_end + 1, bytes.end(), 0);
+      if (options_end == bytes.end()) return false;
+      size = static_cast<std::size_t>(options_end - bytes.begin()) + 1;
+      break;
+    }
+    default:
+      return false;
+  }
+  return size <= bytes.size();
+}
+
+bool findBsonField(std::span<std::uint8_t const> bson, std::string_view field, BsonElement &element) {
+  std::span<std::uint8_t const> document = bson;
+  while (true) {
+    std::size_t dot = field.find('.');
+    std::string_view name = field.substr(0, dot);
+
+    // Check the document's size and terminator, then walk its elements until the name.
+    if (document.size() < 5) return false;
+    auto document_size = readLittleEndian<std::int32_t>(document);
+    if (document_size < 5 || static_cast<std::size_t>(document_size) > document.size()) return false;
+    document = document.first(static_cast<std::size_t>(document_size) - 1);
+    bool found = false;
+    for (std::size_t offset = 4; offset < document.size() && !found;) {
+      std::uint8_t type = document[offset++];
+      auto name_end = std::find(document.begin() + static_cast<std::ptrdiff_t>(offset), document.end(), 0);
+      if (name_end == document.end()) return false;
+      std::string_view element_name(reinterpret_cast<char const *>(document.data() + offset),
+                                    static_cast<std::size_t>(name_end - document.begin()) - offset);
+      offset += element_name.size() + 1;
+      std::size_t size;
+      if (!valueSize(type, document.subspan(offset), size)) return false;
+      if (element_name == name) {
+        element = {type, document.subspan(offset, size)};
+        found = true;
+      }
+      offset += size;
+    }
+    if (!found) return false;
+    if (dot == std::string_view::npos) return true;
+    if (element.type != kDocument && element.type != kArray) return false;
+    document = element.value;
+    field = field.substr(dot + 1);
+  }
+}
+
+/**
+ * Read a numeric element.
+ * @return False if the element is not a number, true otherwise.
+ */
+static bool readNumber(BsonElement const &element, BsonNumber &number) {
+  switch (element.type) {
+    case kDouble:
+      number = readLittleEndian<double>(element.value);
+      return true;
+    case kInt32:
+      number = static_cast<std::int64_t>(readLittleEndian<std::int32_t>(element.value));
+      return true;
+    case kInt64:
+    case kDateTime:
+      number = readLittleEndian<std::int64_t>(element.value);
+      return true;
+    case kUInt64:
+      number = readLittleEndian<std::uint64_t>(element.value);
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Convert a number to a double, rounding large integers.
+ */
+static double toDouble(BsonNumber const &number) {
+  return std::visit([](auto value) -> double { return static_cast<double>(value); }, number);
+}
+
+/**
+ * Compare two numbers by value, exactly when both are integers.
+ */
+static bool numbersEqual(BsonNumber const &left, BsonNumber const &right) {
+  if (std::holds_alternative<double>(left) || std::holds_alternative<double>(right)) {
+    return toDouble(left) == toDouble(right);
+  }
+  return std::visit(
+      [](auto left_value, auto right_value) -> bool {
+        if constexpr (std::is_integral_v<decltype(left_value)> && std::is_integral_v<decltype(right_value)>) {
+          return std::cmp_equal(left_value, right_value);
+        } else {
+          return false;
+        }
+      },
+      left, right);
+}
+
+/**
+ * Test an element against the value of an equals condition.
+ */
+static bool elementEquals(BsonElement const &element, nlohmann::json const &value) {
+  BsonNumber number;
+  if (value.is_number()) {
+    if (!readNumber(element, number)) return false;
+    if (value.is_number_unsigned()) return numbersEqual(number, value.get<std::uint64_t>());
+    if (value.is_number_integer()) return numbersEqual(number, value.get<std::int64_t>());
+    return numbersEqual(number, value.get<double>());
+  }
+  if (value.is_string()) {
+    if (element.type != kString) return false;
+    auto const &string = value.get_ref<std::string const &>();
+
+    // The encoded string's length includes its null terminator.
+    return element.value.size() == 4 + string.size() + 1 &&
+           std::equal(string.begin(), string.end(), element.value.begin() + 4);
+  }
+  if (value.is_boolean()) return element.type == kBoolean && (element.value[0] != 0) == value.get<bool>();
+  if (value.is_null()) return element.type == kNull;
+  return false;
+}
+
+MessageFilter &MessageFilter::whereEquals(std::string field, nlohmann::json value) {
+  conditions.push_back({std::move(field), FieldConditionKind::kEquals, std::move(value)});
+  return *this;
+}
+
+MessageFilter &MessageFilter::whereInRange(std::string field, double min, double max) {
+  conditions.push_back({std::move(field), FieldConditionKind::kRange, nullptr, min, max});
+  return *this;
+}
+
+bool MessageFilter::empty() const { return conditions.empty(); }
+
+bool MessageFilter::matches(std::span<std::uint8_t const> bson) const {
+  BsonElement element;
+  for (auto const &condition : conditions) {
+    if (!findBsonField(bson, condition.field, element)) return false;
+    if (condition.kind == FieldConditionKind::kEquals) {
+      if (!elementEquals(element, condition.value)) return false;
+    } else {
+      BsonNumber number;
+      if (!readNumber(element, number)) return false;
+      double value = toDouble(number);
+      if (value < condition.min || value > condition.max) return false;
+    }
+  }
+  return true;
+}
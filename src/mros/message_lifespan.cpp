@@ -0,0 +1,14 @@
+#include "mros/message_lifespan.hpp"
+
+#include "mros/utils/topic_frame.hpp"
+
+MessageLifespan::MessageLifespan(Clock::duration lifespan, LifespanClock clock) : lifespan_(lifespan), clock_(clock) {}
+
+bool MessageLifespan::expired(ByteSpan frame, Clock::time_point receive_time, Clock::time_point now) const {
+  if (!limited()) return false;
+  if (clock_ == LifespanClock::kReceiveTime) return now - receive_time > lifespan_;
+  TopicFrameHeader header;
+  if (!header.decode(frame)) return false;
+  return TopicFrameHeader::now() - header.publish_time_ns >
+         std::chrono::duration_cast<std::chrono::nanoseconds>(lifespan_).count();
+}
@@ -1,23 +1,29 @@
 #include "mros/node.hpp"
 
+#include <algorithm>
 #include <iostream>
 
-Node::Node(const std::string& node_name)
-    : connected_(false), node_name_(node_name), mros_(MROS::getMROS()), logger_(Logger::getLogger()) {
+Node::Node(const std::string& node_name, std::string const& mediator_address, int mediator_port, NodeOptions options)
+    : options_(std::move(options)),
+      connected_(false),
+      node_name_(node_name),
+      mros_(MROS::getMROS()),
+      logger_(Logger::getLogger()) {
   LogContext context("Node::Node");
   // Set up the client rpc socket with the Mediator server address.
-  bson_rpc_client_ = std::make_unique<ClientBsonRPCSocket>(AF_INET, "127.0.0.1", 13331);
+  bson_rpc_client_ = std::make_unique<ClientBsonRPCSocket>(AF_INET, mediator_address, mediator_port);
 
   // Register the callback to allow the Mediator to connect Subscribers to Publishers.
-  bson_rpc_client_->registerRequestCallback("connectSubscriberToPublishers", [this](json const& input) -> void {
-    return jsonConnectSubscriberToPublishersCallback(input);
-  });
+  registerTypedCallback(*bson_rpc_client_, kConnectSubscriberToPublishersRPC,
+                        [this](PublisherAddresses const& publishers) -> void {
+                          connectSubscriberToPublishers(publishers);
+                        });
 
   // Register the closing callback to disconnect the Node and all of its Publishers and Subscribers.
   bson_rpc_client_->registerClosingCallback([this]() -> void { disconnect(); });
 
   // Connect to the Mediator and send the Node's name to start the rpc.
-  json connecting_message{{"node_name", node_name}};
+  json connecting_message = ConnectNodeRequest{node_name};
   try {
     bson_rpc_client_->connectToServer(connecting_message);
     connected_ = true;
@@ -26,7 +32,10 @@ Node::Node(const std::string& node_name)
   }
 
   // Register the disconnect routine as a deactivation routine for ctrl+C via MROS.
-  mros_.registerDeactivateRoutine([this]() -> void { disconnect(); });
+  deactivate_target_ = std::make_shared<Node*>(this);
+  mros_.registerDeactivateRoutine([weak_target = std::weak_ptr<Node*>(deactivate_target_)]() -> void {
+    if (auto target = weak_target.lock()) (*target)->disconnect();
+  });
 }
 
 Node::~Node() {
@@ -34,10 +43,13 @@ Node::~Node() {
 }
 
 void Node::spin() {
-  // Spin all the Subscribers.
+  // Hand all the Subscribers to the callback executor.
+  std::unique_lock<std::mutex> unique_timer_scheduler_lock(timer_scheduler_mutex_);
+  std::shared_ptr<ThreadPool> callback_executor = callbackExecutor();
+  unique_timer_scheduler_lock.unlock();
   for (const auto& topic_subscriber_ptr : subscribers_) {
     if (auto subscriber_ptr = topic_subscriber_ptr.second.lock()) {
-      subscriber_ptr->spin();
+      subscriber_ptr->spinOn(callback_executor);
     }
   }
 
@@ -56,33 +68,64 @@ void Node::spinOnce() {
   }
 }
 
-void Node::connectSubscriberToPublishers(TopicName topic_name, std::vector<std::string> hosts, std::vector<int> ports) {
+std::shared_ptr<Timer> Node::createTimer(std::chrono::steady_clock::duration period, std::function<void()> callback) {
+  std::lock_guard<std::mutex> timer_scheduler_lock_guard(timer_scheduler_mutex_);
+  if (!timer_scheduler_) timer_scheduler_ = std::make_unique<TimerScheduler>(*callbackExecutor());
+  return timer_scheduler_->createTimer(period, std::move(callback));
+}
+
+std::shared_ptr<Timer> Node::createOneShotTimer(std::chrono::steady_clock::duration delay,
+                                                std::function<void()> callback) {
+  std::lock_guard<std::mutex> timer_scheduler_lock_guard(timer_scheduler_mutex_);
+  if (!timer_scheduler_) timer_scheduler_ = std::make_unique<TimerScheduler>(*callbackExecutor());
+  return timer_scheduler_->createOneShotTimer(delay, std::move(callback));
+}
+
+std::array<TaskPriorityStatistics, kTaskPriorityCount> Node::callbackStatistics() {
+  std::unique_lock<std::mutex> unique_timer_scheduler_lock(timer_scheduler_mutex_);
+  std::shared_ptr<ThreadPool> callback_executor = callback_executor_;
+  unique_timer_scheduler_lock.unlock();
+  return callback_executor ? callback_executor->statistics() : std::array<TaskPriorityStatistics, kTaskPriorityCount>{};
+}
+
+std::shared_ptr<ThreadPool> const& Node::callbackExecutor() {
+  if (!callback_executor_) {
+    callback_executor_ = std::make_shared<ThreadPool>(options_.callback_thread_count, options_.callback_executor);
+  }
+  return callback_executor_;
+}
+
+void Node::spawn(Flow flow) {
+  std::unique_lock<std::mutex> unique_coroutine_scheduler_lock(coroutine_scheduler_mutex_);
+  if (!coroutine_scheduler_) coroutine_scheduler_ = std::make_shared<CoroutineScheduler>();
+  std::shared_ptr<CoroutineScheduler> coroutine_scheduler = coroutine_scheduler_;
+  unique_coroutine_scheduler_lock.unlock();
+  coroutine_scheduler->spawn(std::move(flow));
+}
+
+void Node::connectSubscriberToPublishers(PublisherAddresses const& publishers) {
   // If there is a subscriber on the topic, connect it to all the supplied publisher addresses.
-  auto it = subscribers_.find(topic_name);
+  auto it = subscribers_.find(publishers.topic_name);
   if (it != subscribers_.end()) {
     if (auto subscriber_ptr = it->second.lock()) {
-      for (int i = 0; i < hosts.size(); ++i) {
-        subscriber_ptr->connectToPublisher(hosts[i], ports[i]);
+      std::size_t publisher_count = std::min({publishers.publisher_addresses.size(), publishers.publisher_ports.size(),
+                                              publishers.publisher_transports.size(),
+                                              publishers.publisher_interface_addresses.size()});
+      for (std::size_t i = 0; i < publisher_count; ++i) {
+        subscriber_ptr->connectToPublisher(publishers.publisher_addresses[i], publishers.publisher_ports[i],
+                                           publishers.publisher_transports[i],
+                                           publishers.publisher_interface_addresses[i]);
       }
     }
   }
 }
 
-void Node::jsonConnectSubscriberToPublishersCallback(json const& json) {
-  // Unpack the parameters in the Json message and call the main callback function with those parameters.
-  std::string topic_name = json["topic_name"];
-  std::vector<std::string> hosts = json["publisher_addresses"];
-  std::vector<int> ports = json["publisher_ports"];
-  connectSubscriberToPublishers(topic_name, hosts, ports);
-}
-
 void Node::removeSubscriberByTopic(TopicName topic_name) {
   // Remove the pointer to the subscriber from the container.
   subscribers_.erase(topic_name);
 
   // Tell the Mediator to remove the subscriber from its database.
-  json message {{"topic_name", topic_name}};
-  bson_rpc_client_->sendRequest("removeSubscriber", message);
+  sendTypedRequest(*bson_rpc_client_, kRemoveSubscriberRPC, {topic_name});
 }
 
 void Node::removePublisherByTopic(TopicName topic_name) {
@@ -90,8 +133,7 @@ void Node::removePublisherByTopic(TopicName topic_name) {
   publishers_.erase(topic_name);
 
   // Tell the Mediator to remove the publisher from its database.
-  json message {{"topic_name", topic_name}};
-  bson_rpc_client_->sendRequest("removePublisher", message);
+  sendTypedRequest(*bson_rpc_client_, kRemovePublisherRPC, {topic_name});
 }
 
 void Node::disconnect() {
@@ -117,6 +159,16 @@ void Node::disconnect() {
       }
     }
 
+    // Stop running timers. Callbacks already handed to the executor still finish.
+    std::unique_lock<std::mutex> unique_timer_scheduler_lock(timer_scheduler_mutex_);
+    if (timer_scheduler_) timer_scheduler_->shutdown();
+    unique_timer_scheduler_lock.unlock();
+
+    // Stop resuming coroutines once those already woken, such as by the subscribers disconnecting, have run.
+    std::unique_lock<std::mutex> unique_coroutine_scheduler_lock(coroutine_scheduler_mutex_);
+    if (coroutine_scheduler_) coroutine_scheduler_->shutdown();
+    unique_coroutine_scheduler_lock.unlock();
+
     // Signal the condition variable to release any user thread blocked on spin().
     spin_condition_variable_.notify_all();
   }
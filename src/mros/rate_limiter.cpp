@@ -0,0 +1,20 @@
+#include "mros/rate_limiter.hpp"
+
+RateLimiter::RateLimiter(double max_rate_hz)
+    : period_(max_rate_hz > 0
+                  ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / max_rate_hz))
+                  : Clock::duration::zero()),
+      next_time_() {}
+
+bool RateLimiter::due(Clock::time_point now) const { return !limited() || now >= next_time_ - period_ / 4; }
+
+void RateLimiter::take(Clock::time_point now) {
+  if (!limited()) return;
+  if (now - next_time_ >= period_) {
+    next_time_ = now + period_;
+  } else {
+    next_time_ += period_;
+  }
+}
+
+bool RateLimiter::limited() const { return period_ > Clock::duration::zero(); }
@@ -0,0 +1,126 @@
+#include "mros/wait_set.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "mros/subscriber.hpp"
+
+void WaitSignal::notify() {
+  std::lock_guard<std::mutex> lock_guard(mutex_);
+  raised_ = true;
+  condition_variable_.notify_all();
+}
+
+void WaitSignal::reset() {
+  std::lock_guard<std::mutex> lock_guard(mutex_);
+  raised_ = false;
+}
+
+bool WaitSignal::waitUntil(Clock::time_point deadline) {
+  std::unique_lock<std::mutex> unique_lock(mutex_);
+  if (deadline == Clock::time_point::max()) {
+    condition_variable_.wait(unique_lock, [this]() -> bool { return raised_; });
+  } else {
+    condition_variable_.wait_until(unique_lock, deadline, [this]() -> bool { return raised_; });
+  }
+  return raised_;
+}
+
+void WaitSignals::attach(std::shared_ptr<WaitSignal> const &wait_signal) {
+  std::lock_guard<std::mutex> lock_guard(mutex_);
+  wait_signals_.push_back(wait_signal);
+}
+
+void WaitSignals::notify() {
+  std::lock_guard<std::mutex> lock_guard(mutex_);
+  std::erase_if(wait_signals_, [](std::weak_ptr<WaitSignal> const &weak_wait_signal) -> bool {
+    auto wait_signal = weak_wait_signal.lock();
+    if (!wait_signal) return true;
+    wait_signal->notify();
+    return false;
+  });
+}
+
+void GuardCondition::trigger() {
+  std::unique_lock<std::mutex> unique_lock(mutex_);
+  triggered_ = true;
+  unique_lock.unlock();
+  wait_signals_.notify();
+}
+
+bool GuardCondition::take() {
+  std::lock_guard<std::mutex> lock_guard(mutex_);
+  return std::exchange(triggered_, false);
+}
+
+WaitSet::WaitSet() : wait_signal_(std::make_shared<WaitSignal>()) {}
+
+void WaitSet::addSubscriber(std::shared_ptr<SubscriberBase> subscriber) {
+  subscriber->wait_signals_.attach(wait_signal_);
+  subscribers_.push_back(std::move(subscriber));
+}
+
+void WaitSet::addTimer(Clock::duration period, std::function<void()> callback) {
+  timers_.push_back({period, Clock::now() + period, std::move(callback)});
+}
+
+void WaitSet::addGuardCondition(std::shared_ptr<GuardCondition> guard_condition, std::function<void()> callback) {
+  guard_condition->wait_signals_.attach(wait_signal_);
+  guard_conditions_.push_back({std::move(guard_condition), std::move(callback)});
+}
+
+WaitResult WaitSet::wait(Clock::duration timeout) {
+  Clock::time_point deadline = timeout < Clock::duration::zero() ? Clock::time_point::max() : Clock::now() + timeout;
+  while (true) {
+    // Lower the signal before checking, so that anything becoming ready after its check raises it again and the wait
+    // below returns at once.
+    wait_signal_->reset();
+    Clock::time_point now = Clock::now();
+    WaitResult result = collectReady(now);
+    if (!result.empty() || now >= deadline) return result;
+    wait_signal_->waitUntil(std::min(deadline, nextTimerDeadline()));
+  }
+}
+
+std::size_t WaitSet::spinSome(Clock::duration timeout) {
+  WaitResult result = wait(timeout);
+  std::size_t callback_count = 0;
+  for (std::size_t index : result.guard_conditions) {
+    if (guard_conditions_[index].callback) {
+      guard_conditions_[index].callback();
+      ++callback_count;
+    }
+  }
+  for (std::size_t index : result.timers) {
+    WaitTimer &timer = timers_[index];
+    timer.callback();
+    ++callback_count;
+
+    // Keep the deadlines on the schedule, skipping those already missed by more than a period.
+    Clock::time_point now = Clock::now();
+    timer.next_deadline += timer.period;
+    if (timer.next_deadline <= now) timer.next_deadline = now + timer.period;
+  }
+  for (std::size_t index : result.subscribers) callback_count += subscribers_[index]->spinSome();
+  return callback_count;
+}
+
+WaitResult WaitSet::collectReady(Clock::time_point now) {
+  WaitResult result;
+  for (std::size_t i = 0; i < subscribers_.size(); ++i) {
+    if (subscribers_[i]->hasMessages()) result.subscribers.push_back(i);
+  }
+  for (std::size_t i = 0; i < timers_.size(); ++i) {
+    if (timers_[i].next_deadline <= now) result.timers.push_back(i);
+  }
+  for (std::size_t i = 0; i < guard_conditions_.size(); ++i) {
+    if (guard_conditions_[i].guard_condition->take()) result.guard_conditions.push_back(i);
+  }
+  return result;
+}
+
+WaitSet::Clock::time_point WaitSet::nextTimerDeadline() const {
+  Clock::time_point next_deadline = Clock::time_point::max();
+  for (auto const &timer : timers_) next_deadline = std::min(next_deadline, timer.next_deadline);
+  return next_deadline;
+}
@@ -1,10 +1,21 @@
 #include "socket/bson_rpc_socket/bson_rpc_socket.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 BsonRPCSocket::BsonRPCSocket() : is_connected_(false) {}
 
-BsonRPCSocket::~BsonRPCSocket() = default;
+BsonRPCSocket::~BsonRPCSocket() {
+  // Stop the deadline thread if it was started and wait for it to finish.
+  std::unique_lock<std::mutex> unique_pending_requests_lock(pending_requests_lock_);
+  deadline_thread_stopped_ = true;
+  pending_requests_condition_variable_.notify_all();
+  unique_pending_requests_lock.unlock();
+  if (deadline_thread_.joinable() && deadline_thread_.get_id() != std::this_thread::get_id()) deadline_thread_.join();
+}
 
 void BsonRPCSocket::close() {
   if (is_connected_) {
@@ -20,11 +31,15 @@ void BsonRPCSocket::close() {
 
 bool BsonRPCSocket::connected() { return is_connected_.load(); }
 
+bool BsonRPCSocket::closed() {
+  std::lock_guard<std::mutex> closing_lock_guard(closing_lock_);
+  return closing_message_received_;
+}
+
 void BsonRPCSocket::sendRequest(CallbackName const &callback_name, json const &callback_argument) {
-  json to_send = {{"callback name", callback_name}, {"message", callback_argument}};
   std::lock_guard<std::mutex> sendingLockGuard(sending_lock_);
   try {
-    BsonSocket::sendMessage(to_send);
+    sendRequestEnvelope(callback_name, kRequestFlag_, 0, callback_argument);
   } catch (PeerClosedException &error) {
   } catch (SocketException &error) {
   }
@@ -32,27 +47,53 @@ void BsonRPCSocket::sendRequest(CallbackName const &callback_name, json const &c
 
 void BsonRPCSocket::sendRequestAndGetResponse(CallbackName const &callback_name, json const &callback_argument,
                                               CallbackName const &response_callback_name) {
-  json to_send = {{"callback name", callback_name},
-                  {"response callback name", response_callback_name},
-                  {"message", callback_argument}};
-  std::lock_guard<std::mutex> sending_lock_guard(sending_lock_);
-  try {
-    sendMessage(to_send);
-    // Received on the recv cycle
-  } catch (PeerClosedException &error) {
-  } catch (SocketException &error) {
-  }
+  // Failures are dropped, matching a peer socket that never calls back.
+  sendRequestAndGetResponse(callback_name, callback_argument,
+                            [this, response_callback_name](std::future<json> response) -> void {
+                              invokeRequestCallback(response_callback_name, response.get());
+                            });
+}
+
+std::future<json> BsonRPCSocket::sendRequestAndGetFuture(CallbackName const &callback_name,
+                                                         json const &callback_argument, int timeout) {
+  PendingRequest pending_request;
+  std::future<json> future = pending_request.promise.get_future();
+  pending_request.deadline = timeout < 0 ? std::chrono::steady_clock::time_point::max()
+                                         : std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  sendPendingRequest(callback_name, callback_argument, std::move(pending_request));
+  return future;
+}
+
+void BsonRPCSocket::sendRequestAndGetResponse(CallbackName const &callback_name, json const &callback_argument,
+                                              ResponseCallbackJson const &response_callback, int timeout) {
+  PendingRequest pending_request;
+  pending_request.future = pending_request.promise.get_future();
+  pending_request.response_callback = response_callback;
+  pending_request.deadline = timeout < 0 ? std::chrono::steady_clock::time_point::max()
+                                         : std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+  sendPendingRequest(callback_name, callback_argument, std::move(pending_request));
 }
 
 void BsonRPCSocket::registerRequestCallback(const CallbackName &callback_name, const RequestCallbackJson &callback) {
   std::lock_guard<std::mutex> request_lock_guard(request_callbacks_lock_);
-  request_callbacks_[callback_name] = callback;
+  auto [method_id_iter, inserted] = method_ids_.try_emplace(callback_name, static_cast<MethodID>(methods_.size()));
+  if (inserted) {
+    if (methods_.size() == kUnresolvedMethodID_) throw SocketException("Too many callbacks registered.");
+    methods_.push_back({callback_name, {}, {}});
+  }
+  methods_[method_id_iter->second].request_callback = std::make_shared<RequestCallbackJson const>(callback);
 }
 
 void BsonRPCSocket::registerRequestResponseCallback(const CallbackName &callback_name,
                                                     const RequestResponseCallbackJson &callback) {
-  std::lock_guard<std::mutex> request_response_lock_guard(request_response_callbacks_lock_);
-  request_response_callbacks_[callback_name] = callback;
+  std::lock_guard<std::mutex> request_lock_guard(request_callbacks_lock_);
+  auto [method_id_iter, inserted] = method_ids_.try_emplace(callback_name, static_cast<MethodID>(methods_.size()));
+  if (inserted) {
+    if (methods_.size() == kUnresolvedMethodID_) throw SocketException("Too many callbacks registered.");
+    methods_.push_back({callback_name, {}, {}});
+  }
+  methods_[method_id_iter->second].request_response_callback =
+      std::make_shared<RequestResponseCallbackJson const>(callback);
 }
 
 void BsonRPCSocket::registerClosingCallback(const ClosingCallback &callback) {
@@ -61,23 +102,141 @@ void BsonRPCSocket::registerClosingCallback(const ClosingCallback &callback) {
   closing_callback_ = callback;
 }
 
+void BsonRPCSocket::setDispatcher(std::shared_ptr<RPCDispatcher> dispatcher) { dispatcher_ = std::move(dispatcher); }
+
+void BsonRPCSocket::sendPendingRequest(CallbackName const &callback_name, json const &callback_argument,
+                                       PendingRequest pending_request) {
+  pending_request.callback_name = callback_name;
+  bool has_deadline = pending_request.deadline != std::chrono::steady_clock::time_point::max();
+  RequestID request_id = next_request_id_++;
+
+  // Register the request before sending it so that the response cannot arrive first.
+  std::unique_lock<std::mutex> unique_pending_requests_lock(pending_requests_lock_);
+  if (has_deadline && !deadline_thread_.joinable() && !deadline_thread_stopped_) {
+    deadline_thread_ = std::thread(&BsonRPCSocket::expireRequestsUntilClosed, this);
+  }
+  pending_requests_.emplace(request_id, std::move(pending_request));
+  if (has_deadline) pending_requests_condition_variable_.notify_one();
+  unique_pending_requests_lock.unlock();
+
+  std::exception_ptr error;
+  sending_lock_.lock();
+  try {
+    if (!is_connected_) throw SocketException("Cannot send request on disconnected socket.");
+    sendRequestEnvelope(callback_name, kRequestResponseFlag_, request_id, callback_argument);
+  } catch (SocketException &send_error) {
+    error = std::current_exception();
+  }
+  sending_lock_.unlock();
+
+  // Fail the request right away if it could not be sent, unless closing or a timeout has already failed it.
+  if (error) {
+    unique_pending_requests_lock.lock();
+    auto pending_request_iter = pending_requests_.find(request_id);
+    if (pending_request_iter == pending_requests_.end()) return;
+    auto pending_request_node = pending_requests_.extract(pending_request_iter);
+    unique_pending_requests_lock.unlock();
+    completePendingRequest(pending_request_node.mapped(), nullptr, error);
+  }
+}
+
+void BsonRPCSocket::completePendingRequest(PendingRequest &pending_request, json const *response,
+                                           std::exception_ptr const &error) {
+  if (error) {
+    pending_request.promise.set_exception(error);
+  } else {
+    pending_request.promise.set_value(*response);
+  }
+  if (pending_request.response_callback) {
+    try {
+      pending_request.response_callback(std::move(pending_request.future));
+    } catch (...) {
+    }
+  }
+}
+
+void BsonRPCSocket::failPendingRequests(std::exception_ptr const &error) {
+  // Take every pending request and stop the deadline thread, then fail the requests without holding the lock.
+  std::unique_lock<std::mutex> unique_pending_requests_lock(pending_requests_lock_);
+  std::vector<PendingRequest> failed_requests;
+  for (auto &id_request_pair : pending_requests_) failed_requests.push_back(std::move(id_request_pair.second));
+  pending_requests_.clear();
+  deadline_thread_stopped_ = true;
+  pending_requests_condition_variable_.notify_all();
+  unique_pending_requests_lock.unlock();
+  for (auto &failed_request : failed_requests) completePendingRequest(failed_request, nullptr, error);
+}
+
+void BsonRPCSocket::expireRequestsUntilClosed() {
+  std::unique_lock<std::mutex> unique_pending_requests_lock(pending_requests_lock_);
+  while (!deadline_thread_stopped_) {
+    // Collect the expired requests and find the next deadline among the rest.
+    auto now = std::chrono::steady_clock::now();
+    auto next_deadline = std::chrono::steady_clock::time_point::max();
+    std::vector<PendingRequest> expired_requests;
+    for (auto pending_request_iter = pending_requests_.begin(); pending_request_iter != pending_requests_.end();) {
+      if (pending_request_iter->second.deadline <= now) {
+        expired_requests.push_back(std::move(pending_request_iter->second));
+        pending_request_iter = pending_requests_.erase(pending_request_iter);
+      } else {
+        next_deadline = std::min(next_deadline, pending_request_iter->second.deadline);
+        ++pending_request_iter;
+      }
+    }
+
+    // Fail the expired requests without holding the lock since their callbacks may send new requests.
+    if (!expired_requests.empty()) {
+      unique_pending_requests_lock.unlock();
+      for (auto &expired_request : expired_requests) {
+        completePendingRequest(expired_request, nullptr,
+                               std::make_exception_ptr(RPCTimeoutException(expired_request.callback_name)));
+      }
+      unique_pending_requests_lock.lock();
+      continue;
+    }
+    if (next_deadline == std::chrono::steady_clock::time_point::max()) {
+      pending_requests_condition_variable_.wait(unique_pending_requests_lock);
+    } else {
+      pending_requests_condition_variable_.wait_until(unique_pending_requests_lock, next_deadline);
+    }
+  }
+}
+
 void BsonRPCSocket::startReceiveCycle() {
   receiving_thread_ = std::thread(&BsonRPCSocket::receiveCycle, this);
   receiving_thread_.detach();
 }
 
+json BsonRPCSocket::getMethodNames() {
+  std::lock_guard<std::mutex> request_lock_guard(request_callbacks_lock_);
+  json method_names = json::array();
+  for (auto const &method : methods_) method_names.push_back(method.name);
+  return method_names;
+}
+
+void BsonRPCSocket::setPeerMethodNames(json const &method_names) {
+  std::lock_guard<std::mutex> peer_method_ids_lock_guard(peer_method_ids_lock_);
+  peer_method_ids_.clear();
+  if (!method_names.is_array()) return;
+  for (std::size_t method_id = 0; method_id < method_names.size() && method_id < kUnresolvedMethodID_; ++method_id) {
+    if (method_names[method_id].is_string()) {
+      peer_method_ids_.emplace(method_names[method_id].get<CallbackName>(), static_cast<MethodID>(method_id));
+    }
+  }
+}
+
 void BsonRPCSocket::receiveCycle() {
-  json received_message;
+  Bson frame;
+  Envelope envelope;
   while (true) {
+    bool closing;
     try {
-      received_message = receiveMessage();
-    } catch (PeerClosedException &error) {
+      frame = receiveFrame();
+      closing = !decodeEnvelope(frame, envelope) || (envelope.flags & kCloseFlag_);
     } catch (SocketException &error) {
+      closing = true;
     }
-    auto closing_message_iter = received_message.find("close");
-    auto callback_name_iter = received_message.find("callback name");
-    auto request_response_callback_iter = received_message.find("response callback name");
-    if (closing_message_iter != received_message.end() || received_message.empty() || received_message.is_discarded()) {
+    if (closing) {
       sending_lock_.lock();
       if (is_connected_) {
         is_connected_.store(false);
@@ -86,6 +245,13 @@ void BsonRPCSocket::receiveCycle() {
       BsonSocket::close();
       sending_lock_.unlock();
 
+      // Unblock every caller still waiting on a response, then let dispatched callbacks finish with this socket.
+      failPendingRequests(std::make_exception_ptr(PeerClosedException()));
+      std::unique_lock<std::mutex> unique_in_flight_callbacks_lock(in_flight_callbacks_lock_);
+      in_flight_callbacks_condition_variable_.wait(unique_in_flight_callbacks_lock,
+                                                   [this]() -> bool { return in_flight_callbacks_ == 0; });
+      unique_in_flight_callbacks_lock.unlock();
+
       // Execute closing callback if one is registered;
       closing_callback_lock_.lock();
       if (closing_callback_set_) {
@@ -98,39 +264,184 @@ void BsonRPCSocket::receiveCycle() {
       closing_condition_variable_.notify_one();
       unique_closing_lock.unlock();
       break;
-    } else if (request_response_callback_iter != received_message.end()) {
-      processRequestResponse(received_message);
-    } else if (callback_name_iter != received_message.end()) {
-      processRequest(received_message);
     }
-    received_message.clear();
+
+    // A request that fails to decode or whose callback throws is dropped rather than ending the connection.
+    ByteSpan payload(frame.data() + kEnvelopeSize_, frame.size() - kEnvelopeSize_);
+    try {
+      if (envelope.flags & kResponseFlag_) {
+        processResponse(envelope, payload);
+      } else if (envelope.flags & kRequestResponseFlag_) {
+        processRequestResponse(envelope, payload);
+      } else if (envelope.flags & kRequestFlag_) {
+        processRequest(envelope, payload);
+      }
+    } catch (std::exception const &error) {
+    }
   }
 }
 
-void BsonRPCSocket::processRequest(json const &callback_argument) {
-  std::lock_guard<std::mutex> lock_guard(request_callbacks_lock_);
-  std::string callback_name = callback_argument["callback name"].get<std::string>();
-  auto request_callback_iterator = request_callbacks_.find(callback_name);
-  if (request_callback_iterator != request_callbacks_.end()) {
-    request_callback_iterator->second(callback_argument["message"]);
+void BsonRPCSocket::processRequest(Envelope const &envelope, ByteSpan payload) {
+  json callback_argument;
+  Method method = resolveRequest(envelope, payload, callback_argument);
+  if (!method.request_callback) return;
+  runCallback(method.name, [callback = std::move(method.request_callback),
+                            callback_argument = std::move(callback_argument)]() -> void {
+    (*callback)(callback_argument);
+  });
+}
+
+void BsonRPCSocket::processRequestResponse(Envelope const &envelope, ByteSpan payload) {
+  json callback_argument;
+  Method method = resolveRequest(envelope, payload, callback_argument);
+  CallbackName callback_name = method.name;
+  runCallback(callback_name, [this, request_id = envelope.request_id, method = std::move(method),
+                              callback_argument = std::move(callback_argument)]() -> void {
+    respondToRequest(request_id, method, callback_argument);
+  });
+}
+
+void BsonRPCSocket::respondToRequest(RequestID request_id, Method const &method, json const &callback_argument) {
+  // Every request is answered with a response carrying its ID, including failures, so the caller never hangs.
+  Envelope response_envelope{kUnresolvedMethodID_, kResponseFlag_, request_id};
+  json response;
+  if (!method.request_response_callback) {
+    response_envelope.flags |= kErrorFlag_;
+    response = {{"error", "No request response callback named " + method.name + "."}};
+  } else {
+    try {
+      response = (*method.request_response_callback)(callback_argument);
+    } catch (std::exception const &error) {
+      response_envelope.flags |= kErrorFlag_;
+      response = {{"error", error.what()}};
+    }
+  }
+
+  std::lock_guard<std::mutex> sending_lock_guard(sending_lock_);
+  try {
+    sendEnvelope(response_envelope, response);
+  } catch (SocketException &error) {
   }
 }
 
-void BsonRPCSocket::processRequestResponse(nlohmann::json const &callback_argument) {
-  std::lock_guard<std::mutex> lock_guard(request_response_callbacks_lock_);
-  std::string const response_callback_name = callback_argument["response callback name"].get<std::string>();
-  std::string const callback_name = callback_argument["callback name"].get<std::string>();
-  auto request_response_callback_iter = request_response_callbacks_.find(callback_name);
-  if (request_response_callback_iter != request_response_callbacks_.end()) {
-    json callback_result = request_response_callback_iter->second(callback_argument["message"]);
-    sendRequest(response_callback_name, callback_result);
+void BsonRPCSocket::runCallback(CallbackName const &callback_name, Task task) {
+  if (!dispatcher_) {
+    task();
+    return;
   }
+  std::unique_lock<std::mutex> unique_in_flight_callbacks_lock(in_flight_callbacks_lock_);
+  ++in_flight_callbacks_;
+  unique_in_flight_callbacks_lock.unlock();
+  dispatcher_->dispatch(this, callback_name, [this, task = std::move(task)]() -> void {
+    try {
+      task();
+    } catch (...) {
+    }
+    std::lock_guard<std::mutex> in_flight_callbacks_lock_guard(in_flight_callbacks_lock_);
+    if (--in_flight_callbacks_ == 0) in_flight_callbacks_condition_variable_.notify_all();
+  });
+}
+
+void BsonRPCSocket::processResponse(Envelope const &envelope, ByteSpan payload) {
+  // Take the matching request. It may already have timed out, in which case the response is dropped.
+  std::unique_lock<std::mutex> unique_pending_requests_lock(pending_requests_lock_);
+  auto pending_request_iter = pending_requests_.find(envelope.request_id);
+  if (pending_request_iter == pending_requests_.end()) return;
+  auto pending_request_node = pending_requests_.extract(pending_request_iter);
+  unique_pending_requests_lock.unlock();
+
+  PendingRequest &pending_request = pending_request_node.mapped();
+  json response;
+  try {
+    response = decodePayload(envelope, payload);
+  } catch (json::exception const &error) {
+    std::string error_message = "Malformed response to " + pending_request.callback_name + ".";
+    completePendingRequest(pending_request, nullptr, std::make_exception_ptr(SocketException(error_message)));
+    return;
+  }
+  if (envelope.flags & kErrorFlag_) {
+    std::string error_message = "Peer failed to handle " + pending_request.callback_name + ": " +
+                                response.value("error", std::string());
+    completePendingRequest(pending_request, nullptr, std::make_exception_ptr(SocketException(error_message)));
+  } else {
+    completePendingRequest(pending_request, &response, nullptr);
+  }
+}
+
+BsonRPCSocket::Method BsonRPCSocket::resolveRequest(Envelope const &envelope, ByteSpan payload,
+                                                    json &callback_argument) {
+  if (envelope.flags & kNamedMethodFlag_) {
+    json named_request = json::from_bson(payload.begin(), payload.end());
+    CallbackName callback_name = named_request.at("callback name").get<CallbackName>();
+    callback_argument = std::move(named_request["message"]);
+    std::lock_guard<std::mutex> request_lock_guard(request_callbacks_lock_);
+    auto method_id_iter = method_ids_.find(callback_name);
+    if (method_id_iter == method_ids_.end()) return {callback_name, nullptr, nullptr};
+    return methods_[method_id_iter->second];
+  }
+  callback_argument = decodePayload(envelope, payload);
+  std::lock_guard<std::mutex> request_lock_guard(request_callbacks_lock_);
+  if (envelope.method_id >= methods_.size()) return {"with ID " + std::to_string(envelope.method_id), nullptr, nullptr};
+  return methods_[envelope.method_id];
+}
+
+void BsonRPCSocket::invokeRequestCallback(CallbackName const &callback_name, json const &callback_argument) {
+  std::unique_lock<std::mutex> unique_request_lock(request_callbacks_lock_);
+  auto method_id_iter = method_ids_.find(callback_name);
+  if (method_id_iter == method_ids_.end()) return;
+  auto request_callback = methods_[method_id_iter->second].request_callback;
+  unique_request_lock.unlock();
+  if (request_callback) (*request_callback)(callback_argument);
+}
+
+void BsonRPCSocket::sendRequestEnvelope(CallbackName const &callback_name, std::uint8_t flags, RequestID request_id,
+                                        json const &callback_argument) {
+  Envelope envelope{kUnresolvedMethodID_, flags, request_id};
+  std::unique_lock<std::mutex> unique_peer_method_ids_lock(peer_method_ids_lock_);
+  auto peer_method_id_iter = peer_method_ids_.find(callback_name);
+  if (peer_method_id_iter != peer_method_ids_.end()) envelope.method_id = peer_method_id_iter->second;
+  unique_peer_method_ids_lock.unlock();
+
+  if (envelope.method_id == kUnresolvedMethodID_) {
+    envelope.flags |= kNamedMethodFlag_;
+    sendEnvelope(envelope, {{"callback name", callback_name}, {"message", callback_argument}});
+  } else {
+    sendEnvelope(envelope, callback_argument);
+  }
+}
+
+void BsonRPCSocket::sendEnvelope(Envelope envelope, json const &payload) {
+  Bson bson;
+  if (payload.is_object()) {
+    bson = json::to_bson(payload);
+  } else {
+    envelope.flags |= kWrappedPayloadFlag_;
+    bson = json::to_bson(json{{"message", payload}});
+  }
+  std::array<std::uint8_t, kEnvelopeSize_> header{};
+  std::memcpy(header.data(), &envelope.method_id, sizeof(MethodID));
+  header[sizeof(MethodID)] = envelope.flags;
+  std::memcpy(header.data() + sizeof(MethodID) + 2, &envelope.request_id, sizeof(RequestID));
+  sendFrame({header, bson});
+}
+
+bool BsonRPCSocket::decodeEnvelope(Bson const &frame, Envelope &envelope) {
+  if (frame.size() < kEnvelopeSize_) return false;
+  std::memcpy(&envelope.method_id, frame.data(), sizeof(MethodID));
+  envelope.flags = frame[sizeof(MethodID)];
+  std::memcpy(&envelope.request_id, frame.data() + sizeof(MethodID) + 2, sizeof(RequestID));
+  return true;
+}
+
+json BsonRPCSocket::decodePayload(Envelope const &envelope, ByteSpan payload) {
+  json message = json::from_bson(payload.begin(), payload.end());
+  if (envelope.flags & kWrappedPayloadFlag_) return std::move(message.at("message"));
+  return message;
 }
 
 void BsonRPCSocket::sendClosingMessage() {
-  json message = {{"close", closing_callback_set_}};
   try {
-    sendMessage(message);
+    sendEnvelope({kUnresolvedMethodID_, kCloseFlag_, 0}, json::object());
   } catch (PeerClosedException &error) {
   } catch (SocketException &error) {
   }
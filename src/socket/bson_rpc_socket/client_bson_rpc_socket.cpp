@@ -13,7 +13,7 @@ void ClientBsonRPCSocket::connectToServer(json const &connection_message, int ti
   ClientSocket::connect();
   waitForConnectionAndReceive(timeout);
   is_connected_ = true;
-  sendMessage(connection_message);
+  sendMessage({{"connection message", connection_message}, {"methods", getMethodNames()}});
   json all_clear = receiveMessage();
   ClientBsonRPCSocket::startReceiveCycle();
 }
@@ -27,6 +27,7 @@ void ClientBsonRPCSocket::waitForConnectionAndReceive(int timeout) {
   if (poll_result == 1) {
     // Read out connection message from peer once available, then start receiving thread.
     json acknowledgement = receiveMessage();
+    setPeerMethodNames(acknowledgement["methods"]);
     logger_.debug("Connection message received");
   } else {
     throw SocketException("Timed out waiting for connection message");
@@ -9,13 +9,25 @@ void ConnectionBsonRPCSocket::registerConnectingCallback(const RequestCallbackJs
   connecting_callback_ = std::optional<RequestCallbackJson>(callback);
 }
 
-void ConnectionBsonRPCSocket::startConnection() {
-  sendMessage({{"reply", "ack"}});
-  json connection_message = receiveMessage();
-  if (connecting_callback_) {
-    auto connecting_callback = *connecting_callback_;
-    connecting_callback(connection_message);
+void ConnectionBsonRPCSocket::startConnection(int timeout) {
+  try {
+    // Bound every receive of the handshake by the timeout so that a stuck client cannot block the caller.
+    if (timeout >= 0) setReceiveTimeout(timeout);
+    // Each side sends its method names so that requests can name callbacks by MethodID.
+    sendMessage({{"reply", "ack"}, {"methods", getMethodNames()}});
+    json connection_message = receiveMessage();
+    if (timeout >= 0) setReceiveTimeout(0);
+    setPeerMethodNames(connection_message["methods"]);
+    if (connecting_callback_) {
+      auto connecting_callback = *connecting_callback_;
+      connecting_callback(connection_message["connection message"]);
+    }
+    sendMessage({{"reply", "clr"}});
+  } catch (SocketException const &error) {
+    // The receive cycle was never started, so close without the three way handshake.
+    is_connected_.store(false);
+    BsonSocket::close();
+    throw;
   }
-  sendMessage({{"reply", "clr"}});
   startReceiveCycle();
 }
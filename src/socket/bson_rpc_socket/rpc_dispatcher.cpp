@@ -0,0 +1,73 @@
+#include "socket/bson_rpc_socket/rpc_dispatcher.hpp"
+
+RPCDispatcher::RPCDispatcher(std::size_t thread_count, DispatchPolicy default_policy)
+    : thread_pool_(thread_count), default_policy_(default_policy) {}
+
+RPCDispatcher::~RPCDispatcher() { shutdown(); }
+
+void RPCDispatcher::setPolicy(std::string const &callback_name, DispatchPolicy policy) {
+  std::lock_guard<std::mutex> serial_queues_lock_guard(serial_queues_lock_);
+  policies_[callback_name] = policy;
+}
+
+void RPCDispatcher::dispatch(void const *socket, std::string const &callback_name, Task task) {
+  // Tasks are submitted with the lock held, so that shutdown() cannot stop the pool between the check of shutdown_ and
+  // the submission, which the pool would then drop.
+  std::unique_lock<std::mutex> unique_serial_queues_lock(serial_queues_lock_);
+  auto policy_iter = policies_.find(callback_name);
+  DispatchPolicy policy = policy_iter == policies_.end() ? default_policy_ : policy_iter->second;
+  if (policy == DispatchPolicy::kParallel) {
+    if (!shutdown_) {
+      thread_pool_.submit(std::move(task));
+      return;
+    }
+  } else {
+    // Queue behind a running task with the same key, even during shutdown, since the worker running the key's queue
+    // drains it before the pool finishes. Otherwise start the key's queue with this task.
+    SerialKey key(socket, policy == DispatchPolicy::kSerializedPerMethod ? callback_name : std::string());
+    auto serial_queue_iter = serial_queues_.find(key);
+    if (serial_queue_iter != serial_queues_.end()) {
+      serial_queue_iter->second.push(std::move(task));
+      return;
+    }
+    if (!shutdown_) {
+      serial_queues_[key].push(std::move(task));
+      thread_pool_.submit([this, key]() -> void { runSerial(key); });
+      return;
+    }
+  }
+
+  // Run on the calling thread once shutdown has begun so that the callback is never silently dropped.
+  unique_serial_queues_lock.unlock();
+  try {
+    task();
+  } catch (...) {
+  }
+}
+
+void RPCDispatcher::shutdown() {
+  // Refuse new work before stopping the pool, which drops tasks submitted after it stops, then let the workers finish
+  // the tasks already submitted.
+  std::unique_lock<std::mutex> unique_serial_queues_lock(serial_queues_lock_);
+  shutdown_ = true;
+  unique_serial_queues_lock.unlock();
+  thread_pool_.shutdown();
+}
+
+void RPCDispatcher::runSerial(SerialKey const &key) {
+  // Run the key's tasks until its queue is empty. Looping keeps the queue draining after shutdown() has stopped the
+  // pool from accepting new tasks.
+  std::unique_lock<std::mutex> unique_serial_queues_lock(serial_queues_lock_);
+  auto serial_queue_iter = serial_queues_.find(key);
+  while (!serial_queue_iter->second.empty()) {
+    Task task = std::move(serial_queue_iter->second.front());
+    unique_serial_queues_lock.unlock();
+    try {
+      task();
+    } catch (...) {
+    }
+    unique_serial_queues_lock.lock();
+    serial_queue_iter->second.pop();
+  }
+  serial_queues_.erase(serial_queue_iter);
+}
@@ -1,12 +1,20 @@
 #include "socket/bson_socket/bson_socket.hpp"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <poll.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <array>
+#include <cerrno>
+#include <climits>
+#include <cstring>
 #include <sstream>
+#include <string>
 
 BsonSocket::~BsonSocket() {
   if (is_open_) {
@@ -22,81 +30,173 @@ void BsonSocket::close() {
   }
 }
 
+void BsonSocket::setNoDelay(bool no_delay) {
+  int option = no_delay ? 1 : 0;
+  if (setsockopt(file_descriptor_, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option)) == -1) {
+    throw SocketErrnoException("Failed to set TCP_NODELAY.");
+  }
+}
+
+void BsonSocket::setReceiveTimeout(int timeout) {
+  // A zero timeval makes receives block indefinitely again.
+  timeval receive_timeout{};
+  receive_timeout.tv_sec = timeout / 1000;
+  receive_timeout.tv_usec = (timeout % 1000) * 1000;
+  if (setsockopt(file_descriptor_, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout)) == -1) {
+    throw SocketErrnoException("Failed to set receive timeout.");
+  }
+}
+
+void BsonSocket::shutdown() {
+  if (is_open_) ::shutdown(file_descriptor_, SHUT_RDWR);
+}
+
 void BsonSocket::sendMessage(const json &message) {
+  Bson bson = json::to_bson(message);
+  sendFrame({bson});
+}
+
+void BsonSocket::sendFrame(std::initializer_list<ByteSpan> frame_parts) {
+  checkSendable();
+
+  // Gather the size of the frame followed by its parts so that the whole frame goes out in one call.
+  size_t frame_size = 0;
+  for (auto const &frame_part : frame_parts) frame_size += frame_part.size();
+  std::array<iovec, kMaxFrameParts_ + 1> frame_vector{};
+  if (frame_parts.size() > kMaxFrameParts_) throw SocketException("Too many frame parts.");
+  frame_vector[0] = {&frame_size, sizeof(frame_size)};
+  std::size_t vector_count = 1;
+  for (auto const &frame_part : frame_parts) {
+    frame_vector[vector_count++] = {const_cast<std::uint8_t *>(frame_part.data()), frame_part.size()};
+  }
+  sendVector(frame_vector.data(), vector_count);
+}
+
+void BsonSocket::sendFrames(std::span<ByteSpan const> frame_parts, std::size_t parts_per_frame) {
+  if (parts_per_frame == 0 || frame_parts.size() % parts_per_frame != 0) {
+    throw SocketException("Frame parts do not divide into frames.");
+  }
+  checkSendable();
+
+  // Gather the size of each frame followed by its parts, so that all frames go out together.
+  std::size_t frame_count = frame_parts.size() / parts_per_frame;
+  std::vector<size_t> frame_sizes(frame_count);
+  std::vector<iovec> frames_vector;
+  frames_vector.reserve(frame_count + frame_parts.size());
+  for (std::size_t i = 0; i < frame_count; ++i) {
+    auto parts = frame_parts.subspan(i * parts_per_frame, parts_per_frame);
+    for (auto const &frame_part : parts) frame_sizes[i] += frame_part.size();
+    frames_vector.push_back({&frame_sizes[i], sizeof(frame_sizes[i])});
+    for (auto const &frame_part : parts) {
+      frames_vector.push_back({const_cast<std::uint8_t *>(frame_part.data()), frame_part.size()});
+    }
+  }
+  sendVector(frames_vector.data(), frames_vector.size());
+}
+
+void BsonSocket::checkSendable() {
   if (!is_open_) throw SocketException("Cannot send on closed socket.");
   pollfd poll_set{};
   poll_set.fd = file_descriptor_;
   poll_set.events = POLLRDHUP;  // Event for peer closing on a stream.
   nfds_t poll_set_count = 1;    // One file descriptor in the poll set.
-  int timeout = 1;              // One millisecond timeout.
+  int timeout = 0;              // Only check the current state, never wait.
   int poll_result = poll(&poll_set, poll_set_count, timeout);
   if (poll_result == 1) {
     // This socket registered a read hangup, meaning the peer socket is closed.
     throw PeerClosedException();
   }
-  Bson bson = json::to_bson(message);
+}
 
-  // Send size of the bson before sending the actual bson.
-  size_t bson_size = bson.size();
-  size_t size_to_complete_send = 8;
-  ssize_t send_size = 0;
-  do {
-    send_size =
-        send(file_descriptor_, reinterpret_cast<std::uint8_t *>(&bson_size) + send_size, 8 - send_size, MSG_NOSIGNAL);
-    size_to_complete_send -= send_size;
+void BsonSocket::sendVector(iovec *vector, std::size_t vector_count) {
+  msghdr message_header{};
+  while (vector_count > 0) {
+    message_header.msg_iov = vector;
+    message_header.msg_iovlen = std::min<std::size_t>(vector_count, IOV_MAX);
+    ssize_t send_size = sendmsg(file_descriptor_, &message_header, MSG_NOSIGNAL);
     if (send_size == -1) {
+      if (errno == EINTR) continue;
       throw SocketErrnoException("Failed to send to peer.");
     }
-  } while (size_to_complete_send > 0);
-
-  // Send the actual message.
-  send_size = 0;
-  size_to_complete_send = bson.size();
-  while (size_to_complete_send > 0) {
-    send_size = send(file_descriptor_, bson.data() + send_size, bson.size() - send_size, MSG_NOSIGNAL);
-    size_to_complete_send -= send_size;
-    if (send_size == -1) {
-      throw SocketErrnoException("Failed to send to peer.");
+
+    // Skip the fully sent entries and advance into the partially sent one.
+    auto remaining_size = static_cast<size_t>(send_size);
+    while (vector_count > 0 && remaining_size >= vector->iov_len) {
+      remaining_size -= vector->iov_len;
+      ++vector;
+      --vector_count;
+    }
+    if (vector_count > 0) {
+      vector->iov_base = static_cast<std::uint8_t *>(vector->iov_base) + remaining_size;
+      vector->iov_len -= remaining_size;
     }
   }
 }
 
 json BsonSocket::receiveMessage() {
+  Bson bson = receiveFrame();
+  return json::from_bson(bson.begin(), bson.end());
+}
+
+Bson BsonSocket::receiveFrame() {
   if (!is_open_) throw SocketException("Cannot receive on closed socket.");
-  std::array<std::uint8_t, kReceiveBufferSize_> buffer{};
-  BsonString decode_bson;
-  ssize_t received_size;
 
-  // Make sure there are enough bytes to decode a size. Front bytes of storage_bson_ are always a size.
-  while (storage_bson_.size() < 8) {
-    received_size = recv(file_descriptor_, buffer.data(), buffer.size(), 0);
-    storage_bson_.append(buffer.data(), received_size);
-    if (received_size == 0) {
-      throw PeerClosedException();
-    } else if (received_size == -1) {
-      throw SocketErrnoException("Failed to receive from peer.");
-    }
+  // Make sure there are enough bytes to decode a size. Front bytes of the unconsumed storage are always a size.
+  while (storage_bson_.size() - storage_offset_ < sizeof(size_t)) receiveIntoStorage();
+
+  // Decode the size then consume it.
+  size_t bson_size;
+  std::memcpy(&bson_size, storage_bson_.data() + storage_offset_, sizeof(size_t));
+  storage_offset_ += sizeof(size_t);
+
+  // Refuse sizes no peer would send, such as from a corrupt stream, rather than failing to allocate them.
+  if (bson_size > kMaxFrameSize_) {
+    throw SocketException("Received frame size " + std::to_string(bson_size) + " exceeds the maximum frame size.");
+  }
+
+  // Take the stored bytes of the frame, then receive the rest of the frame directly into it.
+  Bson frame(bson_size);
+  size_t stored_size = std::min(bson_size, storage_bson_.size() - storage_offset_);
+  std::memcpy(frame.data(), storage_bson_.data() + storage_offset_, stored_size);
+  storage_offset_ += stored_size;
+  if (storage_offset_ == storage_bson_.size()) {
+    storage_bson_.clear();
+    storage_offset_ = 0;
   }
+  if (stored_size < bson_size) receiveExactly(frame.data() + stored_size, bson_size - stored_size);
+  return frame;
+}
 
-  // Decode the size then erase it from the storage buffer.
-  decode_bson.append(storage_bson_.data(), 8);
-  size_t bson_size = *reinterpret_cast<size_t *>(decode_bson.data());
-  storage_bson_.erase(storage_bson_.begin(), storage_bson_.begin() += 8);
+void BsonSocket::receiveIntoStorage() {
+  // Drop the consumed bytes before growing the storage.
+  if (storage_offset_ > 0) {
+    storage_bson_.erase(0, storage_offset_);
+    storage_offset_ = 0;
+  }
+  size_t stored_size = storage_bson_.size();
+  storage_bson_.resize(stored_size + kReceiveBufferSize_);
+  ssize_t received_size;
+  do {
+    received_size = recv(file_descriptor_, storage_bson_.data() + stored_size, kReceiveBufferSize_, 0);
+  } while (received_size == -1 && errno == EINTR);
+  storage_bson_.resize(stored_size + std::max<ssize_t>(received_size, 0));
+  if (received_size == 0) {
+    throw PeerClosedException();
+  } else if (received_size == -1) {
+    throw SocketErrnoException("Failed to receive from peer.");
+  }
+}
 
-  // Make sure there are enough bytes to decode the bson whose size has just been decoded.
-  while (storage_bson_.size() < bson_size) {
-    received_size = recv(file_descriptor_, buffer.data(), buffer.size(), 0);
-    storage_bson_.append(buffer.data(), received_size);
+void BsonSocket::receiveExactly(std::uint8_t *destination, std::size_t size) {
+  while (size > 0) {
+    ssize_t received_size = recv(file_descriptor_, destination, size, 0);
     if (received_size == 0) {
       throw PeerClosedException();
     } else if (received_size == -1) {
+      if (errno == EINTR) continue;
       throw SocketErrnoException("Failed to receive from peer.");
     }
+    destination += received_size;
+    size -= static_cast<size_t>(received_size);
   }
-
-  // Decode the first bson_size bytes and erase them from the storage buffer.
-  decode_bson.clear();
-  decode_bson.append(storage_bson_.data(), bson_size);
-  storage_bson_.erase(storage_bson_.begin(), storage_bson_.begin() += static_cast<int>(bson_size));
-  return json::from_bson(decode_bson.begin(), decode_bson.end());
 }
@@ -0,0 +1,23 @@
+#include "socket/bson_socket/write_coalescer.hpp"
+
+WriteCoalescer::WriteCoalescer(Clock::duration max_delay, std::size_t max_bytes)
+    : max_delay_(max_delay), max_bytes_(max_bytes) {}
+
+bool WriteCoalescer::add(std::initializer_list<ByteSpan> frame_parts, Clock::time_point now) {
+  if (frame_count_ == frames_.size()) frames_.emplace_back();
+  Bson &frame = frames_[frame_count_++];
+  frame.clear();
+  for (auto const &frame_part : frame_parts) frame.insert(frame.end(), frame_part.begin(), frame_part.end());
+  byte_count_ += frame.size();
+  if (frame_count_ == 1) deadline_ = now + max_delay_;
+  return byte_count_ >= max_bytes_;
+}
+
+void WriteCoalescer::flush(BsonSocket &socket) {
+  if (frame_count_ == 0) return;
+  frame_spans_.assign(frames_.begin(), frames_.begin() + static_cast<std::ptrdiff_t>(frame_count_));
+  frame_count_ = 0;
+  byte_count_ = 0;
+  deadline_ = Clock::time_point::max();
+  socket.sendFrames(frame_spans_, 1);
+}
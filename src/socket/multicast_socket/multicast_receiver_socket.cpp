@@ -0,0 +1,189 @@
+#include "socket/multicast_socket/multicast_receiver_socket.hpp"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+MulticastReceiverSocket::MulticastReceiverSocket(std::string const &group_address, int port,
+                                                 std::string const &interface_address)
+    : receive_buffer_(std::make_unique_for_overwrite<std::uint8_t[]>(kReceiveBatchSize_ * kMaxMulticastDatagramBytes)) {
+  ip_mreq membership{};
+  sockaddr_in local_address{};
+  local_address.sin_family = AF_INET;
+  local_address.sin_port = htons(port);
+  if (inet_aton(group_address.c_str(), &membership.imr_multiaddr) == 0) {
+    throw SocketException("Failed to convert group address.");
+  }
+  if (inet_aton(interface_address.c_str(), &membership.imr_interface) == 0) {
+    throw SocketException("Failed to convert interface address.");
+  }
+  local_address.sin_addr = membership.imr_multiaddr;
+
+  file_descriptor_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (file_descriptor_ == -1) throw SocketErrnoException("Failed to create socket.");
+  try {
+    // Every receiver of the group binds to the same port. Binding to the group address rather than any address, with
+    // IP_MULTICAST_ALL off, keeps datagrams of other groups on the same port out.
+    int option = 1;  // Nonzero value to enable boolean option.
+    if (setsockopt(file_descriptor_, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option)) == -1) {
+      throw SocketErrnoException("Failed to set socket to reuse address.");
+    }
+    int multicast_all = 0;
+    if (setsockopt(file_descriptor_, IPPROTO_IP, IP_MULTICAST_ALL, &multicast_all, sizeof(multicast_all)) == -1) {
+      throw SocketErrnoException("Failed to turn off receiving all groups.");
+    }
+
+    // Ask for a large receive buffer so that bursts of fragments are not dropped while the receiving thread is busy.
+    // The kernel silently caps it at net.core.rmem_max.
+    int receive_buffer_size = kReceiveBufferBytes_;
+    setsockopt(file_descriptor_, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size));
+    if (bind(file_descriptor_, reinterpret_cast<sockaddr *>(&local_address), sizeof(local_address)) == -1) {
+      throw SocketErrnoException("Failed to bind to port.");
+    }
+    if (setsockopt(file_descriptor_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == -1) {
+      throw SocketErrnoException("Failed to join multicast group.");
+    }
+  } catch (SocketException const &e) {
+    ::close(file_descriptor_);
+    throw;
+  }
+
+  for (std::size_t i = 0; i < kReceiveBatchSize_; ++i) {
+    receive_vectors_[i] = {receive_buffer_.get() + i * kMaxMulticastDatagramBytes, kMaxMulticastDatagramBytes};
+    receive_headers_[i].msg_hdr.msg_iov = &receive_vectors_[i];
+    receive_headers_[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+MulticastReceiverSocket::~MulticastReceiverSocket() { ::close(file_descriptor_); }
+
+void MulticastReceiverSocket::receiveFrames(std::function<void(Bson &)> const &frame_callback) {
+  if (is_shut_down_) throw SocketException("Cannot receive on shut down socket.");
+
+  // Wait for the first datagram only, then take whatever else is already queued.
+  int result;
+  do {
+    result = recvmmsg(file_descriptor_, receive_headers_.data(), kReceiveBatchSize_, MSG_WAITFORONE, nullptr);
+  } while (result == -1 && errno == EINTR && !is_shut_down_);
+  if (is_shut_down_) throw SocketException("Cannot receive on shut down socket.");
+  if (result == -1) throw SocketErrnoException("Failed to receive from group.");
+  {
+    std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+    ++statistics_.receive_call_count;
+    statistics_.received_datagram_count += result;
+  }
+  for (int i = 0; i < result; ++i) {
+    msghdr const &header = receive_headers_[i].msg_hdr;
+    if (header.msg_flags & MSG_TRUNC) {
+      std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+      ++statistics_.malformed_datagram_count;
+      continue;
+    }
+    addDatagram({receive_buffer_.get() + i * kMaxMulticastDatagramBytes, receive_headers_[i].msg_len}, frame_callback);
+  }
+}
+
+void MulticastReceiverSocket::shutdown() {
+  // Shutting down an unconnected datagram socket reports ENOTCONN, but still wakes receivers, which then return zero.
+  is_shut_down_ = true;
+  ::shutdown(file_descriptor_, SHUT_RDWR);
+}
+
+MulticastReceiverStatistics MulticastReceiverSocket::statistics() {
+  std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+  return statistics_;
+}
+
+void MulticastReceiverSocket::addDatagram(ByteSpan datagram, std::function<void(Bson &)> const &frame_callback) {
+  // Check that the fragment lies within its frame, and that the frame is no larger than its fragments could hold or
+  // than any sender sends. The header is unauthenticated, so its frame size is checked before anything is allocated.
+  MulticastFragmentHeader header;
+  bool well_formed = header.decode(datagram);
+  ByteSpan payload = well_formed ? datagram.subspan(MulticastFragmentHeader::kSize) : ByteSpan{};
+  well_formed = well_formed && header.fragment_index < header.fragment_count &&
+                header.frame_size <= header.fragment_count * kMaxMulticastDatagramBytes &&
+                header.frame_size <= kMaxMulticastFrameBytes && header.fragment_offset <= header.frame_size &&
+                payload.size() <= header.frame_size - header.fragment_offset;
+  if (!well_formed) {
+    std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+    ++statistics_.malformed_datagram_count;
+    return;
+  }
+
+  // Each sender has its own stream ID and sequence numbers, so that senders sharing a port do not disturb each other.
+  Stream &stream = findStream(header.stream_id);
+  auto partial_frame = std::find_if(stream.partial_frames.begin(), stream.partial_frames.end(),
+                                    [&header](PartialFrame const &frame) { return frame.sequence == header.sequence; });
+  if (partial_frame == stream.partial_frames.end()) {
+    makeRoom(stream, header.frame_size);
+    stream.partial_frames.push_back({header.sequence, Bson(header.frame_size),
+                                     std::vector<bool>(header.fragment_count, false), header.fragment_count});
+    partial_frame_bytes_ += header.frame_size;
+    partial_frame = std::prev(stream.partial_frames.end());
+  } else if (partial_frame->frame.size() != header.frame_size ||
+             partial_frame->fragment_received.size() != header.fragment_count) {
+    std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+    ++statistics_.malformed_datagram_count;
+    return;
+  }
+  if (partial_frame->fragment_received[header.fragment_index]) return;
+  partial_frame->fragment_received[header.fragment_index] = true;
+  std::copy(payload.begin(), payload.end(), partial_frame->frame.begin() + header.fragment_offset);
+  if (--partial_frame->remaining_fragment_count > 0) return;
+
+  Bson frame = std::move(partial_frame->frame);
+  partial_frame_bytes_ -= frame.size();
+  stream.partial_frames.erase(partial_frame);
+  countFrame(stream, header.sequence);
+  frame_callback(frame);
+}
+
+MulticastReceiverSocket::Stream &MulticastReceiverSocket::findStream(std::uint32_t stream_id) {
+  auto stream = std::find_if(streams_.begin(), streams_.end(),
+                             [stream_id](Stream const &candidate) { return candidate.stream_id == stream_id; });
+  if (stream != streams_.end()) {
+    std::rotate(stream, std::next(stream), streams_.end());
+    return streams_.back();
+  }
+  if (streams_.size() == kMaxStreams_) {
+    for (auto const &partial_frame : streams_.front().partial_frames) {
+      partial_frame_bytes_ -= partial_frame.frame.size();
+    }
+    streams_.erase(streams_.begin());
+  }
+  streams_.push_back({stream_id});
+  return streams_.back();
+}
+
+void MulticastReceiverSocket::makeRoom(Stream &stream, std::size_t frame_size) {
+  auto give_up_oldest = [this](Stream &from) -> void {
+    partial_frame_bytes_ -= from.partial_frames.front().frame.size();
+    from.partial_frames.pop_front();
+  };
+  if (stream.partial_frames.size() == kMaxPartialFrames_) give_up_oldest(stream);
+  while (partial_frame_bytes_ + frame_size > kMaxPartialFrameBytes_ && !stream.partial_frames.empty()) {
+    give_up_oldest(stream);
+  }
+  for (auto &other : streams_) {
+    while (partial_frame_bytes_ + frame_size > kMaxPartialFrameBytes_ && !other.partial_frames.empty()) {
+      give_up_oldest(other);
+    }
+  }
+}
+
+void MulticastReceiverSocket::countFrame(Stream &stream, std::uint64_t sequence) {
+  std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+  ++statistics_.received_frame_count;
+  if (!stream.next_sequence_known) {
+    stream.next_sequence_known = true;
+    stream.next_sequence = sequence + 1;
+  } else if (sequence >= stream.next_sequence) {
+    statistics_.dropped_frame_count += sequence - stream.next_sequence;
+    stream.next_sequence = sequence + 1;
+  } else {
+    ++statistics_.reordered_frame_count;
+    if (statistics_.dropped_frame_count > 0) --statistics_.dropped_frame_count;
+  }
+}
@@ -0,0 +1,158 @@
+#include "socket/multicast_socket/multicast_sender_socket.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <limits>
+#include <random>
+
+MulticastSenderSocket::MulticastSenderSocket(std::string const &group_address, int port,
+                                             std::string const &interface_address, std::size_t max_datagram_bytes)
+    : max_fragment_bytes_(max_datagram_bytes - MulticastFragmentHeader::kSize) {
+  if (max_datagram_bytes <= MulticastFragmentHeader::kSize || max_datagram_bytes > kMaxMulticastDatagramBytes) {
+    throw SocketException("Datagram size must be larger than a fragment header and at most " +
+                          std::to_string(kMaxMulticastDatagramBytes) + " bytes.");
+  }
+  group_address_.sin_family = AF_INET;
+  if (inet_aton(group_address.c_str(), &group_address_.sin_addr) == 0) {
+    throw SocketException("Failed to convert group address.");
+  }
+  in_addr interface{};
+  if (inet_aton(interface_address.c_str(), &interface) == 0) {
+    throw SocketException("Failed to convert interface address.");
+  }
+
+  // A nonzero stream ID, so that a receiver can tell it from having heard no sender yet.
+  std::random_device random_device;
+  stream_id_ = std::uniform_int_distribution<std::uint32_t>(1)(random_device);
+
+  file_descriptor_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (file_descriptor_ == -1) throw SocketErrnoException("Failed to create socket.");
+  try {
+    // Receivers bind to the same port, so this socket must allow it to be reused. It never receives, so it joins no
+    // group, and IP_MULTICAST_ALL is turned off so that the kernel does not queue the groups others join to it.
+    int option = 1;  // Nonzero value to enable boolean option.
+    if (setsockopt(file_descriptor_, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option)) == -1) {
+      throw SocketErrnoException("Failed to set socket to reuse address.");
+    }
+    int multicast_all = 0;
+    if (setsockopt(file_descriptor_, IPPROTO_IP, IP_MULTICAST_ALL, &multicast_all, sizeof(multicast_all)) == -1) {
+      throw SocketErrnoException("Failed to turn off receiving all groups.");
+    }
+    if (setsockopt(file_descriptor_, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) == -1) {
+      throw SocketErrnoException("Failed to set multicast interface.");
+    }
+
+    // Deliver to receivers on this host too, and keep datagrams on the local network.
+    unsigned char loop = 1;
+    unsigned char time_to_live = 1;
+    if (setsockopt(file_descriptor_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) == -1 ||
+        setsockopt(file_descriptor_, IPPROTO_IP, IP_MULTICAST_TTL, &time_to_live, sizeof(time_to_live)) == -1) {
+      throw SocketErrnoException("Failed to set multicast options.");
+    }
+
+    // Bind to the port so that a port of zero reserves a free one for the group.
+    sockaddr_in local_address{};
+    local_address.sin_family = AF_INET;
+    local_address.sin_addr.s_addr = htonl(INADDR_ANY);
+    local_address.sin_port = htons(port);
+    if (bind(file_descriptor_, reinterpret_cast<sockaddr *>(&local_address), sizeof(local_address)) == -1) {
+      throw SocketErrnoException("Failed to bind to port.");
+    }
+    socklen_t length = sizeof(local_address);
+    if (getsockname(file_descriptor_, reinterpret_cast<sockaddr *>(&local_address), &length) == -1) {
+      throw SocketErrnoException("Failed to get socket address.");
+    }
+    group_address_.sin_port = local_address.sin_port;
+  } catch (SocketException const &e) {
+    ::close(file_descriptor_);
+    throw;
+  }
+}
+
+MulticastSenderSocket::~MulticastSenderSocket() { ::close(file_descriptor_); }
+
+void MulticastSenderSocket::sendFrame(std::initializer_list<ByteSpan> frame_parts) {
+  if (frame_parts.size() > kMaxFrameParts_) throw SocketException("Too many frame parts.");
+  std::size_t frame_size = 0;
+  for (auto const &frame_part : frame_parts) frame_size += frame_part.size();
+  std::size_t fragment_count = std::max<std::size_t>(1, (frame_size + max_fragment_bytes_ - 1) / max_fragment_bytes_);
+  if (frame_size > kMaxMulticastFrameBytes || fragment_count > std::numeric_limits<std::uint16_t>::max()) {
+    throw SocketException("Frame of " + std::to_string(frame_size) + " bytes is too large to fragment.");
+  }
+
+  // Each datagram is its fragment header followed by slices of the frame parts, gathered without copying.
+  std::array<MulticastFragmentHeader, kSendBatchSize_> fragment_headers{};
+  std::array<std::array<iovec, kMaxFrameParts_ + 1>, kSendBatchSize_> datagram_vectors{};
+  std::array<mmsghdr, kSendBatchSize_> datagram_headers{};
+  auto frame_part = frame_parts.begin();
+  std::size_t part_offset = 0;
+
+  std::lock_guard<std::mutex> send_lock_guard(send_mutex_);
+  std::uint64_t sequence = next_sequence_++;
+  std::size_t fragment_offset = 0;
+  for (std::size_t batch_start = 0; batch_start < fragment_count; batch_start += kSendBatchSize_) {
+    std::size_t batch_size = std::min(kSendBatchSize_, fragment_count - batch_start);
+    for (std::size_t i = 0; i < batch_size; ++i) {
+      std::size_t fragment_size = std::min(max_fragment_bytes_, frame_size - fragment_offset);
+      fragment_headers[i] = {sequence,
+                             stream_id_,
+                             static_cast<std::uint32_t>(frame_size),
+                             static_cast<std::uint32_t>(fragment_offset),
+                             static_cast<std::uint16_t>(batch_start + i),
+                             static_cast<std::uint16_t>(fragment_count)};
+      auto &vector = datagram_vectors[i];
+      vector[0] = {&fragment_headers[i], MulticastFragmentHeader::kSize};
+      std::size_t vector_count = 1;
+      for (std::size_t remaining_size = fragment_size; remaining_size > 0;) {
+        if (part_offset == frame_part->size()) {
+          ++frame_part;
+          part_offset = 0;
+          continue;
+        }
+        std::size_t slice_size = std::min(remaining_size, frame_part->size() - part_offset);
+        vector[vector_count++] = {const_cast<std::uint8_t *>(frame_part->data() + part_offset), slice_size};
+        part_offset += slice_size;
+        remaining_size -= slice_size;
+      }
+      datagram_headers[i] = {};
+      datagram_headers[i].msg_hdr.msg_name = &group_address_;
+      datagram_headers[i].msg_hdr.msg_namelen = sizeof(group_address_);
+      datagram_headers[i].msg_hdr.msg_iov = vector.data();
+      datagram_headers[i].msg_hdr.msg_iovlen = vector_count;
+      fragment_offset += fragment_size;
+    }
+
+    // Send the batch, skipping a datagram the kernel refuses rather than retrying it.
+    for (std::size_t sent_count = 0; sent_count < batch_size;) {
+      int result = sendmmsg(file_descriptor_, datagram_headers.data() + sent_count,
+                            static_cast<unsigned int>(batch_size - sent_count), 0);
+      ++statistics_.send_call_count;
+      if (result == -1) {
+        if (errno == EINTR) continue;
+        ++statistics_.failed_datagram_count;
+        ++sent_count;
+        continue;
+      }
+      statistics_.sent_datagram_count += result;
+      sent_count += result;
+    }
+  }
+  ++statistics_.sent_frame_count;
+}
+
+std::pair<std::string, int> MulticastSenderSocket::getGroupPort() const {
+  char name[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &group_address_.sin_addr, name, sizeof(name));
+  return {std::string(name), ntohs(group_address_.sin_port)};
+}
+
+MulticastSenderStatistics MulticastSenderSocket::statistics() {
+  std::lock_guard<std::mutex> send_lock_guard(send_mutex_);
+  return statistics_;
+}
@@ -0,0 +1,113 @@
+#include "thread_pool/thread_pool.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "logging/logging.hpp"
+
+ThreadPool::ThreadPool(std::size_t thread_count, ThreadPoolOptions const &options) {
+  thread_count = std::max<std::size_t>(thread_count, 1);
+  std::size_t high_priority_thread_count = std::min(options.high_priority_thread_count, thread_count - 1);
+  worker_threads_.reserve(thread_count);
+  for (std::size_t i = 0; i < thread_count; ++i) {
+    if (i < high_priority_thread_count) {
+      worker_threads_.emplace_back([this, options]() -> void {
+        scheduleHighPriorityThread(options);
+        workUntilShutdown(true);
+      });
+    } else {
+      worker_threads_.emplace_back([this]() -> void { workUntilShutdown(false); });
+    }
+  }
+}
+
+ThreadPool::~ThreadPool() { shutdown(); }
+
+void ThreadPool::submit(Task task, TaskPriority priority, Clock::time_point deadline) {
+  std::lock_guard<std::mutex> tasks_lock_guard(tasks_mutex_);
+  if (shutdown_) return;
+  tasks_[static_cast<std::size_t>(priority)].push({std::move(task), deadline});
+
+  // Either kind of thread may take a high priority task, so wake one of each. The one that loses goes back to waiting.
+  if (priority == TaskPriority::kHigh) high_priority_condition_variable_.notify_one();
+  tasks_condition_variable_.notify_one();
+}
+
+std::array<TaskPriorityStatistics, kTaskPriorityCount> ThreadPool::statistics() {
+  std::lock_guard<std::mutex> tasks_lock_guard(tasks_mutex_);
+  return statistics_;
+}
+
+void ThreadPool::shutdown() {
+  std::unique_lock<std::mutex> unique_tasks_lock(tasks_mutex_);
+  shutdown_ = true;
+  tasks_condition_variable_.notify_all();
+  high_priority_condition_variable_.notify_all();
+  unique_tasks_lock.unlock();
+
+  // Join every worker thread that has not been joined by a previous call.
+  for (auto &worker_thread : worker_threads_) {
+    if (worker_thread.joinable() && worker_thread.get_id() != std::this_thread::get_id()) worker_thread.join();
+  }
+}
+
+void ThreadPool::workUntilShutdown(bool high_priority_only) {
+  auto &high_priority_tasks = tasks_[static_cast<std::size_t>(TaskPriority::kHigh)];
+  auto &condition_variable = high_priority_only ? high_priority_condition_variable_ : tasks_condition_variable_;
+  std::size_t lowest_priority = high_priority_only ? static_cast<std::size_t>(TaskPriority::kHigh) : 0;
+
+  // The lock is held from counting one task to taking the next, so each task takes the lock once.
+  std::unique_lock<std::mutex> unique_tasks_lock(tasks_mutex_);
+  while (true) {
+    condition_variable.wait(unique_tasks_lock, [this, high_priority_only, &high_priority_tasks]() -> bool {
+      if (shutdown_ || !high_priority_tasks.empty()) return true;
+      return !high_priority_only && std::any_of(tasks_.begin(), tasks_.end(),
+                                                [](auto const &tasks) -> bool { return !tasks.empty(); });
+    });
+
+    // Take the oldest task of the highest priority queued. Only exit once the queues have been drained so that no
+    // submitted task is lost.
+    std::size_t priority = kTaskPriorityCount;
+    while (priority > lowest_priority && tasks_[priority - 1].empty()) --priority;
+    if (priority == lowest_priority) return;
+    --priority;
+    QueuedTask queued_task = std::move(tasks_[priority].front());
+    tasks_[priority].pop();
+    unique_tasks_lock.unlock();
+
+    try {
+      queued_task.task();
+    } catch (...) {
+    }
+
+    bool deadline_missed = queued_task.deadline != Clock::time_point::max() && Clock::now() > queued_task.deadline;
+    unique_tasks_lock.lock();
+    ++statistics_[priority].executed_count;
+    if (deadline_missed) ++statistics_[priority].deadline_missed_count;
+  }
+}
+
+void ThreadPool::scheduleHighPriorityThread(ThreadPoolOptions const &options) {
+  Logger &logger = Logger::getLogger();
+  if (options.high_priority_realtime_priority > 0) {
+    sched_param parameters{};
+    parameters.sched_priority = options.high_priority_realtime_priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+    if (error != 0) {
+      logger.warn(std::string("Could not run high priority thread with SCHED_FIFO: ") + std::strerror(error));
+    }
+  }
+  if (!options.high_priority_cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (int cpu : options.high_priority_cpus) CPU_SET(cpu, &cpus);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error != 0) {
+      logger.warn(std::string("Could not set CPU affinity of high priority thread: ") + std::strerror(error));
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#include "timer/rate.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+Rate::Rate(double rate_hz) : Rate(periodOf(rate_hz)) {}
+
+Rate::Rate(double rate_hz, Clock::time_point first_deadline) : Rate(periodOf(rate_hz), first_deadline) {}
+
+Rate::Rate(Clock::duration period) : Rate(period, Clock::now() + period) {}
+
+Rate::Rate(Clock::duration period, Clock::time_point first_deadline)
+    : period_(period), next_deadline_(first_deadline) {
+  if (period_ <= Clock::duration::zero()) throw std::invalid_argument("Rate period must be positive.");
+}
+
+Rate::Clock::duration Rate::periodOf(double rate_hz) {
+  // Written to also reject NaN. Rates too high for the clock get its shortest period.
+  if (!(rate_hz > 0)) throw std::invalid_argument("Rate must be positive.");
+  auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / rate_hz));
+  return std::max(period, Clock::duration(1));
+}
+
+bool Rate::sleep() {
+  Clock::time_point now = Clock::now();
+  Clock::time_point deadline = nextDeadline(now);
+  if (now >= deadline) return false;
+  std::this_thread::sleep_until(deadline);
+  return true;
+}
+
+Rate::Clock::time_point Rate::nextDeadline(Clock::time_point now) {
+  // Skip whole periods that have already passed so that a stalled loop does not burst to catch up.
+  Clock::time_point deadline = next_deadline_;
+  if (now - deadline >= period_) {
+    auto missed = (now - deadline) / period_;
+    missed_deadlines_ += static_cast<std::uint64_t>(missed);
+    deadline += missed * period_;
+  }
+  next_deadline_ = deadline + period_;
+  return deadline;
+}
+
+void Rate::reset() { next_deadline_ = Clock::now() + period_; }
+
+std::uint64_t Rate::missedDeadlines() const { return missed_deadlines_; }
+
+Rate::Clock::duration Rate::period() const { return period_; }
@@ -0,0 +1,132 @@
+#include "timer/timer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+Timer::Timer(Clock::duration period, std::function<void()> callback, Clock::time_point first_deadline, bool one_shot)
+    : period_(period), callback_(std::move(callback)), one_shot_(one_shot), next_deadline_(first_deadline) {}
+
+Timer::~Timer() { cancel(); }
+
+void Timer::cancel() { cancelled_ = true; }
+
+TimerStatistics Timer::statistics() {
+  std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+  return statistics_;
+}
+
+Timer::Clock::duration Timer::period() const { return period_; }
+
+void Timer::recordRun(Clock::duration lateness) {
+  double lateness_s = std::chrono::duration<double>(lateness).count();
+  std::lock_guard<std::mutex> statistics_lock_guard(statistics_mutex_);
+  ++statistics_.fired_count;
+  total_lateness_s_ += lateness_s;
+  statistics_.mean_lateness_s = total_lateness_s_ / static_cast<double>(statistics_.fired_count);
+  statistics_.max_lateness_s = std::max(statistics_.max_lateness_s, lateness_s);
+}
+
+TimerScheduler::TimerScheduler(ThreadPool &executor, Clock::duration resolution)
+    : executor_(executor), timer_wheel_(resolution) {
+  scheduling_thread_ = std::thread([this]() -> void { scheduleUntilShutdown(); });
+}
+
+TimerScheduler::~TimerScheduler() { shutdown(); }
+
+std::shared_ptr<Timer> TimerScheduler::createTimer(Clock::duration period, std::function<void()> callback) {
+  return addTimer(period, std::move(callback), false);
+}
+
+std::shared_ptr<Timer> TimerScheduler::createOneShotTimer(Clock::duration delay, std::function<void()> callback) {
+  return addTimer(delay, std::move(callback), true);
+}
+
+std::shared_ptr<Timer> TimerScheduler::addTimer(Clock::duration period, std::function<void()> callback, bool one_shot) {
+  period = std::max(period, Clock::duration(1));
+  auto timer = std::shared_ptr<Timer>(new Timer(period, std::move(callback), Clock::now() + period, one_shot));
+  std::lock_guard<std::mutex> timers_lock_guard(timers_mutex_);
+  std::uint64_t id = next_timer_id_++;
+  timers_.insert({id, timer});
+  timer_wheel_.schedule(id, timer->next_deadline_);
+
+  // Wake the scheduling thread, which may be sleeping past the new deadline.
+  timers_condition_variable_.notify_one();
+  return timer;
+}
+
+void TimerScheduler::shutdown() {
+  std::unique_lock<std::mutex> unique_timers_lock(timers_mutex_);
+  shutdown_ = true;
+  timers_condition_variable_.notify_all();
+  unique_timers_lock.unlock();
+  if (scheduling_thread_.joinable() && scheduling_thread_.get_id() != std::this_thread::get_id()) {
+    scheduling_thread_.join();
+  }
+}
+
+void TimerScheduler::scheduleUntilShutdown() {
+  std::vector<std::uint64_t> expired_ids;
+  std::unique_lock<std::mutex> unique_timers_lock(timers_mutex_);
+  while (!shutdown_) {
+    auto now = Clock::now();
+    timer_wheel_.advance(now, expired_ids);
+    for (std::uint64_t id : expired_ids) {
+      auto timer_it = timers_.find(id);
+      if (timer_it == timers_.end()) continue;
+
+      // Forget timers that have been destroyed, cancelled, or run their one shot rather than scheduling them again.
+      auto timer = timer_it->second.lock();
+      if (!timer || timer->cancelled_) {
+        timers_.erase(timer_it);
+        continue;
+      }
+      fire(timer, now);
+      if (timer->one_shot_) {
+        timers_.erase(timer_it);
+        continue;
+      }
+      timer_wheel_.schedule(id, timer->next_deadline_);
+    }
+    expired_ids.clear();
+
+    // Sleep until a deadline may expire or a level of the wheel cascades, or until woken by a new timer.
+    Clock::time_point wake_up = timer_wheel_.nextWakeUp();
+    if (wake_up == Clock::time_point::max()) {
+      timers_condition_variable_.wait(unique_timers_lock);
+    } else {
+      timers_condition_variable_.wait_until(unique_timers_lock, wake_up);
+    }
+  }
+}
+
+void TimerScheduler::fire(std::shared_ptr<Timer> const &timer, Clock::time_point now) {
+  Clock::time_point deadline = timer->next_deadline_;
+
+  // Skip the deadline if the last run has not finished, rather than queueing runs faster than they complete.
+  if (timer->running_) {
+    std::lock_guard<std::mutex> statistics_lock_guard(timer->statistics_mutex_);
+    ++timer->statistics_.missed_count;
+  } else {
+    timer->running_ = true;
+    executor_.submit([timer, deadline]() -> void {
+      if (!timer->cancelled_) {
+        timer->recordRun(Clock::now() - deadline);
+        try {
+          timer->callback_();
+        } catch (...) {
+        }
+      }
+      timer->running_ = false;
+    });
+  }
+  if (timer->one_shot_) return;
+
+  // Skip whole periods that have already passed so that a stalled scheduler does not burst to catch up.
+  if (now - deadline >= timer->period_) {
+    auto missed = (now - deadline) / timer->period_;
+    std::lock_guard<std::mutex> statistics_lock_guard(timer->statistics_mutex_);
+    timer->statistics_.missed_count += static_cast<std::uint64_t>(missed);
+    deadline += missed * timer->period_;
+  }
+  timer->next_deadline_ = deadline + timer->period_;
+}
@@ -0,0 +1,108 @@
+#include "timer/timer_wheel.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+TimerWheel::TimerWheel(Clock::duration resolution, Clock::time_point start) : resolution_(resolution), start_(start) {
+  std::uint64_t slot_ticks = 1;
+  for (std::size_t level = 0; level < kSlotCounts_.size(); ++level) {
+    slot_ticks_[level] = slot_ticks;
+    levels_[level].resize(kSlotCounts_[level]);
+    slot_ticks *= kSlotCounts_[level];
+  }
+}
+
+void TimerWheel::schedule(std::uint64_t id, Clock::time_point deadline) {
+  // Round up to a whole tick so that the deadline never expires early.
+  std::uint64_t deadline_tick = 0;
+  if (deadline > start_) {
+    deadline_tick = static_cast<std::uint64_t>((deadline - start_ + resolution_ - Clock::duration(1)) / resolution_);
+  }
+  if (deadline_tick <= current_tick_) {
+    overdue_ids_.push_back(id);
+    ++size_;
+    return;
+  }
+  place({id, deadline_tick});
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<std::uint64_t> &expired_ids) {
+  std::uint64_t target_tick = now > start_ ? static_cast<std::uint64_t>((now - start_) / resolution_) : 0;
+  expired_ids.insert(expired_ids.end(), overdue_ids_.begin(), overdue_ids_.end());
+  size_ -= overdue_ids_.size();
+  overdue_ids_.clear();
+
+  while (current_tick_ < target_tick) {
+    // Skip straight to the target once there is nothing left to expire on the way, and otherwise over the ticks of
+    // empty lower levels to the next tick on which a level that holds deadlines cascades.
+    if (size_ == 0) {
+      current_tick_ = target_tick;
+      break;
+    }
+    std::uint64_t next_tick = current_tick_ + 1;
+    for (std::size_t level = 0; level + 1 < kSlotCounts_.size() && level_sizes_[level] == 0; ++level) {
+      next_tick = (current_tick_ / slot_ticks_[level + 1] + 1) * slot_ticks_[level + 1];
+    }
+    current_tick_ = std::min(next_tick, target_tick);
+
+    // Cascade the slots of the upper levels whose time has come, highest first, so that deadlines cascading from a
+    // level land in the slots of the levels below before those are cascaded in turn.
+    for (std::size_t level = kSlotCounts_.size() - 1; level > 0; --level) {
+      if (current_tick_ % slot_ticks_[level] != 0) continue;
+      std::vector<Entry> entries;
+      std::swap(entries, levels_[level][(current_tick_ / slot_ticks_[level]) % kSlotCounts_[level]]);
+      size_ -= entries.size();
+      level_sizes_[level] -= entries.size();
+      for (Entry const &entry : entries) place(entry);
+    }
+
+    std::vector<Entry> &slot = levels_[0][current_tick_ % kSlotCounts_[0]];
+    size_ -= slot.size();
+    level_sizes_[0] -= slot.size();
+    for (Entry const &entry : slot) expired_ids.push_back(entry.id);
+    slot.clear();
+  }
+}
+
+TimerWheel::Clock::time_point TimerWheel::nextWakeUp() const {
+  if (size_ == 0) return Clock::time_point::max();
+  if (!overdue_ids_.empty()) return start_ + static_cast<Clock::rep>(current_tick_) * resolution_;
+
+  // Deadlines on the levels above cannot expire before the lowest of those levels holding any next cascades.
+  std::uint64_t wake_up_tick = std::numeric_limits<std::uint64_t>::max();
+  for (std::size_t level = 1; level < kSlotCounts_.size(); ++level) {
+    if (level_sizes_[level] == 0) continue;
+    wake_up_tick = (current_tick_ / slot_ticks_[level] + 1) * slot_ticks_[level];
+    break;
+  }
+
+  // The slots of the lowest level hold the deadlines of the ticks before it next wraps, one tick to a slot.
+  if (level_sizes_[0] > 0) {
+    for (std::uint64_t tick = current_tick_ + 1; tick < wake_up_tick && tick <= current_tick_ + kSlotCounts_[0];
+         ++tick) {
+      if (!levels_[0][tick % kSlotCounts_[0]].empty()) {
+        wake_up_tick = tick;
+        break;
+      }
+    }
+  }
+  return start_ + static_cast<Clock::rep>(wake_up_tick) * resolution_;
+}
+
+std::size_t TimerWheel::size() const { return size_; }
+
+void TimerWheel::place(Entry const &entry) {
+  // Deadlines beyond the span of the top level wait in its furthest slot and are placed again when it cascades.
+  std::uint64_t top_span = slot_ticks_.back() * kSlotCounts_.back();
+  std::uint64_t placement_tick = entry.deadline_tick;
+  if (placement_tick - current_tick_ >= top_span) placement_tick = current_tick_ + top_span - 1;
+  for (std::size_t level = 0; level < kSlotCounts_.size(); ++level) {
+    if (placement_tick - current_tick_ < slot_ticks_[level] * kSlotCounts_[level]) {
+      levels_[level][(placement_tick / slot_ticks_[level]) % kSlotCounts_[level]].push_back(entry);
+      ++level_sizes_[level];
+      ++size_;
+      return;
+    }
+  }
+}
@@ -0,0 +1,535 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bag/bag_compression.hpp"
+#include "bag/bag_reader.hpp"
+#include "bag/bag_writer.hpp"
+
+/**
+ * A message read back from a bag.
+ */
+struct ParsedMessage {
+  std::string topic_name;
+  std::int64_t receive_time_ns;
+  std::vector<std::uint8_t> frame;
+};
+
+/**
+ * A bag read back by walking the layout described in bag_format.hpp.
+ */
+struct ParsedBag {
+  BagFileHeader header{};
+  std::vector<BagChunkHeader> chunks;
+  std::vector<ParsedMessage> messages;
+  std::map<std::uint32_t, std::string> index_topics;
+  std::vector<BagChunkInfo> chunk_infos;
+};
+
+/**
+ * Get a path for a bag in the temporary directory, unique to the process and test.
+ */
+static std::string bagPath(std::string const &name) {
+  return (std::filesystem::temp_directory_path() / ("test_bag_" + std::to_string(getpid()) + "_" + name + ".bag"))
+      .string();
+}
+
+/**
+ * Read a bag, checking each chunk's index against its records.
+ */
+static ParsedBag parseBag(std::string const &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::vector<std::uint8_t> bytes(std::filesystem::file_size(path));
+  file.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  std::span<std::uint8_t const> view(bytes);
+  ParsedBag bag;
+  EXPECT_TRUE(readBagStruct(view, bag.header));
+  EXPECT_EQ(bag.header.magic, kBagMagic);
+
+  std::map<std::uint32_t, std::string> topics;
+  std::size_t offset = sizeof(BagFileHeader);
+  for (std::uint64_t chunk = 0; chunk < bag.header.chunk_count; ++chunk) {
+    BagChunkHeader chunk_header{};
+    EXPECT_TRUE(readBagStruct(view.subspan(offset), chunk_header));
+    EXPECT_EQ(chunk_header.magic, kBagChunkMagic);
+    bag.chunks.push_back(chunk_header);
+    auto records = view.subspan(offset + sizeof(BagChunkHeader), chunk_header.stored_size);
+    auto index = view.subspan(offset + sizeof(BagChunkHeader) + chunk_header.stored_size,
+                              chunk_header.index_entry_count * sizeof(BagIndexEntry));
+
+    // Walk the records, remembering where each message starts.
+    std::map<std::uint32_t, std::size_t> message_by_offset;
+    for (std::size_t record_offset = 0; record_offset < records.size();) {
+      BagRecordHeader record_header{};
+      EXPECT_TRUE(readBagStruct(records.subspan(record_offset), record_header));
+      auto frame = records.subspan(record_offset + sizeof(BagRecordHeader), record_header.size);
+      if (record_header.topic_id == kTopicDefinitionID) {
+        std::uint32_t topic_id = 0;
+        readBagStruct(frame, topic_id);
+        topics[topic_id] = std::string(frame.begin() + sizeof(topic_id), frame.end());
+      } else {
+        message_by_offset[static_cast<std::uint32_t>(record_offset)] = bag.messages.size();
+        bag.messages.push_back(
+            {topics.at(record_header.topic_id), record_header.receive_time_ns, {frame.begin(), frame.end()}});
+      }
+      record_offset += sizeof(BagRecordHeader) + record_header.size;
+    }
+
+    // Every index entry points at a message of its topic and time, in time order.
+    EXPECT_EQ(message_by_offset.size(), chunk_header.index_entry_count);
+    std::int64_t previous_time_ns = std::numeric_limits<std::int64_t>::min();
+    for (std::uint32_t entry = 0; entry < chunk_header.index_entry_count; ++entry) {
+      BagIndexEntry index_entry{};
+      readBagStruct(index.subspan(entry * sizeof(BagIndexEntry)), index_entry);
+      ParsedMessage const &message = bag.messages.at(message_by_offset.at(index_entry.offset));
+      EXPECT_EQ(message.topic_name, topics.at(index_entry.topic_id));
+      EXPECT_EQ(message.receive_time_ns, index_entry.receive_time_ns);
+      EXPECT_LE(previous_time_ns, index_entry.receive_time_ns);
+      previous_time_ns = index_entry.receive_time_ns;
+    }
+    offset += sizeof(BagChunkHeader) + chunk_header.stored_size + index.size();
+  }
+
+  // The file index follows the last chunk.
+  EXPECT_EQ(offset, bag.header.index_offset);
+  BagIndexHeader index_header{};
+  EXPECT_TRUE(readBagStruct(view.subspan(offset), index_header));
+  EXPECT_EQ(index_header.magic, kBagIndexMagic);
+  EXPECT_EQ(index_header.chunk_count, bag.header.chunk_count);
+  offset += sizeof(BagIndexHeader);
+  for (std::uint32_t topic = 0; topic < index_header.topic_count; ++topic) {
+    std::uint32_t topic_id = 0;
+    std::uint32_t name_size = 0;
+    readBagStruct(view.subspan(offset), topic_id);
+    readBagStruct(view.subspan(offset + sizeof(topic_id)), name_size);
+    auto name = view.subspan(offset + sizeof(topic_id) + sizeof(name_size), name_size);
+    bag.index_topics[topic_id] = std::string(name.begin(), name.end());
+    offset += sizeof(topic_id) + sizeof(name_size) + name_size;
+  }
+  for (std::uint64_t chunk = 0; chunk < index_header.chunk_count; ++chunk) {
+    BagChunkInfo chunk_info{};
+    readBagStruct(view.subspan(offset), chunk_info);
+    bag.chunk_infos.push_back(chunk_info);
+    offset += sizeof(BagChunkInfo) + chunk_info.topic_count * sizeof(BagChunkTopic);
+  }
+  EXPECT_EQ(offset, bytes.size());
+  EXPECT_EQ(topics, bag.index_topics);
+  return bag;
+}
+
+/**
+ * Make a frame whose bytes identify it.
+ */
+static std::vector<std::uint8_t> makeFrame(std::size_t size, std::uint8_t seed) {
+  std::vector<std::uint8_t> frame(size);
+  for (std::size_t i = 0; i < size; ++i) frame[i] = static_cast<std::uint8_t>(seed + i);
+  return frame;
+}
+
+/**
+ * Test if frames on several topics are written across many chunks and read back in order with their indexes.
+ */
+TEST(BagWriter, WriteAndReadBack) {
+  std::string path = bagPath("read_back");
+  std::vector<ParsedMessage> written;
+  {
+    BagWriter writer(path, {.chunk_size = 256});
+    for (int i = 0; i < 200; ++i) {
+      std::string topic_name = "topic " + std::to_string(i % 3);
+      auto frame = makeFrame(10 + i % 7, static_cast<std::uint8_t>(i));
+      std::span<std::uint8_t const> frame_view(frame);
+      writer.write(topic_name, 1000 + i, {frame_view.first(4), frame_view.subspan(4)});
+      written.push_back({topic_name, 1000 + i, frame});
+    }
+    writer.close();
+    BagWriterStatistics statistics = writer.statistics();
+    ASSERT_EQ(statistics.message_count, 200);
+    ASSERT_GT(statistics.chunk_count, 10);
+  }
+
+  ParsedBag bag = parseBag(path);
+  ASSERT_EQ(bag.messages.size(), written.size());
+  for (std::size_t i = 0; i < written.size(); ++i) {
+    ASSERT_EQ(bag.messages[i].topic_name, written[i].topic_name);
+    ASSERT_EQ(bag.messages[i].receive_time_ns, written[i].receive_time_ns);
+    ASSERT_EQ(bag.messages[i].frame, written[i].frame);
+  }
+  ASSERT_EQ(bag.index_topics.size(), 3);
+  ASSERT_EQ(bag.chunk_infos.size(), bag.chunks.size());
+  ASSERT_EQ(bag.chunk_infos.front().offset, sizeof(BagFileHeader));
+  ASSERT_EQ(bag.chunk_infos.front().start_time_ns, 1000);
+  ASSERT_EQ(bag.chunk_infos.back().end_time_ns, 1199);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if a chunk's index is sorted by time when frames are written out of order.
+ */
+TEST(BagWriter, IndexSortedByTime) {
+  std::string path = bagPath("sorted");
+  {
+    BagWriter writer(path);
+    auto frame = makeFrame(8, 0);
+    for (std::int64_t time_ns : {30, 10, 20}) writer.write("topic", time_ns, {frame});
+  }
+  ParsedBag bag = parseBag(path);
+  ASSERT_EQ(bag.chunks.size(), 1);
+  ASSERT_EQ(bag.chunks[0].start_time_ns, 10);
+  ASSERT_EQ(bag.chunks[0].end_time_ns, 30);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if a chunk that is not full is written once it reaches its maximum age.
+ */
+TEST(BagWriter, ChunkAge) {
+  std::string path = bagPath("age");
+  BagWriter writer(path, {.max_chunk_age = std::chrono::milliseconds(10)});
+  auto frame = makeFrame(8, 0);
+  writer.write("topic", 1, {frame});
+  for (int i = 0; i < 100 && writer.statistics().chunk_count == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(writer.statistics().chunk_count, 1);
+  writer.close();
+  ASSERT_THROW(writer.write("topic", 2, {frame}), BagException);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if frames larger than the mapped window are written across windows.
+ */
+TEST(BagWriter, CrossMappedWindows) {
+  std::string path = bagPath("windows");
+  auto frame = makeFrame(40 << 20, 7);
+  {
+    BagWriter writer(path, {.sync_policy = BagSyncPolicy::kEveryChunk});
+    writer.write("large", 1, {frame});
+    writer.write("large", 2, {frame});
+  }
+  ParsedBag bag = parseBag(path);
+  ASSERT_EQ(bag.messages.size(), 2);
+  ASSERT_EQ(bag.messages[1].frame, frame);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if a bag that cannot be created throws.
+ */
+TEST(BagWriter, CreateFailure) {
+  ASSERT_THROW(BagWriter("/nonexistent/directory/test.bag"), BagException);
+}
+
+/**
+ * Write a bag of frames on a topic at the given times, each frame's first byte being its index in the list.
+ */
+static void writeBag(std::string const &path, std::string const &topic_name, std::vector<std::int64_t> const &times,
+                     std::size_t chunk_size = 64) {
+  BagWriter writer(path, {.chunk_size = chunk_size});
+  for (std::size_t i = 0; i < times.size(); ++i) {
+    auto frame = makeFrame(8, static_cast<std::uint8_t>(i));
+    writer.write(topic_name, times[i], {frame});
+  }
+}
+
+/**
+ * Stream every message of a stream, as topic name and time.
+ */
+static std::vector<std::pair<std::string, std::int64_t>> streamAll(BagMessageStream &stream) {
+  std::vector<std::pair<std::string, std::int64_t>> messages;
+  BagMessage message{};
+  while (stream.next(message)) messages.emplace_back(*message.topic_name, message.receive_time_ns);
+  return messages;
+}
+
+/**
+ * Test if a reader finds the topics and chunks of a bag and streams its frames back unchanged.
+ */
+TEST(BagReader, ReadBack) {
+  std::string path = bagPath("reader");
+  writeBag(path, "topic", {10, 20, 30, 40, 50});
+  BagReader reader(path);
+  ASSERT_TRUE(reader.indexed());
+  ASSERT_EQ(reader.topics(), std::vector<std::string>{"topic"});
+  ASSERT_GT(reader.chunks().size(), 1);
+  ASSERT_EQ(reader.startTime(), 10);
+  ASSERT_EQ(reader.endTime(), 50);
+
+  BagMessageStream stream({&reader});
+  BagMessage message{};
+  for (std::uint8_t i = 0; i < 5; ++i) {
+    ASSERT_TRUE(stream.next(message));
+    ASSERT_EQ(message.receive_time_ns, 10 * (i + 1));
+    ASSERT_TRUE(std::ranges::equal(message.frame, makeFrame(8, i)));
+  }
+  ASSERT_FALSE(stream.next(message));
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if a stream starts at the first message at or after its start time, within and across chunks.
+ */
+TEST(BagReader, Seek) {
+  std::string path = bagPath("seek");
+  std::vector<std::int64_t> times;
+  for (std::int64_t i = 0; i < 100; ++i) times.push_back(i * 10);
+  writeBag(path, "topic", times);
+  BagReader reader(path);
+  for (std::int64_t start_time_ns : {0, 5, 500, 991}) {
+    BagMessageStream stream({&reader}, start_time_ns);
+    auto messages = streamAll(stream);
+    std::int64_t first_time_ns = (start_time_ns + 9) / 10 * 10;
+    ASSERT_EQ(messages.size(), (1000 - first_time_ns) / 10);
+    if (!messages.empty()) {
+      ASSERT_EQ(messages.front().second, first_time_ns);
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if a stream only returns the topics asked for.
+ */
+TEST(BagReader, TopicFilter) {
+  std::string path = bagPath("filter");
+  {
+    BagWriter writer(path, {.chunk_size = 64});
+    auto frame = makeFrame(8, 0);
+    for (int i = 0; i < 30; ++i) writer.write("topic " + std::to_string(i % 3), i, {frame});
+  }
+  BagReader reader(path);
+  BagMessageStream stream({&reader}, std::numeric_limits<std::int64_t>::min(), {"topic 1", "missing"});
+  auto messages = streamAll(stream);
+  ASSERT_EQ(messages.size(), 10);
+  for (auto const &[topic_name, receive_time_ns] : messages) {
+    ASSERT_EQ(topic_name, "topic 1");
+    ASSERT_EQ(receive_time_ns % 3, 1);
+  }
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if the messages of bags recorded at the same time are merged in time order.
+ */
+TEST(BagReader, MergeBags) {
+  std::string first_path = bagPath("merge_first");
+  std::string second_path = bagPath("merge_second");
+  writeBag(first_path, "first", {1, 4, 5, 9, 12, 13});
+  writeBag(second_path, "second", {2, 3, 6, 7, 8, 10, 11});
+  BagReader first(first_path);
+  BagReader second(second_path);
+  BagMessageStream stream({&first, &second}, 3);
+  auto messages = streamAll(stream);
+  ASSERT_EQ(messages.size(), 11);
+  std::set<std::int64_t> first_times{4, 5, 9, 12, 13};
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    ASSERT_EQ(messages[i].second, static_cast<std::int64_t>(i) + 3);
+    ASSERT_EQ(messages[i].first, first_times.contains(messages[i].second) ? "first" : "second");
+  }
+  std::filesystem::remove(first_path);
+  std::filesystem::remove(second_path);
+}
+
+/**
+ * Test if a bag that was never closed, with no file index and a torn last chunk, is read up to its last whole chunk.
+ */
+TEST(BagReader, RecoverUnclosedBag) {
+  std::string path = bagPath("recover");
+  std::vector<std::int64_t> times;
+  for (std::int64_t i = 0; i < 20; ++i) times.push_back(i);
+  writeBag(path, "topic", times);
+  std::uint64_t last_chunk_offset = 0;
+  {
+    BagReader reader(path);
+    last_chunk_offset = reader.chunks().back().offset;
+  }
+  {
+    // Clear the index offset as it is before close(), and cut the file partway into the last chunk.
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    BagFileHeader header{};
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    header.index_offset = 0;
+    file.seekp(0);
+    file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+  }
+  std::filesystem::resize_file(path, last_chunk_offset + sizeof(BagChunkHeader));
+
+  BagReader reader(path);
+  ASSERT_FALSE(reader.indexed());
+  ASSERT_EQ(reader.topics(), std::vector<std::string>{"topic"});
+  BagMessageStream stream({&reader});
+  auto messages = streamAll(stream);
+  ASSERT_FALSE(messages.empty());
+  ASSERT_LT(messages.size(), times.size());
+  for (std::size_t i = 0; i < messages.size(); ++i) ASSERT_EQ(messages[i].second, times[i]);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if an index entry pointing past the records of its chunk throws rather than reading out of bounds.
+ */
+TEST(BagReader, IndexPastRecords) {
+  std::string path = bagPath("index_past_records");
+  writeBag(path, "topic", {0, 1, 2});
+  {
+    // Point the first chunk's first index entry far past its records.
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    BagChunkHeader chunk_header{};
+    file.seekg(sizeof(BagFileHeader));
+    file.read(reinterpret_cast<char *>(&chunk_header), sizeof(chunk_header));
+    std::streamoff index_offset = sizeof(BagFileHeader) + sizeof(BagChunkHeader) + chunk_header.stored_size;
+    BagIndexEntry index_entry{};
+    file.seekg(index_offset);
+    file.read(reinterpret_cast<char *>(&index_entry), sizeof(index_entry));
+    index_entry.offset = std::numeric_limits<std::uint32_t>::max() - 4;
+    file.seekp(index_offset);
+    file.write(reinterpret_cast<char const *>(&index_entry), sizeof(index_entry));
+  }
+
+  BagReader reader(path);
+  BagMessageStream stream({&reader});
+  ASSERT_THROW(streamAll(stream), BagException);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Test if a file that is not a bag throws.
+ */
+TEST(BagReader, NotABag) {
+  std::string path = bagPath("not_a_bag");
+  std::ofstream(path) << "not a bag";
+  ASSERT_THROW(BagReader reader(path), BagException);
+  std::filesystem::remove(path);
+}
+
+/**
+ * Compress and decompress bytes, checking they come back unchanged.
+ * @return The compressed size.
+ */
+static std::size_t lzRoundTrip(std::vector<std::uint8_t> const &input) {
+  std::vector<std::uint8_t> compressed(lzCompressBound(input.size()));
+  compressed.resize(lzCompress(input, compressed));
+  std::vector<std::uint8_t> output(input.size());
+  lzDecompress(compressed, output);
+  EXPECT_EQ(output, input);
+  return compressed.size();
+}
+
+/**
+ * Make bytes that do not compress.
+ */
+static std::vector<std::uint8_t> makeRandomBytes(std::size_t size, unsigned seed) {
+  std::mt19937 generator(seed);
+  std::vector<std::uint8_t> bytes(size);
+  for (auto &byte : bytes) byte = static_cast<std::uint8_t>(generator());
+  return bytes;
+}
+
+/**
+ * Test if the codec round trips inputs around its minimum match and length encoding boundaries.
+ */
+TEST(BagCompression, RoundTrip) {
+  for (std::size_t size : {0, 1, 3, 4, 5, 14, 15, 16, 19, 20, 270, 271, 70000}) {
+    lzRoundTrip(makeRandomBytes(size, static_cast<unsigned>(size)));
+    lzRoundTrip(std::vector<std::uint8_t>(size, 'x'));
+    lzRoundTrip(makeFrame(size, 0));
+  }
+
+  // Repeats further apart than the 64 KiB window, and a mix of compressible and incompressible runs.
+  auto block = makeRandomBytes(70000, 1);
+  std::vector<std::uint8_t> input;
+  for (int i = 0; i < 3; ++i) input.insert(input.end(), block.begin(), block.end());
+  lzRoundTrip(input);
+  input = makeRandomBytes(1000, 2);
+  input.insert(input.end(), 5000, 0);
+  auto tail = makeRandomBytes(1000, 3);
+  input.insert(input.end(), tail.begin(), tail.end());
+  ASSERT_LT(lzRoundTrip(input), 2100);
+}
+
+/**
+ * Test if repetitive data compresses well and incompressible data only grows within the bound.
+ */
+TEST(BagCompression, Ratio) {
+  ASSERT_LT(lzRoundTrip(std::vector<std::uint8_t>(1 << 20, 0)), 5000);
+  ASSERT_LT(lzRoundTrip(makeFrame(1 << 20, 0)), 10000);
+  ASSERT_LE(lzRoundTrip(makeRandomBytes(1 << 20, 4)), lzCompressBound(1 << 20));
+}
+
+/**
+ * Test if corrupt input throws rather than reading or writing out of bounds.
+ */
+TEST(BagCompression, CorruptInput) {
+  auto input = makeFrame(1000, 0);
+  input.insert(input.end(), input.begin(), input.end());
+  std::vector<std::uint8_t> compressed(lzCompressBound(input.size()));
+  compressed.resize(lzCompress(input, compressed));
+  std::vector<std::uint8_t> output(input.size());
+
+  // Cut short, too small an output, too large an output, and every byte flipped in turn.
+  ASSERT_THROW(lzDecompress(std::span(compressed).first(compressed.size() - 1), output), BagException);
+  ASSERT_THROW(lzDecompress(compressed, std::span(output).first(output.size() - 1)), BagException);
+  std::vector<std::uint8_t> larger_output(input.size() + 1);
+  ASSERT_THROW(lzDecompress(compressed, larger_output), BagException);
+  ASSERT_THROW(lzDecompress({}, output), BagException);
+  for (std::size_t i = 0; i < compressed.size(); ++i) {
+    auto corrupt = compressed;
+    corrupt[i] ^= 0xA5;
+    try {
+      lzDecompress(corrupt, output);
+    } catch (BagException const &e) {
+    }
+  }
+}
+
+/**
+ * Test if a compressed bag reads back the same with and without decompression threads, and if chunks that do not get
+ * smaller are stored as is.
+ */
+TEST(BagReader, CompressedChunks) {
+  std::string path = bagPath("compressed");
+  std::vector<std::vector<std::uint8_t>> frames;
+  {
+    BagWriter writer(path, {.chunk_size = 4096, .compression = BagCompression::kLZ});
+    for (int i = 0; i < 300; ++i) {
+      // The first chunks' worth of frames are incompressible.
+      frames.push_back(i < 30 ? makeRandomBytes(400, i) : makeFrame(400, static_cast<std::uint8_t>(i)));
+      writer.write(i % 2 == 0 ? "even" : "odd", i, {frames.back()});
+    }
+    writer.close();
+    BagWriterStatistics statistics = writer.statistics();
+    ASSERT_LT(statistics.stored_record_bytes * 2, statistics.record_bytes);
+  }
+
+  BagReader reader(path);
+  std::set<std::uint32_t> compressions;
+  for (auto const &chunk : reader.chunks()) compressions.insert(reader.chunkHeader(chunk).compression);
+  ASSERT_EQ(compressions, (std::set<std::uint32_t>{0, 1}));
+  for (std::size_t thread_count : {0, 1, 3}) {
+    BagMessageStream stream({&reader}, std::numeric_limits<std::int64_t>::min(), {}, thread_count);
+    BagMessage message{};
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+      ASSERT_TRUE(stream.next(message));
+      ASSERT_EQ(message.receive_time_ns, static_cast<std::int64_t>(i));
+      ASSERT_TRUE(std::ranges::equal(message.frame, frames[i]));
+    }
+    ASSERT_FALSE(stream.next(message));
+  }
+
+  // Seeking and filtering skip chunks, which must not throw off the order of the chunks decompressed ahead.
+  BagMessageStream stream({&reader}, 150, {"odd"}, 2);
+  auto messages = streamAll(stream);
+  ASSERT_EQ(messages.size(), 75);
+  ASSERT_EQ(messages.front().second, 151);
+  std::filesystem::remove(path);
+}
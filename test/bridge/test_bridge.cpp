@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bridge/bridge_link.hpp"
+#include "socket/bson_socket/client_bson_socket.hpp"
+#include "socket/bson_socket/connection_bson_socket.hpp"
+#include "socket/server_socket.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Test if an unlimited bucket never holds a send back.
+ */
+TEST(TokenBucket, Unlimited) {
+  TokenBucket token_bucket(0, 0);
+  ASSERT_FALSE(token_bucket.limited());
+  ASSERT_EQ(token_bucket.take(1 << 30), Clock::duration::zero());
+}
+
+/**
+ * Test if a bucket lets a burst through, then holds sends back until the rate repays what they took.
+ */
+TEST(TokenBucket, BurstThenRate) {
+  auto start = Clock::time_point();
+  TokenBucket token_bucket(1000, 100, start);
+  ASSERT_EQ(token_bucket.take(100, start), Clock::duration::zero());
+  ASSERT_EQ(token_bucket.take(50, start), 50ms);
+  ASSERT_EQ(token_bucket.take(50, start + 50ms), 50ms);
+  ASSERT_EQ(token_bucket.take(0, start + 100ms), Clock::duration::zero());
+
+  // A long pause only refills the bucket to its burst size.
+  ASSERT_EQ(token_bucket.take(100, start + 10s), Clock::duration::zero());
+  ASSERT_EQ(token_bucket.take(10, start + 10s), 10ms);
+}
+
+/**
+ * Test if messages appended to a batch are read back in order, and if a truncated batch is reported.
+ */
+TEST(BridgeProtocol, BatchRoundTrip) {
+  std::vector<std::uint8_t> batch;
+  std::vector<std::vector<std::uint8_t>> messages = {{1, 2, 3}, {}, std::vector<std::uint8_t>(1000, 7)};
+  for (std::uint32_t i = 0; i < messages.size(); ++i) appendBridgeMessage(batch, i * 10, messages[i]);
+
+  std::vector<std::pair<std::uint32_t, std::vector<std::uint8_t>>> read;
+  auto read_message = [&read](std::uint32_t topic_id, ByteSpan message) -> void {
+    read.emplace_back(topic_id, std::vector<std::uint8_t>(message.begin(), message.end()));
+  };
+  ASSERT_TRUE(forEachBridgeMessage(batch, read_message));
+  ASSERT_EQ(read.size(), messages.size());
+  for (std::uint32_t i = 0; i < messages.size(); ++i) {
+    ASSERT_EQ(read[i].first, i * 10);
+    ASSERT_EQ(read[i].second, messages[i]);
+  }
+
+  read.clear();
+  ASSERT_FALSE(forEachBridgeMessage(std::span(batch).first(batch.size() - 1), read_message));
+  ASSERT_EQ(read.size(), 2);
+}
+
+/**
+ * Testing fixture connecting two BridgeLinks over loopback. The second link collects what it receives.
+ */
+class BridgeLinkTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    server_socket_ = std::make_unique<ServerSocket>(AF_INET, "127.0.0.1", kPort_, 1);
+    client_socket_ = std::make_shared<ClientBsonMessageSocket>(AF_INET, "127.0.0.1", kPort_);
+    client_socket_->connect();
+    while (!connection_socket_) connection_socket_ = server_socket_->acceptConnection<ConnectionBsonSocket>();
+  }
+
+  void TearDown() override { server_socket_->close(); }
+
+  /**
+   * Start the links, the second one collecting the messages it receives.
+   */
+  void startLinks(BridgeLinkOptions options) {
+    sending_link_ = std::make_unique<BridgeLink>(client_socket_, options);
+    receiving_link_ = std::make_unique<BridgeLink>(connection_socket_, options);
+    sending_link_->start([](std::uint32_t, ByteSpan) -> void {}, [this]() -> void { ++closed_count_; });
+    receiving_link_->start([this](std::uint32_t topic_id, ByteSpan message) -> void {
+      std::lock_guard<std::mutex> received_lock_guard(received_mutex_);
+      received_.emplace_back(topic_id, message.size());
+      received_condition_variable_.notify_all();
+    });
+  }
+
+  /**
+   * Wait until a number of messages have been received.
+   */
+  bool waitForMessages(std::size_t message_count) {
+    std::unique_lock<std::mutex> unique_received_lock(received_mutex_);
+    return received_condition_variable_.wait_for(unique_received_lock, 5s, [this, message_count]() -> bool {
+      return received_.size() >= message_count;
+    });
+  }
+
+  std::unique_ptr<ServerSocket> server_socket_;
+  std::shared_ptr<ClientBsonMessageSocket> client_socket_;
+  std::shared_ptr<ConnectionBsonSocket> connection_socket_;
+  std::unique_ptr<BridgeLink> sending_link_;
+  std::unique_ptr<BridgeLink> receiving_link_;
+
+  /**
+   * Topic ID and size of each message received by the second link.
+   */
+  std::vector<std::pair<std::uint32_t, std::size_t>> received_;
+  std::mutex received_mutex_;
+  std::condition_variable received_condition_variable_;
+  std::atomic<int> closed_count_ = 0;
+
+  static constexpr int kPort_ = 13351;
+};
+
+/**
+ * Test if a burst of small messages arrives in order in far fewer frames than messages, and if a message larger than
+ * a batch arrives whole.
+ */
+TEST_F(BridgeLinkTest, BatchSmallMessages) {
+  startLinks({.max_batch_bytes = 4096, .max_batch_delay = 5ms});
+  for (std::uint32_t i = 0; i < 1000; ++i) ASSERT_TRUE(sending_link_->send(i % 5, std::vector<std::uint8_t>(i % 50)));
+  ASSERT_TRUE(sending_link_->send(9, std::vector<std::uint8_t>(100000)));
+  ASSERT_TRUE(waitForMessages(1001));
+  for (std::uint32_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(received_[i].first, i % 5);
+    ASSERT_EQ(received_[i].second, i % 50);
+  }
+  ASSERT_EQ(received_.back(), std::make_pair(9U, std::size_t{100000}));
+
+  // The counters are updated after each frame, so stop the threads before reading them.
+  sending_link_->close();
+  receiving_link_->close();
+  BridgeLinkStatistics statistics = sending_link_->statistics();
+  ASSERT_EQ(statistics.sent_message_count, 1001);
+  ASSERT_LT(statistics.sent_batch_count, 100);
+  ASSERT_EQ(receiving_link_->statistics().received_batch_count, statistics.sent_batch_count);
+}
+
+/**
+ * Test if a single message is not held longer than the batch delay.
+ */
+TEST_F(BridgeLinkTest, BatchDelay) {
+  startLinks({.max_batch_delay = 20ms});
+  auto start = Clock::now();
+  sending_link_->send(0, std::vector<std::uint8_t>(10));
+  ASSERT_TRUE(waitForMessages(1));
+  ASSERT_GE(Clock::now() - start, 15ms);
+  ASSERT_LT(Clock::now() - start, 1s);
+}
+
+/**
+ * Test if the rate limit spreads sends out over time.
+ */
+TEST_F(BridgeLinkTest, RateLimit) {
+  startLinks({.max_batch_bytes = 1024, .max_rate_bytes_per_s = 1e6, .burst_bytes = 10000});
+  auto start = Clock::now();
+  for (int i = 0; i < 200; ++i) sending_link_->send(0, std::vector<std::uint8_t>(992));
+  ASSERT_TRUE(waitForMessages(200));
+
+  // 200 KB at 1 MB/s after a 10 KB burst.
+  ASSERT_GE(Clock::now() - start, 180ms);
+  ASSERT_GT(sending_link_->statistics().throttled_batch_count, 0);
+}
+
+/**
+ * Test if a link notices the other side closing, and refuses messages afterwards.
+ */
+TEST_F(BridgeLinkTest, PeerClosed) {
+  startLinks({});
+  receiving_link_->close();
+  for (int i = 0; i < 100 && closed_count_ == 0; ++i) std::this_thread::sleep_for(10ms);
+  ASSERT_FALSE(sending_link_->connected());
+  ASSERT_EQ(closed_count_, 1);
+  ASSERT_FALSE(sending_link_->send(0, {}));
+  sending_link_->close();
+  ASSERT_EQ(closed_count_, 1);
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "mediator/graph_history.hpp"
+#include "mros/graph_watcher.hpp"
+
+/**
+ * Make a change without a version, as the Mediator passes to GraphHistory::record().
+ */
+static GraphDelta makeDelta(GraphDeltaKind kind, std::string const &node_uri, std::string const &topic_name = "") {
+  return {0, kind, node_uri, "node " + node_uri, topic_name};
+}
+
+/**
+ * Test if recorded changes get consecutive versions and can be fetched since any kept version.
+ */
+TEST(GraphHistory, DeltasSince) {
+  GraphHistory history(10);
+  std::vector<GraphDelta> deltas;
+  ASSERT_EQ(history.version(), 0);
+  ASSERT_TRUE(history.deltasSince(0, deltas));
+  ASSERT_TRUE(deltas.empty());
+
+  ASSERT_EQ(history.record(makeDelta(GraphDeltaKind::kAddNode, "a")).version, 1);
+  ASSERT_EQ(history.record(makeDelta(GraphDeltaKind::kAddPublisher, "a", "t")).version, 2);
+  ASSERT_EQ(history.record(makeDelta(GraphDeltaKind::kAddNode, "b")).version, 3);
+  ASSERT_TRUE(history.deltasSince(1, deltas));
+  ASSERT_EQ(deltas.size(), 2);
+  ASSERT_EQ(deltas[0].version, 2);
+  ASSERT_EQ(deltas[0].topic_name, "t");
+  ASSERT_EQ(deltas[1].version, 3);
+  ASSERT_TRUE(history.deltasSince(3, deltas));
+  ASSERT_TRUE(deltas.empty());
+
+  // A version newer than the history cannot be caught up from.
+  ASSERT_FALSE(history.deltasSince(4, deltas));
+}
+
+/**
+ * Test if changes older than the capacity can no longer be fetched.
+ */
+TEST(GraphHistory, Capacity) {
+  GraphHistory history(2);
+  for (int i = 0; i < 5; ++i) history.record(makeDelta(GraphDeltaKind::kAddNode, std::to_string(i)));
+  std::vector<GraphDelta> deltas;
+  ASSERT_FALSE(history.deltasSince(2, deltas));
+  ASSERT_TRUE(history.deltasSince(3, deltas));
+  ASSERT_EQ(deltas.size(), 2);
+  ASSERT_EQ(deltas[0].version, 4);
+  ASSERT_EQ(deltas[1].node_uri, "4");
+}
+
+/**
+ * Test if a view built from a snapshot and then deltas matches the graph.
+ */
+TEST(GraphView, SnapshotThenDeltas) {
+  GraphView view;
+  GraphUpdate snapshot{5, true, {{"a", "node a", {"t"}, {}}, {"b", "node b", {}, {"t"}}}, {}};
+  ASSERT_TRUE(view.apply(snapshot));
+  ASSERT_EQ(view.version(), 5);
+  ASSERT_EQ(view.nodes().size(), 2);
+  ASSERT_TRUE(view.nodes().at("a").publications.contains("t"));
+
+  // Changes at or before the snapshot's version are ignored.
+  GraphDelta stale = makeDelta(GraphDeltaKind::kRemoveNode, "a");
+  stale.version = 5;
+  ASSERT_TRUE(view.apply(stale));
+  ASSERT_EQ(view.nodes().size(), 2);
+
+  GraphUpdate deltas{8, false, {}, {makeDelta(GraphDeltaKind::kAddNode, "c"),
+                                    makeDelta(GraphDeltaKind::kAddSubscriber, "c", "t"),
+                                    makeDelta(GraphDeltaKind::kRemovePublisher, "a", "t")}};
+  for (std::uint64_t i = 0; i < deltas.deltas.size(); ++i) deltas.deltas[i].version = 6 + i;
+  ASSERT_TRUE(view.apply(deltas));
+  ASSERT_EQ(view.version(), 8);
+  ASSERT_TRUE(view.nodes().at("a").publications.empty());
+  ASSERT_TRUE(view.nodes().at("c").subscriptions.contains("t"));
+  ASSERT_EQ(view.findNodes("node c"), std::vector<std::string>{"c"});
+
+  GraphDelta removal = makeDelta(GraphDeltaKind::kRemoveNode, "c");
+  removal.version = 9;
+  ASSERT_TRUE(view.apply(removal));
+  ASSERT_TRUE(view.findNodes("node c").empty());
+}
+
+/**
+ * Test if a change that skips a version is rejected without changing the view.
+ */
+TEST(GraphView, RejectGap) {
+  GraphView view;
+  GraphDelta delta = makeDelta(GraphDeltaKind::kAddNode, "a");
+  delta.version = 2;
+  ASSERT_FALSE(view.apply(delta));
+  ASSERT_EQ(view.version(), 0);
+  ASSERT_TRUE(view.nodes().empty());
+
+  // Deltas ending before the update's version are incomplete.
+  delta.version = 1;
+  ASSERT_FALSE(view.apply(GraphUpdate{2, false, {}, {delta}}));
+}
+
+/**
+ * Test if graph changes survive encoding as an RPC message.
+ */
+TEST(GraphView, EncodeDelta) {
+  GraphDelta delta{7, GraphDeltaKind::kRemoveSubscriber, "127.0.0.1:1", "node", "topic"};
+  json encoded = delta;
+  ASSERT_EQ(encoded["kind"], "remove subscriber");
+  GraphDelta decoded = decodeRPCMessage<GraphDelta>("graphChanged", encoded);
+  ASSERT_EQ(decoded.version, 7);
+  ASSERT_EQ(decoded.kind, GraphDeltaKind::kRemoveSubscriber);
+  ASSERT_EQ(decoded.topic_name, "topic");
+}
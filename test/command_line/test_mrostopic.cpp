@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <span>
+#include <vector>
+
+#include "command_line/publish_pacer.hpp"
+#include "command_line/topic_statistics.hpp"
+#include "messages/raw_message.hpp"
+
+/**
+ * Test if an empty window reports nothing.
+ */
+TEST(TopicStatistics, EmptyWindow) {
+  TopicStatistics statistics(10);
+  TopicStatisticsSummary summary = statistics.summarize();
+  ASSERT_EQ(summary.total_count, 0);
+  ASSERT_EQ(summary.window_count, 0);
+  ASSERT_EQ(summary.rate_hz, 0);
+  ASSERT_EQ(summary.bandwidth_bytes_per_s, 0);
+}
+
+/**
+ * Test the rate, bandwidth, size, and delay of a steady 100 Hz topic.
+ */
+TEST(TopicStatistics, SteadyTopic) {
+  TopicStatistics statistics(1000);
+  for (std::int64_t i = 0; i < 101; ++i) {
+    std::int64_t arrival_time_ns = i * 10'000'000;
+    statistics.record(arrival_time_ns, arrival_time_ns - 2'000'000, 1000);
+  }
+  TopicStatisticsSummary summary = statistics.summarize();
+  ASSERT_EQ(summary.total_count, 101);
+  ASSERT_EQ(summary.window_count, 101);
+  ASSERT_NEAR(summary.rate_hz, 100, 1e-9);
+  ASSERT_NEAR(summary.min_interval_s, 0.01, 1e-12);
+  ASSERT_NEAR(summary.max_interval_s, 0.01, 1e-12);
+  ASSERT_NEAR(summary.interval_std_dev_s, 0, 1e-12);
+  ASSERT_NEAR(summary.bandwidth_bytes_per_s, 100'000, 1e-6);
+  ASSERT_EQ(summary.mean_size_bytes, 1000);
+  ASSERT_EQ(summary.min_size_bytes, 1000);
+  ASSERT_EQ(summary.max_size_bytes, 1000);
+  ASSERT_NEAR(summary.mean_delay_s, 0.002, 1e-12);
+  ASSERT_NEAR(summary.delay_std_dev_s, 0, 1e-12);
+}
+
+/**
+ * Test if only the most recent messages are kept once the window is full.
+ */
+TEST(TopicStatistics, WindowKeepsMostRecent) {
+  TopicStatistics statistics(4);
+
+  // A slow start, then four messages 1 ms apart with growing sizes and delays.
+  statistics.record(0, 0, 1);
+  statistics.record(1'000'000'000, 1'000'000'000, 1);
+  for (std::int64_t i = 1; i <= 4; ++i) {
+    std::int64_t arrival_time_ns = 2'000'000'000 + i * 1'000'000;
+    statistics.record(arrival_time_ns, arrival_time_ns - i * 1'000'000, static_cast<std::size_t>(i * 100));
+  }
+  TopicStatisticsSummary summary = statistics.summarize();
+  ASSERT_EQ(summary.total_count, 6);
+  ASSERT_EQ(summary.window_count, 4);
+  ASSERT_NEAR(summary.rate_hz, 1000, 1e-6);
+  ASSERT_EQ(summary.min_size_bytes, 100);
+  ASSERT_EQ(summary.max_size_bytes, 400);
+  ASSERT_EQ(summary.mean_size_bytes, 250);
+  ASSERT_NEAR(summary.min_delay_s, 0.001, 1e-12);
+  ASSERT_NEAR(summary.max_delay_s, 0.004, 1e-12);
+  ASSERT_NEAR(summary.mean_delay_s, 0.0025, 1e-12);
+
+  // Bandwidth counts the bytes arriving after the first message of the window.
+  ASSERT_NEAR(summary.bandwidth_bytes_per_s, (200 + 300 + 400) / 0.003, 1e-6);
+}
+
+/**
+ * Test if a frame header survives encoding and a RawMessage keeps the frame's payload undecoded.
+ */
+TEST(TopicStatistics, RawFrame) {
+  TopicFrameHeader header{1234567890123, 42};
+  auto encoded_header = header.encode();
+  std::vector<std::uint8_t> frame(encoded_header.begin(), encoded_header.end());
+  frame.insert(frame.end(), {1, 2, 3});
+
+  TopicFrameHeader decoded_header;
+  ASSERT_TRUE(decoded_header.decode(frame));
+  ASSERT_EQ(decoded_header.publish_time_ns, header.publish_time_ns);
+  ASSERT_EQ(decoded_header.sequence, header.sequence);
+  ASSERT_FALSE(decoded_header.decode(std::span<std::uint8_t const>(frame.data(), TopicFrameHeader::kSize - 1)));
+
+  RawMessage message;
+  message.set_from_frame(decoded_header, std::span<std::uint8_t const>(frame).subspan(TopicFrameHeader::kSize));
+  ASSERT_EQ(message.payload, (std::vector<std::uint8_t>{1, 2, 3}));
+  ASSERT_EQ(message.header.sequence, 42);
+}
+
+/**
+ * Test if deadlines stay on the absolute schedule however late each one is served.
+ */
+TEST(PublishPacer, AbsoluteDeadlines) {
+  auto start = PublishPacer::Clock::now();
+  PublishPacer pacer(1000, start);
+  ASSERT_EQ(pacer.nextDeadline(start), start);
+
+  // Serving a deadline late within its period does not shift the following deadlines.
+  ASSERT_EQ(pacer.nextDeadline(start + std::chrono::microseconds(1900)), start + std::chrono::milliseconds(1));
+  ASSERT_EQ(pacer.nextDeadline(start + std::chrono::microseconds(1950)), start + std::chrono::milliseconds(2));
+  ASSERT_EQ(pacer.missedDeadlines(), 0);
+}
+
+/**
+ * Test if a pacer that falls behind skips the deadlines it missed and counts them.
+ */
+TEST(PublishPacer, SkipMissedDeadlines) {
+  auto start = PublishPacer::Clock::now();
+  PublishPacer pacer(1000, start);
+  pacer.nextDeadline(start);
+  ASSERT_EQ(pacer.nextDeadline(start + std::chrono::microseconds(5500)), start + std::chrono::milliseconds(5));
+  ASSERT_EQ(pacer.missedDeadlines(), 4);
+  ASSERT_EQ(pacer.nextDeadline(start + std::chrono::microseconds(5600)), start + std::chrono::milliseconds(6));
+}
+
+/**
+ * Test if a pacer without a rate never waits.
+ */
+TEST(PublishPacer, Unpaced) {
+  PublishPacer pacer(0);
+  auto now = PublishPacer::Clock::now();
+  ASSERT_EQ(pacer.nextDeadline(now), now);
+  ASSERT_EQ(pacer.nextDeadline(now), now);
+  ASSERT_EQ(pacer.missedDeadlines(), 0);
+}
+
+/**
+ * Test if synthetic payloads have the requested size and decode as a message with a data string.
+ */
+TEST(PublishPacer, SyntheticPayload) {
+  Bson payload = makeSyntheticPayload(1000);
+  ASSERT_EQ(payload.size(), 1000);
+  ASSERT_EQ(json::from_bson(payload)["data"].get<std::string>().size(), 1000 - makeSyntheticPayload(0).size());
+  ASSERT_TRUE(json::from_bson(makeSyntheticPayload(0))["data"].get<std::string>().empty());
+}
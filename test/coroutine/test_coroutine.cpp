@@ -0,0 +1,217 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "coroutine/coroutine_scheduler.hpp"
+#include "coroutine/flow.hpp"
+#include "coroutine/rpc_awaitable.hpp"
+#include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+#include "socket/bson_rpc_socket/connection_bson_rpc_socket.hpp"
+#include "socket/server_socket.hpp"
+
+using namespace std::chrono_literals;
+
+/**
+ * Event that coroutines await until it is set from another thread, handing them back to their scheduler.
+ */
+class TestEvent {
+ public:
+  struct Awaiter {
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      std::lock_guard<std::mutex> waiters_lock_guard(event.waiters_mutex_);
+      event.waiters_.push_back(handle);
+    }
+
+    void await_resume() const noexcept {}
+
+    TestEvent &event;
+  };
+
+  Awaiter operator co_await() { return Awaiter{*this}; }
+
+  /**
+   * Hand every waiting coroutine to the scheduler.
+   */
+  void set(CoroutineScheduler &scheduler) {
+    std::lock_guard<std::mutex> waiters_lock_guard(waiters_mutex_);
+    for (auto handle : waiters_) scheduler.schedule(handle);
+    waiters_.clear();
+  }
+
+  std::size_t waiterCount() {
+    std::lock_guard<std::mutex> waiters_lock_guard(waiters_mutex_);
+    return waiters_.size();
+  }
+
+ private:
+  std::vector<std::coroutine_handle<>> waiters_;
+  std::mutex waiters_mutex_;
+};
+
+/**
+ * Wait for a condition, polling it, for up to a second.
+ */
+template <typename PredicateT>
+bool waitFor(PredicateT predicate) {
+  auto deadline = std::chrono::steady_clock::now() + 1s;
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::sleep_for(1ms);
+  }
+  return true;
+}
+
+Flow recordThread(std::promise<std::thread::id> &thread_id) {
+  thread_id.set_value(std::this_thread::get_id());
+  co_return;
+}
+
+Flow awaitEvent(TestEvent &event, std::atomic<int> &finished_count, std::thread::id &thread_id) {
+  co_await event;
+  thread_id = std::this_thread::get_id();
+  ++finished_count;
+}
+
+Flow throwAfterEvent(TestEvent &event) {
+  co_await event;
+  throw std::runtime_error("flow failed");
+}
+
+/**
+ * Test if a spawned flow does not start until spawned, then runs on the scheduling thread.
+ */
+TEST(CoroutineScheduler, SpawnRunsOnSchedulingThread) {
+  auto scheduler = std::make_shared<CoroutineScheduler>();
+  std::promise<std::thread::id> thread_id;
+  Flow flow = recordThread(thread_id);
+  auto thread_id_future = thread_id.get_future();
+  ASSERT_EQ(thread_id_future.wait_for(10ms), std::future_status::timeout);
+  scheduler->spawn(std::move(flow));
+  ASSERT_NE(thread_id_future.get(), std::this_thread::get_id());
+}
+
+/**
+ * Test if thousands of flows suspend at once and are all resumed on the one scheduling thread.
+ */
+TEST(CoroutineScheduler, ManyFlowsOnOneThread) {
+  auto scheduler = std::make_shared<CoroutineScheduler>();
+  TestEvent event;
+  const int kFlowCount = 5000;
+  std::atomic<int> finished_count = 0;
+  std::vector<std::thread::id> thread_ids(kFlowCount);
+  for (int i = 0; i < kFlowCount; ++i) scheduler->spawn(awaitEvent(event, finished_count, thread_ids[i]));
+  ASSERT_TRUE(waitFor([&event, kFlowCount]() -> bool { return event.waiterCount() == kFlowCount; }));
+  ASSERT_EQ(finished_count, 0);
+  event.set(*scheduler);
+  ASSERT_TRUE(waitFor([&finished_count, kFlowCount]() -> bool { return finished_count == kFlowCount; }));
+  for (auto const &thread_id : thread_ids) ASSERT_EQ(thread_id, thread_ids.front());
+  ASSERT_EQ(scheduler->resumedCount(), 2 * kFlowCount);
+}
+
+/**
+ * Test if an exception ends only the flow that threw it.
+ */
+TEST(CoroutineScheduler, ExceptionEndsFlow) {
+  auto scheduler = std::make_shared<CoroutineScheduler>();
+  TestEvent event;
+  std::atomic<int> finished_count = 0;
+  std::thread::id thread_id;
+  scheduler->spawn(throwAfterEvent(event));
+  scheduler->spawn(awaitEvent(event, finished_count, thread_id));
+  ASSERT_TRUE(waitFor([&event]() -> bool { return event.waiterCount() == 2; }));
+  event.set(*scheduler);
+  ASSERT_TRUE(waitFor([&finished_count]() -> bool { return finished_count == 1; }));
+}
+
+/**
+ * Argument of the typed RPC method in the AwaitTypedRequest test.
+ */
+struct SumArgument {
+  std::vector<int> values;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SumArgument, values)
+
+/**
+ * Result of the typed RPC method in the AwaitTypedRequest test.
+ */
+struct SumResult {
+  int sum;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(SumResult, sum)
+
+inline constexpr RPCMethod<SumArgument, SumResult> kSumRPC{"sum"};
+inline constexpr RPCMethod<SumArgument, SumResult> kMissingRPC{"missing"};
+
+Flow awaitSums(BsonRPCSocket &socket, std::vector<int> &sums, std::atomic<bool> &failed_missing,
+               std::thread::id &thread_id, std::promise<void> &done) {
+  // Arguments are named rather than braced temporaries in the co_await expressions, which GCC 12 destroys twice.
+  for (int i = 1; i <= 3; ++i) {
+    SumArgument argument{std::vector<int>(i, i)};
+    SumResult result = co_await awaitTypedRequest(socket, kSumRPC, argument, 1000);
+    sums.push_back(result.sum);
+  }
+  thread_id = std::this_thread::get_id();
+  try {
+    SumArgument argument;
+    co_await awaitTypedRequest(socket, kMissingRPC, argument, 200);
+  } catch (SocketException const &e) {
+    failed_missing = true;
+  }
+  done.set_value();
+}
+
+/**
+ * Test if a flow awaiting typed requests gets their results, resumed back on the scheduling thread, and the error of a
+ * request that is never answered.
+ */
+TEST(RPCAwaitable, AwaitTypedRequest) {
+  const int kPort = 13336;
+  ServerSocket server_socket(AF_INET, "127.0.0.1", kPort, 16);
+  ClientBsonRPCSocket client_rpc_socket(AF_INET, "127.0.0.1", kPort);
+  registerTypedCallback(client_rpc_socket, kSumRPC, [](SumArgument const &argument) -> SumResult {
+    SumResult result{0};
+    for (int value : argument.values) result.sum += value;
+    return result;
+  });
+  std::thread client_thread([&client_rpc_socket]() -> void {
+    while (true) {
+      try {
+        client_rpc_socket.connectToServer();
+        break;
+      } catch (SocketException &error) {
+      }
+    }
+  });
+  std::shared_ptr<ConnectionBsonRPCSocket> connection_rpc_socket;
+  while (!connection_rpc_socket) connection_rpc_socket = server_socket.acceptConnection<ConnectionBsonRPCSocket>();
+  connection_rpc_socket->startConnection();
+  client_thread.join();
+
+  std::vector<int> sums;
+  std::atomic<bool> failed_missing = false;
+  std::thread::id flow_thread_id;
+  std::promise<std::thread::id> scheduler_thread_id;
+  std::promise<void> done;
+  auto scheduler = std::make_shared<CoroutineScheduler>();
+  scheduler->spawn(recordThread(scheduler_thread_id));
+  scheduler->spawn(awaitSums(*connection_rpc_socket, sums, failed_missing, flow_thread_id, done));
+  ASSERT_EQ(done.get_future().wait_for(2s), std::future_status::ready);
+  ASSERT_EQ(sums, (std::vector<int>{1, 4, 9}));
+  ASSERT_TRUE(failed_missing);
+  ASSERT_EQ(flow_thread_id, scheduler_thread_id.get_future().get());
+
+  scheduler->shutdown();
+  connection_rpc_socket->close();
+  client_rpc_socket.close();
+  server_socket.close();
+}
@@ -1,6 +1,15 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+
+#include "../mros/mediator_environment.hpp"
 #include "mediator/mediator.hpp"
+#include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+
+static constexpr int kMediatorPort = 13362;
+
+testing::Environment *const mediator_environment =
+    testing::AddGlobalTestEnvironment(new MediatorEnvironment(kMediatorPort));
 
 TEST(Mediator, TestBasic) {
   ASSERT_TRUE(true);
@@ -45,21 +54,22 @@ TEST(Mediator, TestBasic) {
  */
 
 /**
- * Test jsonAddNodeCallback().
- */
-
-/**
- * Test jsonAddPublisherCallback().
- */
-
-/**
- * Test jsonAddSubscriberCallback().
- */
-
-/**
- * Test jsonRemovePublisherCallback().
- */
-
-/**
- * Test jsonRemoveSubscriberCallback().
+ * Test that the typed callbacks registered for each connection reject malformed requests, answering full duplex ones
+ * with an error and dropping half duplex ones, and that the connection keeps serving well formed requests.
  */
+TEST(Mediator, RejectMalformedRequests) {
+  ClientBsonRPCSocket client(AF_INET, MediatorEnvironment::kMediatorAddress, kMediatorPort);
+  client.connectToServer(ConnectNodeRequest{"malformed_client"});
+
+  ASSERT_THROW(client.sendRequestAndGetFuture(kAddSubscriberRPC.name, {{"topic", 5}}, 2000).get(), SocketException);
+  client.sendRequest(kAddPublisherRPC.name, {{"topic_name", "malformed_topic"}});
+
+  GraphUpdate update = sendTypedRequestAndGetFuture(client, kGetGraphRPC, GraphRequest{false, 0}, 2000).get();
+  auto node = std::find_if(update.nodes.begin(), update.nodes.end(), [](GraphNodeInfo const &node_info) -> bool {
+    return node_info.node_name == "malformed_client";
+  });
+  ASSERT_NE(node, update.nodes.end());
+  ASSERT_TRUE(node->publications.empty());
+  ASSERT_TRUE(node->subscriptions.empty());
+  client.close();
+}
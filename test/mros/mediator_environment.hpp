@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <csignal>
+#include <thread>
+
+#include "mediator/mediator.hpp"
+#include "mros/mros.hpp"
+
+/**
+ * Environment running a Mediator in the test process for the tests' Nodes to connect to, stopped the same way ctrl+C
+ * stops it.
+ */
+class MediatorEnvironment : public testing::Environment {
+ public:
+  /**
+   * @param port The port the Mediator listens on, distinct for each test executable.
+   */
+  explicit MediatorEnvironment(int port) : port_(port) {}
+
+  void SetUp() override {
+    char program_name[] = "test";
+    char *argv[] = {program_name, nullptr};
+    MROS::init(1, argv);
+    mediator_thread_ = std::thread([port = port_]() -> void { Mediator mediator(kMediatorAddress, port); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+
+  void TearDown() override {
+    std::raise(SIGINT);
+    mediator_thread_.join();
+  }
+
+  static constexpr char const *kMediatorAddress = "127.0.0.1";
+
+ private:
+  int port_;
+  std::thread mediator_thread_;
+};
+
+/**
+ * Wait up to a timeout for a condition to hold, returning whether it did.
+ */
+template <typename ConditionT>
+bool waitFor(ConditionT const &condition, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000)) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
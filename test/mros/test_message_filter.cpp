@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "mros/message_filter.hpp"
+
+using json = nlohmann::json;
+
+/**
+ * Encode a message the way publishers do.
+ */
+static std::vector<std::uint8_t> encode(json const &message) { return json::to_bson(message); }
+
+/**
+ * Message with fields of every type filters read, including nested documents and arrays.
+ */
+static json const kMessage = {{"id", 7},
+                              {"big", std::numeric_limits<std::int64_t>::max()},
+                              {"wide", std::int64_t{1} << 40},
+                              {"speed", 2.5},
+                              {"name", "front_camera"},
+                              {"valid", true},
+                              {"nothing", nullptr},
+                              {"data", json::binary({1, 2, 3})},
+                              {"pose", {{"position", {{"x", 1.5}, {"y", -3}}}, {"frame", "map"}}},
+                              {"ranges", {0.5, 1.5, 2.5}}};
+
+/**
+ * Test if equals conditions match fields of each type, comparing numbers by value.
+ */
+TEST(MessageFilter, Equals) {
+  auto bson = encode(kMessage);
+  ASSERT_TRUE(MessageFilter().matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("id", 7).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("id", 7.0).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("id", 8).matches(bson));
+  std::uint64_t big = std::numeric_limits<std::int64_t>::max();
+  ASSERT_TRUE(MessageFilter().whereEquals("big", big).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("big", static_cast<double>(std::numeric_limits<std::int64_t>::max()) * 2)
+                   .matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("wide", std::int64_t{1} << 40).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("speed", 2.5).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("name", "front_camera").matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("name", "front").matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("name", 7).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("valid", true).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("valid", false).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("nothing", nullptr).matches(bson));
+}
+
+/**
+ * Test if conditions reach into nested documents and arrays, past fields of types they do not read.
+ */
+TEST(MessageFilter, NestedFields) {
+  auto bson = encode(kMessage);
+  ASSERT_TRUE(MessageFilter().whereEquals("pose.frame", "map").matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("pose.position.y", -3).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("ranges.1", 1.5).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("ranges.3", 1.5).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("pose.position.z", 0).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("name.first", "front").matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("missing", 0).matches(bson));
+}
+
+/**
+ * Test if range conditions are inclusive, only match numbers, and combine with other conditions.
+ */
+TEST(MessageFilter, Range) {
+  auto bson = encode(kMessage);
+  ASSERT_TRUE(MessageFilter().whereInRange("speed", 2.5, 3).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereInRange("id", 0, 7).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereInRange("id", 8, 9).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereInRange("pose.position.x", 1, 2).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereInRange("name", 0, 1).matches(bson));
+  ASSERT_TRUE(MessageFilter().whereEquals("valid", true).whereInRange("id", 5, 10).matches(bson));
+  ASSERT_FALSE(MessageFilter().whereEquals("valid", true).whereInRange("id", 10, 20).matches(bson));
+}
+
+/**
+ * Test if truncated or corrupt Bson fails the filter rather than being read past its end.
+ */
+TEST(MessageFilter, MalformedBson) {
+  auto bson = encode(kMessage);
+  MessageFilter filter = MessageFilter().whereEquals("ranges.2", 2.5);
+  ASSERT_TRUE(filter.matches(bson));
+  for (std::size_t size = 0; size < bson.size(); ++size) {
+    ASSERT_FALSE(filter.matches(std::span(bson).first(size)));
+  }
+
+  // A string length running past the document.
+  auto corrupt = encode({{"name", "abc"}, {"id", 1}});
+  corrupt[4 + 1 + 5] = 0xFF;
+  ASSERT_FALSE(MessageFilter().whereEquals("id", 1).matches(corrupt));
+  ASSERT_FALSE(MessageFilter().whereEquals("id", 1).matches(std::vector<std::uint8_t>{1, 2, 3}));
+}
+
+/**
+ * Test if a filter survives the round trip through the request a subscriber sends to publishers.
+ */
+TEST(MessageFilter, RequestRoundTrip) {
+  SubscribeRequest request{MessageFilter().whereEquals("name", "front_camera").whereInRange("speed", 1, 3)};
+  auto decoded = json::from_bson(json::to_bson(request)).get<SubscribeRequest>();
+  ASSERT_EQ(decoded.filter.conditions.size(), 2);
+  ASSERT_TRUE(decoded.filter.matches(encode(kMessage)));
+  ASSERT_FALSE(decoded.filter.matches(encode({{"name", "front_camera"}, {"speed", 4}})));
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "mros/message_lifespan.hpp"
+#include "mros/utils/topic_frame.hpp"
+
+using namespace std::chrono_literals;
+using Clock = MessageLifespan::Clock;
+
+/**
+ * Make a frame holding only a header, published a time ago by the wall clock.
+ */
+static std::vector<std::uint8_t> frameOfAge(std::chrono::nanoseconds age) {
+  TopicFrameHeader header{TopicFrameHeader::now() - age.count(), 0};
+  auto encoded_header = header.encode();
+  return {encoded_header.begin(), encoded_header.end()};
+}
+
+/**
+ * Test if a lifespan of zero keeps messages however old.
+ */
+TEST(MessageLifespan, Unlimited) {
+  MessageLifespan lifespan;
+  ASSERT_FALSE(lifespan.limited());
+  ASSERT_FALSE(lifespan.needsReceiveTime());
+  auto now = Clock::now();
+  ASSERT_FALSE(lifespan.expired(frameOfAge(1h), now - 1h, now));
+}
+
+/**
+ * Test if messages expire by the time since they were received, whatever their publish time.
+ */
+TEST(MessageLifespan, ReceiveTime) {
+  MessageLifespan lifespan(100ms);
+  ASSERT_TRUE(lifespan.needsReceiveTime());
+  auto now = Clock::now();
+  ASSERT_FALSE(lifespan.expired(frameOfAge(1h), now - 50ms, now));
+  ASSERT_FALSE(lifespan.expired(frameOfAge(0ms), now - 100ms, now));
+  ASSERT_TRUE(lifespan.expired(frameOfAge(0ms), now - 101ms, now));
+}
+
+/**
+ * Test if messages expire by the publish time in their header, whatever their receive time, and if frames without a
+ * header are left for decoding to reject.
+ */
+TEST(MessageLifespan, PublishTime) {
+  MessageLifespan lifespan(100ms, LifespanClock::kPublishTime);
+  ASSERT_FALSE(lifespan.needsReceiveTime());
+  auto now = Clock::now();
+  ASSERT_FALSE(lifespan.expired(frameOfAge(50ms), now - 1h, now));
+  ASSERT_TRUE(lifespan.expired(frameOfAge(200ms), now, now));
+  ASSERT_FALSE(lifespan.expired(std::vector<std::uint8_t>(3), now, now));
+}
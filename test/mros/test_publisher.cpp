@@ -1,29 +1,83 @@
-#include "gtest/gtest.h"
+#include <gtest/gtest.h>
 
-#include "mros/publisher.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
-TEST(Publisher, TestBasic) {
-  ASSERT_TRUE(true);
-}
+#include "mediator_environment.hpp"
+#include "mros/node.hpp"
 
-/**
- * Test ~Publisher().
- */
+using namespace std::chrono_literals;
 
 /**
- * Test publish().
+ * Message counting the times it is encoded, so that tests can tell whether publishing encoded it.
  */
+struct CountedMessage {
+  int data = 0;
 
-/** TESTS FOR THE PRIVATE INTERFACE WITH NODE **/
+  static inline std::atomic<int> convert_count = 0;
 
-/**
- * Test Publisher(node, topic_name).
- */
+  void set_from_json(nlohmann::json json) { data = json["data"]; }
+
+  nlohmann::json convert_to_json() const {
+    ++convert_count;
+    return {{"data", data}};
+  }
+};
+
+static constexpr int kMediatorPort = 13360;
+
+testing::Environment *const mediator_environment =
+    testing::AddGlobalTestEnvironment(new MediatorEnvironment(kMediatorPort));
 
 /**
- * Test getAddress().
+ * Test if the subscriber count goes from zero to one as a Subscriber connects and back to zero once it disconnects, and
+ * if the connect callback is called once with the new count.
  */
+TEST(Publisher, SubscriberCount) {
+  auto publishing_node = std::make_shared<Node>("publisher", MediatorEnvironment::kMediatorAddress, kMediatorPort);
+  auto publisher = publishing_node->createPublisher<CountedMessage>("count_topic");
+  std::vector<std::size_t> connect_counts;
+  std::mutex connect_counts_mutex;
+  publisher->onSubscriberConnect([&connect_counts, &connect_counts_mutex](std::size_t count) -> void {
+    std::lock_guard<std::mutex> connect_counts_lock_guard(connect_counts_mutex);
+    connect_counts.push_back(count);
+  });
+  ASSERT_FALSE(publisher->hasSubscribers());
+  ASSERT_EQ(publisher->getNumSubscribers(), 0);
+
+  auto subscribing_node = std::make_shared<Node>("subscriber", MediatorEnvironment::kMediatorAddress, kMediatorPort);
+  auto subscriber = subscribing_node->createSubscriber<CountedMessage>("count_topic", 10,
+                                                                       [](CountedMessage const &) -> void {});
+  ASSERT_TRUE(waitFor([&publisher]() -> bool { return publisher->hasSubscribers(); }));
+  ASSERT_EQ(publisher->getNumSubscribers(), 1);
+  {
+    std::lock_guard<std::mutex> connect_counts_lock_guard(connect_counts_mutex);
+    ASSERT_EQ(connect_counts, std::vector<std::size_t>{1});
+  }
+
+  // Disconnect the Subscriber, then publish once so that its receiving thread wakes to see it and the Subscriber can be
+  // destroyed. The Publisher finds out that the Subscriber is gone when it next sends to it.
+  subscribing_node.reset();
+  publisher->publish(CountedMessage{});
+  subscriber.reset();
+  ASSERT_TRUE(waitFor([&publisher]() -> bool {
+    publisher->publish(CountedMessage{});
+    return !publisher->hasSubscribers();
+  }));
+  ASSERT_EQ(publisher->getNumSubscribers(), 0);
+  std::lock_guard<std::mutex> connect_counts_lock_guard(connect_counts_mutex);
+  ASSERT_EQ(connect_counts, std::vector<std::size_t>{1});
+}
 
 /**
- * Test disconnect().
- */
\ No newline at end of file
+ * Test if publishing with no subscribers returns without encoding the message.
+ */
+TEST(Publisher, PublishWithoutSubscribers) {
+  auto publishing_node = std::make_shared<Node>("publisher", MediatorEnvironment::kMediatorAddress, kMediatorPort);
+  auto publisher = publishing_node->createPublisher<CountedMessage>("unheard_topic");
+  CountedMessage::convert_count = 0;
+  for (int i = 0; i < 10; ++i) publisher->publish(CountedMessage{i});
+  ASSERT_EQ(CountedMessage::convert_count, 0);
+}
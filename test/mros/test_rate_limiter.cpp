@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include "mros/rate_limiter.hpp"
+
+using namespace std::chrono_literals;
+using Clock = RateLimiter::Clock;
+
+/**
+ * Count the messages a limiter lets through out of messages arriving at a fixed interval for a duration.
+ */
+static int countLetThrough(RateLimiter& rate_limiter, Clock::time_point start, Clock::duration interval,
+                           Clock::duration duration) {
+  int count = 0;
+  for (auto now = start; now < start + duration; now += interval) {
+    if (rate_limiter.due(now)) {
+      rate_limiter.take(now);
+      ++count;
+    }
+  }
+  return count;
+}
+
+/**
+ * Test if a limiter without a rate lets every message through.
+ */
+TEST(RateLimiter, Unlimited) {
+  RateLimiter rate_limiter;
+  ASSERT_FALSE(rate_limiter.limited());
+  ASSERT_EQ(countLetThrough(rate_limiter, Clock::now(), 1ms, 1s), 1000);
+  ASSERT_FALSE(RateLimiter(-1).limited());
+}
+
+/**
+ * Test if messages published faster than the maximum rate are decimated to it without drifting. The slack lets each
+ * message through a little early, so a window holds up to one more message than the rate gives.
+ */
+TEST(RateLimiter, Decimates) {
+  RateLimiter rate_limiter(2);
+  ASSERT_TRUE(rate_limiter.limited());
+  ASSERT_NEAR(countLetThrough(rate_limiter, Clock::now(), 5ms, 10s), 20, 1);
+
+  // Intervals that do not divide the period still average out to the rate.
+  RateLimiter uneven_rate_limiter(30);
+  ASSERT_NEAR(countLetThrough(uneven_rate_limiter, Clock::now(), 7ms, 10s), 300, 1);
+}
+
+/**
+ * Test if messages at exactly the maximum rate all pass despite arriving a little early.
+ */
+TEST(RateLimiter, JitterAtMaximumRate) {
+  RateLimiter rate_limiter(100);
+  auto start = Clock::now();
+  int count = 0;
+  for (int i = 0; i < 1000; ++i) {
+    auto now = start + i * 10ms + (i % 2 == 0 ? 1ms : -1ms);
+    if (rate_limiter.due(now)) {
+      rate_limiter.take(now);
+      ++count;
+    }
+  }
+  ASSERT_EQ(count, 1000);
+}
+
+/**
+ * Test if a limiter that fell behind after a pause does not let a burst through to catch up.
+ */
+TEST(RateLimiter, NoBurstAfterPause) {
+  RateLimiter rate_limiter(10);
+  auto start = Clock::now();
+  ASSERT_NEAR(countLetThrough(rate_limiter, start, 10ms, 1s), 10, 1);
+  ASSERT_EQ(countLetThrough(rate_limiter, start + 10s, 1ms, 50ms), 1);
+}
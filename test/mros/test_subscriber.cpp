@@ -1,33 +1,152 @@
-#include "gtest/gtest.h"
+#include <gtest/gtest.h>
 
-#include "mros/subscriber.hpp"
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
 
-TEST(Subscriber, TestBasic) {
-  ASSERT_TRUE(true);
-}
+#include "mediator_environment.hpp"
+#include "messages/example_message.hpp"
+#include "mros/node.hpp"
+
+using namespace std::chrono_literals;
+
+static constexpr int kMediatorPort = 13361;
+
+testing::Environment *const mediator_environment =
+    testing::AddGlobalTestEnvironment(new MediatorEnvironment(kMediatorPort));
 
 /**
- * Test ~Subscriber().
+ * Testing fixture for a batch Subscriber connected to a Publisher, recording the batches its callback is run with.
  */
+class BatchSubscriberTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    subscribing_node_ = std::make_shared<Node>("subscriber", MediatorEnvironment::kMediatorAddress, kMediatorPort);
+    publishing_node_ = std::make_shared<Node>("publisher", MediatorEnvironment::kMediatorAddress, kMediatorPort);
+    publisher_ = publishing_node_->createPublisher<StringMessage>(kTopicName_);
+  }
+
+  /**
+   * Create the Subscriber and wait for it to connect to the Publisher.
+   */
+  void subscribe(SubscriberOptions const &options) {
+    subscriber_ = subscribing_node_->createSubscriber<StringMessage>(
+        kTopicName_, 100, [this](std::span<StringMessage const> messages) -> void {
+          std::vector<std::string> batch;
+          for (auto const &message : messages) batch.push_back(message.data);
+          batches_.push_back(batch);
+          std::this_thread::sleep_for(callback_stall_);
+        },
+        options);
+    ASSERT_TRUE(waitFor([this]() -> bool { return publisher_->hasSubscribers(); }));
+  }
+
+  /**
+   * Publish messages numbered from first to last, then give the Subscriber time to queue them.
+   */
+  void publish(int first, int last) {
+    for (int i = first; i <= last; ++i) publisher_->publish(StringMessage{std::to_string(i)});
+    std::this_thread::sleep_for(200ms);
+  }
+
+  /**
+   * Run the callback with every queued message as a WaitSet does.
+   */
+  void spinSome() {
+    WaitSet wait_set;
+    wait_set.addSubscriber(subscriber_);
+    wait_set.spinSome(1s);
+  }
+
+  /**
+   * Destroyed in reverse, the Publisher first, so that the Subscriber's receiving thread is not left waiting on it.
+   */
+  std::shared_ptr<Node> subscribing_node_;
+  std::shared_ptr<Subscriber<StringMessage>> subscriber_;
+  std::shared_ptr<Node> publishing_node_;
+  std::shared_ptr<Publisher<StringMessage>> publisher_;
+
+  std::vector<std::vector<std::string>> batches_;
+
+  /**
+   * Time the callback takes with each batch.
+   */
+  std::chrono::milliseconds callback_stall_{0};
+
+  const std::string kTopicName_ = "batch_topic";
+};
 
 /**
- * Test spin().
+ * Test if the span callback is run once with every queued message, in order.
  */
+TEST_F(BatchSubscriberTest, SpanCallback) {
+  subscribe({});
+  publish(0, 4);
+  spinSome();
+  std::vector<std::vector<std::string>> expected_batches = {{"0", "1", "2", "3", "4"}};
+  ASSERT_EQ(batches_, expected_batches);
+}
 
 /**
- * Test spinOnce().
+ * Test if queued messages are split into batches of at most the maximum batch size.
  */
-
-/** TESTS FOR THE PRIVATE INTERFACE WITH NODE **/
+TEST_F(BatchSubscriberTest, MaxBatchSize) {
+  SubscriberOptions options;
+  options.max_batch_size = 4;
+  subscribe(options);
+  publish(0, 9);
+  spinSome();
+  std::vector<std::vector<std::string>> expected_batches = {
+      {"0", "1", "2", "3"}, {"4", "5", "6", "7"}, {"8", "9"}};
+  ASSERT_EQ(batches_, expected_batches);
+}
 
 /**
- * Test Subscriber(node, topic_name, queue_size, callback).
+ * Test if messages that outlived the lifespan are left out of the batch and counted.
  */
+TEST_F(BatchSubscriberTest, SkipExpired) {
+  SubscriberOptions options;
+  options.lifespan = 300ms;
+  subscribe(options);
+  publish(0, 2);
+  std::this_thread::sleep_for(300ms);
+  publish(3, 4);
+  spinSome();
+  std::vector<std::vector<std::string>> expected_batches = {{"3", "4"}};
+  ASSERT_EQ(batches_, expected_batches);
+  ASSERT_EQ(subscriber_->expiredCount(), 3);
+}
 
 /**
- * Test connectToPublisher().
+ * Test if messages that expire while the callback is stalled on an earlier batch of the same spin are skipped and
+ * counted.
  */
+TEST_F(BatchSubscriberTest, ExpireDuringStalledCallback) {
+  SubscriberOptions options;
+  options.lifespan = 500ms;
+  options.max_batch_size = 2;
+  callback_stall_ = 400ms;
+  subscribe(options);
+  publish(0, 5);
+  spinSome();
+  publish(6, 7);
+  spinSome();
+  std::vector<std::vector<std::string>> expected_batches = {{"0", "1"}, {"6", "7"}};
+  ASSERT_EQ(batches_, expected_batches);
+  ASSERT_EQ(subscriber_->expiredCount(), 4);
+}
 
 /**
- * Test disconnect().
- */
\ No newline at end of file
+ * Test if spinOnce() runs the span callback with a batch of one message.
+ */
+TEST_F(BatchSubscriberTest, SpinOnceBatchOfOne) {
+  subscribe({});
+  publish(0, 2);
+  subscriber_->spinOnce();
+  subscriber_->spinOnce();
+  std::vector<std::vector<std::string>> expected_batches = {{"0"}, {"1"}};
+  ASSERT_EQ(batches_, expected_batches);
+}
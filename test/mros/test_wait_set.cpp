@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mros/subscriber.hpp"
+#include "mros/wait_set.hpp"
+
+using namespace std::chrono_literals;
+using Clock = WaitSet::Clock;
+
+/**
+ * Subscriber queueing integers pushed by the test, raising its WaitSets as a Subscriber does on receiving.
+ */
+class FakeSubscriber : public SubscriberBase {
+ public:
+  void push(int value) {
+    std::lock_guard<std::mutex> values_lock_guard(values_mutex_);
+    values_.push_back(value);
+    if (values_.size() == 1) wait_signals_.notify();
+  }
+
+  std::vector<int> received_;
+
+ protected:
+  void disconnect() override {}
+
+  void connectToPublisher(std::string const &, int, TopicTransport, std::string const &) override {}
+
+  void spin() override {}
+
+  void spinOnce() override {}
+
+  void spinOn(std::shared_ptr<ThreadPool> const &) override {}
+
+  bool hasMessages() override {
+    std::lock_guard<std::mutex> values_lock_guard(values_mutex_);
+    return !values_.empty();
+  }
+
+  std::size_t spinSome() override {
+    std::lock_guard<std::mutex> values_lock_guard(values_mutex_);
+    received_.insert(received_.end(), values_.begin(), values_.end());
+    std::size_t count = values_.size();
+    values_.clear();
+    return count;
+  }
+
+ private:
+  std::vector<int> values_;
+  std::mutex values_mutex_;
+};
+
+/**
+ * Test if waiting with nothing ready blocks for the timeout and reports nothing.
+ */
+TEST(WaitSet, TimesOut) {
+  WaitSet wait_set;
+  wait_set.addSubscriber(std::make_shared<FakeSubscriber>());
+  auto start = Clock::now();
+  ASSERT_TRUE(wait_set.wait(50ms).empty());
+  ASSERT_GE(Clock::now() - start, 50ms);
+  ASSERT_EQ(wait_set.spinSome(0ms), 0);
+}
+
+/**
+ * Test if a message queued from another thread wakes the wait, which reports only the subscriber that is ready, and
+ * if every queued message is processed in one call.
+ */
+TEST(WaitSet, WakesOnMessage) {
+  WaitSet wait_set;
+  auto idle_subscriber = std::make_shared<FakeSubscriber>();
+  auto subscriber = std::make_shared<FakeSubscriber>();
+  wait_set.addSubscriber(idle_subscriber);
+  wait_set.addSubscriber(subscriber);
+  std::thread pushing_thread([&subscriber]() -> void {
+    std::this_thread::sleep_for(20ms);
+    for (int i = 0; i < 5; ++i) subscriber->push(i);
+  });
+  auto start = Clock::now();
+  WaitResult result = wait_set.wait(-1ms);
+  ASSERT_LT(Clock::now() - start, 1s);
+  ASSERT_EQ(result.subscribers, std::vector<std::size_t>{1});
+  pushing_thread.join();
+  ASSERT_EQ(wait_set.spinSome(0ms), 5);
+  ASSERT_EQ(subscriber->received_, (std::vector<int>{0, 1, 2, 3, 4}));
+  ASSERT_TRUE(idle_subscriber->received_.empty());
+}
+
+/**
+ * Test if a guard condition triggered before the wait is reported by it, once.
+ */
+TEST(WaitSet, GuardCondition) {
+  WaitSet wait_set;
+  auto guard_condition = std::make_shared<GuardCondition>();
+  int run_count = 0;
+  wait_set.addGuardCondition(guard_condition, [&run_count]() -> void { ++run_count; });
+  guard_condition->trigger();
+  ASSERT_EQ(wait_set.spinSome(1s), 1);
+  ASSERT_EQ(run_count, 1);
+  ASSERT_TRUE(wait_set.wait(10ms).empty());
+
+  std::thread triggering_thread([&guard_condition]() -> void {
+    std::this_thread::sleep_for(20ms);
+    guard_condition->trigger();
+  });
+  ASSERT_EQ(wait_set.wait(1s).guard_conditions, std::vector<std::size_t>{0});
+  triggering_thread.join();
+}
+
+/**
+ * Test if timers wake the wait on their deadlines, running on the waiting thread at their own rates.
+ */
+TEST(WaitSet, Timers) {
+  WaitSet wait_set;
+  int fast_count = 0;
+  int slow_count = 0;
+  wait_set.addTimer(10ms, [&fast_count]() -> void { ++fast_count; });
+  wait_set.addTimer(50ms, [&slow_count]() -> void { ++slow_count; });
+  auto start = Clock::now();
+  while (Clock::now() - start < 505ms) wait_set.spinSome(1s);
+  ASSERT_GE(fast_count, 25);
+  ASSERT_LE(fast_count, 51);
+  ASSERT_GE(slow_count, 5);
+  ASSERT_LE(slow_count, 11);
+}
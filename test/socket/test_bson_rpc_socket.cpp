@@ -1,11 +1,40 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
 #include "socket/bson_rpc_socket/connection_bson_rpc_socket.hpp"
+#include "socket/bson_rpc_socket/rpc_dispatcher.hpp"
+#include "socket/bson_rpc_socket/typed_rpc.hpp"
 #include "socket/server_socket.hpp"
 
+/**
+ * Argument of the typed RPC methods in the TypedRequest test.
+ */
+struct TypedArgument {
+  std::string name;
+  std::vector<int> values;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TypedArgument, name, values)
+
+/**
+ * Result of the typed full duplex RPC method in the TypedRequest test.
+ */
+struct TypedResult {
+  int sum;
+};
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TypedResult, sum)
+
+/**
+ * Typed methods for the TypedRequest test.
+ */
+inline constexpr RPCMethod<TypedArgument> kTypedRequestRPC{"typedRequest"};
+inline constexpr RPCMethod<TypedArgument, TypedResult> kTypedSumRPC{"typedSum"};
+
 /**
  * Testing fixture for testing rpc sockets.
  */
@@ -170,6 +199,188 @@ class RPCSocketTest : public testing::Test {
     connection_rpc_socket_->close();
   }
 
+  /**
+   * Client process for RequestFuture test.
+   */
+  void requestFutureClient() {
+    RequestResponseCallbackJson callback = [this](json const &input) -> json {
+      return requestResponseCallback1(input);
+    };
+    client_rpc_socket_->registerRequestResponseCallback("requestResponseCallback1", callback);
+    connectClient();
+  }
+
+  /**
+   * Server process for RequestFuture test. Keeps many requests outstanding and checks each gets its own response.
+   */
+  void requestFutureServer() {
+    acceptConnection();
+    connection_rpc_socket_->startConnection();
+    std::vector<std::future<json>> futures;
+    for (int i = 0; i < kOutstandingRequestCount_; ++i) {
+      futures.push_back(connection_rpc_socket_->sendRequestAndGetFuture("requestResponseCallback1", {{"index", i}}));
+    }
+    for (int i = 0; i < kOutstandingRequestCount_; ++i) {
+      EXPECT_EQ(futures[i].get()["index"], i);
+    }
+    connection_rpc_socket_->close();
+  }
+
+  /**
+   * Client process for RequestFutureFailure test.
+   */
+  void requestFutureFailureClient() {
+    RequestResponseCallbackJson callback = [](json const &input) -> json {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      return input;
+    };
+    client_rpc_socket_->registerRequestResponseCallback("slowCallback", callback);
+    connectClient();
+  }
+
+  /**
+   * Server process for RequestFutureFailure test.
+   */
+  void requestFutureFailureServer() {
+    acceptConnection();
+    connection_rpc_socket_->startConnection();
+
+    // A response that does not arrive within the timeout fails the future.
+    auto slow_future = connection_rpc_socket_->sendRequestAndGetFuture("slowCallback", kRequestCallback1CorrectRequest_,
+                                                                       20);
+    EXPECT_THROW(slow_future.get(), RPCTimeoutException);
+
+    // A request for a callback the peer does not have fails instead of going unanswered.
+    auto missing_future = connection_rpc_socket_->sendRequestAndGetFuture("missingCallback", {});
+    EXPECT_THROW(missing_future.get(), SocketException);
+
+    // The callback form receives the ready future.
+    std::promise<json> callback_promise;
+    connection_rpc_socket_->sendRequestAndGetResponse(
+        "slowCallback", kRequestCallback1CorrectRequest_,
+        [&callback_promise](std::future<json> response) -> void { callback_promise.set_value(response.get()); });
+    EXPECT_EQ(callback_promise.get_future().get(), kRequestCallback1CorrectRequest_);
+    connection_rpc_socket_->close();
+
+    // Requests on a closed socket fail immediately.
+    auto closed_future = connection_rpc_socket_->sendRequestAndGetFuture("slowCallback", {});
+    EXPECT_THROW(closed_future.get(), SocketException);
+  }
+
+  /**
+   * Client process for DispatchedCallbacks test. Runs callbacks on a dispatcher, serializing orderedCallback.
+   */
+  void dispatchedCallbacksClient() {
+    auto dispatcher = std::make_shared<RPCDispatcher>(4);
+    dispatcher->setPolicy("orderedCallback", DispatchPolicy::kSerializedPerMethod);
+    client_rpc_socket_->setDispatcher(dispatcher);
+    client_rpc_socket_->registerRequestResponseCallback("slowCallback", [this](json const &input) -> json {
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      ++slowCallbackFinishedCount_;
+      return input;
+    });
+    client_rpc_socket_->registerRequestResponseCallback("fastCallback",
+                                                        [](json const &input) -> json { return input; });
+    client_rpc_socket_->registerRequestCallback("orderedCallback", [this](json const &input) -> void {
+      std::lock_guard<std::mutex> ordered_indices_lock_guard(ordered_indices_lock_);
+      ordered_indices_.push_back(input["index"]);
+    });
+    client_rpc_socket_->registerClosingCallback(
+        [this]() -> void { closingSlowCallbackCount_ = slowCallbackFinishedCount_.load(); });
+    connectClient();
+  }
+
+  /**
+   * Server process for DispatchedCallbacks test.
+   */
+  void dispatchedCallbacksServer() {
+    acceptConnection();
+    connection_rpc_socket_->startConnection();
+
+    // A fast request is answered while a slow request sent before it is still running.
+    auto slow_future = connection_rpc_socket_->sendRequestAndGetFuture("slowCallback", {{"slow", true}});
+    auto fast_future = connection_rpc_socket_->sendRequestAndGetFuture("fastCallback", {{"fast", true}});
+    EXPECT_EQ(fast_future.get()["fast"], true);
+    EXPECT_EQ(slowCallbackFinishedCount_, 0);
+
+    // Serialized requests run in the order they were sent.
+    for (int i = 0; i < kOrderedRequestCount_; ++i) {
+      connection_rpc_socket_->sendRequest("orderedCallback", {{"index", i}});
+    }
+
+    // Closing waits for the dispatched callbacks before running the closing callback.
+    connection_rpc_socket_->sendRequestAndGetFuture("slowCallback", {{"slow", true}});
+    EXPECT_EQ(slow_future.get()["slow"], true);
+    connection_rpc_socket_->close();
+  }
+
+  /**
+   * Client process for TypedRequest test.
+   */
+  void typedRequestClient() {
+    registerTypedCallback(*client_rpc_socket_, kTypedRequestRPC, [this](TypedArgument const &argument) -> void {
+      EXPECT_EQ(argument.name, "request");
+      ++requestCallback1Count_;
+    });
+    registerTypedCallback(*client_rpc_socket_, kTypedSumRPC, [](TypedArgument const &argument) -> TypedResult {
+      TypedResult result{0};
+      for (int value : argument.values) result.sum += value;
+      return result;
+    });
+    connectClient();
+  }
+
+  /**
+   * Server process for TypedRequest test.
+   */
+  void typedRequestServer() {
+    acceptConnection();
+    connection_rpc_socket_->startConnection();
+
+    // Typed requests are encoded, decoded and dispatched to the typed handlers.
+    sendTypedRequest(*connection_rpc_socket_, kTypedRequestRPC, {"request", {}});
+    EXPECT_EQ(sendTypedRequestAndGetFuture(*connection_rpc_socket_, kTypedSumRPC, {"sum", {1, 2, 3, 4}}).get().sum, 10);
+
+    // Malformed requests are rejected before reaching the handlers, and answered with an error when full duplex.
+    connection_rpc_socket_->sendRequest(kTypedRequestRPC.name, {{"name", 5}});
+    auto malformed_future = connection_rpc_socket_->sendRequestAndGetFuture(kTypedSumRPC.name, {{"values", "1, 2"}});
+    EXPECT_THROW(malformed_future.get(), SocketException);
+
+    // The connection still works after malformed requests.
+    EXPECT_EQ(sendTypedRequestAndGetFuture(*connection_rpc_socket_, kTypedSumRPC, {"sum", {5}}).get().sum, 5);
+    connection_rpc_socket_->close();
+  }
+
+  /**
+   * Number of requests kept outstanding at once in the RequestFuture test.
+   */
+  const int kOutstandingRequestCount_ = 100;
+
+  /**
+   * Number of serialized requests sent in the DispatchedCallbacks test.
+   */
+  const int kOrderedRequestCount_ = 200;
+
+  /**
+   * Indices received by orderedCallback, in the order it was called.
+   */
+  std::vector<int> ordered_indices_;
+
+  /**
+   * Lock taken to ensure thread safety of accessing ordered_indices_.
+   */
+  std::mutex ordered_indices_lock_;
+
+  /**
+   * Number of slowCallback calls that have finished.
+   */
+  std::atomic<int> slowCallbackFinishedCount_ = 0;
+
+  /**
+   * Value of slowCallbackFinishedCount_ when the closing callback ran.
+   */
+  int closingSlowCallbackCount_ = 0;
+
   /** TESTING CALLBACKS **/
   /**
    * Assert that the data sent to this callback is the same as the stored correct value and increment the call counter
@@ -283,3 +494,74 @@ TEST_F(RPCSocketTest, ClosingCallback) {
   server_thread.join();
   ASSERT_EQ(closingCallback1Count_, 2);
 }
+
+/**
+ * Test if many outstanding full duplex requests are each matched to their own response.
+ */
+TEST_F(RPCSocketTest, RequestFuture) {
+  std::thread client_thread(&RPCSocketTest::requestFutureClient, this);
+  std::thread server_thread(&RPCSocketTest::requestFutureServer, this);
+  client_thread.join();
+  server_thread.join();
+  ASSERT_EQ(requestResponseCallback1Count_, kOutstandingRequestCount_);
+}
+
+/**
+ * Test if full duplex requests fail on timeout, on a missing peer callback, and on a closed socket.
+ */
+TEST_F(RPCSocketTest, RequestFutureFailure) {
+  std::thread client_thread(&RPCSocketTest::requestFutureFailureClient, this);
+  std::thread server_thread(&RPCSocketTest::requestFutureFailureServer, this);
+  client_thread.join();
+  server_thread.join();
+}
+
+/**
+ * Test if dispatched callbacks run concurrently, serialize when configured, and finish before the closing callback.
+ */
+TEST_F(RPCSocketTest, DispatchedCallbacks) {
+  std::thread client_thread(&RPCSocketTest::dispatchedCallbacksClient, this);
+  std::thread server_thread(&RPCSocketTest::dispatchedCallbacksServer, this);
+  client_thread.join();
+  server_thread.join();
+  while (!client_rpc_socket_->closed()) std::this_thread::yield();
+  ASSERT_EQ(ordered_indices_.size(), kOrderedRequestCount_);
+  for (int i = 0; i < kOrderedRequestCount_; ++i) ASSERT_EQ(ordered_indices_[i], i);
+  ASSERT_EQ(closingSlowCallbackCount_, 2);
+}
+
+/**
+ * Test if typed requests reach their handlers, and if malformed requests are rejected without ending the connection.
+ */
+TEST_F(RPCSocketTest, TypedRequest) {
+  std::thread client_thread(&RPCSocketTest::typedRequestClient, this);
+  std::thread server_thread(&RPCSocketTest::typedRequestServer, this);
+  client_thread.join();
+  server_thread.join();
+  ASSERT_EQ(requestCallback1Count_, 1);
+}
+
+/**
+ * Test if callbacks dispatched while the dispatcher shuts down all run, and those for one socket still run in order.
+ */
+TEST(RPCDispatcher, DispatchDuringShutdown) {
+  for (int round = 0; round < 20; ++round) {
+    RPCDispatcher dispatcher(2, DispatchPolicy::kSerializedPerSocket);
+    dispatcher.setPolicy("parallel", DispatchPolicy::kParallel);
+    std::atomic<int> parallel_count = 0;
+    std::vector<int> serial_indices;
+    int const dispatch_count = 2000;
+    std::thread dispatching_thread([&]() -> void {
+      for (int i = 0; i < dispatch_count; ++i) {
+        dispatcher.dispatch(&dispatcher, "serial", [&serial_indices, i]() -> void { serial_indices.push_back(i); });
+        dispatcher.dispatch(&dispatcher, "parallel", [&parallel_count]() -> void { ++parallel_count; });
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::microseconds(100 * round));
+    dispatcher.shutdown();
+    dispatching_thread.join();
+    ASSERT_EQ(parallel_count, dispatch_count);
+    ASSERT_EQ(serial_indices.size(), dispatch_count);
+    for (int i = 0; i < dispatch_count; ++i) ASSERT_EQ(serial_indices[i], i);
+  }
+}
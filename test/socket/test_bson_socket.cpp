@@ -1,9 +1,16 @@
+#include <arpa/inet.h>
 #include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "socket/bson_socket/client_bson_socket.hpp"
 #include "socket/bson_socket/connection_bson_socket.hpp"
+#include "socket/bson_socket/write_coalescer.hpp"
 #include "socket/server_socket.hpp"
 
 /**
@@ -128,3 +135,103 @@ TEST_F(MessageSocketTest, SendReceive) {
   ASSERT_THROW(connection_socket_->sendMessage(message1_), PeerClosedException);
   ASSERT_THROW(connection_socket_->receiveMessage(), PeerClosedException);
 }
+
+/**
+ * Test if frames sent together, more than fit in one sendmsg() call, are received separately and in order.
+ */
+TEST_F(MessageSocketTest, SendFrames) {
+  std::size_t const frame_count = 2000;
+  std::vector<Bson> headers;
+  std::vector<Bson> payloads;
+  std::vector<ByteSpan> frame_parts;
+  for (std::size_t i = 0; i < frame_count; ++i) {
+    headers.push_back(Bson(i % 7, static_cast<std::uint8_t>(i)));
+    payloads.push_back(json::to_bson(json{{"index", i}}));
+  }
+  for (std::size_t i = 0; i < frame_count; ++i) {
+    frame_parts.push_back(headers[i]);
+    frame_parts.push_back(payloads[i]);
+  }
+  std::thread sending_thread([this, &frame_parts]() -> void { connection_socket_->sendFrames(frame_parts, 2); });
+  for (std::size_t i = 0; i < frame_count; ++i) {
+    Bson expected_frame = headers[i];
+    expected_frame.insert(expected_frame.end(), payloads[i].begin(), payloads[i].end());
+    ASSERT_EQ(client_socket_->receiveFrame(), expected_frame);
+  }
+  sending_thread.join();
+  ASSERT_THROW(connection_socket_->sendFrames(frame_parts, 3), SocketException);
+}
+
+/**
+ * Test if a write coalescer holds frames until its byte threshold or deadline, and writes them as separate frames.
+ */
+TEST_F(MessageSocketTest, WriteCoalescer) {
+  auto now = WriteCoalescer::Clock::now();
+  WriteCoalescer coalescer(std::chrono::microseconds(500), 10);
+  ASSERT_TRUE(coalescer.empty());
+  ASSERT_EQ(coalescer.deadline(), WriteCoalescer::Clock::time_point::max());
+
+  Bson first{1, 2, 3};
+  Bson second{4, 5};
+  Bson third{6, 7, 8, 9, 10};
+  ASSERT_FALSE(coalescer.add({first}, now));
+  ASSERT_EQ(coalescer.deadline(), now + std::chrono::microseconds(500));
+  ASSERT_FALSE(coalescer.add({second, second}, now + std::chrono::microseconds(100)));
+  ASSERT_EQ(coalescer.deadline(), now + std::chrono::microseconds(500));
+  ASSERT_TRUE(coalescer.add({third}, now + std::chrono::microseconds(200)));
+
+  coalescer.flush(*connection_socket_);
+  ASSERT_TRUE(coalescer.empty());
+  ASSERT_EQ(coalescer.deadline(), WriteCoalescer::Clock::time_point::max());
+  ASSERT_EQ(client_socket_->receiveFrame(), first);
+  ASSERT_EQ(client_socket_->receiveFrame(), (Bson{4, 5, 4, 5}));
+  ASSERT_EQ(client_socket_->receiveFrame(), third);
+
+  // Storage kept from the first round must not leak into the next.
+  ASSERT_FALSE(coalescer.add({second}, now));
+  coalescer.flush(*connection_socket_);
+  ASSERT_EQ(client_socket_->receiveFrame(), second);
+}
+
+/**
+ * Test if TCP_NODELAY can be turned on and off.
+ */
+TEST_F(MessageSocketTest, NoDelay) {
+  connection_socket_->setNoDelay(true);
+  connection_socket_->sendMessage(message1_);
+  connection_socket_->setNoDelay(false);
+  connection_socket_->sendMessage(message2_);
+  ASSERT_EQ(client_socket_->receiveMessage(), message1_);
+  ASSERT_EQ(client_socket_->receiveMessage(), message2_);
+}
+
+/**
+ * Test if a size prefix larger than the maximum frame size is rejected rather than allocated.
+ */
+TEST_F(MessageSocketTest, RejectOversizedFrame) {
+  int raw_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(kServerPort_);
+  inet_pton(AF_INET, kServerAddress_.c_str(), &address.sin_addr);
+  ASSERT_EQ(::connect(raw_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+  std::shared_ptr<ConnectionBsonSocket> raw_peer;
+  while (!raw_peer) raw_peer = server_socket_->acceptConnection<ConnectionBsonSocket>();
+
+  std::size_t corrupt_size = ~std::size_t(0);
+  ASSERT_EQ(::send(raw_socket, &corrupt_size, sizeof(corrupt_size), 0), sizeof(corrupt_size));
+  ASSERT_THROW(raw_peer->receiveFrame(), SocketException);
+  ::close(raw_socket);
+}
+
+/**
+ * Test if a receive with a timeout set throws once the timeout passes without a message, and if a message still arrives
+ * after the timeout is cleared.
+ */
+TEST_F(MessageSocketTest, ReceiveTimeout) {
+  connection_socket_->setReceiveTimeout(50);
+  ASSERT_THROW(connection_socket_->receiveMessage(), SocketErrnoException);
+  connection_socket_->setReceiveTimeout(0);
+  client_socket_->sendMessage(message1_);
+  ASSERT_EQ(connection_socket_->receiveMessage(), message1_);
+}
@@ -0,0 +1,209 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "socket/multicast_socket/multicast_receiver_socket.hpp"
+#include "socket/multicast_socket/multicast_sender_socket.hpp"
+
+using namespace std::chrono_literals;
+
+/**
+ * Testing fixture for a multicast sender and a receiver on loopback.
+ */
+class MulticastSocketTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    sender_ = std::make_unique<MulticastSenderSocket>(kGroup_, 0, kInterface_, kDatagramBytes_);
+    port_ = sender_->getGroupPort().second;
+    receiver_ = std::make_unique<MulticastReceiverSocket>(kGroup_, port_, kInterface_);
+  }
+
+  /**
+   * Receive until a number of frames have arrived.
+   */
+  static std::vector<Bson> receive(MulticastReceiverSocket &receiver, std::size_t frame_count) {
+    std::vector<Bson> frames;
+    while (frames.size() < frame_count) {
+      receiver.receiveFrames([&frames](Bson &frame) -> void { frames.push_back(std::move(frame)); });
+    }
+    return frames;
+  }
+
+  /**
+   * Send one hand made datagram to the group, bypassing the sender's fragmentation.
+   */
+  void sendDatagram(MulticastFragmentHeader const &header, std::vector<std::uint8_t> const &payload) {
+    std::vector<std::uint8_t> datagram(MulticastFragmentHeader::kSize);
+    std::memcpy(datagram.data(), &header, MulticastFragmentHeader::kSize);
+    datagram.insert(datagram.end(), payload.begin(), payload.end());
+    int file_descriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    in_addr interface{};
+    inet_aton(kInterface_, &interface);
+    setsockopt(file_descriptor, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+    sockaddr_in group_address{};
+    group_address.sin_family = AF_INET;
+    group_address.sin_port = htons(port_);
+    inet_aton(kGroup_, &group_address.sin_addr);
+    sendto(file_descriptor, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr *>(&group_address),
+           sizeof(group_address));
+    close(file_descriptor);
+  }
+
+  std::unique_ptr<MulticastSenderSocket> sender_;
+  std::unique_ptr<MulticastReceiverSocket> receiver_;
+  int port_ = 0;
+
+  static constexpr char const *kGroup_ = "239.255.13.32";
+  static constexpr char const *kInterface_ = "127.0.0.1";
+  static constexpr std::size_t kDatagramBytes_ = 1472;
+};
+
+/**
+ * Test if a small frame and a frame of many fragments arrive whole, and if the fragments are sent in batches.
+ */
+TEST_F(MulticastSocketTest, FragmentRoundTrip) {
+  std::vector<std::uint8_t> header{1, 2, 3};
+  std::vector<std::uint8_t> small(100, 7);
+  std::vector<std::uint8_t> large(100000);
+  for (std::size_t i = 0; i < large.size(); ++i) large[i] = static_cast<std::uint8_t>(i * 31);
+  sender_->sendFrame({header, small});
+  sender_->sendFrame({header, large});
+
+  std::vector<Bson> frames = receive(*receiver_, 2);
+  Bson expected_small(header);
+  expected_small.insert(expected_small.end(), small.begin(), small.end());
+  Bson expected_large(header);
+  expected_large.insert(expected_large.end(), large.begin(), large.end());
+  ASSERT_EQ(frames[0], expected_small);
+  ASSERT_EQ(frames[1], expected_large);
+
+  std::size_t fragment_count = (expected_large.size() + kDatagramBytes_ - MulticastFragmentHeader::kSize - 1) /
+                               (kDatagramBytes_ - MulticastFragmentHeader::kSize);
+  MulticastSenderStatistics sender_statistics = sender_->statistics();
+  ASSERT_EQ(sender_statistics.sent_frame_count, 2);
+  ASSERT_EQ(sender_statistics.sent_datagram_count, 1 + fragment_count);
+  ASSERT_LE(sender_statistics.send_call_count, 3);
+  MulticastReceiverStatistics receiver_statistics = receiver_->statistics();
+  ASSERT_EQ(receiver_statistics.received_frame_count, 2);
+  ASSERT_EQ(receiver_statistics.received_datagram_count, 1 + fragment_count);
+  ASSERT_EQ(receiver_statistics.dropped_frame_count, 0);
+}
+
+/**
+ * Test if every receiver of the group gets each frame while the sender sends it once.
+ */
+TEST_F(MulticastSocketTest, FanOut) {
+  auto second_receiver = std::make_unique<MulticastReceiverSocket>(kGroup_, port_, kInterface_);
+  auto third_receiver = std::make_unique<MulticastReceiverSocket>(kGroup_, port_, kInterface_);
+  std::vector<std::uint8_t> message(5000, 9);
+  sender_->sendFrame({message});
+  ASSERT_EQ(receive(*receiver_, 1)[0], message);
+  ASSERT_EQ(receive(*second_receiver, 1)[0], message);
+  ASSERT_EQ(receive(*third_receiver, 1)[0], message);
+  ASSERT_EQ(sender_->statistics().sent_datagram_count, 4);
+}
+
+/**
+ * Test if fragments arriving out of order are reassembled, and if gaps and late frames are counted.
+ */
+TEST_F(MulticastSocketTest, DropAndReorderCounters) {
+  std::uint32_t stream_id = 42;
+  sendDatagram({0, stream_id, 1, 0, 0, 1}, {10});
+  sendDatagram({3, stream_id, 1, 0, 0, 1}, {13});
+  sendDatagram({1, stream_id, 1, 0, 0, 1}, {11});
+
+  // Frame 4 in two fragments, the second first.
+  sendDatagram({4, stream_id, 4, 2, 1, 2}, {16, 17});
+  sendDatagram({4, stream_id, 4, 0, 0, 2}, {14, 15});
+
+  // A fragment running past the end of its frame.
+  sendDatagram({5, stream_id, 2, 0, 0, 1}, {1, 2, 3});
+
+  std::vector<Bson> frames = receive(*receiver_, 4);
+  ASSERT_EQ(frames[0], Bson{10});
+  ASSERT_EQ(frames[1], Bson{13});
+  ASSERT_EQ(frames[2], Bson{11});
+  ASSERT_EQ(frames[3], (Bson{14, 15, 16, 17}));
+
+  // Frame 2 never arrived and frame 5 was malformed. Frame 1 was counted as dropped when frame 3 arrived, then as
+  // reordered.
+  sendDatagram({6, stream_id, 1, 0, 0, 1}, {18});
+  receive(*receiver_, 1);
+  MulticastReceiverStatistics statistics = receiver_->statistics();
+  ASSERT_EQ(statistics.received_frame_count, 5);
+  ASSERT_EQ(statistics.dropped_frame_count, 2);
+  ASSERT_EQ(statistics.reordered_frame_count, 1);
+  ASSERT_EQ(statistics.malformed_datagram_count, 1);
+}
+
+/**
+ * Test if a fragment header claiming a frame larger than any sender sends is counted as malformed rather than
+ * allocated.
+ */
+TEST_F(MulticastSocketTest, OversizeFrameMalformed) {
+  std::uint32_t stream_id = 42;
+  sendDatagram({0, stream_id, std::uint32_t(100) << 20, 0, 0, 2000}, {1, 2, 3});
+  sendDatagram({1, stream_id, 1, 0, 0, 1}, {11});
+  std::vector<Bson> frames = receive(*receiver_, 1);
+  ASSERT_EQ(frames[0], Bson{11});
+  MulticastReceiverStatistics statistics = receiver_->statistics();
+  ASSERT_EQ(statistics.received_frame_count, 1);
+  ASSERT_EQ(statistics.malformed_datagram_count, 1);
+}
+
+/**
+ * Test if frames of two senders sharing a port are reassembled when their fragments interleave, and if each sender's
+ * sequence numbers are counted on their own.
+ */
+TEST_F(MulticastSocketTest, InterleavedStreams) {
+  std::uint32_t first_stream_id = 42;
+  std::uint32_t second_stream_id = 43;
+  sendDatagram({0, first_stream_id, 4, 0, 0, 2}, {10, 11});
+  sendDatagram({7, second_stream_id, 4, 0, 0, 2}, {20, 21});
+  sendDatagram({0, first_stream_id, 4, 2, 1, 2}, {12, 13});
+  sendDatagram({7, second_stream_id, 4, 2, 1, 2}, {22, 23});
+  sendDatagram({1, first_stream_id, 1, 0, 0, 1}, {14});
+  sendDatagram({8, second_stream_id, 1, 0, 0, 1}, {24});
+
+  std::vector<Bson> frames = receive(*receiver_, 4);
+  ASSERT_EQ(frames[0], (Bson{10, 11, 12, 13}));
+  ASSERT_EQ(frames[1], (Bson{20, 21, 22, 23}));
+  ASSERT_EQ(frames[2], Bson{14});
+  ASSERT_EQ(frames[3], Bson{24});
+  MulticastReceiverStatistics statistics = receiver_->statistics();
+  ASSERT_EQ(statistics.dropped_frame_count, 0);
+  ASSERT_EQ(statistics.reordered_frame_count, 0);
+}
+
+/**
+ * Test if shutting the receiver down wakes a thread waiting for datagrams.
+ */
+TEST_F(MulticastSocketTest, ShutdownWakesReceiver) {
+  auto receiving = std::async(std::launch::async, [this]() -> bool {
+    try {
+      receive(*receiver_, 1);
+      return false;
+    } catch (SocketException const &e) {
+      return true;
+    }
+  });
+  std::this_thread::sleep_for(50ms);
+  receiver_->shutdown();
+  ASSERT_EQ(receiving.wait_for(2s), std::future_status::ready);
+  ASSERT_TRUE(receiving.get());
+}
+
+/**
+ * Test if a datagram size that cannot hold a fragment header is refused.
+ */
+TEST(MulticastSenderSocket, InvalidDatagramSize) {
+  ASSERT_THROW(MulticastSenderSocket("239.255.13.32", 0, "127.0.0.1", MulticastFragmentHeader::kSize),
+               SocketException);
+  ASSERT_THROW(MulticastSenderSocket("239.255.13.32", 0, "127.0.0.1", 70000), SocketException);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <latch>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "thread_pool/thread_pool.hpp"
+
+using namespace std::chrono_literals;
+
+/**
+ * Test if every submitted task is executed before shutdown() returns.
+ */
+TEST(ThreadPool, ExecutesAllTasks) {
+  std::atomic<int> executed_count = 0;
+  ThreadPool thread_pool(4);
+  for (int i = 0; i < 1000; ++i) {
+    thread_pool.submit([&executed_count]() -> void { ++executed_count; });
+  }
+  thread_pool.shutdown();
+  ASSERT_EQ(executed_count, 1000);
+}
+
+/**
+ * Test if a blocked task does not prevent the other worker threads from executing tasks.
+ */
+TEST(ThreadPool, BlockedTaskDoesNotBlockPool) {
+  std::latch release_latch(1);
+  std::latch finished_latch(10);
+  ThreadPool thread_pool(2);
+  thread_pool.submit([&release_latch]() -> void { release_latch.wait(); });
+  for (int i = 0; i < 10; ++i) {
+    thread_pool.submit([&finished_latch]() -> void { finished_latch.count_down(); });
+  }
+  finished_latch.wait();
+  release_latch.count_down();
+}
+
+/**
+ * Test if tasks that throw do not stop the worker threads and if tasks submitted after shutdown() are dropped.
+ */
+TEST(ThreadPool, ThrowingTaskAndSubmitAfterShutdown) {
+  std::atomic<int> executed_count = 0;
+  ThreadPool thread_pool(1);
+  thread_pool.submit([]() -> void { throw std::runtime_error("task failure"); });
+  thread_pool.submit([&executed_count]() -> void { ++executed_count; });
+  thread_pool.shutdown();
+  thread_pool.submit([&executed_count]() -> void { ++executed_count; });
+  ASSERT_EQ(executed_count, 1);
+  ASSERT_EQ(thread_pool.size(), 1);
+}
+
+/**
+ * Test if queued tasks run by priority class, and in submission order within a class.
+ */
+TEST(ThreadPool, RunsByPriority) {
+  std::latch release_latch(1);
+  std::vector<int> order;
+  ThreadPool thread_pool(1);
+  thread_pool.submit([&release_latch]() -> void { release_latch.wait(); });
+  thread_pool.submit([&order]() -> void { order.push_back(0); }, TaskPriority::kLow);
+  thread_pool.submit([&order]() -> void { order.push_back(1); });
+  thread_pool.submit([&order]() -> void { order.push_back(2); }, TaskPriority::kHigh);
+  thread_pool.submit([&order]() -> void { order.push_back(3); });
+  thread_pool.submit([&order]() -> void { order.push_back(4); }, TaskPriority::kHigh);
+  release_latch.count_down();
+  thread_pool.shutdown();
+  ASSERT_EQ(order, (std::vector<int>{2, 4, 1, 3, 0}));
+  auto statistics = thread_pool.statistics();
+  ASSERT_EQ(statistics[static_cast<std::size_t>(TaskPriority::kLow)].executed_count, 1);
+  ASSERT_EQ(statistics[static_cast<std::size_t>(TaskPriority::kNormal)].executed_count, 3);
+  ASSERT_EQ(statistics[static_cast<std::size_t>(TaskPriority::kHigh)].executed_count, 2);
+}
+
+/**
+ * Test if tasks finishing after their deadline are counted, and tasks without one never are.
+ */
+TEST(ThreadPool, CountsMissedDeadlines) {
+  ThreadPool thread_pool(1);
+  auto now = ThreadPool::Clock::now();
+  thread_pool.submit([]() -> void { std::this_thread::sleep_for(20ms); }, TaskPriority::kNormal, now + 10ms);
+  thread_pool.submit([]() -> void {}, TaskPriority::kNormal, now + 1s);
+  thread_pool.submit([]() -> void { std::this_thread::sleep_for(20ms); });
+  thread_pool.shutdown();
+  auto statistics = thread_pool.statistics()[static_cast<std::size_t>(TaskPriority::kNormal)];
+  ASSERT_EQ(statistics.executed_count, 3);
+  ASSERT_EQ(statistics.deadline_missed_count, 1);
+}
+
+/**
+ * Test if a thread reserved for high priority tasks runs them while every other thread is busy, and never runs lower
+ * priority tasks, even when asked for a realtime priority and CPU affinity it may not be granted.
+ */
+TEST(ThreadPool, ReservedHighPriorityThread) {
+  std::latch release_latch(1);
+  std::latch high_priority_latch(1);
+  std::atomic<int> normal_count = 0;
+  ThreadPoolOptions options;
+  options.high_priority_thread_count = 1;
+  options.high_priority_realtime_priority = 10;
+  options.high_priority_cpus = {0};
+  ThreadPool thread_pool(2, options);
+  thread_pool.submit([&release_latch]() -> void { release_latch.wait(); });
+  thread_pool.submit([&normal_count]() -> void { ++normal_count; });
+  thread_pool.submit([&high_priority_latch]() -> void { high_priority_latch.count_down(); }, TaskPriority::kHigh);
+  high_priority_latch.wait();
+  std::this_thread::sleep_for(20ms);
+  ASSERT_EQ(normal_count, 0);
+  release_latch.count_down();
+  thread_pool.shutdown();
+  ASSERT_EQ(normal_count, 1);
+}
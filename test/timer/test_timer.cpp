@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "timer/rate.hpp"
+#include "timer/timer.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Testing fixture for a scheduler running callbacks on a small executor.
+ */
+class TimerSchedulerTest : public testing::Test {
+ protected:
+  ThreadPool executor_{2};
+  TimerScheduler timer_scheduler_{executor_};
+};
+
+/**
+ * Test if a timer runs its callback once a period, without drifting.
+ */
+TEST_F(TimerSchedulerTest, Periodic) {
+  std::atomic<int> run_count = 0;
+  auto start = Clock::now();
+  auto timer = timer_scheduler_.createTimer(20ms, [&run_count]() -> void { ++run_count; });
+  std::this_thread::sleep_until(start + 1010ms);
+  int count = run_count;
+  ASSERT_GE(count, 45);
+  ASSERT_LE(count, 50);
+  TimerStatistics statistics = timer->statistics();
+  ASSERT_EQ(statistics.fired_count, static_cast<std::uint64_t>(count));
+  ASSERT_GE(statistics.mean_lateness_s, 0);
+  ASSERT_LE(statistics.mean_lateness_s, statistics.max_lateness_s);
+}
+
+/**
+ * Test if hundreds of timers all run on the scheduler's one thread and the executor's two.
+ */
+TEST_F(TimerSchedulerTest, ManyTimers) {
+  std::vector<std::atomic<int>> run_counts(300);
+  std::vector<std::shared_ptr<Timer>> timers;
+  for (std::size_t i = 0; i < run_counts.size(); ++i) {
+    auto period = std::chrono::milliseconds(10 + static_cast<int>(i % 7) * 10);
+    timers.push_back(timer_scheduler_.createTimer(period, [&run_counts, i]() -> void { ++run_counts[i]; }));
+  }
+  std::this_thread::sleep_for(500ms);
+  for (auto &timer : timers) timer->cancel();
+  for (std::size_t i = 0; i < run_counts.size(); ++i) {
+    int expected = 500 / (10 + static_cast<int>(i % 7) * 10);
+    ASSERT_GE(run_counts[i], expected / 2) << "timer " << i;
+    ASSERT_LE(run_counts[i], expected) << "timer " << i;
+  }
+}
+
+/**
+ * Test if a one-shot timer runs its callback once, and if cancelling one before its deadline stops it.
+ */
+TEST_F(TimerSchedulerTest, OneShot) {
+  std::atomic<int> run_count = 0;
+  std::atomic<int> cancelled_count = 0;
+  auto timer = timer_scheduler_.createOneShotTimer(20ms, [&run_count]() -> void { ++run_count; });
+  auto cancelled_timer =
+      timer_scheduler_.createOneShotTimer(50ms, [&cancelled_count]() -> void { ++cancelled_count; });
+  cancelled_timer->cancel();
+  std::this_thread::sleep_for(200ms);
+  ASSERT_EQ(run_count, 1);
+  ASSERT_EQ(cancelled_count, 0);
+  TimerStatistics statistics = timer->statistics();
+  ASSERT_EQ(statistics.fired_count, 1);
+  ASSERT_EQ(statistics.missed_count, 0);
+}
+
+/**
+ * Test if cancelling or destroying a timer stops its callback.
+ */
+TEST_F(TimerSchedulerTest, CancelAndDestroy) {
+  std::atomic<int> cancelled_count = 0;
+  std::atomic<int> destroyed_count = 0;
+  auto cancelled_timer = timer_scheduler_.createTimer(10ms, [&cancelled_count]() -> void { ++cancelled_count; });
+  auto destroyed_timer = timer_scheduler_.createTimer(10ms, [&destroyed_count]() -> void { ++destroyed_count; });
+  std::this_thread::sleep_for(100ms);
+  cancelled_timer->cancel();
+  destroyed_timer.reset();
+  std::this_thread::sleep_for(20ms);
+  int cancelled_at = cancelled_count;
+  int destroyed_at = destroyed_count;
+  ASSERT_GT(cancelled_at, 0);
+  ASSERT_GT(destroyed_at, 0);
+  std::this_thread::sleep_for(100ms);
+  ASSERT_EQ(cancelled_count, cancelled_at);
+  ASSERT_EQ(destroyed_count, destroyed_at);
+}
+
+/**
+ * Test if deadlines that come while the callback is still running are skipped and counted, not queued.
+ */
+TEST_F(TimerSchedulerTest, OverrunIsCounted) {
+  std::atomic<int> running_count = 0;
+  std::atomic<int> max_running_count = 0;
+  auto timer = timer_scheduler_.createTimer(10ms, [&running_count, &max_running_count]() -> void {
+    max_running_count = std::max<int>(max_running_count, ++running_count);
+    std::this_thread::sleep_for(35ms);
+    --running_count;
+  });
+  std::this_thread::sleep_for(500ms);
+  timer->cancel();
+  TimerStatistics statistics = timer->statistics();
+  ASSERT_EQ(max_running_count, 1);
+  ASSERT_GT(statistics.fired_count, 5);
+  ASSERT_GT(statistics.missed_count, statistics.fired_count);
+}
+
+/**
+ * Test if a loop paced by a Rate keeps to the rate however long each iteration takes.
+ */
+TEST(Rate, NoDrift) {
+  Rate rate(100);
+  auto start = Clock::now();
+  for (int i = 0; i < 50; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(i % 5));
+    rate.sleep();
+  }
+  auto elapsed = Clock::now() - start;
+  ASSERT_GE(elapsed, 500ms);
+  ASSERT_LT(elapsed, 540ms);
+}
+
+/**
+ * Test if a loop that stalls skips the deadlines it missed instead of bursting, and counts them.
+ */
+TEST(Rate, SkipsMissedDeadlines) {
+  Rate rate(100ms);
+  std::this_thread::sleep_for(350ms);
+  ASSERT_FALSE(rate.sleep());
+  ASSERT_EQ(rate.missedDeadlines(), 2);
+  auto start = Clock::now();
+  ASSERT_TRUE(rate.sleep());
+  ASSERT_GE(Clock::now() - start, 30ms);
+
+  // Restarting the schedule after a pause does not count the pause.
+  std::this_thread::sleep_for(300ms);
+  rate.reset();
+  ASSERT_TRUE(rate.sleep());
+  ASSERT_EQ(rate.missedDeadlines(), 2);
+}
+
+/**
+ * Test if rates and periods that are not positive are rejected.
+ */
+TEST(Rate, RejectsNonPositiveRate) {
+  ASSERT_THROW(Rate(0.0), std::invalid_argument);
+  ASSERT_THROW(Rate(-10.0), std::invalid_argument);
+  ASSERT_THROW(Rate(std::nan("")), std::invalid_argument);
+  ASSERT_THROW(Rate(Clock::duration::zero()), std::invalid_argument);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "timer/timer_wheel.hpp"
+
+using namespace std::chrono_literals;
+using Clock = TimerWheel::Clock;
+
+/**
+ * Testing fixture for a wheel with a millisecond resolution starting at a fixed time.
+ */
+class TimerWheelTest : public testing::Test {
+ protected:
+  /**
+   * Advance the wheel to a number of milliseconds after its start and return the identifiers that expired.
+   */
+  std::vector<std::uint64_t> advanceTo(Clock::duration time) {
+    std::vector<std::uint64_t> expired_ids;
+    timer_wheel_.advance(start_ + time, expired_ids);
+    return expired_ids;
+  }
+
+  Clock::time_point start_ = Clock::now();
+  TimerWheel timer_wheel_{1ms, start_};
+};
+
+/**
+ * Test if deadlines expire on their tick and not before, rounding up to whole ticks.
+ */
+TEST_F(TimerWheelTest, ExpiresOnDeadline) {
+  timer_wheel_.schedule(1, start_ + 10ms);
+  timer_wheel_.schedule(2, start_ + 10ms + 500us);
+  timer_wheel_.schedule(3, start_ + 20ms);
+  ASSERT_EQ(timer_wheel_.size(), 3);
+  ASSERT_TRUE(advanceTo(9ms).empty());
+  ASSERT_EQ(advanceTo(10ms), std::vector<std::uint64_t>{1});
+  ASSERT_EQ(advanceTo(11ms), std::vector<std::uint64_t>{2});
+  ASSERT_EQ(advanceTo(30ms), std::vector<std::uint64_t>{3});
+  ASSERT_EQ(timer_wheel_.size(), 0);
+}
+
+/**
+ * Test if deadlines far enough out to start on the upper levels cascade down and expire on their tick.
+ */
+TEST_F(TimerWheelTest, CascadesFromUpperLevels) {
+  std::vector<Clock::duration> deadlines = {255ms, 256ms, 300ms, 16383ms, 16384ms, 20000ms, 2000000ms};
+  for (std::uint64_t id = 0; id < deadlines.size(); ++id) timer_wheel_.schedule(id, start_ + deadlines[id]);
+  for (std::uint64_t id = 0; id < deadlines.size(); ++id) {
+    ASSERT_TRUE(advanceTo(deadlines[id] - 1ms).empty()) << "deadline " << id;
+    ASSERT_EQ(advanceTo(deadlines[id]), std::vector<std::uint64_t>{id});
+  }
+}
+
+/**
+ * Test if deadlines beyond the span of the top level wait on it and still expire on their tick.
+ */
+TEST_F(TimerWheelTest, BeyondTopLevel) {
+  auto deadline = 100h;
+  timer_wheel_.schedule(7, start_ + deadline);
+  ASSERT_TRUE(advanceTo(deadline - 1ms).empty());
+  ASSERT_EQ(advanceTo(deadline), std::vector<std::uint64_t>{7});
+}
+
+/**
+ * Test if random deadlines all expire exactly once, on their tick, when the wheel is advanced in uneven steps.
+ */
+TEST_F(TimerWheelTest, RandomDeadlines) {
+  std::mt19937 generator(3);
+  std::uniform_int_distribution<int> deadline_ms(0, 100000);
+  std::vector<int> deadlines(2000);
+  for (std::uint64_t id = 0; id < deadlines.size(); ++id) {
+    deadlines[id] = deadline_ms(generator);
+    timer_wheel_.schedule(id, start_ + std::chrono::milliseconds(deadlines[id]));
+  }
+  std::vector<int> expired_at(deadlines.size(), -1);
+  std::uniform_int_distribution<int> step_ms(1, 700);
+  for (int time_ms = 0; time_ms <= 100000 + 700; time_ms += step_ms(generator)) {
+    for (std::uint64_t id : advanceTo(std::chrono::milliseconds(time_ms))) {
+      ASSERT_EQ(expired_at[id], -1);
+      ASSERT_LE(deadlines[id], time_ms);
+      expired_at[id] = time_ms;
+    }
+  }
+  ASSERT_EQ(std::count(expired_at.begin(), expired_at.end(), -1), 0);
+  ASSERT_EQ(timer_wheel_.size(), 0);
+}
+
+/**
+ * Test if a deadline that has already passed expires on the next advance without the wheel moving.
+ */
+TEST_F(TimerWheelTest, OverdueDeadline) {
+  advanceTo(50ms);
+  timer_wheel_.schedule(4, start_ + 10ms);
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), start_ + 50ms);
+  ASSERT_EQ(advanceTo(50ms), std::vector<std::uint64_t>{4});
+}
+
+/**
+ * Test if the wake up time is the next deadline on the lowest level, or when it wraps if it is empty.
+ */
+TEST_F(TimerWheelTest, NextWakeUp) {
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), Clock::time_point::max());
+  timer_wheel_.schedule(1, start_ + 40ms);
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), start_ + 40ms);
+  advanceTo(40ms);
+  timer_wheel_.schedule(2, start_ + 1000ms);
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), start_ + 256ms);
+  advanceTo(768ms);
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), start_ + 1000ms);
+}
+
+/**
+ * Test if the wake up time comes before a later deadline on the lowest level when an earlier one is yet to cascade.
+ */
+TEST_F(TimerWheelTest, NextWakeUpBeforeCascade) {
+  advanceTo(10ms);
+  timer_wheel_.schedule(1, start_ + 300ms);
+  advanceTo(250ms);
+  timer_wheel_.schedule(2, start_ + 400ms);
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), start_ + 256ms);
+  advanceTo(256ms);
+  ASSERT_EQ(timer_wheel_.nextWakeUp(), start_ + 300ms);
+}
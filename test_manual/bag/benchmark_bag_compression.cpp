@@ -0,0 +1,173 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bag/bag_compression.hpp"
+#include "bag/bag_reader.hpp"
+#include "bag/bag_writer.hpp"
+
+using Clock = std::chrono::steady_clock;
+using json = nlohmann::json;
+
+/**
+ * A kind of message to benchmark, making the frame of its i-th message.
+ */
+struct MessageKind {
+  std::string name;
+  std::function<std::vector<std::uint8_t>(int)> make_frame;
+};
+
+/**
+ * Small BSON pose, as a state estimator publishes at a high rate.
+ */
+static std::vector<std::uint8_t> makePose(int i) {
+  double t = i * 0.01;
+  json pose = {{"header", {{"stamp", 1700000000000000000 + i * 10000000LL}, {"frame_id", "base_link"}}},
+               {"position", {{"x", std::cos(t)}, {"y", std::sin(t)}, {"z", 0.0}}},
+               {"orientation", {{"x", 0.0}, {"y", 0.0}, {"z", std::sin(t / 2)}, {"w", std::cos(t / 2)}}}};
+  return json::to_bson(pose);
+}
+
+/**
+ * Planar lidar scan of 16384 float ranges over a smooth room with a little noise.
+ */
+static std::vector<std::uint8_t> makeScan(int i) {
+  static std::mt19937 generator(1);
+  std::normal_distribution<float> noise(0, 0.002F);
+  std::vector<float> ranges(16384);
+  for (std::size_t beam = 0; beam < ranges.size(); ++beam) {
+    double angle = 2 * M_PI * static_cast<double>(beam) / static_cast<double>(ranges.size());
+    ranges[beam] = static_cast<float>(3 + std::cos(4 * angle + i * 0.01)) + noise(generator);
+  }
+  std::vector<std::uint8_t> frame(ranges.size() * sizeof(float));
+  std::memcpy(frame.data(), ranges.data(), frame.size());
+  return frame;
+}
+
+/**
+ * 640x480 8 bit camera image of a moving gradient with sensor noise in the lowest bit.
+ */
+static std::vector<std::uint8_t> makeImage(int i) {
+  static std::mt19937 generator(2);
+  std::vector<std::uint8_t> frame(640 * 480);
+  for (std::size_t row = 0; row < 480; ++row) {
+    for (std::size_t column = 0; column < 640; ++column) {
+      frame[row * 640 + column] = static_cast<std::uint8_t>(((row + column + i) / 4) ^ (generator() & 1));
+    }
+  }
+  return frame;
+}
+
+/**
+ * Already compressed payload, such as a JPEG image, which does not compress further.
+ */
+static std::vector<std::uint8_t> makeCompressed(int i) {
+  std::mt19937 generator(i);
+  std::vector<std::uint8_t> frame(256 << 10);
+  for (auto &byte : frame) byte = static_cast<std::uint8_t>(generator());
+  return frame;
+}
+
+/**
+ * Benchmark the bag codec on representative messages.
+ *
+ * Usage: benchmark_bag_compression [megabytes]
+ *
+ * For each kind of message, records about the given number of megabytes of frames (default 256) into a bag with and
+ * without compression, and reports the codec's speed and ratio, the recording time, and replay throughput with no,
+ * one, and several decompression threads. Replay touches every byte of every frame, as publishing it would.
+ */
+int main(int argc, char **argv) {
+  std::size_t total_bytes = (argc > 1 ? std::stoul(argv[1]) : 256) << 20;
+  std::vector<MessageKind> kinds = {{"pose", makePose},
+                                    {"lidar scan", makeScan},
+                                    {"camera image", makeImage},
+                                    {"compressed image", makeCompressed}};
+  auto seconds_since = [](Clock::time_point start) -> double {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+  auto megabytes_per_second = [](std::uint64_t bytes, double seconds) -> double {
+    return static_cast<double>(bytes) / seconds / 1e6;
+  };
+  std::cout << std::fixed << std::setprecision(1);
+
+  for (auto const &kind : kinds) {
+    // Make a pool of distinct frames once, so that generating them is not timed.
+    std::vector<std::vector<std::uint8_t>> frames;
+    std::size_t pool_bytes = 0;
+    for (int i = 0; i < 1000 && pool_bytes < (32 << 20); ++i) {
+      frames.push_back(kind.make_frame(i));
+      pool_bytes += frames.back().size();
+    }
+    std::size_t message_count = total_bytes / frames.front().size();
+    std::cout << kind.name << ": " << message_count << " messages of " << frames.front().size() << " bytes"
+              << std::endl;
+
+    // Raw codec speed on one chunk's worth of frames.
+    std::vector<std::uint8_t> chunk;
+    for (std::size_t i = 0; chunk.size() < (4 << 20); ++i) {
+      auto const &frame = frames[i % frames.size()];
+      chunk.insert(chunk.end(), frame.begin(), frame.end());
+    }
+    std::vector<std::uint8_t> compressed(lzCompressBound(chunk.size()));
+    auto compress_start = Clock::now();
+    compressed.resize(lzCompress(chunk, compressed));
+    double compress_seconds = seconds_since(compress_start);
+    std::vector<std::uint8_t> decompressed(chunk.size());
+    auto decompress_start = Clock::now();
+    lzDecompress(compressed, decompressed);
+    double decompress_seconds = seconds_since(decompress_start);
+    std::cout << "  codec:    ratio " << std::setprecision(2)
+              << static_cast<double>(chunk.size()) / static_cast<double>(compressed.size()) << std::setprecision(1)
+              << ", compress " << megabytes_per_second(chunk.size(), compress_seconds) << " MB/s, decompress "
+              << megabytes_per_second(chunk.size(), decompress_seconds) << " MB/s" << std::endl;
+
+    for (auto compression : {BagCompression::kNone, BagCompression::kLZ}) {
+      std::string path = (std::filesystem::temp_directory_path() /
+                          ("benchmark_bag_compression_" + std::to_string(getpid()) + ".bag"))
+                             .string();
+      auto record_start = Clock::now();
+      {
+        BagWriter writer(path, {.sync_policy = BagSyncPolicy::kNone, .compression = compression});
+        for (std::size_t i = 0; i < message_count; ++i) {
+          writer.write(kind.name, static_cast<std::int64_t>(i), {frames[i % frames.size()]});
+        }
+        writer.close();
+      }
+      double record_seconds = seconds_since(record_start);
+      std::uint64_t file_size = std::filesystem::file_size(path);
+      std::cout << "  " << (compression == BagCompression::kNone ? "none:" : "lz:  ") << "     file "
+                << file_size / 1e6 << " MB, record " << megabytes_per_second(total_bytes, record_seconds)
+                << " MB/s, replay";
+
+      BagReader reader(path);
+      for (std::size_t thread_count : {0, 1, 4}) {
+        auto replay_start = Clock::now();
+        BagMessageStream stream({&reader}, std::numeric_limits<std::int64_t>::min(), {}, thread_count);
+        BagMessage message{};
+        std::uint64_t frame_bytes = 0;
+        std::uint64_t checksum = 0;
+        while (stream.next(message)) {
+          for (std::uint8_t byte : message.frame) checksum += byte;
+          frame_bytes += message.frame.size();
+        }
+        std::cout << " " << megabytes_per_second(frame_bytes, seconds_since(replay_start)) << " MB/s ("
+                  << thread_count << " threads)";
+        if (checksum == 0) std::cout << " empty";
+      }
+      std::cout << std::endl;
+      std::filesystem::remove(path);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mediator/mediator.hpp"
+#include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+#include "socket/bson_socket/client_bson_socket.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Benchmark the time for a burst of nodes connecting at once to all be registered by the Mediator.
+ *
+ * Usage: benchmark_mediator_connections [node_count] [stuck_client_count] [port]
+ *
+ * Stuck clients connect before the burst and never send their connection message. They should cost the burst nothing
+ * since their handshakes time out on the handshake threads instead of blocking the accepting loop.
+ */
+int main(int argc, char** argv) {
+  int node_count = argc > 1 ? std::stoi(argv[1]) : 2000;
+  int stuck_client_count = argc > 2 ? std::stoi(argv[2]) : 8;
+  int port = argc > 3 ? std::stoi(argv[3]) : 13340;
+
+  // Every node holds a client socket here and a connection socket in the Mediator.
+  rlimit file_limit{};
+  getrlimit(RLIMIT_NOFILE, &file_limit);
+  file_limit.rlim_cur = file_limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &file_limit);
+
+  MROS::init(argc, argv);
+  std::thread mediator_thread([port]() -> void { Mediator mediator("127.0.0.1", port); });
+  std::this_thread::sleep_for(500ms);
+
+  // Occupy the handshake threads with clients that never complete their handshake.
+  std::vector<std::shared_ptr<ClientBsonMessageSocket>> stuck_clients;
+  for (int i = 0; i < stuck_client_count; ++i) {
+    auto stuck_client = std::make_shared<ClientBsonMessageSocket>(AF_INET, "127.0.0.1", port);
+    stuck_client->connect();
+    stuck_clients.push_back(stuck_client);
+  }
+  std::this_thread::sleep_for(100ms);
+
+  // Release every node at once and record when each one has been registered.
+  std::vector<std::shared_ptr<ClientBsonRPCSocket>> clients;
+  std::vector<Clock::duration> latencies(node_count);
+  std::vector<char> succeeded(node_count, false);
+  std::vector<std::thread> node_threads;
+  for (int i = 0; i < node_count; ++i) {
+    clients.push_back(std::make_shared<ClientBsonRPCSocket>(AF_INET, "127.0.0.1", port));
+  }
+  std::latch start_latch(node_count + 1);
+  for (int i = 0; i < node_count; ++i) {
+    node_threads.emplace_back([&, i]() -> void {
+      start_latch.arrive_and_wait();
+      auto start = Clock::now();
+      try {
+        clients[i]->connectToServer({{"node_name", "benchmark_node_" + std::to_string(i)}});
+        succeeded[i] = true;
+      } catch (std::exception const& e) {
+      }
+      latencies[i] = Clock::now() - start;
+    });
+  }
+  auto start = Clock::now();
+  start_latch.arrive_and_wait();
+  for (auto& node_thread : node_threads) node_thread.join();
+  auto graph_registered = Clock::now() - start;
+
+  std::sort(latencies.begin(), latencies.end());
+  auto milliseconds = [](Clock::duration duration) -> double {
+    return std::chrono::duration<double, std::milli>(duration).count();
+  };
+  long registered_count = std::count(succeeded.begin(), succeeded.end(), true);
+  std::cout << "nodes registered:       " << registered_count << " / " << node_count << std::endl;
+  std::cout << "stuck clients:          " << stuck_client_count << std::endl;
+  std::cout << "graph registered in:    " << milliseconds(graph_registered) << " ms" << std::endl;
+  std::cout << "per node latency p50:   " << milliseconds(latencies[node_count / 2]) << " ms" << std::endl;
+  std::cout << "per node latency p99:   " << milliseconds(latencies[node_count * 99 / 100]) << " ms" << std::endl;
+  std::cout << "per node latency max:   " << milliseconds(latencies.back()) << " ms" << std::endl;
+
+  // Stop the Mediator the same way ctrl+C does.
+  std::raise(SIGINT);
+  mediator_thread.join();
+  return 0;
+}
@@ -0,0 +1,403 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mediator/mediator.hpp"
+#include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+#include "thread_pool/thread_pool.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Scale test harness for the Mediator.
+ *
+ * The process forks. The parent runs a Mediator and samples its own CPU time, resident memory, and thread count, so the
+ * numbers describe the Mediator alone. The child simulates lightweight nodes that speak the Mediator's RPC protocol
+ * over ClientBsonRPCSocket without creating real publishers or subscribers.
+ *
+ * Usage: harness_mediator_scale [--nodes N] [--topics T] [--fan-in P] [--fan-out S] [--churn-rounds R]
+ *                               [--churn-fraction F] [--workers W] [--port PORT]
+ *
+ * Each topic gets P publishing nodes (fan-in) and S subscribing nodes (fan-out). Every churn round a fraction F of the
+ * nodes leaves and rejoins with the same topics, and a fraction F of the publishers is removed and added again.
+ */
+
+/**
+ * Harness configuration parsed from the command line.
+ */
+struct HarnessOptions {
+  int node_count = 500;
+  int topic_count = 50;
+  int fan_in = 2;
+  int fan_out = 10;
+  int churn_rounds = 5;
+  double churn_fraction = 0.1;
+  int worker_count = 64;
+  int port = 13350;
+};
+
+/**
+ * Parse the harness options, leaving defaults for options that are not supplied.
+ */
+HarnessOptions parseOptions(int argc, char** argv) {
+  HarnessOptions options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string option = argv[i];
+    std::string value = argv[i + 1];
+    if (option == "--nodes") options.node_count = std::stoi(value);
+    else if (option == "--topics") options.topic_count = std::stoi(value);
+    else if (option == "--fan-in") options.fan_in = std::stoi(value);
+    else if (option == "--fan-out") options.fan_out = std::stoi(value);
+    else if (option == "--churn-rounds") options.churn_rounds = std::stoi(value);
+    else if (option == "--churn-fraction") options.churn_fraction = std::stod(value);
+    else if (option == "--workers") options.worker_count = std::stoi(value);
+    else if (option == "--port") options.port = std::stoi(value);
+  }
+  return options;
+}
+
+/**
+ * Latency samples of one kind, safe to record from any thread.
+ */
+class LatencyRecorder {
+ public:
+  void record(Clock::duration latency) {
+    std::lock_guard<std::mutex> samples_lock_guard(samples_mutex_);
+    samples_.push_back(latency);
+  }
+
+  void print(std::string const& name) {
+    std::lock_guard<std::mutex> samples_lock_guard(samples_mutex_);
+    std::sort(samples_.begin(), samples_.end());
+    auto percentile = [this](double fraction) -> double {
+      if (samples_.empty()) return 0.0;
+      auto index = static_cast<std::size_t>(fraction * static_cast<double>(samples_.size() - 1));
+      return std::chrono::duration<double, std::milli>(samples_[index]).count();
+    };
+    std::cout << name << ": n=" << samples_.size() << " p50=" << percentile(0.5) << "ms p90=" << percentile(0.9)
+              << "ms p99=" << percentile(0.99) << "ms max=" << percentile(1.0) << "ms" << std::endl;
+  }
+
+ private:
+  std::vector<Clock::duration> samples_;
+  std::mutex samples_mutex_;
+};
+
+/**
+ * Latencies and counters shared by all simulated nodes.
+ */
+struct SimulationResults {
+  /**
+   * Time for connectToServer() to return, which is after the Mediator has run addNode().
+   */
+  LatencyRecorder join_latency;
+
+  /**
+   * Time from sending addSubscriber to receiving the list of publishers.
+   */
+  LatencyRecorder subscribe_latency;
+
+  /**
+   * Time from sending addPublisher to each subscribing node being told to connect to it.
+   */
+  LatencyRecorder publisher_propagation_latency;
+
+  /**
+   * Send times of every addPublisher request, keyed by the unique fake port of the publisher.
+   */
+  std::map<int, Clock::time_point> publisher_send_times;
+  std::mutex publisher_send_times_mutex;
+
+  /**
+   * Number of RPC messages received from the Mediator, used to detect when the graph has settled.
+   */
+  std::atomic<long> received_count = 0;
+};
+
+/**
+ * A node that only exercises the Mediator's RPC interface.
+ */
+class SimulatedNode {
+ public:
+  SimulatedNode(int index, HarnessOptions const& options, SimulationResults& results)
+      : index_(index), options_(options), results_(results) {
+    // Assign topics round robin so that each topic gets fan_in publishers and fan_out subscribers.
+    for (int topic = 0; topic < options.topic_count; ++topic) {
+      for (int k = 0; k < options.fan_in; ++k) {
+        if ((topic * options.fan_in + k) % options.node_count == index) published_topics_.push_back(topic);
+      }
+      for (int k = 0; k < options.fan_out; ++k) {
+        if ((topic * options.fan_out + k + options.node_count / 2) % options.node_count == index) {
+          subscribed_topics_.push_back(topic);
+        }
+      }
+    }
+  }
+
+  /**
+   * Connect to the Mediator with a fresh socket and register this node's publishers and subscribers.
+   */
+  void join() {
+    socket_ = std::make_shared<ClientBsonRPCSocket>(AF_INET, "127.0.0.1", options_.port);
+    socket_->registerRequestCallback("connectSubscriberToPublishers",
+                                     [this](json const& input) -> void { onNewPublishers(input); });
+    socket_->registerRequestCallback("addSubscriberResponse",
+                                     [this](json const& input) -> void { onSubscribeResponse(input); });
+    auto start = Clock::now();
+    socket_->connectToServer({{"node_name", "simulated_node_" + std::to_string(index_)}});
+    results_.join_latency.record(Clock::now() - start);
+    for (int topic : published_topics_) addPublisher(topic);
+    for (int topic : subscribed_topics_) addSubscriber(topic);
+  }
+
+  /**
+   * Close the connection to the Mediator, which removes this node from the graph.
+   */
+  void leave() {
+    socket_->close();
+    retired_sockets_.push_back(std::move(socket_));
+  }
+
+  /**
+   * Remove and add back every publisher of this node.
+   */
+  void republish() {
+    for (int topic : published_topics_) {
+      socket_->sendRequest("removePublisher", {{"topic_name", topicName(topic)}});
+      addPublisher(topic);
+    }
+  }
+
+  bool hasPublishers() const { return !published_topics_.empty(); }
+
+ private:
+  static std::string topicName(int topic) { return "topic_" + std::to_string(topic); }
+
+  void addPublisher(int topic) {
+    // Publishers are never connected to, so the port only needs to identify this publisher to the subscribers.
+    int fake_port = (index_ * options_.topic_count + topic) * 64 + (publish_generation_++ % 64);
+    {
+      std::lock_guard<std::mutex> send_times_lock_guard(results_.publisher_send_times_mutex);
+      results_.publisher_send_times[fake_port] = Clock::now();
+    }
+    socket_->sendRequest("addPublisher", {{"topic_name", topicName(topic)}, {"address", "127.0.0.1"},
+                                          {"port", fake_port}});
+  }
+
+  void addSubscriber(int topic) {
+    std::string topic_name = topicName(topic);
+    {
+      std::lock_guard<std::mutex> pending_lock_guard(pending_subscriptions_mutex_);
+      pending_subscriptions_[topic_name] = Clock::now();
+    }
+    socket_->sendRequestAndGetResponse("addSubscriber", {{"topic_name", topic_name}}, "addSubscriberResponse");
+  }
+
+  void onSubscribeResponse(json const& input) {
+    ++results_.received_count;
+    std::lock_guard<std::mutex> pending_lock_guard(pending_subscriptions_mutex_);
+    auto pending_iter = pending_subscriptions_.find(input["topic_name"].get<std::string>());
+    if (pending_iter != pending_subscriptions_.end()) {
+      results_.subscribe_latency.record(Clock::now() - pending_iter->second);
+      pending_subscriptions_.erase(pending_iter);
+    }
+  }
+
+  void onNewPublishers(json const& input) {
+    ++results_.received_count;
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> send_times_lock_guard(results_.publisher_send_times_mutex);
+    for (int port : input["publisher_ports"].get<std::vector<int>>()) {
+      auto send_time_iter = results_.publisher_send_times.find(port);
+      if (send_time_iter != results_.publisher_send_times.end()) {
+        results_.publisher_propagation_latency.record(now - send_time_iter->second);
+      }
+    }
+  }
+
+  int index_;
+  HarnessOptions const& options_;
+  SimulationResults& results_;
+  std::vector<int> published_topics_;
+  std::vector<int> subscribed_topics_;
+  int publish_generation_ = 0;
+
+  std::shared_ptr<ClientBsonRPCSocket> socket_;
+
+  /**
+   * Closed sockets are kept until the end of the simulation since their receiving threads are detached.
+   */
+  std::vector<std::shared_ptr<ClientBsonRPCSocket>> retired_sockets_;
+
+  std::map<std::string, Clock::time_point> pending_subscriptions_;
+  std::mutex pending_subscriptions_mutex_;
+};
+
+/**
+ * Run a task for every index on the worker pool and wait for all of them to finish.
+ */
+template <typename FunctionT>
+void runOnWorkers(ThreadPool& workers, std::vector<int> const& indices, FunctionT&& function) {
+  std::latch finished_latch(static_cast<std::ptrdiff_t>(indices.size()));
+  for (int index : indices) {
+    workers.submit([&finished_latch, &function, index]() -> void {
+      try {
+        function(index);
+      } catch (std::exception const& e) {
+        std::cerr << "simulated node " << index << ": " << e.what() << std::endl;
+      }
+      finished_latch.count_down();
+    });
+  }
+  finished_latch.wait();
+}
+
+/**
+ * Wait until no message has arrived from the Mediator for a while.
+ */
+void waitForQuiescence(SimulationResults& results) {
+  long last_count = -1;
+  while (results.received_count != last_count) {
+    last_count = results.received_count;
+    std::this_thread::sleep_for(500ms);
+  }
+}
+
+/**
+ * Simulate the nodes in the child process and print the latency results.
+ */
+int runSimulation(HarnessOptions const& options) {
+  // Give the Mediator in the parent process time to start listening.
+  std::this_thread::sleep_for(500ms);
+
+  SimulationResults results;
+  std::vector<std::unique_ptr<SimulatedNode>> nodes;
+  std::vector<int> all_indices;
+  for (int i = 0; i < options.node_count; ++i) {
+    nodes.push_back(std::make_unique<SimulatedNode>(i, options, results));
+    all_indices.push_back(i);
+  }
+  ThreadPool workers(options.worker_count);
+
+  auto start = Clock::now();
+  runOnWorkers(workers, all_indices, [&nodes](int index) -> void { nodes[index]->join(); });
+  waitForQuiescence(results);
+  std::cout << "initial graph: " << options.node_count << " nodes registered in "
+            << std::chrono::duration<double>(Clock::now() - start).count() << "s" << std::endl;
+
+  std::mt19937 random_engine(27);
+  auto churn_count = static_cast<std::size_t>(options.churn_fraction * options.node_count);
+  for (int round = 0; round < options.churn_rounds; ++round) {
+    // Pick the nodes that leave and rejoin, and separately the nodes that recreate their publishers.
+    std::vector<int> shuffled_indices = all_indices;
+    std::shuffle(shuffled_indices.begin(), shuffled_indices.end(), random_engine);
+    std::vector<int> churning_indices(shuffled_indices.begin(), shuffled_indices.begin() + churn_count);
+    std::vector<int> republishing_indices;
+    for (auto it = shuffled_indices.begin() + churn_count; it != shuffled_indices.end(); ++it) {
+      if (republishing_indices.size() == churn_count) break;
+      if (nodes[*it]->hasPublishers()) republishing_indices.push_back(*it);
+    }
+
+    runOnWorkers(workers, churning_indices, [&nodes](int index) -> void { nodes[index]->leave(); });
+    runOnWorkers(workers, churning_indices, [&nodes](int index) -> void { nodes[index]->join(); });
+    runOnWorkers(workers, republishing_indices, [&nodes](int index) -> void { nodes[index]->republish(); });
+    waitForQuiescence(results);
+    std::cout << "churn round " << round + 1 << ": " << churning_indices.size() << " nodes rejoined, "
+              << republishing_indices.size() << " nodes republished" << std::endl;
+  }
+
+  results.join_latency.print("join latency");
+  results.subscribe_latency.print("subscribe latency");
+  results.publisher_propagation_latency.print("publisher propagation latency");
+  workers.shutdown();
+  return 0;
+}
+
+/**
+ * Resource usage of this process, read from the kernel.
+ */
+struct ResourceSample {
+  double cpu_seconds = 0;
+  long resident_kilobytes = 0;
+  long thread_count = 0;
+};
+
+ResourceSample sampleResources() {
+  ResourceSample sample;
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  sample.cpu_seconds = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+                       static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    if (key == "VmRSS:") status >> sample.resident_kilobytes;
+    if (key == "Threads:") status >> sample.thread_count;
+  }
+  return sample;
+}
+
+int main(int argc, char** argv) {
+  HarnessOptions options = parseOptions(argc, argv);
+
+  // Every simulated node holds a socket in each process.
+  rlimit file_limit{};
+  getrlimit(RLIMIT_NOFILE, &file_limit);
+  file_limit.rlim_cur = file_limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &file_limit);
+
+  // Fork before any thread exists so that the child starts from a clean single threaded state.
+  pid_t simulation_pid = fork();
+  if (simulation_pid == -1) {
+    std::cerr << "Failed to fork simulation process" << std::endl;
+    return 1;
+  }
+  if (simulation_pid == 0) {
+    // Exit without running destructors since the simulated nodes' receiving threads are detached and still running.
+    int simulation_result = runSimulation(options);
+    std::cout.flush();
+    _exit(simulation_result);
+  }
+
+  MROS::init(argc, argv);
+  std::thread mediator_thread([&options]() -> void { Mediator mediator("127.0.0.1", options.port); });
+
+  // Sample the Mediator process until the simulation exits.
+  auto start = Clock::now();
+  ResourceSample peak;
+  int simulation_status = 0;
+  while (waitpid(simulation_pid, &simulation_status, WNOHANG) == 0) {
+    ResourceSample sample = sampleResources();
+    peak.resident_kilobytes = std::max(peak.resident_kilobytes, sample.resident_kilobytes);
+    peak.thread_count = std::max(peak.thread_count, sample.thread_count);
+    std::this_thread::sleep_for(100ms);
+  }
+  double wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  ResourceSample final_sample = sampleResources();
+
+  std::cout << "mediator cpu: " << final_sample.cpu_seconds << "s over " << wall_seconds << "s wall ("
+            << 100.0 * final_sample.cpu_seconds / wall_seconds << "% of one core)" << std::endl;
+  std::cout << "mediator peak resident memory: " << peak.resident_kilobytes / 1024.0 << " MiB" << std::endl;
+  std::cout << "mediator peak thread count: " << peak.thread_count << std::endl;
+
+  // Stop the Mediator the same way ctrl+C does.
+  std::raise(SIGINT);
+  mediator_thread.join();
+  return WIFEXITED(simulation_status) ? WEXITSTATUS(simulation_status) : 1;
+}
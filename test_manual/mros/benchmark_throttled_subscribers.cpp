@@ -0,0 +1,171 @@
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mediator/mediator.hpp"
+#include "messages/example_message.hpp"
+#include "mros/node.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Messages and bytes delivered to the callbacks of a group of subscribers.
+ */
+struct DeliveryCounters {
+  std::atomic<std::uint64_t> message_count = 0;
+  std::atomic<std::uint64_t> byte_count = 0;
+};
+
+/**
+ * Get the CPU time a process or thread has used, in seconds.
+ * @param who RUSAGE_SELF for the process or RUSAGE_THREAD for the calling thread.
+ */
+static double cpuSeconds(int who) {
+  rusage usage{};
+  getrusage(who, &usage);
+  auto seconds = [](timeval const &time) -> double { return static_cast<double>(time.tv_sec) + time.tv_usec * 1e-6; };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+/**
+ * Get the bytes received on the loopback interface so far, from every process on the host, or zero if unavailable.
+ */
+static std::uint64_t loopbackBytes() {
+  std::ifstream net_dev("/proc/net/dev");
+  std::string line;
+  while (std::getline(net_dev, line)) {
+    std::istringstream fields(line);
+    std::string interface;
+    std::uint64_t received_bytes;
+    if (fields >> interface >> received_bytes && interface == "lo:") return received_bytes;
+  }
+  return 0;
+}
+
+/**
+ * Run one phase of the benchmark: a publisher at a fixed rate, subscribers that take every message, and subscribers
+ * that only want a lower rate. Throttled subscribers either ask the publisher to decimate for them, or receive every
+ * message and discard the ones over their rate in the callback, as they had to before publishers could decimate.
+ */
+static void runPhase(bool publisher_decimates, int full_rate_count, int throttled_count, double rate_hz,
+                     double max_rate_hz, std::size_t size_bytes, double duration_s, int port) {
+  std::string topic_name = publisher_decimates ? "throttled_topic" : "unthrottled_topic";
+  DeliveryCounters full_rate_counters;
+  DeliveryCounters throttled_counters;
+  std::vector<std::shared_ptr<Node>> nodes;
+  std::vector<std::shared_ptr<Subscriber<StringMessage>>> subscribers;
+  std::vector<std::unique_ptr<RateLimiter>> callback_rate_limiters;
+  for (int i = 0; i < full_rate_count + throttled_count; ++i) {
+    bool throttled = i >= full_rate_count;
+    auto node = std::make_shared<Node>("subscriber_" + std::to_string(i), "127.0.0.1", port);
+    SubscriberOptions options;
+    if (throttled && publisher_decimates) options.max_rate_hz = max_rate_hz;
+    DeliveryCounters &counters = throttled ? throttled_counters : full_rate_counters;
+    RateLimiter *callback_rate_limiter = nullptr;
+    if (throttled && !publisher_decimates) {
+      callback_rate_limiters.push_back(std::make_unique<RateLimiter>(max_rate_hz));
+      callback_rate_limiter = callback_rate_limiters.back().get();
+    }
+    auto subscriber = node->createSubscriber<StringMessage>(
+        topic_name, 1000,
+        [&counters, callback_rate_limiter](StringMessage const &message) -> void {
+          if (callback_rate_limiter) {
+            auto now = RateLimiter::Clock::now();
+            if (!callback_rate_limiter->due(now)) return;
+            callback_rate_limiter->take(now);
+          }
+          ++counters.message_count;
+          counters.byte_count += message.data.size();
+        },
+        options);
+    subscriber->spin();
+    nodes.push_back(node);
+    subscribers.push_back(subscriber);
+  }
+
+  auto publishing_node = std::make_shared<Node>("publisher", "127.0.0.1", port);
+  auto publisher = publishing_node->createPublisher<StringMessage>(topic_name);
+  std::this_thread::sleep_for(500ms);
+
+  // Publish at the rate, counting the CPU time of this thread, which encodes and sends every message.
+  StringMessage message;
+  message.data.assign(size_bytes, 'x');
+  auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / rate_hz));
+  auto message_count = static_cast<std::uint64_t>(duration_s * rate_hz);
+  std::uint64_t loopback_bytes_start = loopbackBytes();
+  double process_cpu_start = cpuSeconds(RUSAGE_SELF);
+  double publisher_cpu_start = cpuSeconds(RUSAGE_THREAD);
+  auto start = Clock::now();
+  for (std::uint64_t i = 0; i < message_count; ++i) {
+    std::this_thread::sleep_until(start + i * interval);
+    publisher->publish(message);
+  }
+  std::this_thread::sleep_for(200ms);
+  double elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+  double publisher_cpu_s = cpuSeconds(RUSAGE_THREAD) - publisher_cpu_start;
+  double process_cpu_s = cpuSeconds(RUSAGE_SELF) - process_cpu_start;
+  double loopback_megabytes_per_s = static_cast<double>(loopbackBytes() - loopback_bytes_start) / elapsed_s / 1e6;
+
+  auto megabytes_per_s = [elapsed_s](DeliveryCounters const &counters) -> double {
+    return static_cast<double>(counters.byte_count) / elapsed_s / 1e6;
+  };
+  auto per_subscriber_hz = [elapsed_s](DeliveryCounters const &counters, int count) -> double {
+    return count == 0 ? 0 : static_cast<double>(counters.message_count) / elapsed_s / count;
+  };
+  std::cout << std::fixed << std::setprecision(2)
+            << (publisher_decimates ? "decimated by publisher:" : "discarded by subscriber callback:") << std::endl
+            << "  full rate subscribers:  " << per_subscriber_hz(full_rate_counters, full_rate_count) << " Hz each, "
+            << megabytes_per_s(full_rate_counters) << " MB/s delivered" << std::endl
+            << "  throttled subscribers:  " << per_subscriber_hz(throttled_counters, throttled_count) << " Hz each, "
+            << megabytes_per_s(throttled_counters) << " MB/s delivered" << std::endl
+            << "  loopback traffic:       " << loopback_megabytes_per_s << " MB/s" << std::endl
+            << "  publisher thread cpu:   " << 100 * publisher_cpu_s / elapsed_s << " %" << std::endl
+            << "  process cpu:            " << 100 * process_cpu_s / elapsed_s << " %" << std::endl;
+}
+
+/**
+ * Benchmark the cost of subscribers that need a lower rate than a topic is published at, comparing the publisher
+ * decimating for them with them receiving every message and discarding most in their callbacks.
+ *
+ * Usage: benchmark_throttled_subscribers [full_rate_count] [throttled_count] [rate_hz] [max_rate_hz] [size_bytes]
+ *                                        [duration_s] [port]
+ *
+ * Loopback traffic counts every byte over the loopback interface, so the host should otherwise be quiet. Publisher
+ * thread CPU counts encoding and sending. Process CPU also counts receiving, queueing, and decoding, which the
+ * throttled subscribers do for every message when the publisher does not decimate for them.
+ */
+int main(int argc, char **argv) {
+  int full_rate_count = argc > 1 ? std::stoi(argv[1]) : 1;
+  int throttled_count = argc > 2 ? std::stoi(argv[2]) : 4;
+  double rate_hz = argc > 3 ? std::stod(argv[3]) : 200;
+  double max_rate_hz = argc > 4 ? std::stod(argv[4]) : 2;
+  std::size_t size_bytes = argc > 5 ? std::stoul(argv[5]) : 100000;
+  double duration_s = argc > 6 ? std::stod(argv[6]) : 5;
+  int port = argc > 7 ? std::stoi(argv[7]) : 13341;
+
+  MROS::init(argc, argv);
+  std::thread mediator_thread([port]() -> void { Mediator mediator("127.0.0.1", port); });
+  std::this_thread::sleep_for(500ms);
+
+  std::cout << full_rate_count << " full rate and " << throttled_count << " throttled subscribers, " << rate_hz
+            << " Hz published, " << max_rate_hz << " Hz wanted by throttled subscribers, " << size_bytes
+            << " byte messages" << std::endl;
+  runPhase(false, full_rate_count, throttled_count, rate_hz, max_rate_hz, size_bytes, duration_s, port);
+  runPhase(true, full_rate_count, throttled_count, rate_hz, max_rate_hz, size_bytes, duration_s, port);
+
+  // Stop the Mediator the same way ctrl+C does.
+  std::raise(SIGINT);
+  mediator_thread.join();
+  return 0;
+}
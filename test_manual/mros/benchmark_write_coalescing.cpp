@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mediator/mediator.hpp"
+#include "messages/example_message.hpp"
+#include "mros/node.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Way a phase of the benchmark writes its messages.
+ */
+struct WriteMode {
+  std::string name;
+  bool tcp_no_delay;
+  std::chrono::microseconds coalesce_delay;
+};
+
+/**
+ * Latencies from publishing to the subscriber callback, in microseconds.
+ */
+struct LatencyRecorder {
+  std::vector<double> latencies_us;
+  std::mutex mutex;
+};
+
+/**
+ * Get a percentile of sorted values, or zero if there are none.
+ */
+static double percentile(std::vector<double> const &sorted_values, double fraction) {
+  if (sorted_values.empty()) return 0;
+  auto index = static_cast<std::size_t>(fraction * static_cast<double>(sorted_values.size() - 1));
+  return sorted_values[index];
+}
+
+/**
+ * Run one phase of the benchmark: a publisher sending small messages at a fixed rate to one subscriber, which records
+ * the latency of each message from the publish time stamped into it.
+ */
+static void runPhase(WriteMode const &mode, double rate_hz, std::size_t size_bytes, double duration_s, int port,
+                     int phase) {
+  std::string topic_name = "coalescing_topic_" + std::to_string(phase);
+  LatencyRecorder recorder;
+  auto subscribing_node = std::make_shared<Node>("subscriber_" + std::to_string(phase), "127.0.0.1", port);
+  auto subscriber = subscribing_node->createSubscriber<StringMessage>(
+      topic_name, 1000000, [&recorder](StringMessage const &message) -> void {
+        auto received_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch());
+        double latency_us = static_cast<double>(received_ns.count() - std::stoll(message.data)) / 1000;
+        std::lock_guard<std::mutex> recorder_lock_guard(recorder.mutex);
+        recorder.latencies_us.push_back(latency_us);
+      });
+  subscriber->spin();
+
+  PublisherOptions options;
+  options.tcp_no_delay = mode.tcp_no_delay;
+  options.coalesce_delay = mode.coalesce_delay;
+  auto publishing_node = std::make_shared<Node>("publisher_" + std::to_string(phase), "127.0.0.1", port);
+  auto publisher = publishing_node->createPublisher<StringMessage>(topic_name, options);
+  while (!publisher->hasSubscribers()) std::this_thread::sleep_for(10ms);
+
+  // Publish at the rate, stamping each message with its publish time and padding it to the size.
+  auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1 / rate_hz));
+  auto message_count = static_cast<std::uint64_t>(duration_s * rate_hz);
+  StringMessage message;
+  auto start = Clock::now();
+  for (std::uint64_t i = 0; i < message_count; ++i) {
+    std::this_thread::sleep_until(start + i * interval);
+    message.data = std::to_string(Clock::now().time_since_epoch().count());
+    message.data.resize(std::max(size_bytes, message.data.size()), ' ');
+    publisher->publish(message);
+  }
+  double elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+  std::this_thread::sleep_for(200ms);
+
+  PublisherSendStatistics statistics = publisher->sendStatistics();
+  std::vector<double> latencies_us;
+  {
+    std::lock_guard<std::mutex> recorder_lock_guard(recorder.mutex);
+    latencies_us = recorder.latencies_us;
+  }
+  std::sort(latencies_us.begin(), latencies_us.end());
+  double writes_per_message =
+      statistics.frame_count == 0 ? 0 : static_cast<double>(statistics.write_count) / statistics.frame_count;
+  std::cout << std::fixed << std::setprecision(2) << "  " << std::setw(22) << std::left << mode.name << std::right
+            << std::setw(10) << static_cast<double>(message_count) / elapsed_s << " Hz sent " << std::setw(8)
+            << latencies_us.size() << " received " << std::setw(6) << writes_per_message
+            << " writes/msg  latency us p50 " << std::setw(8) << percentile(latencies_us, 0.5) << " p99 " << std::setw(8)
+            << percentile(latencies_us, 0.99) << " max " << std::setw(9) << percentile(latencies_us, 1) << std::endl;
+}
+
+/**
+ * Benchmark writing small messages at several rates with Nagle's algorithm, with TCP_NODELAY, and with writes
+ * coalesced under a latency bound, reporting the writes to the subscriber connection per message, each one sendmsg()
+ * call, and the latency from publishing to the subscriber callback.
+ *
+ * Usage: benchmark_write_coalescing [size_bytes] [duration_s] [coalesce_delay_us] [port]
+ */
+int main(int argc, char **argv) {
+  std::size_t size_bytes = argc > 1 ? std::stoul(argv[1]) : 64;
+  double duration_s = argc > 2 ? std::stod(argv[2]) : 2;
+  std::chrono::microseconds coalesce_delay(argc > 3 ? std::stol(argv[3]) : 200);
+  int port = argc > 4 ? std::stoi(argv[4]) : 13342;
+
+  MROS::init(argc, argv);
+  std::thread mediator_thread([port]() -> void { Mediator mediator("127.0.0.1", port); });
+  std::this_thread::sleep_for(500ms);
+
+  std::vector<WriteMode> modes = {
+      {"nagle", false, std::chrono::microseconds(0)},
+      {"tcp_no_delay", true, std::chrono::microseconds(0)},
+      {"coalesced " + std::to_string(coalesce_delay.count()) + "us", true, coalesce_delay},
+  };
+  int phase = 0;
+  for (double rate_hz : {100.0, 1000.0, 10000.0, 50000.0}) {
+    std::cout << size_bytes << " byte messages at " << rate_hz << " Hz:" << std::endl;
+    for (auto const &mode : modes) runPhase(mode, rate_hz, size_bytes, duration_s, port, phase++);
+  }
+
+  // Stop the Mediator the same way ctrl+C does.
+  std::raise(SIGINT);
+  mediator_thread.join();
+  return 0;
+}
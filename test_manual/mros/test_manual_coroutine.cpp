@@ -0,0 +1,27 @@
+#include "messages/example_message.hpp"
+#include "mros/node.hpp"
+
+/**
+ * Print each message on the topic, and every tenth message ask the Mediator how many Nodes there are, all without
+ * holding a thread while waiting.
+ */
+Flow printMessages(std::shared_ptr<Node> node, std::shared_ptr<Subscriber<StringMessage>> subscriber) {
+  GraphRequest graph_request{false, 0};
+  for (int count = 1;; ++count) {
+    StringMessage message = co_await subscriber->next();
+    std::cout << "awaited: " << message.data << std::endl;
+    if (count % 10 == 0) {
+      GraphUpdate graph = co_await node->callMediator(kGetGraphRPC, graph_request);
+      std::cout << "nodes: " << graph.nodes.size() << std::endl;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  MROS::init(argc, argv);
+  auto test_node = std::make_shared<Node>("test coroutine node");
+  auto subscriber = test_node->createSubscriber<StringMessage>("test topic", 15);
+  test_node->spawn(printMessages(test_node, subscriber));
+  test_node->spin();
+  return 0;
+}
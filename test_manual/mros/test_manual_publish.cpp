@@ -4,20 +4,18 @@
 using namespace std::chrono_literals;
 
 int main(int argc, char** argv) {
-  StringMessage message;
-
   MROS::init(argc, argv);
-  MROS& mros = MROS::getMROS();
   auto test_node = std::make_shared<Node>("test node");
   auto publisher = test_node->createPublisher<StringMessage>("test topic");
 
+  // Publish from a timer on the Node's executor rather than a loop, so that the deadlines do not drift.
   int count = 0;
-  while (mros.active()) {
+  auto timer = test_node->createTimer(100ms, [&publisher, &count]() -> void {
+    StringMessage message;
     message.data = std::to_string(count);
     ++count;
-
     publisher->publish(message);
-    std::this_thread::sleep_for(100ms);
-  }
+  });
+  test_node->spin();
   return 0;
 }
@@ -0,0 +1,23 @@
+#include "messages/example_message.hpp"
+#include "mros/node.hpp"
+
+using namespace std::chrono_literals;
+
+void callback(StringMessage const& msg) { std::cout << "called callback with: " << msg.data << std::endl; }
+
+int main(int argc, char** argv) {
+  MROS::init(argc, argv);
+  auto test_node = std::make_shared<Node>("test node");
+  auto subscriber = test_node->createSubscriber<StringMessage>("test topic", 15, &callback);
+
+  // Run the callbacks on this thread, waking only for messages, the status timer, or ctrl+C.
+  WaitSet wait_set;
+  wait_set.addSubscriber(subscriber);
+  int status_count = 0;
+  wait_set.addTimer(1s, [&status_count]() -> void { std::cout << "status " << ++status_count << std::endl; });
+  auto stop = std::make_shared<GuardCondition>();
+  wait_set.addGuardCondition(stop);
+  MROS::getMROS().registerDeactivateRoutine([stop]() -> void { stop->trigger(); });
+  while (MROS::getMROS().active()) wait_set.spinSome(-1s);
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket/bson_rpc_socket/client_bson_rpc_socket.hpp"
+#include "socket/bson_rpc_socket/connection_bson_rpc_socket.hpp"
+#include "socket/server_socket.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Benchmark RPC round trips between a client and a connection socket over loopback.
+ *
+ * Usage: benchmark_bson_rpc_socket [request_count] [port]
+ *
+ * Reports sequential round trip latency, pipelined round trip throughput with many requests in flight, and one way
+ * request throughput. The request is a small Mediator style message.
+ */
+int main(int argc, char** argv) {
+  int request_count = argc > 1 ? std::stoi(argv[1]) : 20000;
+  int port = argc > 2 ? std::stoi(argv[2]) : 13336;
+  json request = {{"topic_name", "/benchmark/topic"}, {"address", "127.0.0.1"}, {"port", 40000}};
+
+  // Connect a client and a connection socket. The connection socket answers requests and counts one way requests.
+  std::atomic<int> one_way_count = 0;
+  ServerSocket server_socket(AF_INET, "127.0.0.1", port, 1);
+  auto client_socket = std::make_shared<ClientBsonRPCSocket>(AF_INET, "127.0.0.1", port);
+  std::shared_ptr<ConnectionBsonRPCSocket> connection_socket;
+  std::thread server_thread([&]() -> void {
+    while (!connection_socket) connection_socket = server_socket.acceptConnection<ConnectionBsonRPCSocket>();
+    connection_socket->registerRequestResponseCallback("echo", [](json const& input) -> json { return input; });
+    connection_socket->registerRequestCallback("count", [&one_way_count](json const&) -> void {
+      ++one_way_count;
+    });
+    connection_socket->startConnection();
+  });
+  client_socket->connectToServer();
+  server_thread.join();
+
+  // Sequential round trips, one request in flight.
+  std::vector<Clock::duration> latencies;
+  latencies.reserve(request_count);
+  auto sequential_start = Clock::now();
+  for (int i = 0; i < request_count; ++i) {
+    auto start = Clock::now();
+    client_socket->sendRequestAndGetFuture("echo", request).get();
+    latencies.push_back(Clock::now() - start);
+  }
+  double sequential_seconds = std::chrono::duration<double>(Clock::now() - sequential_start).count();
+  std::sort(latencies.begin(), latencies.end());
+  auto microseconds = [](Clock::duration duration) -> double {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+
+  // Pipelined round trips, many requests in flight.
+  const std::size_t kInFlight = 64;
+  std::deque<std::future<json>> in_flight;
+  auto pipelined_start = Clock::now();
+  for (int i = 0; i < request_count; ++i) {
+    if (in_flight.size() == kInFlight) {
+      in_flight.front().get();
+      in_flight.pop_front();
+    }
+    in_flight.push_back(client_socket->sendRequestAndGetFuture("echo", request));
+  }
+  for (auto& future : in_flight) future.get();
+  double pipelined_seconds = std::chrono::duration<double>(Clock::now() - pipelined_start).count();
+
+  // One way requests, finished once the peer has handled all of them.
+  auto one_way_start = Clock::now();
+  for (int i = 0; i < request_count; ++i) client_socket->sendRequest("count", request);
+  while (one_way_count < request_count) std::this_thread::yield();
+  double one_way_seconds = std::chrono::duration<double>(Clock::now() - one_way_start).count();
+
+  std::cout << "sequential round trip:  " << request_count / sequential_seconds << " req/s, p50 "
+            << microseconds(latencies[latencies.size() / 2]) << " us, p99 "
+            << microseconds(latencies[latencies.size() * 99 / 100]) << " us" << std::endl;
+  std::cout << "pipelined round trip:   " << request_count / pipelined_seconds << " req/s (" << kInFlight
+            << " in flight)" << std::endl;
+  std::cout << "one way request:        " << request_count / one_way_seconds << " req/s" << std::endl;
+
+  client_socket->close();
+  server_socket.close();
+  return 0;
+}